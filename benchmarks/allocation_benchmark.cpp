@@ -0,0 +1,133 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Counts heap allocations made while parsing, copying and compiling SPIR-V modules to GLSL.
+// The view phase creates a compiler from a copy-on-write view of a shared ParsedIR instead of a full copy.
+// Usage: spirv-cross-alloc-bench <file.spv>...
+
+#include "spirv_glsl.hpp"
+#include "spirv_parser.hpp"
+#include "../tests-other/test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+static size_t allocation_count;
+
+void *operator new(size_t size)
+{
+	allocation_count++;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw bad_alloc();
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-alloc-bench <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t parse_total = 0;
+	size_t copy_total = 0;
+	size_t view_total = 0;
+	size_t view_compile_total = 0;
+	size_t compile_total = 0;
+	size_t recompile_total = 0;
+	unsigned modules = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		try
+		{
+			size_t start = allocation_count;
+			Parser parser(spirv.data(), spirv.size(), true);
+			parser.parse();
+			size_t parse_count = allocation_count - start;
+
+			start = allocation_count;
+			CompilerGLSL compiler(parser.get_parsed_ir());
+			size_t copy_count = allocation_count - start;
+
+			auto opts = compiler.get_common_options();
+			if (!opts.version)
+				opts.version = 450;
+			compiler.set_common_options(opts);
+
+			start = allocation_count;
+			compiler.compile();
+			size_t compile_count = allocation_count - start;
+
+			// A second compile() goes through reset() and recycles expressions from the previous run.
+			start = allocation_count;
+			compiler.compile();
+			size_t recompile_count = allocation_count - start;
+
+			auto shared_ir = make_shared<const ParsedIR>(move(parser.get_parsed_ir()));
+			start = allocation_count;
+			CompilerGLSL view_compiler(ParsedIR{ shared_ir });
+			size_t view_count = allocation_count - start;
+			view_compiler.set_common_options(opts);
+
+			start = allocation_count;
+			view_compiler.compile();
+			size_t view_compile_count = allocation_count - start;
+
+			printf("%s: parse %u, copy %u, compile %u, recompile %u, view %u, view compile %u\n", argv[i],
+			       unsigned(parse_count), unsigned(copy_count), unsigned(compile_count), unsigned(recompile_count),
+			       unsigned(view_count), unsigned(view_compile_count));
+
+			parse_total += parse_count;
+			copy_total += copy_count;
+			view_total += view_count;
+			view_compile_total += view_compile_count;
+			compile_total += compile_count;
+			recompile_total += recompile_count;
+			modules++;
+		}
+		catch (const exception &e)
+		{
+			fprintf(stderr, "%s: %s\n", argv[i], e.what());
+		}
+	}
+
+	printf("Total: %u modules, parse %u, copy %u, compile %u, recompile %u, view %u, view compile %u\n", modules,
+	       unsigned(parse_total), unsigned(copy_total), unsigned(compile_total), unsigned(recompile_total),
+	       unsigned(view_total), unsigned(view_compile_total));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the cost of decoration and name lookups, the queries emitters make for nearly every ID they touch.
+// Usage: spirv-cross-decoration-bench [--iterations <count>] <file.spv>...
+
+#include "spirv_cross.hpp"
+#include "spirv_parser.hpp"
+#include "../tests-other/test_common.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace spv;
+using namespace std;
+using namespace spirv_cross_test;
+
+int main(int argc, char *argv[])
+{
+	uint32_t iterations = 1000;
+	vector<const char *> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+			iterations = uint32_t(strtoul(argv[++i], nullptr, 0));
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.empty() || iterations == 0)
+	{
+		fprintf(stderr, "Usage: spirv-cross-decoration-bench [--iterations <count>] <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t total_lookups = 0;
+	double total_seconds = 0.0;
+	uint32_t checksum = 0;
+
+	for (auto *path : paths)
+	{
+		auto spirv = read_spirv_file(path);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		try
+		{
+			Parser parser(spirv.data(), spirv.size(), true);
+			parser.parse();
+			Compiler compiler(move(parser.get_parsed_ir()));
+			uint32_t bound = compiler.get_current_id_bound();
+
+			auto start = chrono::steady_clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				for (uint32_t id = 1; id < bound; id++)
+				{
+					checksum += compiler.get_decoration(id, DecorationLocation);
+					checksum += compiler.get_decoration(id, DecorationBinding);
+					checksum += compiler.has_decoration(id, DecorationBlock);
+					checksum += compiler.get_member_decoration(id, 0, DecorationOffset);
+					checksum += uint32_t(compiler.get_name(id).size());
+				}
+			}
+			auto end = chrono::steady_clock::now();
+
+			double seconds = chrono::duration<double>(end - start).count();
+			size_t lookups = size_t(bound - 1) * 5 * iterations;
+			printf("%s: %.2f ns/lookup\n", path, 1e9 * seconds / lookups);
+
+			total_lookups += lookups;
+			total_seconds += seconds;
+		}
+		catch (const exception &e)
+		{
+			fprintf(stderr, "%s: %s\n", path, e.what());
+		}
+	}
+
+	// Print the checksum so the lookups cannot be optimized away.
+	printf("Total: %u modules, %.2f ns/lookup (checksum %u)\n", unsigned(paths.size()),
+	       1e9 * total_seconds / total_lookups, checksum);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+
+# Compiles every shader in the shaders*/ directories to SPIR-V, for spirv-cross-bench.
+# The shaders are compiled the same way test_shaders.py compiles them, without spirv-opt.
+# Shaders which fail to compile are skipped with a warning.
+# Usage: make_fixtures.py <output directory>
+
+import os
+import subprocess
+import sys
+
+def compile_shader(shader, spirv_path):
+    if '.asm.' in shader:
+        cmd = ['spirv-as', '-o', spirv_path, shader]
+        if '.preserve.' in shader:
+            cmd.append('--preserve-numeric-ids')
+    else:
+        cmd = ['glslangValidator', '--target-env', 'vulkan1.1', '-V', '-o', spirv_path, shader]
+    subprocess.check_call(cmd, stdout = subprocess.DEVNULL)
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write('Usage: make_fixtures.py <output directory>\n')
+        sys.exit(1)
+
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    output_dir = sys.argv[1]
+    if not os.path.isdir(output_dir):
+        os.makedirs(output_dir)
+
+    count = 0
+    shader_dirs = sorted(d for d in os.listdir(root) if d.startswith('shaders') and os.path.isdir(os.path.join(root, d)))
+    for shader_dir in shader_dirs:
+        for directory, _, files in os.walk(os.path.join(root, shader_dir)):
+            for f in sorted(files):
+                shader = os.path.join(directory, f)
+                relpath = os.path.relpath(shader, root)
+                spirv_path = os.path.join(output_dir, relpath.replace(os.sep, '__') + '.spv')
+                try:
+                    compile_shader(shader, spirv_path)
+                    count += 1
+                except (subprocess.CalledProcessError, OSError) as e:
+                    sys.stderr.write('Skipping {}: {}\n'.format(relpath, e))
+
+    print('Wrote {} SPIR-V modules to {}.'.format(count, output_dir))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the throughput of Parser::parse() over a set of SPIR-V modules.
+// Usage: spirv-cross-parse-bench [--iterations <count>] <file.spv>...
+
+#include "spirv_parser.hpp"
+#include "../tests-other/test_common.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+int main(int argc, char *argv[])
+{
+	uint32_t iterations = 1000;
+	vector<const char *> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+			iterations = uint32_t(strtoul(argv[++i], nullptr, 0));
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.empty() || iterations == 0)
+	{
+		fprintf(stderr, "Usage: spirv-cross-parse-bench [--iterations <count>] <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t total_words = 0;
+	double total_seconds = 0.0;
+
+	for (auto *path : paths)
+	{
+		auto spirv = read_spirv_file(path);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		auto start = chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			// Borrow the words so we only measure decoding, not copying the module.
+			Parser parser(spirv.data(), spirv.size(), true);
+			parser.parse();
+		}
+		auto end = chrono::steady_clock::now();
+
+		double seconds = chrono::duration<double>(end - start).count();
+
+		double bytes = double(spirv.size() * sizeof(uint32_t)) * iterations;
+		printf("%s: %.3f us/parse, %.1f MB/s\n", path, 1e6 * seconds / iterations, bytes / (seconds * 1e6));
+
+		total_words += spirv.size();
+		total_seconds += seconds;
+	}
+
+	double total_bytes = double(total_words * sizeof(uint32_t)) * iterations;
+	printf("Total: %u modules, %.1f MB/s\n", unsigned(paths.size()), total_bytes / (total_seconds * 1e6));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures parsing, reflection with get_shader_resources() and compile() for each backend over a set of modules,
+// usually the whole shader corpus as built by benchmarks/make_fixtures.py.
+// Every phase reports throughput, p50/p99 latency and heap allocations per operation,
+// and --json writes the results in a form which can be diffed between versions.
+// Usage: spirv-cross-bench [--iterations <count>] [--json <path>] <file.spv>...
+
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include "spirv_parser.hpp"
+#include "spirv_reflect.hpp"
+#include "../tests-other/test_common.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+static size_t allocation_count;
+static size_t allocation_bytes;
+
+void *operator new(size_t size)
+{
+	allocation_count++;
+	allocation_bytes += size;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw bad_alloc();
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+// In kilobytes, or 0 where the platform has no cheap way to ask.
+static uint64_t peak_rss_kb()
+{
+#if defined(__APPLE__)
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? uint64_t(usage.ru_maxrss) / 1024 : 0;
+#elif defined(__unix__)
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? uint64_t(usage.ru_maxrss) : 0;
+#else
+	return 0;
+#endif
+}
+
+enum Phase
+{
+	PhaseParse,
+	PhaseReflect,
+	PhaseGLSL,
+	PhaseHLSL,
+	PhaseMSL,
+	PhaseJSON,
+	PhaseCount
+};
+
+static const char *phase_names[PhaseCount] = { "parse", "reflect", "glsl", "hlsl", "msl", "json" };
+
+struct PhaseResults
+{
+	// Seconds per operation, over every iteration of every module.
+	vector<double> samples;
+	size_t allocations = 0;
+	size_t allocated_bytes = 0;
+
+	// Modules where the phase threw, e.g. because a backend does not support a feature.
+	uint32_t failed_modules = 0;
+};
+
+struct PhaseSummary
+{
+	double ops_per_second;
+	double p50;
+	double p99;
+	double allocations_per_op;
+	double allocated_bytes_per_op;
+};
+
+struct ModuleResults
+{
+	const char *path;
+	size_t word_count;
+
+	// Median seconds per phase, or a negative value if the phase failed.
+	double median[PhaseCount];
+};
+
+static unique_ptr<CompilerGLSL> create_compiler(Phase phase, const shared_ptr<const ParsedIR> &ir)
+{
+	// Every compiler gets a copy-on-write view of the parsed module, so creating one costs next to nothing.
+	switch (phase)
+	{
+	case PhaseHLSL:
+	{
+		auto *hlsl = new CompilerHLSL(ParsedIR(ir));
+		auto opts = hlsl->get_hlsl_options();
+		opts.shader_model = 50;
+		hlsl->set_hlsl_options(opts);
+		return unique_ptr<CompilerGLSL>(hlsl);
+	}
+
+	case PhaseMSL:
+		return unique_ptr<CompilerGLSL>(new CompilerMSL(ParsedIR(ir)));
+
+	case PhaseJSON:
+		return unique_ptr<CompilerGLSL>(new CompilerReflection(ParsedIR(ir)));
+
+	default:
+	{
+		unique_ptr<CompilerGLSL> glsl(new CompilerGLSL(ParsedIR(ir)));
+		auto opts = glsl->get_common_options();
+		if (!opts.version)
+			opts.version = 450;
+		glsl->set_common_options(opts);
+		return glsl;
+	}
+	}
+}
+
+// Runs one operation of a phase, and returns how long the measured part took.
+// The allocations made by the measured part are added to results, unless it is null.
+static double run_phase(Phase phase, const vector<uint32_t> &spirv, const shared_ptr<const ParsedIR> &ir,
+                        PhaseResults *results)
+{
+	unique_ptr<CompilerGLSL> compiler;
+	if (phase != PhaseParse)
+		compiler = create_compiler(phase, ir);
+
+	size_t start_count = allocation_count;
+	size_t start_bytes = allocation_bytes;
+	auto start = chrono::steady_clock::now();
+
+	if (phase == PhaseParse)
+	{
+		// Borrow the words so we only measure decoding, not copying the module.
+		Parser parser(spirv.data(), spirv.size(), true);
+		parser.parse();
+	}
+	else if (phase == PhaseReflect)
+		compiler->get_shader_resources();
+	else
+		compiler->compile();
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (results)
+	{
+		results->allocations += allocation_count - start_count;
+		results->allocated_bytes += allocation_bytes - start_bytes;
+	}
+	return seconds;
+}
+
+static double percentile(vector<double> samples, double p)
+{
+	if (samples.empty())
+		return 0.0;
+	size_t index = min(samples.size() - 1, size_t(p * samples.size()));
+	nth_element(begin(samples), begin(samples) + index, end(samples));
+	return samples[index];
+}
+
+static PhaseSummary summarize(const PhaseResults &phase)
+{
+	double total = 0.0;
+	for (auto sample : phase.samples)
+		total += sample;
+
+	double ops = double(max<size_t>(phase.samples.size(), 1));
+	PhaseSummary summary;
+	summary.ops_per_second = total > 0.0 ? phase.samples.size() / total : 0.0;
+	summary.p50 = percentile(phase.samples, 0.5);
+	summary.p99 = percentile(phase.samples, 0.99);
+	summary.allocations_per_op = phase.allocations / ops;
+	summary.allocated_bytes_per_op = phase.allocated_bytes / ops;
+	return summary;
+}
+
+static void write_json_string(FILE *file, const char *str)
+{
+	fputc('"', file);
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			fputc('\\', file);
+		fputc(*str, file);
+	}
+	fputc('"', file);
+}
+
+static bool write_json(const char *path, uint32_t iterations, const PhaseResults *phases,
+                       const vector<ModuleResults> &modules)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to write file: %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "    \"iterations\" : %u,\n", iterations);
+	fprintf(file, "    \"modules\" : %u,\n", unsigned(modules.size()));
+	fprintf(file, "    \"peak_rss_kb\" : %llu,\n", static_cast<unsigned long long>(peak_rss_kb()));
+
+	fprintf(file, "    \"phases\" : {");
+	for (int p = 0; p < PhaseCount; p++)
+	{
+		auto summary = summarize(phases[p]);
+		fprintf(file, "%s\n        \"%s\" : {\n", p ? "," : "", phase_names[p]);
+		fprintf(file, "            \"ops\" : %u,\n", unsigned(phases[p].samples.size()));
+		fprintf(file, "            \"failed_modules\" : %u,\n", phases[p].failed_modules);
+		fprintf(file, "            \"ops_per_second\" : %.3f,\n", summary.ops_per_second);
+		fprintf(file, "            \"p50_us\" : %.3f,\n", 1e6 * summary.p50);
+		fprintf(file, "            \"p99_us\" : %.3f,\n", 1e6 * summary.p99);
+		fprintf(file, "            \"allocations_per_op\" : %.1f,\n", summary.allocations_per_op);
+		fprintf(file, "            \"allocated_bytes_per_op\" : %.1f\n", summary.allocated_bytes_per_op);
+		fprintf(file, "        }");
+	}
+	fprintf(file, "\n    },\n");
+
+	// Per module medians, so a regression can be traced to the shaders it affects.
+	fprintf(file, "    \"module_medians_us\" : [");
+	for (size_t i = 0; i < modules.size(); i++)
+	{
+		auto &module = modules[i];
+		fprintf(file, "%s\n        { \"path\" : ", i ? "," : "");
+		write_json_string(file, module.path);
+		fprintf(file, ", \"words\" : %u", unsigned(module.word_count));
+		for (int p = 0; p < PhaseCount; p++)
+		{
+			if (module.median[p] < 0.0)
+				fprintf(file, ", \"%s\" : null", phase_names[p]);
+			else
+				fprintf(file, ", \"%s\" : %.3f", phase_names[p], 1e6 * module.median[p]);
+		}
+		fprintf(file, " }");
+	}
+	fprintf(file, "\n    ]\n");
+	fprintf(file, "}\n");
+
+	bool success = !ferror(file);
+	fclose(file);
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t iterations = 20;
+	const char *json_path = nullptr;
+	vector<const char *> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+			iterations = uint32_t(strtoul(argv[++i], nullptr, 0));
+		else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+			json_path = argv[++i];
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.empty() || iterations == 0)
+	{
+		fprintf(stderr, "Usage: spirv-cross-bench [--iterations <count>] [--json <path>] <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	PhaseResults phases[PhaseCount];
+	vector<ModuleResults> modules;
+	vector<double> module_samples;
+
+	for (auto *path : paths)
+	{
+		auto spirv = read_spirv_file(path);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		ModuleResults module = { path, spirv.size(), {} };
+		shared_ptr<const ParsedIR> ir;
+
+		for (int p = 0; p < PhaseCount; p++)
+		{
+			auto phase = Phase(p);
+			module.median[p] = -1.0;
+
+			try
+			{
+				// The first run warms up caches and finds modules the phase cannot handle, and is not counted.
+				if (phase != PhaseParse)
+					run_phase(phase, spirv, ir, nullptr);
+
+				module_samples.clear();
+				for (uint32_t i = 0; i < iterations; i++)
+					module_samples.push_back(run_phase(phase, spirv, ir, &phases[p]));
+
+				phases[p].samples.insert(end(phases[p].samples), begin(module_samples), end(module_samples));
+				module.median[p] = percentile(module_samples, 0.5);
+
+				if (phase == PhaseParse)
+				{
+					Parser parser(spirv.data(), spirv.size());
+					parser.parse();
+					ir = make_shared<const ParsedIR>(move(parser.get_parsed_ir()));
+				}
+			}
+			catch (const exception &e)
+			{
+				fprintf(stderr, "%s: %s: %s\n", path, phase_names[p], e.what());
+				phases[p].failed_modules++;
+				if (phase == PhaseParse)
+					break;
+			}
+		}
+
+		modules.push_back(module);
+	}
+
+	printf("%u modules, %u iterations each, peak RSS %llu KiB\n", unsigned(modules.size()), iterations,
+	       static_cast<unsigned long long>(peak_rss_kb()));
+	for (int p = 0; p < PhaseCount; p++)
+	{
+		auto summary = summarize(phases[p]);
+		printf("%-8s %10.1f ops/s, p50 %9.3f us, p99 %9.3f us, %8.1f allocations/op, %u modules failed\n",
+		       phase_names[p], summary.ops_per_second, 1e6 * summary.p50, 1e6 * summary.p99,
+		       summary.allocations_per_op, phases[p].failed_modules);
+	}
+
+	if (json_path && !write_json(json_path, iterations, phases, modules))
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures join() and convert_to_string() against the ostringstream, std::to_string() and sprintf() versions
+// they replaced, on the kind of pieces emitters glue together, and checks that both give the same text.
+// Usage: spirv-cross-string-bench [--iterations <count>]
+
+#include "spirv_common.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace spirv_cross;
+using namespace std;
+
+template <typename... Ts>
+static string ostringstream_join(Ts &&... ts)
+{
+	ostringstream stream;
+	stream.imbue(locale::classic());
+	inner::join_helper(stream, std::forward<Ts>(ts)...);
+	return stream.str();
+}
+
+static string sprintf_convert_to_string(double t)
+{
+	char buf[64];
+	sprintf(buf, SPIRV_CROSS_FLT_FMT, t);
+	fixup_radix_point(buf);
+	if (!strchr(buf, '.') && !strchr(buf, 'e'))
+		strcat(buf, ".0");
+	return buf;
+}
+
+struct Result
+{
+	double seconds = 0.0;
+	size_t checksum = 0;
+};
+
+template <typename Op>
+static Result measure(uint32_t iterations, const Op &op)
+{
+	Result result;
+	auto start = chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+		result.checksum += op(i).size();
+	auto end = chrono::steady_clock::now();
+	result.seconds = chrono::duration<double>(end - start).count();
+	return result;
+}
+
+static bool report(const char *name, uint32_t iterations, const Result &before, const Result &after)
+{
+	printf("%-20s %8.1f ns -> %8.1f ns (%.2fx)\n", name, 1e9 * before.seconds / iterations,
+	       1e9 * after.seconds / iterations, before.seconds / after.seconds);
+	if (before.checksum != after.checksum)
+	{
+		fprintf(stderr, "%s: output differs.\n", name);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t iterations = 1000000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+			iterations = uint32_t(strtoul(argv[++i], nullptr, 0));
+		else
+		{
+			fprintf(stderr, "Usage: spirv-cross-string-bench [--iterations <count>]\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (iterations == 0)
+		return EXIT_FAILURE;
+
+	// Every case is checked once up front, as the sums of lengths below would miss reordered characters.
+	const string name = "gl_GlobalInvocationID";
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		int32_t value = int32_t(i * 2654435761u);
+		double d = double(value) / double(1 << (i & 7));
+		if (ostringstream_join(name, "[", i, "].", value, ' ', uint64_t(i) << 40) !=
+		        join(name, "[", i, "].", value, ' ', uint64_t(i) << 40) ||
+		    to_string(value) != convert_to_string(value) || sprintf_convert_to_string(d) != convert_to_string(d) ||
+		    sprintf_convert_to_string(-d) != convert_to_string(-d) ||
+		    sprintf_convert_to_string(d * 1e9) != convert_to_string(d * 1e9))
+		{
+			fprintf(stderr, "Output differs for %u.\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+#ifndef SPIRV_CROSS_NO_THREAD_LOCAL
+	// A long join must not leave the thread with a buffer that large.
+	if (join(string(100000, 'x'), 1).size() != 100001 || StringBuilder::get_thread_builder().capacity() > 4096)
+	{
+		fprintf(stderr, "The join buffer was not shrunk.\n");
+		return EXIT_FAILURE;
+	}
+#endif
+
+	bool ok = true;
+
+	// An expression with an index, as access chains build them.
+	ok &= report("join(expression)", iterations,
+	             measure(iterations, [&](uint32_t i) { return ostringstream_join(name, "[", i & 63, "].x"); }),
+	             measure(iterations, [&](uint32_t i) { return join(name, "[", i & 63, "].x"); }));
+
+	// A declaration with only strings.
+	ok &= report("join(strings)", iterations,
+	             measure(iterations, [&](uint32_t) { return ostringstream_join("vec4 ", name, " = ", name, ";"); }),
+	             measure(iterations, [&](uint32_t) { return join("vec4 ", name, " = ", name, ";"); }));
+
+	// A temporary name.
+	ok &= report("join(temporary)", iterations,
+	             measure(iterations, [](uint32_t i) { return ostringstream_join("_", i); }),
+	             measure(iterations, [](uint32_t i) { return join("_", i); }));
+
+	ok &= report("convert(int)", iterations,
+	             measure(iterations, [](uint32_t i) { return to_string(int32_t(i * 2654435761u)); }),
+	             measure(iterations, [](uint32_t i) { return convert_to_string(int32_t(i * 2654435761u)); }));
+
+	// Half of these are whole numbers.
+	ok &= report("convert(float)", iterations,
+	             measure(iterations, [](uint32_t i) { return sprintf_convert_to_string(double(i) * 0.5); }),
+	             measure(iterations, [](uint32_t i) { return convert_to_string(double(i) * 0.5); }));
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
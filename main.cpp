@@ -15,6 +15,7 @@
  */
 
 #include "spirv_cpp.hpp"
+#include "spirv_cross_cache.hpp"
 #include "spirv_cross_util.hpp"
 #include "spirv_glsl.hpp"
 #include "spirv_hlsl.hpp"
@@ -22,12 +23,16 @@
 #include "spirv_parser.hpp"
 #include "spirv_reflect.hpp"
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <functional>
 #include <limits>
 #include <memory>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -35,6 +40,13 @@
 #pragma warning(disable : 4996)
 #endif
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace spv;
 using namespace spirv_cross;
 using namespace std;
@@ -207,7 +219,142 @@ static vector<uint32_t> read_spirv_file(const char *path)
 	return spirv;
 }
 
-static bool write_string_to_file(const char *path, const char *string)
+// Holds the words of a SPIR-V file for as long as the parsed IR needs them.
+// Where possible the file is memory mapped, so the parser can borrow the words directly
+// instead of reading them into a buffer first.
+class SPIRVFile
+{
+public:
+	SPIRVFile() = default;
+	SPIRVFile(const SPIRVFile &) = delete;
+	void operator=(const SPIRVFile &) = delete;
+
+	~SPIRVFile()
+	{
+#ifndef _WIN32
+		if (mapped)
+			munmap(mapped, mapped_size);
+#endif
+	}
+
+	bool load(const char *path)
+	{
+#ifndef _WIN32
+		int fd = open(path, O_RDONLY);
+		if (fd >= 0)
+		{
+			struct stat s;
+			if (fstat(fd, &s) == 0 && s.st_size >= off_t(sizeof(uint32_t)))
+			{
+				void *ptr = mmap(nullptr, size_t(s.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (ptr != MAP_FAILED)
+				{
+					mapped = ptr;
+					mapped_size = size_t(s.st_size);
+				}
+			}
+			close(fd);
+
+			if (mapped)
+				return true;
+		}
+#endif
+
+		// Fall back to reading the whole file.
+		words = read_spirv_file(path);
+		return !words.empty();
+	}
+
+	const uint32_t *data() const
+	{
+		return mapped ? static_cast<const uint32_t *>(mapped) : words.data();
+	}
+
+	size_t size() const
+	{
+		return mapped ? mapped_size / sizeof(uint32_t) : words.size();
+	}
+
+private:
+	vector<uint32_t> words;
+	void *mapped = nullptr;
+	size_t mapped_size = 0;
+};
+
+// Keeps a copy of the source on its way to the file, for the compile cache.
+class CopyingFileOutputSink : public FileOutputSink
+{
+public:
+	CopyingFileOutputSink(FILE *file_, string *copy_)
+	    : FileOutputSink(file_)
+	    , copy(copy_)
+	{
+	}
+
+	void write(const char *data, size_t size) override
+	{
+		FileOutputSink::write(data, size);
+		if (copy)
+			copy->append(data, size);
+	}
+
+private:
+	string *copy;
+};
+
+// Writes the source straight from the compiler's output buffer to path, or stdout if path is null.
+// If copy is given, the source is appended to it as well, e.g. for the compile cache.
+static bool compile_to_file(CompilerGLSL &compiler, const char *path, string *copy = nullptr)
+{
+	FILE *file = path ? fopen(path, "w") : stdout;
+	if (!file)
+	{
+		fprintf(stderr, "Failed to write file: %s\n", path);
+		return false;
+	}
+
+	CopyingFileOutputSink sink(file, copy);
+	compiler.compile_to(sink);
+	if (path)
+		fclose(file);
+
+	if (sink.failed())
+	{
+		fprintf(stderr, "Failed to write file: %s\n", path ? path : "<stdout>");
+		return false;
+	}
+
+	return true;
+}
+
+static bool write_string_to_file(const char *path, const string &str)
+{
+	FILE *file = path ? fopen(path, "w") : stdout;
+	if (!file)
+	{
+		fprintf(stderr, "Failed to write file: %s\n", path);
+		return false;
+	}
+
+	bool success = fwrite(str.data(), 1, str.size(), file) == str.size();
+	if (path)
+		fclose(file);
+	if (!success)
+		fprintf(stderr, "Failed to write file: %s\n", path ? path : "<stdout>");
+	return success;
+}
+
+static const char *recompile_trigger_names[] = {
+	"expression_invalidated", "expression_read_twice", "forwarding_disallowed", "temporary_hoisted",
+	"phi_temporary_copy",     "ladder_break",          "loop_pattern",          "parameter_written",
+	"constant_array_on_stack", "helper_function",      "header_line",           "image_access",
+};
+static_assert(sizeof(recompile_trigger_names) / sizeof(recompile_trigger_names[0]) == RecompileTriggerCount,
+              "Missing name for a RecompileTrigger.");
+
+// Writes CompileStatistics as JSON. Times are in seconds.
+// parse_time is the time main() spent parsing the SPIR-V.
+static bool write_stats_to_file(const char *path, const CompileStatistics &stats, double parse_time)
 {
 	FILE *file = fopen(path, "w");
 	if (!file)
@@ -216,9 +363,42 @@ static bool write_string_to_file(const char *path, const char *string)
 		return false;
 	}
 
-	fprintf(file, "%s", string);
+	fprintf(file, "{\n");
+	fprintf(file, "    \"parse_time\" : %.9f,\n", parse_time);
+	fprintf(file, "    \"compile_time\" : %.9f,\n", stats.compile_time);
+
+	fprintf(file, "    \"phase_times\" : {\n");
+	fprintf(file, "        \"control_flow_analysis\" : %.9f,\n", stats.control_flow_analysis_time);
+	fprintf(file, "        \"image_and_sampler_analysis\" : %.9f,\n", stats.image_and_sampler_analysis_time);
+	fprintf(file, "        \"active_builtins\" : %.9f", stats.active_builtins_time);
+	for (auto &phase : stats.backend_phase_times)
+		fprintf(file, ",\n        \"%s\" : %.9f", phase.first.c_str(), phase.second);
+	fprintf(file, "\n    },\n");
+
+	fprintf(file, "    \"emit_pass_times\" : [");
+	for (size_t i = 0; i < stats.emit_pass_times.size(); i++)
+		fprintf(file, "%s%.9f", i ? ", " : " ", stats.emit_pass_times[i]);
+	fprintf(file, " ],\n");
+
+	fprintf(file, "    \"expressions_created\" : %u,\n", stats.expressions_created);
+	fprintf(file, "    \"temporaries_forced\" : %u,\n", stats.temporaries_forced);
+	fprintf(file, "    \"bytes_emitted\" : %llu,\n", static_cast<unsigned long long>(stats.bytes_emitted));
+
+	auto &recompile = stats.recompile;
+	fprintf(file, "    \"recompile\" : {\n");
+	fprintf(file, "        \"full_passes\" : %u,\n", recompile.full_passes);
+	fprintf(file, "        \"function_passes\" : %u,\n", recompile.function_passes);
+	fprintf(file, "        \"helper_passes\" : %u,\n", recompile.helper_passes);
+	fprintf(file, "        \"triggers\" : {");
+	for (uint32_t i = 0; i < RecompileTriggerCount; i++)
+		fprintf(file, "%s\n            \"%s\" : %u", i ? "," : "", recompile_trigger_names[i], recompile.triggers[i]);
+	fprintf(file, "\n        }\n");
+	fprintf(file, "    }\n");
+	fprintf(file, "}\n");
+
+	bool success = !ferror(file);
 	fclose(file);
-	return true;
+	return success;
 }
 
 static void print_resources(const Compiler &compiler, const char *tag, const vector<Resource> &resources)
@@ -475,6 +655,11 @@ struct CLIArguments
 	const char *input = nullptr;
 	const char *output = nullptr;
 	const char *cpp_interface_name = nullptr;
+	const char *stats = nullptr;
+	const char *batch = nullptr;
+	uint32_t batch_threads = 0;
+	const char *cache_dir = nullptr;
+	uint32_t cache_size = 256;
 	uint32_t version = 0;
 	uint32_t shader_model = 0;
 	uint32_t msl_version = 0;
@@ -524,6 +709,9 @@ struct CLIArguments
 	bool flatten_multidimensional_arrays = false;
 	bool use_420pack_extension = true;
 	bool remove_unused = false;
+	bool fold_spec_constants = false;
+	bool remove_unused_ir = false;
+	bool eliminate_common_subexpressions = false;
 	bool combined_samplers_inherit_bindings = false;
 };
 
@@ -565,6 +753,9 @@ static void print_help()
 	                "\t[--entry name]\n"
 	                "\t[--stage <stage (vert, frag, geom, tesc, tese comp)>]\n"
 	                "\t[--remove-unused-variables]\n"
+	                "\t[--fold-spec-constants]\n"
+	                "\t[--remove-unused-ir]\n"
+	                "\t[--eliminate-common-subexpressions]\n"
 	                "\t[--flatten-multidimensional-arrays]\n"
 	                "\t[--no-420pack-extension]\n"
 	                "\t[--remap-variable-type <variable_name> <new_variable_type>]\n"
@@ -573,6 +764,23 @@ static void print_help()
 	                "\t[--rename-entry-point <old> <new> <stage>]\n"
 	                "\t[--combined-samplers-inherit-bindings]\n"
 	                "\t[--no-support-nonzero-baseinstance]\n"
+	                "\t[--stats <json path>]\n"
+	                "\t[--batch <manifest path>]\n"
+	                "\t[--batch-threads <count>]\n"
+	                "\t[--cache-dir <directory>]\n"
+	                "\t[--cache-size <MiB>]\n"
+	                "\n"
+	                "With --batch, each line of the manifest holds the arguments of one job, e.g.\n"
+	                "\tshader.spv --hlsl --shader-model 50 --output shader.hlsl\n"
+	                "Arguments are separated by whitespace and can be put in double quotes.\n"
+	                "Empty lines and lines starting with # are ignored.\n"
+	                "Jobs run concurrently on --batch-threads threads, by default one per core,\n"
+	                "so every job must write its result with --output.\n"
+	                "\n"
+	                "With --cache-dir, compiled sources and --reflect output are kept in the directory, and a run\n"
+	                "with the same input and arguments writes the kept output instead of compiling. The directory is\n"
+	                "trimmed to --cache-size (default 256 MiB) by deleting the least recently used entries.\n"
+	                "Runs with --dump-resources, --stats or --iterations are not cached.\n"
 	                "\n");
 }
 
@@ -678,7 +886,10 @@ static ExecutionModel stage_to_execution_model(const std::string &stage)
 		SPIRV_CROSS_THROW("Invalid stage.");
 }
 
-static int main_inner(int argc, char *argv[])
+static int run_batch(const char *manifest_path, uint32_t num_threads, CompileCache *cache);
+
+// batch_cache is the cache given to --batch itself, which all jobs of the batch share.
+static int main_inner(int argc, char *argv[], bool batch_job = false, CompileCache *batch_cache = nullptr)
 {
 	CLIArguments args;
 	CLICallbacks cbs;
@@ -688,6 +899,11 @@ static int main_inner(int argc, char *argv[])
 		parser.end();
 	});
 	cbs.add("--output", [&args](CLIParser &parser) { args.output = parser.next_string(); });
+	cbs.add("--stats", [&args](CLIParser &parser) { args.stats = parser.next_string(); });
+	cbs.add("--batch", [&args](CLIParser &parser) { args.batch = parser.next_string(); });
+	cbs.add("--batch-threads", [&args](CLIParser &parser) { args.batch_threads = parser.next_uint(); });
+	cbs.add("--cache-dir", [&args](CLIParser &parser) { args.cache_dir = parser.next_string(); });
+	cbs.add("--cache-size", [&args](CLIParser &parser) { args.cache_size = parser.next_uint(); });
 	cbs.add("--es", [&args](CLIParser &) {
 		args.es = true;
 		args.set_es = true;
@@ -786,13 +1002,23 @@ static int main_inner(int argc, char *argv[])
 	});
 
 	cbs.add("--remove-unused-variables", [&args](CLIParser &) { args.remove_unused = true; });
+	cbs.add("--fold-spec-constants", [&args](CLIParser &) { args.fold_spec_constants = true; });
+	cbs.add("--remove-unused-ir", [&args](CLIParser &) { args.remove_unused_ir = true; });
+	cbs.add("--eliminate-common-subexpressions",
+	        [&args](CLIParser &) { args.eliminate_common_subexpressions = true; });
 	cbs.add("--combined-samplers-inherit-bindings",
 	        [&args](CLIParser &) { args.combined_samplers_inherit_bindings = true; });
 
 	cbs.add("--no-support-nonzero-baseinstance", [&](CLIParser &) { args.support_nonzero_baseinstance = false; });
 
 	cbs.default_handler = [&args](const char *value) { args.input = value; };
-	cbs.error_handler = [] { print_help(); };
+	cbs.error_handler = [batch_job] {
+		// The usage text would drown out the other jobs in a batch.
+		if (batch_job)
+			fprintf(stderr, "Invalid arguments.\n");
+		else
+			print_help();
+	};
 
 	CLIParser parser{ move(cbs), argc - 1, argv + 1 };
 	if (!parser.parse())
@@ -804,6 +1030,20 @@ static int main_inner(int argc, char *argv[])
 		return EXIT_SUCCESS;
 	}
 
+	unique_ptr<CompileCache> cache;
+	if (args.cache_dir)
+		cache.reset(new CompileCache(args.cache_dir, uint64_t(args.cache_size) * 1024 * 1024));
+
+	if (args.batch)
+	{
+		if (batch_job)
+		{
+			fprintf(stderr, "A batch manifest cannot use --batch.\n");
+			return EXIT_FAILURE;
+		}
+		return run_batch(args.batch, args.batch_threads, cache.get());
+	}
+
 	if (!args.input)
 	{
 		fprintf(stderr, "Didn't specify input file.\n");
@@ -811,23 +1051,76 @@ static int main_inner(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	auto spirv_file = read_spirv_file(args.input);
-	if (spirv_file.empty())
+	// Jobs run concurrently, so their output cannot share stdout.
+	if (batch_job && !args.output)
+	{
+		fprintf(stderr, "Every job in a batch manifest needs --output.\n");
+		return EXIT_FAILURE;
+	}
+
+	SPIRVFile spirv_file;
+	if (!spirv_file.load(args.input))
 		return EXIT_FAILURE;
-	Parser spirv_parser(move(spirv_file));
 
+	// Only runs which output nothing but the source can be answered from the cache.
+	CompileCache *compile_cache = cache ? cache.get() : batch_cache;
+	if (args.dump_resources || args.stats || args.iterations > 1)
+		compile_cache = nullptr;
+
+	// The key is the input and every argument which can change the output, in the order they were given.
+	CompileCacheKey cache_key;
+	if (compile_cache)
+	{
+		cache_key.add(spirv_file.data(), spirv_file.size());
+		for (int i = 1; i < argc; i++)
+		{
+			if (argv[i] == args.input)
+				continue;
+			if (!strcmp(argv[i], "--output") || !strcmp(argv[i], "--cache-dir") || !strcmp(argv[i], "--cache-size"))
+			{
+				i++;
+				continue;
+			}
+			cache_key.add(string(argv[i]));
+		}
+
+		// --reflect is part of the key, so reflection and source runs never share an entry.
+		CompileCacheEntry entry;
+		if (compile_cache->load(cache_key, entry))
+		{
+			auto &output = args.reflect.empty() ? entry.source : entry.reflection;
+			return write_string_to_file(args.output, output) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	// Collects the output on its way to the file. Failing to store it only means the next run has to compile again.
+	CompileCacheEntry cache_entry;
+
+	// spirv_file outlives every compiler below, so the parser can borrow the words.
+	auto parse_start = chrono::steady_clock::now();
+	Parser spirv_parser(spirv_file.data(), spirv_file.size(), true);
 	spirv_parser.parse();
+	double parse_time = chrono::duration<double>(chrono::steady_clock::now() - parse_start).count();
 
 	// Special case reflection because it has little to do with the path followed by code-outputting compilers
 	if (!args.reflect.empty())
 	{
 		CompilerReflection compiler(move(spirv_parser.get_parsed_ir()));
 		compiler.set_format(args.reflect);
-		auto json = compiler.compile();
-		if (args.output)
-			write_string_to_file(args.output, json.c_str());
-		else
-			printf("%s", json.c_str());
+		compiler.set_compile_statistics_enabled(args.stats != nullptr);
+
+		// These change what the module contains, so reflection has to see them as well.
+		if (args.fold_spec_constants)
+			compiler.fold_specialization_constants();
+		if (args.remove_unused_ir)
+			compiler.remove_unused_ir();
+
+		if (!compile_to_file(compiler, args.output, compile_cache ? &cache_entry.reflection : nullptr))
+			return EXIT_FAILURE;
+		if (compile_cache)
+			compile_cache->store(cache_key, cache_entry);
+		if (args.stats && !write_stats_to_file(args.stats, compiler.get_compile_statistics(), parse_time))
+			return EXIT_FAILURE;
 		return EXIT_SUCCESS;
 	}
 
@@ -1011,6 +1304,13 @@ static int main_inner(int argc, char *argv[])
 		hlsl->set_hlsl_options(hlsl_opts);
 	}
 
+	if (args.fold_spec_constants)
+		compiler->fold_specialization_constants();
+	if (args.remove_unused_ir)
+		compiler->remove_unused_ir();
+	if (args.eliminate_common_subexpressions)
+		compiler->eliminate_common_subexpressions();
+
 	if (build_dummy_sampler)
 	{
 		uint32_t sampler = compiler->build_dummy_sampler_for_combined_images();
@@ -1103,21 +1403,189 @@ static int main_inner(int argc, char *argv[])
 			hlsl_compiler->set_decoration(new_builtin, DecorationDescriptorSet, 0);
 			hlsl_compiler->set_decoration(new_builtin, DecorationBinding, 0);
 		}
+
+		for (auto &remap : args.hlsl_attr_remap)
+			hlsl_compiler->add_vertex_attribute_remap(remap);
+	}
+
+	// Only the last iteration writes its output, and the statistics are from the last iteration as well.
+	compiler->set_compile_statistics_enabled(args.stats != nullptr);
+	for (uint32_t i = 1; i < args.iterations; i++)
+		compiler->compile();
+
+	if (!compile_to_file(*compiler, args.output, compile_cache ? &cache_entry.source : nullptr))
+		return EXIT_FAILURE;
+	if (compile_cache)
+		compile_cache->store(cache_key, cache_entry);
+	if (args.stats && !write_stats_to_file(args.stats, compiler->get_compile_statistics(), parse_time))
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
+
+struct BatchJob
+{
+	uint32_t line;
+	vector<string> args;
+
+	int status = EXIT_FAILURE;
+	string error;
+};
+
+// Splits a manifest line into arguments. Returns false if a quote is not closed.
+static bool split_batch_arguments(const string &line, vector<string> &args)
+{
+	size_t i = 0;
+	while (i < line.size())
+	{
+		if (isspace(static_cast<unsigned char>(line[i])))
+		{
+			i++;
+			continue;
+		}
+
+		string arg;
+		while (i < line.size() && !isspace(static_cast<unsigned char>(line[i])))
+		{
+			if (line[i] != '"')
+			{
+				arg += line[i++];
+				continue;
+			}
+
+			// Quoted part, where only \" and \\ are escapes.
+			for (i++; i < line.size() && line[i] != '"'; i++)
+			{
+				if (line[i] == '\\' && i + 1 < line.size() && (line[i + 1] == '"' || line[i + 1] == '\\'))
+					i++;
+				arg += line[i];
+			}
+
+			if (i == line.size())
+				return false;
+			i++;
+		}
+
+		args.push_back(move(arg));
+	}
+
+	return true;
+}
+
+static bool read_batch_manifest(const char *path, vector<BatchJob> &jobs)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open batch manifest: %s\n", path);
+		return false;
+	}
+
+	string line;
+	uint32_t line_number = 0;
+	bool success = true;
+	for (;;)
+	{
+		int c = fgetc(file);
+		if (c != EOF && c != '\n')
+		{
+			line += char(c);
+			continue;
+		}
+
+		line_number++;
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		size_t first = line.find_first_not_of(" \t");
+		if (first != string::npos && line[first] != '#')
+		{
+			BatchJob job;
+			job.line = line_number;
+			if (split_batch_arguments(line, job.args))
+				jobs.push_back(move(job));
+			else
+			{
+				fprintf(stderr, "%s:%u: Unterminated quote.\n", path, line_number);
+				success = false;
+			}
+		}
+
+		line.clear();
+		if (c == EOF)
+			break;
+	}
+
+	fclose(file);
+	return success;
+}
+
+static void run_batch_job(BatchJob &job, CompileCache *cache)
+{
+	// Each job is parsed exactly like a command line of its own.
+	string program = "spirv-cross";
+	vector<char *> argv;
+	argv.push_back(&program[0]);
+	for (auto &arg : job.args)
+		argv.push_back(&arg[0]);
+	argv.push_back(nullptr);
+
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	try
+#endif
+	{
+		job.status = main_inner(int(argv.size() - 1), argv.data(), true, cache);
 	}
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	catch (const std::exception &e)
+	{
+		job.status = EXIT_FAILURE;
+		job.error = e.what();
+	}
+#endif
+}
+
+static int run_batch(const char *manifest_path, uint32_t num_threads, CompileCache *cache)
+{
+	vector<BatchJob> jobs;
+	if (!read_batch_manifest(manifest_path, jobs))
+		return EXIT_FAILURE;
+
+	if (num_threads == 0)
+		num_threads = max(thread::hardware_concurrency(), 1u);
+	num_threads = uint32_t(min<size_t>(num_threads, jobs.size()));
+
+	// Same scheme as compile_entry_points(), workers pull the next job off a shared counter.
+	atomic<size_t> next_job(0);
+	const auto worker = [&]() {
+		for (size_t i = next_job++; i < jobs.size(); i = next_job++)
+			run_batch_job(jobs[i], cache);
+	};
+
+	vector<thread> threads;
+	for (uint32_t i = 1; i < num_threads; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &t : threads)
+		t.join();
 
-	string glsl;
-	for (uint32_t i = 0; i < args.iterations; i++)
+	uint32_t failures = 0;
+	for (auto &job : jobs)
 	{
-		if (args.hlsl)
-			glsl = static_cast<CompilerHLSL *>(compiler.get())->compile(move(args.hlsl_attr_remap));
+		if (job.status == EXIT_SUCCESS)
+			continue;
+
+		failures++;
+		if (job.error.empty())
+			fprintf(stderr, "%s:%u: Job failed.\n", manifest_path, job.line);
 		else
-			glsl = compiler->compile();
+			fprintf(stderr, "%s:%u: Job failed: %s\n", manifest_path, job.line, job.error.c_str());
 	}
 
-	if (args.output)
-		write_string_to_file(args.output, glsl.c_str());
-	else
-		printf("%s", glsl.c_str());
+	if (failures)
+	{
+		fprintf(stderr, "%u of %u jobs in %s failed.\n", failures, uint32_t(jobs.size()), manifest_path);
+		return EXIT_FAILURE;
+	}
 
 	return EXIT_SUCCESS;
 }
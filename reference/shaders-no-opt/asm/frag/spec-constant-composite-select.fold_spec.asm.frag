@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) out vec4 FragColor;
+
+void main()
+{
+    vec4 _40 = vec4(0.5, 0.75, 0.0, 1.0) * vec2(0.25, 0.5).x;
+    _40.w = vec2(0.25, 0.5).y + 0.25;
+    FragColor = _40;
+}
+
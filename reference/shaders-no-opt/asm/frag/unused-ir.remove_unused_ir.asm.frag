@@ -0,0 +1,28 @@
+#version 450
+
+#ifndef SPIRV_CROSS_CONSTANT_ID_0
+#define SPIRV_CROSS_CONSTANT_ID_0 1.0
+#endif
+const float Strength = SPIRV_CROSS_CONSTANT_ID_0;
+
+layout(binding = 2, std140) uniform UBO
+{
+    vec4 scale;
+    vec4 unused_middle;
+    vec4 bias;
+} ubo;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 0) in vec4 vColor;
+
+vec4 shade(vec4 color)
+{
+    return ((color * ubo.scale) * Strength) + ubo.bias;
+}
+
+void main()
+{
+    vec4 _43 = vColor;
+    FragColor = shade(_43);
+}
+
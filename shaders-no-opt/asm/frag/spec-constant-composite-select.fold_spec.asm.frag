@@ -0,0 +1,76 @@
+; SPIR-V
+; Version: 1.0
+; Generator: Khronos Glslang Reference Front End; 7
+; Bound: 48
+; Schema: 0
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %FragColor
+               OpExecutionMode %main OriginUpperLeft
+               OpName %main "main"
+               OpName %FragColor "FragColor"
+               OpName %Red "Red"
+               OpName %Green "Green"
+               OpName %Mode "Mode"
+               OpName %Tint "Tint"
+               OpName %Swapped "Swapped"
+               OpName %UseTint "UseTint"
+               OpName %Scale "Scale"
+               OpName %ModeBits "ModeBits"
+               OpName %Weights "Weights"
+               OpDecorate %FragColor Location 0
+               OpDecorate %Red SpecId 0
+               OpDecorate %Green SpecId 1
+               OpDecorate %Mode SpecId 2
+               OpDecorate %UseTint SpecId 3
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+        %int = OpTypeInt 32 1
+       %uint = OpTypeInt 32 0
+       %bool = OpTypeBool
+    %v4float = OpTypeVector %float 4
+     %v2bool = OpTypeVector %bool 2
+    %v2float = OpTypeVector %float 2
+      %int_1 = OpConstant %int 1
+      %int_2 = OpConstant %int 2
+     %uint_2 = OpConstant %uint 2
+    %float_0 = OpConstant %float 0
+    %float_1 = OpConstant %float 1
+  %float_0_5 = OpConstant %float 0.5
+  %float_0_25 = OpConstant %float 0.25
+        %Red = OpSpecConstant %float 0.75
+      %Green = OpSpecConstant %float 0.5
+       %Mode = OpSpecConstant %int 2
+    %UseTint = OpSpecConstantFalse %bool
+       %Tint = OpSpecConstantComposite %v4float %Red %Green %float_0 %float_1
+    %Swapped = OpSpecConstantOp %v4float VectorShuffle %Tint %Tint 1 0 2 3
+      %Scale = OpSpecConstantOp %float Select %UseTint %float_0_5 %float_0_25
+   %ModeBits = OpSpecConstantOp %int BitwiseAnd %Mode %int_2
+%UseTintVec = OpSpecConstantComposite %v2bool %UseTint %UseTint
+    %Weights = OpSpecConstantComposite %v2float %Scale %Green
+%PickedWeights = OpSpecConstantOp %v2float Select %UseTintVec %Weights %Weights
+%_ptr_Output_v4float = OpTypePointer Output %v4float
+  %FragColor = OpVariable %_ptr_Output_v4float Output
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+               OpSelectionMerge %merge None
+               OpSwitch %ModeBits %default 0 %case0 2 %case2
+      %case0 = OpLabel
+               OpStore %FragColor %Tint
+               OpBranch %merge
+      %case2 = OpLabel
+         %wx = OpCompositeExtract %float %PickedWeights 0
+         %wy = OpCompositeExtract %float %PickedWeights 1
+     %scaled = OpVectorTimesScalar %v4float %Swapped %wx
+     %offset = OpFAdd %float %wy %Scale
+     %result = OpCompositeInsert %v4float %offset %scaled 3
+               OpStore %FragColor %result
+               OpBranch %merge
+    %default = OpLabel
+     %dimmed = OpVectorTimesScalar %v4float %Tint %Scale
+               OpStore %FragColor %dimmed
+               OpBranch %merge
+      %merge = OpLabel
+               OpReturn
+               OpFunctionEnd
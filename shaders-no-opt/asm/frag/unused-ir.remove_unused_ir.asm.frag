@@ -0,0 +1,125 @@
+; SPIR-V
+; Version: 1.0
+; Generator: Khronos Glslang Reference Front End; 7
+; Bound: 64
+; Schema: 0
+               OpCapability Shader
+          %1 = OpExtInstImport "GLSL.std.450"
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %FragColor %vColor %vUnused
+               OpEntryPoint Fragment %other_main "other_main" %FragColor %vColor
+               OpExecutionMode %main OriginUpperLeft
+               OpExecutionMode %other_main OriginUpperLeft
+               OpName %main "main"
+               OpName %other_main "other_main"
+               OpName %shade_f4_ "shade(vf4;"
+               OpName %color "color"
+               OpName %unused_helper_f1_ "unused_helper(f1;"
+               OpName %value "value"
+               OpName %FragColor "FragColor"
+               OpName %vColor "vColor"
+               OpName %vUnused "vUnused"
+               OpName %UBO "UBO"
+               OpMemberName %UBO 0 "scale"
+               OpMemberName %UBO 1 "unused_middle"
+               OpMemberName %UBO 2 "bias"
+               OpMemberName %UBO 3 "unused_tail"
+               OpMemberName %UBO 4 "other_tail"
+               OpName %ubo "ubo"
+               OpName %UnusedUBO "UnusedUBO"
+               OpMemberName %UnusedUBO 0 "unused_member"
+               OpName %unused_ubo "unused_ubo"
+               OpName %UnusedStruct "UnusedStruct"
+               OpMemberName %UnusedStruct 0 "a"
+               OpMemberName %UnusedStruct 1 "b"
+               OpName %unused_private "unused_private"
+               OpName %Strength "Strength"
+               OpName %UnusedSpec "UnusedSpec"
+               OpDecorate %FragColor Location 0
+               OpDecorate %vColor Location 0
+               OpDecorate %vUnused Location 1
+               OpDecorate %vUnused Flat
+               OpMemberDecorate %UBO 0 Offset 0
+               OpMemberDecorate %UBO 1 Offset 16
+               OpMemberDecorate %UBO 2 Offset 32
+               OpMemberDecorate %UBO 3 Offset 48
+               OpMemberDecorate %UBO 4 Offset 64
+               OpDecorate %UBO Block
+               OpDecorate %ubo DescriptorSet 0
+               OpDecorate %ubo Binding 2
+               OpMemberDecorate %UnusedUBO 0 Offset 0
+               OpDecorate %UnusedUBO Block
+               OpDecorate %unused_ubo DescriptorSet 0
+               OpDecorate %unused_ubo Binding 3
+               OpDecorate %Strength SpecId 0
+               OpDecorate %UnusedSpec SpecId 1
+               OpDecorate %shaded RelaxedPrecision
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+        %int = OpTypeInt 32 1
+    %v4float = OpTypeVector %float 4
+    %v3float = OpTypeVector %float 3
+%_ptr_Function_v4float = OpTypePointer Function %v4float
+%_ptr_Function_float = OpTypePointer Function %float
+   %fn_shade = OpTypeFunction %v4float %_ptr_Function_v4float
+  %fn_unused = OpTypeFunction %float %_ptr_Function_float
+      %int_0 = OpConstant %int 0
+      %int_2 = OpConstant %int 2
+      %int_4 = OpConstant %int 4
+    %float_2 = OpConstant %float 2
+   %float_42 = OpConstant %float 42
+   %Strength = OpSpecConstant %float 1
+ %UnusedSpec = OpSpecConstant %int 7
+        %UBO = OpTypeStruct %v4float %v4float %v4float %v4float %v4float
+%_ptr_Uniform_UBO = OpTypePointer Uniform %UBO
+        %ubo = OpVariable %_ptr_Uniform_UBO Uniform
+%_ptr_Uniform_v4float = OpTypePointer Uniform %v4float
+  %UnusedUBO = OpTypeStruct %v4float
+%_ptr_Uniform_UnusedUBO = OpTypePointer Uniform %UnusedUBO
+ %unused_ubo = OpVariable %_ptr_Uniform_UnusedUBO Uniform
+%UnusedStruct = OpTypeStruct %v3float %int
+%_ptr_Private_float = OpTypePointer Private %float
+%unused_private = OpVariable %_ptr_Private_float Private %float_42
+%_ptr_Output_v4float = OpTypePointer Output %v4float
+  %FragColor = OpVariable %_ptr_Output_v4float Output
+%_ptr_Input_v4float = OpTypePointer Input %v4float
+     %vColor = OpVariable %_ptr_Input_v4float Input
+%_ptr_Input_int = OpTypePointer Input %int
+    %vUnused = OpVariable %_ptr_Input_int Input
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+      %param = OpVariable %_ptr_Function_v4float Function
+     %loaded = OpLoad %v4float %vColor
+               OpStore %param %loaded
+     %shaded = OpFunctionCall %v4float %shade_f4_ %param
+               OpStore %FragColor %shaded
+               OpReturn
+               OpFunctionEnd
+ %other_main = OpFunction %void None %fn
+%other_entry = OpLabel
+   %tail_ptr = OpAccessChain %_ptr_Uniform_v4float %ubo %int_4
+       %tail = OpLoad %v4float %tail_ptr
+               OpStore %FragColor %tail
+               OpReturn
+               OpFunctionEnd
+  %shade_f4_ = OpFunction %v4float None %fn_shade
+      %color = OpFunctionParameter %_ptr_Function_v4float
+%shade_entry = OpLabel
+  %scale_ptr = OpAccessChain %_ptr_Uniform_v4float %ubo %int_0
+      %scale = OpLoad %v4float %scale_ptr
+   %bias_ptr = OpAccessChain %_ptr_Uniform_v4float %ubo %int_2
+       %bias = OpLoad %v4float %bias_ptr
+          %c = OpLoad %v4float %color
+     %scaled = OpFMul %v4float %c %scale
+ %strengthed = OpVectorTimesScalar %v4float %scaled %Strength
+     %biased = OpFAdd %v4float %strengthed %bias
+               OpReturnValue %biased
+               OpFunctionEnd
+%unused_helper_f1_ = OpFunction %float None %fn_unused
+      %value = OpFunctionParameter %_ptr_Function_float
+%unused_entry = OpLabel
+          %v = OpLoad %float %value
+    %doubled = OpFMul %float %v %float_2
+               OpReturnValue %doubled
+               OpFunctionEnd
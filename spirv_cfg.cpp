@@ -29,6 +29,8 @@ CFG::CFG(Compiler &compiler_, const SPIRFunction &func_)
 {
 	build_post_order_visit_order();
 	build_immediate_dominators();
+	build_immediate_post_dominators();
+	build_dominance_frontiers();
 }
 
 uint32_t CFG::find_common_dominator(uint32_t a, uint32_t b) const
@@ -43,113 +45,320 @@ uint32_t CFG::find_common_dominator(uint32_t a, uint32_t b) const
 	return a;
 }
 
+uint32_t CFG::post_dominator_rank(uint32_t block) const
+{
+	// Walking the post-order forwards visits successors before predecessors, so later blocks rank lower.
+	// The end of the function, block 0, post-dominates everything and ranks highest.
+	uint32_t count = uint32_t(post_order.size());
+	return block ? count + 1 - get_visit_order(block) : count + 1;
+}
+
+uint32_t CFG::find_common_post_dominator(uint32_t a, uint32_t b) const
+{
+	while (a != b)
+	{
+		if (post_dominator_rank(a) < post_dominator_rank(b))
+			a = get_immediate_post_dominator(a);
+		else
+			b = get_immediate_post_dominator(b);
+	}
+	return a;
+}
+
+bool CFG::dominates(uint32_t a, uint32_t b) const
+{
+	if (!get_immediate_dominator(a) || !get_immediate_dominator(b))
+		return false;
+
+	// Dominators are visited after the blocks they dominate.
+	uint32_t order = get_visit_order(a);
+	while (b != a && get_visit_order(b) < order)
+		b = get_immediate_dominator(b);
+	return b == a;
+}
+
 void CFG::build_immediate_dominators()
 {
-	// Traverse the post-order in reverse and build up the immediate dominator tree.
-	immediate_dominators.clear();
-	immediate_dominators[func.entry_block] = func.entry_block;
+	// This is the iterative algorithm by Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+	// Traverse the post-order in reverse and intersect the dominators of all predecessors seen so far.
+	// Back edges are not part of the CFG, so a single pass finds the fixed point, and the second one confirms it.
+	immediate_dominators.assign(block_ids.size(), 0);
+	immediate_dominators[get_block_index(func.entry_block)] = func.entry_block;
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (auto i = post_order.size(); i; i--)
+		{
+			uint32_t block = post_order[i - 1];
+			if (block == func.entry_block)
+				continue;
+
+			uint32_t dominator = 0;
+			for (auto pred : get_preceding_edges(block))
+			{
+				if (!get_immediate_dominator(pred))
+					continue;
+				dominator = dominator ? find_common_dominator(dominator, pred) : pred;
+			}
+
+			auto &idom = immediate_dominators[get_block_index(block)];
+			if (idom != dominator)
+			{
+				idom = dominator;
+				changed = true;
+			}
+		}
+	}
+}
+
+void CFG::build_immediate_post_dominators()
+{
+	// The same algorithm on the reversed CFG, starting from an implied end of the function which all blocks without
+	// successors branch to. The post-order is a reverse post-order of the reversed CFG already.
+	immediate_post_dominators.assign(block_ids.size(), 0);
+
+	for (auto block : post_order)
+	{
+		uint32_t order = get_visit_order(block);
+		uint32_t post_dominator = 0;
+		bool first = true;
+
+		for (auto succ : get_succeeding_edges(block))
+		{
+			// Skip implied merge edges which lead to blocks we never visited, or back to a block we came from.
+			int succ_order = visit_order[get_block_index(succ)];
+			if (succ_order <= 0 || uint32_t(succ_order) > order)
+				continue;
+
+			post_dominator = first ? succ : find_common_post_dominator(post_dominator, succ);
+			first = false;
+		}
+
+		immediate_post_dominators[get_block_index(block)] = post_dominator;
+	}
+}
+
+void CFG::build_dominance_frontiers()
+{
+	// For every join point, walk up the dominator tree from each predecessor until we reach the dominator of the join.
+	// The join is in the dominance frontier of every block on the way.
+	vector<pair<uint32_t, uint32_t>> frontiers;
+	vector<uint32_t> last_join(block_ids.size(), 0);
 
 	for (auto i = post_order.size(); i; i--)
 	{
 		uint32_t block = post_order[i - 1];
-		auto &pred = preceding_edges[block];
-		if (pred.empty()) // This is for the entry block, but we've already set up the dominators.
+		auto pred = get_preceding_edges(block);
+		if (pred.size() < 2)
 			continue;
 
-		for (auto &edge : pred)
+		uint32_t order = get_visit_order(block);
+		uint32_t dominator = get_immediate_dominator(block);
+		for (auto runner : pred)
 		{
-			if (immediate_dominators[block])
+			if (get_visit_order(runner) < order)
+				continue;
+
+			while (runner != dominator)
 			{
-				assert(immediate_dominators[edge]);
-				immediate_dominators[block] = find_common_dominator(block, edge);
+				uint32_t index = get_block_index(runner);
+				if (last_join[index] != block)
+				{
+					last_join[index] = block;
+					frontiers.emplace_back(index, block);
+				}
+				runner = get_immediate_dominator(runner);
 			}
-			else
-				immediate_dominators[block] = edge;
 		}
 	}
-}
 
-bool CFG::is_back_edge(uint32_t to) const
-{
-	// We have a back edge if the visit order is set with the temporary magic value 0.
-	// Crossing edges will have already been recorded with a visit order.
-	auto itr = visit_order.find(to);
-	assert(itr != end(visit_order));
-	return itr->second.get() == 0;
+	// Counting sort by block, keeping the reverse post-order within each frontier.
+	frontier_offsets.assign(block_ids.size() + 1, 0);
+	for (auto &frontier : frontiers)
+		frontier_offsets[frontier.first + 1]++;
+	for (size_t i = 0; i < block_ids.size(); i++)
+		frontier_offsets[i + 1] += frontier_offsets[i];
+
+	frontier_blocks.resize(frontiers.size());
+	vector<uint32_t> cursor(begin(frontier_offsets), end(frontier_offsets) - 1);
+	for (auto &frontier : frontiers)
+		frontier_blocks[cursor[frontier.first]++] = frontier.second;
 }
 
-bool CFG::post_order_visit(uint32_t block_id)
+uint32_t CFG::add_block(uint32_t block)
 {
-	// If we have already branched to this block (back edge), stop recursion.
-	// If our branches are back-edges, we do not record them.
-	// We have to record crossing edges however.
-	if (visit_order[block_id].get() >= 0)
-		return !is_back_edge(block_id);
+	if (block_indices.empty())
+		index_base = block;
+
+	if (block < index_base)
+	{
+		block_indices.insert(begin(block_indices), index_base - block, 0);
+		index_base = block;
+	}
+	else if (block - index_base >= block_indices.size())
+		block_indices.resize(block - index_base + 1);
 
-	// Block back-edges from recursively revisiting ourselves.
-	visit_order[block_id].get() = 0;
+	auto &index = block_indices[block - index_base];
+	if (!index)
+	{
+		block_ids.push_back(block);
+		visit_order.push_back(-1);
+		index = uint32_t(block_ids.size());
+	}
+	return index - 1;
+}
 
-	// First visit our branch targets.
-	auto &block = compiler.get<SPIRBlock>(block_id);
+// The i-th branch target of block, in the order the CFG visits them.
+static bool get_branch_target(const SPIRBlock &block, uint32_t i, uint32_t &target)
+{
 	switch (block.terminator)
 	{
 	case SPIRBlock::Direct:
-		if (post_order_visit(block.next_block))
-			add_branch(block_id, block.next_block);
-		break;
+		target = block.next_block;
+		return i == 0;
 
 	case SPIRBlock::Select:
-		if (post_order_visit(block.true_block))
-			add_branch(block_id, block.true_block);
-		if (post_order_visit(block.false_block))
-			add_branch(block_id, block.false_block);
-		break;
+		target = i == 0 ? block.true_block : block.false_block;
+		return i < 2;
 
 	case SPIRBlock::MultiSelect:
-		for (auto &target : block.cases)
+		if (i < block.cases.size())
 		{
-			if (post_order_visit(target.block))
-				add_branch(block_id, target.block);
+			target = block.cases[i].block;
+			return true;
 		}
-		if (block.default_block && post_order_visit(block.default_block))
-			add_branch(block_id, block.default_block);
-		break;
+		target = block.default_block;
+		return i == block.cases.size() && block.default_block != 0;
 
 	default:
-		break;
+		return false;
 	}
-
-	// If this is a loop header, add an implied branch to the merge target.
-	// This is needed to avoid annoying cases with do { ... } while(false) loops often generated by inliners.
-	// To the CFG, this is linear control flow, but we risk picking the do/while scope as our dominating block.
-	// This makes sure that if we are accessing a variable outside the do/while, we choose the loop header as dominator.
-	if (block.merge == SPIRBlock::MergeLoop)
-		add_branch(block_id, block.merge_block);
-
-	// Then visit ourselves. Start counting at one, to let 0 be a magic value for testing back vs. crossing edges.
-	visit_order[block_id].get() = ++visit_count;
-	post_order.push_back(block_id);
-	return true;
 }
 
 void CFG::build_post_order_visit_order()
 {
-	uint32_t block = func.entry_block;
-	visit_count = 0;
-	visit_order.clear();
-	post_order.clear();
-	post_order_visit(block);
+	// Size the block index map for the whole function up front, block IDs within a function are mostly contiguous.
+	if (!func.blocks.empty())
+	{
+		auto range = minmax_element(begin(func.blocks), end(func.blocks));
+		index_base = *range.first;
+		block_indices.resize(*range.second - *range.first + 1);
+		block_ids.reserve(func.blocks.size());
+		visit_order.reserve(func.blocks.size());
+		post_order.reserve(func.blocks.size());
+
+		for (auto block : func.blocks)
+			add_block(block);
+	}
+
+	struct Frame
+	{
+		uint32_t block;
+		uint32_t next_target;
+	};
+
+	// Edges in the order they are found, which is the order of the edge arrays.
+	vector<pair<uint32_t, uint32_t>> edges;
+	vector<Frame> stack;
+	uint32_t visit_count = 0;
+
+	visit_order[add_block(func.entry_block)] = 0;
+	stack.push_back({ func.entry_block, 0 });
+
+	while (!stack.empty())
+	{
+		uint32_t block_id = stack.back().block;
+		auto &block = compiler.get<SPIRBlock>(block_id);
+
+		// First visit our branch targets.
+		// If we have already branched to a block still on the stack, this is a back edge, which we do not record.
+		// We have to record crossing edges however.
+		uint32_t target;
+		if (get_branch_target(block, stack.back().next_target++, target))
+		{
+			auto &order = visit_order[add_block(target)];
+			if (order < 0)
+			{
+				// Block back-edges from revisiting the target while we are in it.
+				order = 0;
+				stack.push_back({ target, 0 });
+			}
+			else if (order > 0)
+				edges.emplace_back(block_id, target);
+			continue;
+		}
+
+		// If this is a loop header, add an implied branch to the merge target.
+		// This is needed to avoid annoying cases with do { ... } while(false) loops often generated by inliners.
+		// To the CFG, this is linear control flow, but we risk picking the do/while scope as our dominating block.
+		// This makes sure that if we are accessing a variable outside the do/while, we choose the loop header as dominator.
+		if (block.merge == SPIRBlock::MergeLoop)
+		{
+			add_block(block.merge_block);
+			edges.emplace_back(block_id, block.merge_block);
+		}
+
+		// Then visit ourselves. Start counting at one, to let 0 be a magic value for testing back vs. crossing edges.
+		visit_order[get_block_index(block_id)] = int(++visit_count);
+		post_order.push_back(block_id);
+		stack.pop_back();
+
+		// The block we came from records its edge to us once we are done.
+		if (!stack.empty())
+			edges.emplace_back(stack.back().block, block_id);
+	}
+
+	build_edges(edges);
 }
 
-void CFG::add_branch(uint32_t from, uint32_t to)
+void CFG::build_edges(const vector<pair<uint32_t, uint32_t>> &edges)
 {
-	const auto add_unique = [](vector<uint32_t> &l, uint32_t value) {
-		auto itr = find(begin(l), end(l), value);
-		if (itr == end(l))
-			l.push_back(value);
-	};
-	add_unique(preceding_edges[to], from);
-	add_unique(succeeding_edges[from], to);
+	size_t count = block_ids.size();
+	preceding_offsets.assign(count + 1, 0);
+	succeeding_offsets.assign(count + 1, 0);
+
+	// Group the edges by source block, keeping the order they were found in, and drop duplicates,
+	// e.g. from a selection with the same block on both sides.
+	vector<uint32_t> order(count + 1, 0);
+	for (auto &edge : edges)
+		order[get_block_index(edge.first) + 1]++;
+	for (size_t i = 0; i < count; i++)
+		order[i + 1] += order[i];
+
+	vector<uint32_t> sorted_edges(edges.size());
+	for (uint32_t i = 0; i < uint32_t(edges.size()); i++)
+		sorted_edges[order[get_block_index(edges[i].first)]++] = i;
+
+	vector<bool> unique_edges(edges.size());
+	vector<uint32_t> last_source(count, InvalidIndex);
+	for (auto i : sorted_edges)
+	{
+		uint32_t from = get_block_index(edges[i].first);
+		uint32_t to = get_block_index(edges[i].second);
+		if (last_source[to] != from)
+		{
+			last_source[to] = from;
+			unique_edges[i] = true;
+			succeeding_blocks.push_back(edges[i].second);
+			succeeding_offsets[from + 1]++;
+			preceding_offsets[to + 1]++;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		succeeding_offsets[i + 1] += succeeding_offsets[i];
+		preceding_offsets[i + 1] += preceding_offsets[i];
+	}
+
+	// Predecessors are listed in the order their edges were found.
+	preceding_blocks.resize(succeeding_blocks.size());
+	vector<uint32_t> cursor(begin(preceding_offsets), end(preceding_offsets) - 1);
+	for (size_t i = 0; i < edges.size(); i++)
+		if (unique_edges[i])
+			preceding_blocks[cursor[get_block_index(edges[i].second)]++] = edges[i].first;
 }
 
 DominatorBuilder::DominatorBuilder(const CFG &cfg_)
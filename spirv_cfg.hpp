@@ -28,6 +28,51 @@ class CFG
 public:
 	CFG(Compiler &compiler, const SPIRFunction &function);
 
+	// A view of block IDs which are stored back to back in one of the edge arrays.
+	class BlockRange
+	{
+	public:
+		BlockRange(const uint32_t *first_, const uint32_t *last_)
+		    : first(first_)
+		    , last(last_)
+		{
+		}
+
+		const uint32_t *begin() const
+		{
+			return first;
+		}
+
+		const uint32_t *end() const
+		{
+			return last;
+		}
+
+		size_t size() const
+		{
+			return size_t(last - first);
+		}
+
+		bool empty() const
+		{
+			return first == last;
+		}
+
+		uint32_t front() const
+		{
+			return *first;
+		}
+
+		uint32_t operator[](size_t index) const
+		{
+			return first[index];
+		}
+
+	private:
+		const uint32_t *first;
+		const uint32_t *last;
+	};
+
 	Compiler &get_compiler()
 	{
 		return compiler;
@@ -43,88 +88,162 @@ public:
 		return func;
 	}
 
+	enum : uint32_t
+	{
+		InvalidIndex = ~0u
+	};
+
+	// Every block of the function has a dense index below get_block_count(), in the order of SPIRFunction::blocks,
+	// which analyses can use to keep their per block state in flat arrays.
+	// Blocks which are not part of the CFG, i.e. not reachable from the entry block, have no edges or dominators.
+	uint32_t get_block_count() const
+	{
+		return uint32_t(block_ids.size());
+	}
+
+	uint32_t get_block_index(uint32_t block) const
+	{
+		uint32_t offset = block - index_base;
+		if (block < index_base || offset >= block_indices.size())
+			return InvalidIndex;
+		return block_indices[offset] - 1;
+	}
+
+	uint32_t get_block_id(uint32_t index) const
+	{
+		return block_ids[index];
+	}
+
+	// Blocks reachable from the entry block, successors before predecessors.
+	const std::vector<uint32_t> &get_post_order() const
+	{
+		return post_order;
+	}
+
 	uint32_t get_immediate_dominator(uint32_t block) const
 	{
-		auto itr = immediate_dominators.find(block);
-		if (itr != std::end(immediate_dominators))
-			return itr->second;
-		else
-			return 0;
+		uint32_t index = get_block_index(block);
+		return index != InvalidIndex ? immediate_dominators[index] : 0;
+	}
+
+	// The CFG has no back edges, so blocks which only branch back to a loop header end it, like returns do.
+	// Returns 0 if the block is only post-dominated by the end of the function.
+	uint32_t get_immediate_post_dominator(uint32_t block) const
+	{
+		uint32_t index = get_block_index(block);
+		return index != InvalidIndex ? immediate_post_dominators[index] : 0;
 	}
 
 	uint32_t get_visit_order(uint32_t block) const
 	{
-		auto itr = visit_order.find(block);
-		assert(itr != std::end(visit_order));
-		int v = itr->second.get();
+		uint32_t index = get_block_index(block);
+		assert(index != InvalidIndex);
+		int v = visit_order[index];
 		assert(v > 0);
 		return uint32_t(v);
 	}
 
 	uint32_t find_common_dominator(uint32_t a, uint32_t b) const;
+	uint32_t find_common_post_dominator(uint32_t a, uint32_t b) const;
+
+	// Whether every path from the entry block to b goes through a. Blocks dominate themselves.
+	bool dominates(uint32_t a, uint32_t b) const;
 
-	const std::vector<uint32_t> &get_preceding_edges(uint32_t block) const
+	BlockRange get_preceding_edges(uint32_t block) const
 	{
-		auto itr = preceding_edges.find(block);
-		if (itr != std::end(preceding_edges))
-			return itr->second;
-		else
-			return empty_vector;
+		return get_range(preceding_offsets, preceding_blocks, block);
 	}
 
-	const std::vector<uint32_t> &get_succeeding_edges(uint32_t block) const
+	BlockRange get_succeeding_edges(uint32_t block) const
 	{
-		auto itr = succeeding_edges.find(block);
-		if (itr != std::end(succeeding_edges))
-			return itr->second;
-		else
-			return empty_vector;
+		return get_range(succeeding_offsets, succeeding_blocks, block);
 	}
 
-	template <typename Op>
-	void walk_from(std::unordered_set<uint32_t> &seen_blocks, uint32_t block, const Op &op) const
+	// The blocks where the dominance of block ends, i.e. which block does not dominate,
+	// but which have a predecessor dominated by block.
+	BlockRange get_dominance_frontier(uint32_t block) const
 	{
-		if (seen_blocks.count(block))
-			return;
-		seen_blocks.insert(block);
-
-		op(block);
-		for (auto b : get_succeeding_edges(block))
-			walk_from(seen_blocks, b, op);
+		return get_range(frontier_offsets, frontier_blocks, block);
 	}
 
-private:
-	struct VisitOrder
+	// Calls op once for every block reachable from block, including block itself.
+	template <typename Op>
+	void walk_from(uint32_t block, const Op &op) const
 	{
-		int &get()
+		uint32_t index = get_block_index(block);
+		if (index == InvalidIndex)
 		{
-			return v;
+			op(block);
+			return;
 		}
 
-		const int &get() const
+		std::vector<bool> seen_blocks(block_ids.size());
+		std::vector<uint32_t> stack;
+		stack.push_back(block);
+		seen_blocks[index] = true;
+
+		while (!stack.empty())
 		{
-			return v;
-		}
+			block = stack.back();
+			stack.pop_back();
+			op(block);
 
-		int v = -1;
-	};
+			// Push in reverse so successors are walked in order.
+			auto succ = get_succeeding_edges(block);
+			for (size_t i = succ.size(); i; i--)
+			{
+				uint32_t next = succ[i - 1];
+				index = get_block_index(next);
+				if (!seen_blocks[index])
+				{
+					seen_blocks[index] = true;
+					stack.push_back(next);
+				}
+			}
+		}
+	}
 
+private:
 	Compiler &compiler;
 	const SPIRFunction &func;
-	std::unordered_map<uint32_t, std::vector<uint32_t>> preceding_edges;
-	std::unordered_map<uint32_t, std::vector<uint32_t>> succeeding_edges;
-	std::unordered_map<uint32_t, uint32_t> immediate_dominators;
-	std::unordered_map<uint32_t, VisitOrder> visit_order;
+
+	// All the per block arrays below are indexed with the dense block index.
+	// block_indices maps a block ID to its index plus one, offset by index_base, the lowest block ID in the function.
+	std::vector<uint32_t> block_ids;
+	std::vector<uint32_t> block_indices;
+	uint32_t index_base = 0;
+
+	// -1 if not visited, 0 while on the traversal stack, otherwise the post-order index counting from one.
+	std::vector<int> visit_order;
 	std::vector<uint32_t> post_order;
-	std::vector<uint32_t> empty_vector;
+	std::vector<uint32_t> immediate_dominators;
+	std::vector<uint32_t> immediate_post_dominators;
 
-	void add_branch(uint32_t from, uint32_t to);
+	// Edges and dominance frontiers of the block with index i are in [offsets[i], offsets[i + 1]).
+	std::vector<uint32_t> preceding_offsets;
+	std::vector<uint32_t> preceding_blocks;
+	std::vector<uint32_t> succeeding_offsets;
+	std::vector<uint32_t> succeeding_blocks;
+	std::vector<uint32_t> frontier_offsets;
+	std::vector<uint32_t> frontier_blocks;
+
+	BlockRange get_range(const std::vector<uint32_t> &offsets, const std::vector<uint32_t> &blocks,
+	                     uint32_t block) const
+	{
+		uint32_t index = get_block_index(block);
+		if (index == InvalidIndex)
+			return BlockRange(nullptr, nullptr);
+		const uint32_t *data = blocks.data();
+		return BlockRange(data + offsets[index], data + offsets[index + 1]);
+	}
+
+	uint32_t add_block(uint32_t block);
 	void build_post_order_visit_order();
+	void build_edges(const std::vector<std::pair<uint32_t, uint32_t>> &edges);
 	void build_immediate_dominators();
-	bool post_order_visit(uint32_t block);
-	uint32_t visit_count = 0;
-
-	bool is_back_edge(uint32_t to) const;
+	void build_immediate_post_dominators();
+	void build_dominance_frontiers();
+	uint32_t post_dominator_rank(uint32_t block) const;
 };
 
 class DominatorBuilder
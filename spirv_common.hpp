@@ -20,16 +20,19 @@
 #include "spirv.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <functional>
 #include <locale>
 #include <memory>
+#include <new>
 #include <sstream>
 #include <stack>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -91,20 +94,100 @@ public:
 
 namespace inner
 {
-template <typename T>
-void join_helper(std::ostringstream &stream, T &&t)
+template <typename Stream, typename T>
+void join_helper(Stream &stream, T &&t)
 {
 	stream << std::forward<T>(t);
 }
 
-template <typename T, typename... Ts>
-void join_helper(std::ostringstream &stream, T &&t, Ts &&... ts)
+template <typename Stream, typename T, typename... Ts>
+void join_helper(Stream &stream, T &&t, Ts &&... ts)
 {
 	stream << std::forward<T>(t);
 	join_helper(stream, std::forward<Ts>(ts)...);
 }
+
+// Enough for any 64-bit integer and its sign.
+enum
+{
+	MaxIntegerChars = 24
+};
+
+template <typename T>
+inline bool is_negative(T value, std::true_type)
+{
+	return value < 0;
+}
+
+template <typename T>
+inline bool is_negative(T, std::false_type)
+{
+	return false;
+}
+
+// Writes the digits of value right before end and returns where they start. Prints the same as std::to_string(),
+// but without allocating or looking at the locale.
+template <typename T>
+inline char *format_integer(char *end, T value)
+{
+	typedef typename std::make_unsigned<T>::type Unsigned;
+	bool negative = is_negative(value, std::is_signed<T>());
+
+	// Negate as unsigned, which works for the most negative value as well.
+	Unsigned magnitude = negative ? Unsigned(Unsigned(0) - Unsigned(value)) : Unsigned(value);
+
+	// Two digits at a time halves the number of divisions.
+	static const char digit_pairs[] = "0001020304050607080910111213141516171819"
+	                                  "2021222324252627282930313233343536373839"
+	                                  "4041424344454647484950515253545556575859"
+	                                  "6061626364656667686970717273747576777879"
+	                                  "8081828384858687888990919293949596979899";
+	while (magnitude >= 100)
+	{
+		auto pair = &digit_pairs[2 * unsigned(magnitude % 100)];
+		magnitude /= 100;
+		*--end = pair[1];
+		*--end = pair[0];
+	}
+
+	if (magnitude >= 10)
+	{
+		auto pair = &digit_pairs[2 * unsigned(magnitude)];
+		*--end = pair[1];
+		*--end = pair[0];
+	}
+	else
+		*--end = char('0' + magnitude);
+
+	if (negative)
+		*--end = '-';
+	return end;
+}
+
+// The integer types which stream operators print as numbers, and which the text builders format themselves.
+// ostream prints bool as a number and signed/unsigned char as a character, so those are left to ostream.
+template <typename T>
+struct is_formatted_integer
+    : std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value && (sizeof(T) > 1)>
+{
+};
 } // namespace inner
 
+inline uint32_t trailing_zeroes(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return uint32_t(__builtin_ctzll(x));
+#else
+	uint32_t result = 0;
+	while ((x & 1) == 0)
+	{
+		x >>= 1;
+		result++;
+	}
+	return result;
+#endif
+}
+
 class Bitset
 {
 public:
@@ -118,8 +201,9 @@ public:
 	{
 		if (bit < 64)
 			return (lower & (1ull << bit)) != 0;
-		else
-			return higher.count(bit) != 0;
+
+		auto *word = find_higher(bit >> 6);
+		return word && (word->bits & (1ull << (bit & 63))) != 0;
 	}
 
 	inline void set(uint32_t bit)
@@ -127,15 +211,24 @@ public:
 		if (bit < 64)
 			lower |= 1ull << bit;
 		else
-			higher.insert(bit);
+			find_or_insert_higher(bit >> 6).bits |= 1ull << (bit & 63);
 	}
 
 	inline void clear(uint32_t bit)
 	{
 		if (bit < 64)
+		{
 			lower &= ~(1ull << bit);
-		else
-			higher.erase(bit);
+			return;
+		}
+
+		auto *word = find_higher(bit >> 6);
+		if (word)
+		{
+			word->bits &= ~(1ull << (bit & 63));
+			if (!word->bits)
+				erase_higher(uint32_t(word - higher_words()));
+		}
 	}
 
 	inline uint64_t get_lower() const
@@ -146,37 +239,50 @@ public:
 	inline void reset()
 	{
 		lower = 0;
-		higher.clear();
+		higher_count = 0;
+		higher_heap.clear();
 	}
 
 	inline void merge_and(const Bitset &other)
 	{
 		lower &= other.lower;
-		std::unordered_set<uint32_t> tmp_set;
-		for (auto &v : higher)
-			if (other.higher.count(v) != 0)
-				tmp_set.insert(v);
-		higher = std::move(tmp_set);
+
+		uint32_t i = 0;
+		while (i < higher_count)
+		{
+			auto &word = higher_words()[i];
+			auto *other_word = other.find_higher(word.index);
+			word.bits &= other_word ? other_word->bits : 0;
+			if (word.bits)
+				i++;
+			else
+				erase_higher(i);
+		}
 	}
 
 	inline void merge_or(const Bitset &other)
 	{
 		lower |= other.lower;
-		for (auto &v : other.higher)
-			higher.insert(v);
+		for (uint32_t i = 0; i < other.higher_count; i++)
+		{
+			auto &other_word = other.higher_words()[i];
+			find_or_insert_higher(other_word.index).bits |= other_word.bits;
+		}
 	}
 
 	inline bool operator==(const Bitset &other) const
 	{
-		if (lower != other.lower)
-			return false;
-
-		if (higher.size() != other.higher.size())
+		if (lower != other.lower || higher_count != other.higher_count)
 			return false;
 
-		for (auto &v : higher)
-			if (other.higher.count(v) == 0)
+		// Zero words are never stored, so equal sets have identical word lists.
+		for (uint32_t i = 0; i < higher_count; i++)
+		{
+			auto &a = higher_words()[i];
+			auto &b = other.higher_words()[i];
+			if (a.index != b.index || a.bits != b.bits)
 				return false;
+		}
 
 		return true;
 	}
@@ -186,51 +292,618 @@ public:
 		return !(*this == other);
 	}
 
+	// Visits set bits in ascending order.
+	// The bits visited are the ones set when the call starts, so op may set or clear bits in this Bitset.
 	template <typename Op>
 	void for_each_bit(const Op &op) const
 	{
-		// TODO: Add ctz-based iteration.
-		for (uint32_t i = 0; i < 64; i++)
+		for_each_bit_in_word(lower, 0, op);
+		if (higher_count == 0)
+			return;
+
+		// Walk a copy of the higher words, as op may insert or erase words.
+		if (higher_heap.empty())
+		{
+			HigherWord words[InlineHigherWords];
+			uint32_t count = higher_count;
+			for (uint32_t i = 0; i < count; i++)
+				words[i] = higher_inline[i];
+			for_each_bit_in_words(words, count, op);
+		}
+		else
+		{
+			auto words = higher_heap;
+			for_each_bit_in_words(words.data(), uint32_t(words.size()), op);
+		}
+	}
+
+	inline bool empty() const
+	{
+		return lower == 0 && higher_count == 0;
+	}
+
+private:
+	// Bits above 63 are stored as 64-bit words, sorted by word index.
+	// Only non-zero words are kept, so sparse high bits like decoration 5635 cost one word, not 89.
+	struct HigherWord
+	{
+		uint32_t index;
+		uint64_t bits;
+	};
+
+	enum
+	{
+		InlineHigherWords = 2
+	};
+
+	// The most common bits to set are all lower than 64, so optimize for this case.
+	// A couple of higher words are stored inline; only bitsets with more than that go to the heap.
+	uint64_t lower = 0;
+	uint32_t higher_count = 0;
+	HigherWord higher_inline[InlineHigherWords] = {};
+	std::vector<HigherWord> higher_heap;
+
+	template <typename Op>
+	static void for_each_bit_in_word(uint64_t bits, uint32_t base, const Op &op)
+	{
+		while (bits)
+		{
+			op(base + trailing_zeroes(bits));
+			bits &= bits - 1;
+		}
+	}
+
+	template <typename Op>
+	static void for_each_bit_in_words(const HigherWord *words, uint32_t count, const Op &op)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			for_each_bit_in_word(words[i].bits, words[i].index << 6, op);
+	}
+
+	inline HigherWord *higher_words()
+	{
+		return higher_heap.empty() ? higher_inline : higher_heap.data();
+	}
+
+	inline const HigherWord *higher_words() const
+	{
+		return higher_heap.empty() ? higher_inline : higher_heap.data();
+	}
+
+	inline const HigherWord *find_higher(uint32_t index) const
+	{
+		auto *words = higher_words();
+		for (uint32_t i = 0; i < higher_count && words[i].index <= index; i++)
+			if (words[i].index == index)
+				return &words[i];
+		return nullptr;
+	}
+
+	inline HigherWord *find_higher(uint32_t index)
+	{
+		return const_cast<HigherWord *>(static_cast<const Bitset *>(this)->find_higher(index));
+	}
+
+	HigherWord &find_or_insert_higher(uint32_t index)
+	{
+		auto *words = higher_words();
+		uint32_t pos = 0;
+		while (pos < higher_count && words[pos].index < index)
+			pos++;
+
+		if (pos < higher_count && words[pos].index == index)
+			return words[pos];
+
+		if (!higher_heap.empty())
+			higher_heap.insert(higher_heap.begin() + pos, { index, 0 });
+		else if (higher_count < InlineHigherWords)
+		{
+			for (uint32_t i = higher_count; i > pos; i--)
+				higher_inline[i] = higher_inline[i - 1];
+			higher_inline[pos] = { index, 0 };
+		}
+		else
+		{
+			// Spill to the heap. We stay there until the higher words are all cleared again.
+			higher_heap.reserve(higher_count + 1);
+			higher_heap.insert(higher_heap.end(), higher_inline, higher_inline + higher_count);
+			higher_heap.insert(higher_heap.begin() + pos, { index, 0 });
+		}
+
+		higher_count++;
+		return higher_words()[pos];
+	}
+
+	inline void erase_higher(uint32_t pos)
+	{
+		if (!higher_heap.empty())
+		{
+			higher_heap.erase(higher_heap.begin() + pos);
+		}
+		else
+		{
+			// The second bound is implied by the first, but keeps GCC from warning about reads past the array.
+			for (uint32_t i = pos; i + 1 < higher_count && i + 1 < InlineHigherWords; i++)
+				higher_inline[i] = higher_inline[i + 1];
+		}
+		higher_count--;
+	}
+};
+
+// Hands out stable integer symbols for strings,
+// so that sets of names can hash and compare integers instead of full strings.
+class StringInterner
+{
+public:
+	enum : uint32_t
+	{
+		InvalidSymbol = 0xffffffffu
+	};
+
+	StringInterner() = default;
+	StringInterner(StringInterner &&) = default;
+	StringInterner &operator=(StringInterner &&) = default;
+
+	StringInterner(const StringInterner &other)
+	{
+		*this = other;
+	}
+
+	StringInterner &operator=(const StringInterner &other)
+	{
+		if (this != &other)
 		{
-			if (lower & (1ull << i))
-				op(i);
+			symbols = other.symbols;
+
+			// strings points into the keys of symbols, so it must refer to our own copy.
+			strings.resize(symbols.size());
+			for (auto &symbol : symbols)
+				strings[symbol.second] = &symbol.first;
 		}
+		return *this;
+	}
+
+	uint32_t intern(const std::string &str)
+	{
+		auto itr = symbols.find(str);
+		if (itr != std::end(symbols))
+			return itr->second;
+
+		auto symbol = uint32_t(strings.size());
+		strings.push_back(&symbols.emplace(str, symbol).first->first);
+		return symbol;
+	}
+
+	// Returns InvalidSymbol if the string was never interned.
+	uint32_t find(const std::string &str) const
+	{
+		auto itr = symbols.find(str);
+		return itr != std::end(symbols) ? itr->second : uint32_t(InvalidSymbol);
+	}
+
+	const std::string &get(uint32_t symbol) const
+	{
+		return *strings[symbol];
+	}
+
+private:
+	std::unordered_map<std::string, uint32_t> symbols;
+	std::vector<const std::string *> strings;
+};
+
+// A set of names in use in some scope, stored as interned symbols.
+// Numeric suffixes are also tracked per prefix, e.g. "foo_" -> { 1, 3 } for "foo_1" and "foo_3",
+// so a free name can be found for a collision without building and looking up every candidate string.
+class NameCache
+{
+public:
+	bool contains(const StringInterner &interner, const std::string &name) const
+	{
+		auto symbol = interner.find(name);
+		return symbol != StringInterner::InvalidSymbol && names.count(symbol) != 0;
+	}
+
+	// Checks if the name made up of the interned prefix and a number is in use.
+	bool contains_suffix(uint32_t prefix_symbol, uint32_t number) const
+	{
+		auto itr = suffixes.find(prefix_symbol);
+		return itr != std::end(suffixes) && itr->second.count(number) != 0;
+	}
 
-		if (higher.empty())
+	void insert(StringInterner &interner, const std::string &name)
+	{
+		uint32_t symbol = interner.intern(name);
+		if (!names.insert(symbol).second)
 			return;
 
-		// Need to enforce an order here for reproducible results,
-		// but hitting this path should happen extremely rarely, so having this slow path is fine.
-		std::vector<uint32_t> bits;
-		bits.reserve(higher.size());
-		for (auto &v : higher)
-			bits.push_back(v);
-		std::sort(std::begin(bits), std::end(bits));
+		Insertion insertion = { symbol, uint32_t(StringInterner::InvalidSymbol), 0 };
+
+		// Only track numbers which can be generated as a suffix, i.e. "<prefix>_<number>" without leading zeroes.
+		size_t digits_begin = name.find_last_not_of("0123456789") + 1;
+		size_t digit_count = name.size() - digits_begin;
+		if (digits_begin != 0 && digit_count != 0 && digit_count <= 9 && name[digits_begin - 1] == '_' &&
+		    (digit_count == 1 || name[digits_begin] != '0'))
+		{
+			uint32_t number = 0;
+			for (size_t i = digits_begin; i < name.size(); i++)
+				number = number * 10 + uint32_t(name[i] - '0');
 
-		for (auto &v : bits)
-			op(v);
+			insertion.prefix_symbol = interner.intern(name.substr(0, digits_begin));
+			insertion.number = number;
+			suffixes[insertion.prefix_symbol].insert(number);
+		}
+
+		insertions.push_back(insertion);
 	}
 
-	inline bool empty() const
+	// The number of names inserted so far, to be passed to rollback().
+	size_t size() const
+	{
+		return insertions.size();
+	}
+
+	// Removes every name which was inserted after the first count names.
+	void rollback(size_t count)
+	{
+		while (insertions.size() > count)
+		{
+			auto &insertion = insertions.back();
+			names.erase(insertion.symbol);
+			if (insertion.prefix_symbol != StringInterner::InvalidSymbol)
+				suffixes[insertion.prefix_symbol].erase(insertion.number);
+			insertions.pop_back();
+		}
+	}
+
+	void clear()
 	{
-		return lower == 0 && higher.empty();
+		names.clear();
+		suffixes.clear();
+		insertions.clear();
 	}
 
 private:
-	// The most common bits to set are all lower than 64,
-	// so optimize for this case. Bits spilling outside 64 go into a slower data structure.
-	// In almost all cases, higher data structure will not be used.
-	uint64_t lower = 0;
-	std::unordered_set<uint32_t> higher;
+	struct Insertion
+	{
+		uint32_t symbol;
+		uint32_t prefix_symbol;
+		uint32_t number;
+	};
+
+	std::unordered_set<uint32_t> names;
+	std::unordered_map<uint32_t, std::unordered_set<uint32_t>> suffixes;
+	std::vector<Insertion> insertions;
+};
+
+// An append-only text buffer for emitting source code.
+// Text is stored in a list of blocks which are never reallocated, so appending never copies what has been
+// written so far, and the final text can be handed out block by block without building one std::string.
+// Strings, characters and integers are appended directly, anything else is formatted with an ostringstream
+// in the classic locale, so output never depends on the global locale.
+class StringStream
+{
+public:
+	StringStream() = default;
+	StringStream(const StringStream &) = delete;
+	void operator=(const StringStream &) = delete;
+
+	StringStream &operator<<(const std::string &s)
+	{
+		append(s.data(), s.size());
+		return *this;
+	}
+
+	StringStream &operator<<(const char *s)
+	{
+		append(s, strlen(s));
+		return *this;
+	}
+
+	StringStream &operator<<(char c)
+	{
+		if (current && current->size < current->capacity)
+		{
+			current->data[current->size++] = c;
+			total_size++;
+		}
+		else
+			append(&c, 1);
+		return *this;
+	}
+
+	template <typename T>
+	StringStream &operator<<(const T &t)
+	{
+		append_value(t, inner::is_formatted_integer<T>());
+		return *this;
+	}
+
+	void append(const char *s, size_t len)
+	{
+		while (len)
+		{
+			if (!current || current->size == current->capacity)
+				add_block(len);
+
+			size_t to_copy = std::min(len, current->capacity - current->size);
+			memcpy(current->data.get() + current->size, s, to_copy);
+			current->size += to_copy;
+			total_size += to_copy;
+			s += to_copy;
+			len -= to_copy;
+		}
+	}
+
+	// Appends the text of other from offset and on.
+	void append(const StringStream &other, size_t offset = 0)
+	{
+		other.for_each_block([&](const char *data, size_t size) {
+			if (offset >= size)
+			{
+				offset -= size;
+				return;
+			}
+			append(data + offset, size - offset);
+			offset = 0;
+		});
+	}
+
+	// Appends count spaces, used for indentation.
+	void append_spaces(size_t count)
+	{
+		static const char spaces[] = "                                                                ";
+		const size_t max_count = sizeof(spaces) - 1;
+		while (count > max_count)
+		{
+			append(spaces, max_count);
+			count -= max_count;
+		}
+		append(spaces, count);
+	}
+
+	size_t size() const
+	{
+		return total_size;
+	}
+
+	bool empty() const
+	{
+		return total_size == 0;
+	}
+
+	// Discards the text, but keeps the last (and largest) block around for the next round of appends.
+	void reset()
+	{
+		if (blocks.size() > 1)
+		{
+			Block block = std::move(blocks.back());
+			blocks.clear();
+			blocks.push_back(std::move(block));
+		}
+
+		if (!blocks.empty())
+			blocks.front().size = 0;
+		current = blocks.empty() ? nullptr : &blocks.front();
+		total_size = 0;
+	}
+
+	// Throws away everything after the first new_size characters.
+	void truncate(size_t new_size)
+	{
+		if (new_size >= total_size)
+			return;
+
+		size_t offset = 0;
+		for (size_t i = 0; i < blocks.size(); i++)
+		{
+			auto &block = blocks[i];
+			if (new_size <= offset + block.size)
+			{
+				block.size = new_size - offset;
+				blocks.resize(i + 1);
+				current = &blocks.back();
+				break;
+			}
+			offset += block.size;
+		}
+
+		total_size = new_size;
+	}
+
+	// Calls op(const char *data, size_t size) for every block in order.
+	template <typename Op>
+	void for_each_block(const Op &op) const
+	{
+		for (auto &block : blocks)
+			if (block.size)
+				op(block.data.get(), block.size);
+	}
+
+	std::string str() const
+	{
+		std::string result;
+		result.reserve(total_size);
+		for_each_block([&](const char *data, size_t size) { result.append(data, size); });
+		return result;
+	}
+
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> data;
+		size_t size;
+		size_t capacity;
+	};
+
+	enum
+	{
+		FirstBlockSize = 4 * 1024,
+		MaxBlockSize = 256 * 1024
+	};
+
+	std::vector<Block> blocks;
+	Block *current = nullptr;
+	size_t total_size = 0;
+
+	void add_block(size_t min_size)
+	{
+		// Grow geometrically, so the number of blocks stays logarithmic in the size of the output.
+		size_t capacity =
+		    blocks.empty() ? size_t(FirstBlockSize) : std::min<size_t>(blocks.back().capacity * 2, MaxBlockSize);
+		capacity = std::max(capacity, std::min<size_t>(min_size, MaxBlockSize));
+
+		Block block;
+		block.data.reset(new char[capacity]);
+		block.size = 0;
+		block.capacity = capacity;
+		blocks.push_back(std::move(block));
+		current = &blocks.back();
+	}
+
+	template <typename T>
+	void append_value(const T &t, std::true_type)
+	{
+		char buf[inner::MaxIntegerChars];
+		char *end = buf + sizeof(buf);
+		char *start = inner::format_integer(end, t);
+		append(start, size_t(end - start));
+	}
+
+	template <typename T>
+	void append_value(const T &t, std::false_type)
+	{
+		std::ostringstream stream;
+		stream.imbue(std::locale::classic());
+		stream << t;
+		*this << stream.str();
+	}
+};
+
+// Builds short strings, like expressions and names, in a buffer which keeps its capacity between uses.
+// Appends the same way as StringStream, so output never depends on the global locale either.
+// join() reuses one builder per thread, so apart from growing that once in a while, it only allocates its result.
+// A buffer which grew past MaxRetainedCapacity is handed to the result instead of being kept for the thread.
+// With SPIRV_CROSS_NO_THREAD_LOCAL, join() builds each string in a builder of its own instead.
+class StringBuilder
+{
+public:
+	explicit StringBuilder(size_t initial_capacity = InitialCapacity)
+	{
+		buffer.reserve(initial_capacity);
+	}
+
+	StringBuilder &operator<<(const std::string &s)
+	{
+		buffer.append(s);
+		return *this;
+	}
+
+	StringBuilder &operator<<(const char *s)
+	{
+		buffer.append(s);
+		return *this;
+	}
+
+	StringBuilder &operator<<(char c)
+	{
+		buffer.push_back(c);
+		return *this;
+	}
+
+	template <typename T>
+	StringBuilder &operator<<(const T &t)
+	{
+		append_value(t, inner::is_formatted_integer<T>());
+		return *this;
+	}
+
+	void clear()
+	{
+		buffer.clear();
+	}
+
+	const std::string &str() const
+	{
+		return buffer;
+	}
+
+	// Returns a copy of the string, or the buffer itself if it grew too large to keep around.
+	std::string take_str()
+	{
+		if (buffer.capacity() <= MaxRetainedCapacity)
+			return buffer;
+
+		std::string result = std::move(buffer);
+		buffer = std::string();
+		buffer.reserve(InitialCapacity);
+		return result;
+	}
+
+	// Moves the string out, leaving the builder empty.
+	std::string release()
+	{
+		std::string result = std::move(buffer);
+		buffer = std::string();
+		return result;
+	}
+
+	size_t capacity() const
+	{
+		return buffer.capacity();
+	}
+
+#ifndef SPIRV_CROSS_NO_THREAD_LOCAL
+	// The builder join() uses on the calling thread.
+	static StringBuilder &get_thread_builder()
+	{
+		static thread_local StringBuilder builder;
+		return builder;
+	}
+#endif
+
+private:
+	enum
+	{
+		InitialCapacity = 256,
+		MaxRetainedCapacity = 4096
+	};
+
+	std::string buffer;
+
+	template <typename T>
+	void append_value(const T &t, std::true_type)
+	{
+		char buf[inner::MaxIntegerChars];
+		char *end = buf + sizeof(buf);
+		buffer.append(inner::format_integer(end, t), end);
+	}
+
+	template <typename T>
+	void append_value(const T &t, std::false_type)
+	{
+		std::ostringstream stream;
+		stream.imbue(std::locale::classic());
+		stream << t;
+		buffer.append(stream.str());
+	}
 };
 
 // Helper template to avoid lots of nasty string temporary munging.
 template <typename... Ts>
 std::string join(Ts &&... ts)
 {
-	std::ostringstream stream;
-	inner::join_helper(stream, std::forward<Ts>(ts)...);
-	return stream.str();
+#ifdef SPIRV_CROSS_NO_THREAD_LOCAL
+	// One builder shared by all threads would be a data race when compiling in parallel.
+	StringBuilder builder(0);
+	inner::join_helper(builder, std::forward<Ts>(ts)...);
+	return builder.release();
+#else
+	// Arguments are evaluated before we get here, so nested joins are done with the builder by now.
+	auto &builder = StringBuilder::get_thread_builder();
+	builder.clear();
+	inner::join_helper(builder, std::forward<Ts>(ts)...);
+	return builder.take_str();
+#endif
 }
 
 inline std::string merge(const std::vector<std::string> &list)
@@ -248,7 +921,11 @@ inline std::string merge(const std::vector<std::string> &list)
 template <typename T>
 inline std::string convert_to_string(T &&t)
 {
-	return std::to_string(std::forward<T>(t));
+	// Promote the way std::to_string() would, so bools, bytes and enums print as numbers.
+	auto value = +t;
+	char buf[inner::MaxIntegerChars];
+	char *end = buf + sizeof(buf);
+	return std::string(inner::format_integer(end, value), end);
 }
 
 // Allow implementations to set a convenient standard precision
@@ -263,28 +940,84 @@ inline std::string convert_to_string(T &&t)
 #pragma warning(disable : 4996)
 #endif
 
-inline std::string convert_to_string(float t)
+// sprintf() writes the radix point of the current C locale, which might be ',' or even several bytes.
+// Everything else it writes for a floating point value is an ASCII digit, sign, exponent or inf/nan,
+// so whatever is left must be the radix point. This way we never need to touch or query the global locale.
+// Returns the new length, and whether the text has a radix point or an exponent, i.e. reads as a float literal.
+inline size_t fixup_radix_point(char *str, bool &float_literal)
 {
+	char *out = str;
+	bool in_radix_point = false;
+	float_literal = false;
+	for (const char *in = str; *in; in++)
+	{
+		char c = *in;
+		if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '+' || c == '-')
+		{
+			*out++ = c;
+			in_radix_point = false;
+			if (c == 'e')
+				float_literal = true;
+		}
+		else if (!in_radix_point)
+		{
+			*out++ = '.';
+			in_radix_point = true;
+			float_literal = true;
+		}
+	}
+	*out = '\0';
+	return size_t(out - str);
+}
+
+inline void fixup_radix_point(char *str)
+{
+	bool float_literal;
+	fixup_radix_point(str, float_literal);
+}
+
+namespace inner
+{
+inline std::string format_float_literal(double t)
+{
+	// Most constants are whole numbers, which the default format prints as plain integers. Below 2^53 all of them
+	// convert to int64_t exactly, and every digit %.32g prints is significant. -0 has to keep its sign.
+	const double max_exact = 9007199254740992.0;
+	if (strcmp(SPIRV_CROSS_FLT_FMT, "%.32g") == 0 && t >= -max_exact && t <= max_exact && double(int64_t(t)) == t &&
+	    !(t == 0.0 && std::signbit(t)))
+	{
+		char buf[MaxIntegerChars + 2];
+		char *end = buf + MaxIntegerChars;
+		char *start = format_integer(end, int64_t(t));
+		memcpy(end, ".0", 2);
+		return std::string(start, end + 2);
+	}
+
 	// std::to_string for floating point values is broken.
 	// Fallback to something more sane.
 	char buf[64];
 	sprintf(buf, SPIRV_CROSS_FLT_FMT, t);
+	bool float_literal;
+	size_t len = fixup_radix_point(buf, float_literal);
+
 	// Ensure that the literal is float.
-	if (!strchr(buf, '.') && !strchr(buf, 'e'))
-		strcat(buf, ".0");
-	return buf;
+	if (!float_literal)
+	{
+		memcpy(buf + len, ".0", 3);
+		len += 2;
+	}
+	return std::string(buf, len);
+}
+} // namespace inner
+
+inline std::string convert_to_string(float t)
+{
+	return inner::format_float_literal(t);
 }
 
 inline std::string convert_to_string(double t)
 {
-	// std::to_string for floating point values is broken.
-	// Fallback to something more sane.
-	char buf[64];
-	sprintf(buf, SPIRV_CROSS_FLT_FMT, t);
-	// Ensure that the literal is float.
-	if (!strchr(buf, '.') && !strchr(buf, 'e'))
-		strcat(buf, ".0");
-	return buf;
+	return inner::format_float_literal(t);
 }
 
 #ifdef _MSC_VER
@@ -299,19 +1032,88 @@ struct Instruction
 	uint32_t length = 0;
 };
 
+class ObjectPoolBase
+{
+public:
+	virtual ~ObjectPoolBase() = default;
+	virtual void free_opaque(void *ptr) = 0;
+};
+
+// Allocates objects of one type in geometrically growing slabs.
+// Freed objects are destroyed and threaded onto an intrusive free list, so their memory is recycled by later
+// allocations without going back to the heap. The slabs themselves are only released when the pool is destroyed.
+template <typename T>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+	explicit ObjectPool(unsigned start_object_count_ = 16)
+	    : start_object_count(start_object_count_)
+	{
+	}
+
+	ObjectPool(const ObjectPool &) = delete;
+	void operator=(const ObjectPool &) = delete;
+
+	~ObjectPool()
+	{
+		for (auto *slab : memory)
+			::operator delete(slab);
+	}
+
+	template <typename... P>
+	T *allocate(P &&... p)
+	{
+		if (!vacant)
+		{
+			unsigned num_objects = start_object_count << std::min<size_t>(memory.size(), 10);
+			T *slab = static_cast<T *>(::operator new(num_objects * sizeof(T)));
+			memory.push_back(slab);
+
+			for (unsigned i = num_objects; i; i--)
+				vacant = new (&slab[i - 1]) FreeNode{ vacant };
+		}
+
+		void *ptr = vacant;
+		vacant = vacant->next;
+		return new (ptr) T(std::forward<P>(p)...);
+	}
+
+	void free(T *ptr)
+	{
+		ptr->~T();
+		vacant = new (ptr) FreeNode{ vacant };
+	}
+
+	void free_opaque(void *ptr) override
+	{
+		free(static_cast<T *>(ptr));
+	}
+
+private:
+	struct FreeNode
+	{
+		FreeNode *next;
+	};
+	static_assert(sizeof(T) >= sizeof(FreeNode), "Object is too small to hold a free list node.");
+
+	FreeNode *vacant = nullptr;
+	std::vector<T *> memory;
+	unsigned start_object_count;
+};
+
 // Helper for Variant interface.
 struct IVariant
 {
 	virtual ~IVariant() = default;
-	virtual std::unique_ptr<IVariant> clone() = 0;
+	virtual IVariant *clone(ObjectPoolBase *pool) = 0;
 
 	uint32_t self = 0;
 };
 
-#define SPIRV_CROSS_DECLARE_CLONE(T)                    \
-	std::unique_ptr<IVariant> clone() override          \
-	{                                                   \
-		return std::unique_ptr<IVariant>(new T(*this)); \
+#define SPIRV_CROSS_DECLARE_CLONE(T)                                \
+	IVariant *clone(ObjectPoolBase *pool) override                  \
+	{                                                               \
+		return static_cast<ObjectPool<T> *>(pool)->allocate(*this); \
 	}
 
 enum Types
@@ -468,7 +1270,7 @@ struct SPIRType : IVariant
 	uint32_t parent_type = 0;
 
 	// Used in backends to avoid emitting members with conflicting names.
-	std::unordered_set<std::string> member_name_cache;
+	NameCache member_name_cache;
 
 	SPIRV_CROSS_DECLARE_CLONE(SPIRType)
 };
@@ -1217,11 +2019,59 @@ struct SPIRConstant : IVariant
 	SPIRV_CROSS_DECLARE_CLONE(SPIRConstant)
 };
 
+// One object pool per IVariant type. A ParsedIR owns one group, and all Variants in its ids array allocate from it.
+// Variants refer to pools by Types enum through the pools array, which points into this object.
+class ObjectPoolGroup
+{
+public:
+	ObjectPoolGroup()
+	{
+		pools[TypeType] = &type_pool;
+		pools[TypeVariable] = &variable_pool;
+		pools[TypeConstant] = &constant_pool;
+		pools[TypeFunction] = &function_pool;
+		pools[TypeFunctionPrototype] = &function_prototype_pool;
+		pools[TypeBlock] = &block_pool;
+		pools[TypeExtension] = &extension_pool;
+		pools[TypeExpression] = &expression_pool;
+		pools[TypeConstantOp] = &constant_op_pool;
+		pools[TypeCombinedImageSampler] = &combined_image_sampler_pool;
+		pools[TypeAccessChain] = &access_chain_pool;
+		pools[TypeUndef] = &undef_pool;
+	}
+
+	ObjectPoolGroup(const ObjectPoolGroup &) = delete;
+	void operator=(const ObjectPoolGroup &) = delete;
+
+	ObjectPoolBase *pools[TypeCount] = {};
+
+private:
+	ObjectPool<SPIRType> type_pool;
+	ObjectPool<SPIRVariable> variable_pool;
+	ObjectPool<SPIRConstant> constant_pool;
+	ObjectPool<SPIRFunction> function_pool;
+	ObjectPool<SPIRFunctionPrototype> function_prototype_pool;
+	ObjectPool<SPIRBlock> block_pool;
+	ObjectPool<SPIRExtension> extension_pool;
+	ObjectPool<SPIRExpression> expression_pool;
+	ObjectPool<SPIRConstantOp> constant_op_pool;
+	ObjectPool<SPIRCombinedImageSampler> combined_image_sampler_pool;
+	ObjectPool<SPIRAccessChain> access_chain_pool;
+	ObjectPool<SPIRUndef> undef_pool;
+};
+
 class Variant
 {
 public:
-	// MSVC 2013 workaround, we shouldn't need these constructors.
-	Variant() = default;
+	explicit Variant(ObjectPoolGroup *group_)
+	    : group(group_)
+	{
+	}
+
+	~Variant()
+	{
+		release();
+	}
 
 	// Marking custom move constructor as noexcept is important.
 	Variant(Variant &&other) SPIRV_CROSS_NOEXCEPT
@@ -1229,20 +2079,25 @@ public:
 		*this = std::move(other);
 	}
 
-	Variant(const Variant &variant)
-	{
-		*this = variant;
-	}
+	// We cannot copy from other variant without our own pool group.
+	// Have to explicitly copy.
+	Variant(const Variant &variant) = delete;
 
 	// Marking custom move constructor as noexcept is important.
 	Variant &operator=(Variant &&other) SPIRV_CROSS_NOEXCEPT
 	{
 		if (this != &other)
 		{
-			holder = std::move(other.holder);
+			release();
+			holder = other.holder;
+			group = other.group;
 			type = other.type;
 			allow_type_rewrite = other.allow_type_rewrite;
+			holder_is_shared = other.holder_is_shared;
+
+			other.holder = nullptr;
 			other.type = TypeNone;
+			other.holder_is_shared = false;
 		}
 		return *this;
 	}
@@ -1250,6 +2105,7 @@ public:
 	// This copy/clone should only be called in the Compiler constructor.
 	// If this is called inside ::compile(), we invalidate any references we took higher in the stack.
 	// This should never happen.
+	// The object is cloned into our own pool group, which might differ from the group of other.
 	Variant &operator=(const Variant &other)
 	{
 #ifdef SPIRV_CROSS_COPY_CONSTRUCTOR_SANITIZE
@@ -1257,24 +2113,57 @@ public:
 #endif
 		if (this != &other)
 		{
-			holder.reset();
+			release();
+
 			if (other.holder)
-				holder = other.holder->clone();
+				holder = other.holder->clone(group->pools[other.type]);
+			else
+				holder = nullptr;
+
 			type = other.type;
 			allow_type_rewrite = other.allow_type_rewrite;
 		}
 		return *this;
 	}
 
-	void set(std::unique_ptr<IVariant> val, Types new_type)
+	// Refers to the object held by another variant instead of cloning it.
+	// Const access reads the shared object in place. It is only cloned into our own pool
+	// the first time it is accessed through the non-const get(), so other must outlive this variant
+	// and must not be modified in the meantime. References taken through const access before that
+	// keep referring to the shared object, and do not see writes to the clone.
+	void set_shared(const Variant &other)
+	{
+		release();
+		holder = other.holder;
+		type = other.type;
+		allow_type_rewrite = other.allow_type_rewrite;
+		holder_is_shared = holder != nullptr;
+	}
+
+	void set(IVariant *val, Types new_type)
 	{
-		holder = std::move(val);
+		release();
+
 		if (!allow_type_rewrite && type != TypeNone && type != new_type)
+		{
+			if (val)
+				group->pools[new_type]->free_opaque(val);
 			SPIRV_CROSS_THROW("Overwriting a variant with new type.");
+		}
+
+		holder = val;
 		type = new_type;
 		allow_type_rewrite = false;
 	}
 
+	template <typename T, typename... Ts>
+	T *allocate_and_set(Types new_type, Ts &&... ts)
+	{
+		T *val = static_cast<ObjectPool<T> &>(*group->pools[new_type]).allocate(std::forward<Ts>(ts)...);
+		set(val, new_type);
+		return val;
+	}
+
 	template <typename T>
 	T &get()
 	{
@@ -1282,7 +2171,9 @@ public:
 			SPIRV_CROSS_THROW("nullptr");
 		if (static_cast<Types>(T::type) != type)
 			SPIRV_CROSS_THROW("Bad cast");
-		return *static_cast<T *>(holder.get());
+		if (holder_is_shared)
+			unshare();
+		return *static_cast<T *>(holder);
 	}
 
 	template <typename T>
@@ -1292,7 +2183,7 @@ public:
 			SPIRV_CROSS_THROW("nullptr");
 		if (static_cast<Types>(T::type) != type)
 			SPIRV_CROSS_THROW("Bad cast");
-		return *static_cast<const T *>(holder.get());
+		return *static_cast<const T *>(holder);
 	}
 
 	Types get_type() const
@@ -1312,7 +2203,7 @@ public:
 
 	void reset()
 	{
-		holder.reset();
+		release();
 		type = TypeNone;
 	}
 
@@ -1322,9 +2213,27 @@ public:
 	}
 
 private:
-	std::unique_ptr<IVariant> holder;
+	ObjectPoolGroup *group = nullptr;
+
+	IVariant *holder = nullptr;
+	bool holder_is_shared = false;
+
 	Types type = TypeNone;
 	bool allow_type_rewrite = false;
+
+	void unshare()
+	{
+		holder = holder->clone(group->pools[type]);
+		holder_is_shared = false;
+	}
+
+	void release()
+	{
+		if (holder && !holder_is_shared)
+			group->pools[type]->free_opaque(holder);
+		holder = nullptr;
+		holder_is_shared = false;
+	}
 };
 
 template <typename T>
@@ -1342,9 +2251,7 @@ const T &variant_get(const Variant &var)
 template <typename T, typename... P>
 T &variant_set(Variant &var, P &&... args)
 {
-	auto uptr = std::unique_ptr<T>(new T(std::forward<P>(args)...));
-	auto ptr = uptr.get();
-	var.set(std::move(uptr), static_cast<Types>(T::type));
+	auto *ptr = var.allocate_and_set<T>(static_cast<Types>(T::type), std::forward<P>(args)...);
 	return *ptr;
 }
 
@@ -1356,6 +2263,77 @@ struct AccessChainMeta
 	bool storage_is_invariant = false;
 };
 
+// Maps decorations to the offset of their literal argument in the SPIR-V binary.
+// An ID rarely has more than a couple of such decorations, so a small inline array beats a hash map.
+class DecorationWordOffsets
+{
+public:
+	void set(spv::Decoration decoration, uint32_t word_offset)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (entries[i].decoration == decoration)
+			{
+				entries[i].word_offset = word_offset;
+				return;
+			}
+		}
+
+		for (auto &entry : overflow)
+		{
+			if (entry.decoration == decoration)
+			{
+				entry.word_offset = word_offset;
+				return;
+			}
+		}
+
+		if (count < InlineCount)
+			entries[count++] = { decoration, word_offset };
+		else
+			overflow.push_back({ decoration, word_offset });
+	}
+
+	bool find(spv::Decoration decoration, uint32_t &word_offset) const
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (entries[i].decoration == decoration)
+			{
+				word_offset = entries[i].word_offset;
+				return true;
+			}
+		}
+
+		for (auto &entry : overflow)
+		{
+			if (entry.decoration == decoration)
+			{
+				word_offset = entry.word_offset;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	struct Entry
+	{
+		spv::Decoration decoration;
+		uint32_t word_offset;
+	};
+
+	enum
+	{
+		InlineCount = 3
+	};
+
+	Entry entries[InlineCount];
+	uint32_t count = 0;
+	std::vector<Entry> overflow;
+};
+
 struct Meta
 {
 	struct Decoration
@@ -1390,7 +2368,7 @@ struct Meta
 	Decoration decoration;
 	std::vector<Decoration> members;
 
-	std::unordered_map<uint32_t, uint32_t> decoration_word_offset;
+	DecorationWordOffsets decoration_word_offset;
 
 	// For SPV_GOOGLE_hlsl_functionality1.
 	bool hlsl_is_magic_counter_buffer = false;
@@ -1404,22 +2382,6 @@ struct Meta
 using VariableTypeRemapCallback =
     std::function<void(const SPIRType &type, const std::string &var_name, std::string &name_of_type)>;
 
-class ClassicLocale
-{
-public:
-	ClassicLocale()
-	{
-		old = std::locale::global(std::locale::classic());
-	}
-	~ClassicLocale()
-	{
-		std::locale::global(old);
-	}
-
-private:
-	std::locale old;
-};
-
 class Hasher
 {
 public:
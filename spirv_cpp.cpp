@@ -304,11 +304,8 @@ void CompilerCPP::emit_resources()
 		statement("");
 }
 
-string CompilerCPP::compile()
+void CompilerCPP::emit_source()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
-
 	// Do not deal with ES-isms like precision, older extensions and such.
 	options.es = false;
 	options.version = 450;
@@ -336,8 +333,7 @@ string CompilerCPP::compile()
 		resource_registrations.clear();
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
 
 		emit_header();
 		emit_resources();
@@ -345,7 +341,7 @@ string CompilerCPP::compile()
 		emit_function(get<SPIRFunction>(ir.default_entry_point), Bitset());
 
 		pass_count++;
-	} while (force_recompile);
+	} while (is_forcing_recompilation());
 
 	// Match opening scope of emit_header().
 	end_scope_decl();
@@ -357,8 +353,6 @@ string CompilerCPP::compile()
 
 	// Entry point in CPP is always main() for the time being.
 	get_entry_point().name = "main";
-
-	return buffer->str();
 }
 
 void CompilerCPP::emit_c_linkage()
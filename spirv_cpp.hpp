@@ -46,8 +46,6 @@ public:
 	{
 	}
 
-	std::string compile() override;
-
 	// Sets a custom symbol name that can override
 	// spirv_cross_get_interface.
 	//
@@ -59,6 +57,7 @@ public:
 	}
 
 private:
+	void emit_source() override;
 	void emit_header() override;
 	void emit_c_linkage();
 	void emit_function_prototype(SPIRFunction &func, const Bitset &return_flags) override;
@@ -28,16 +28,20 @@ using namespace spirv_cross;
 
 Compiler::Compiler(vector<uint32_t> ir_)
 {
+	auto start = chrono::steady_clock::now();
 	Parser parser(move(ir_));
 	parser.parse();
 	set_ir(move(parser.get_parsed_ir()));
+	parse_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 }
 
 Compiler::Compiler(const uint32_t *ir_, size_t word_count)
 {
+	auto start = chrono::steady_clock::now();
 	Parser parser(ir_, word_count);
 	parser.parse();
 	set_ir(move(parser.get_parsed_ir()));
+	parse_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 }
 
 Compiler::Compiler(const ParsedIR &ir_)
@@ -53,23 +57,121 @@ Compiler::Compiler(ParsedIR &&ir_)
 void Compiler::set_ir(ParsedIR &&ir_)
 {
 	ir = move(ir_);
+	call_graph.valid = false;
 	parse_fixup();
 }
 
 void Compiler::set_ir(const ParsedIR &ir_)
 {
 	ir = ir_;
+	call_graph.valid = false;
 	parse_fixup();
 }
 
 string Compiler::compile()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
 	return "";
 }
 
-bool Compiler::variable_storage_is_aliased(const SPIRVariable &v)
+Compiler::PhaseTimer::PhaseTimer(const Compiler &compiler, double &seconds_)
+{
+	if (compiler.compile_statistics_enabled)
+	{
+		seconds = &seconds_;
+		start = chrono::steady_clock::now();
+	}
+}
+
+Compiler::PhaseTimer::PhaseTimer(Compiler &compiler, const char *name_)
+{
+	if (compiler.compile_statistics_enabled)
+	{
+		statistics = &compiler.compile_statistics;
+		name = name_;
+		start = chrono::steady_clock::now();
+	}
+}
+
+Compiler::PhaseTimer::~PhaseTimer()
+{
+	if (!seconds && !statistics)
+		return;
+
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (seconds)
+		*seconds += elapsed;
+	else
+		statistics->backend_phase_times.emplace_back(name, elapsed);
+}
+
+void Compiler::begin_compile_statistics()
+{
+	if (!compile_statistics_enabled)
+		return;
+
+	compile_statistics = CompileStatistics();
+	compile_statistics.parse_time = parse_time;
+	compile_start = chrono::steady_clock::now();
+}
+
+void Compiler::begin_emit_pass_statistics()
+{
+	if (!compile_statistics_enabled)
+		return;
+
+	// A pass lasts until the next one begins, or until the compile is done.
+	auto now = chrono::steady_clock::now();
+	auto &times = compile_statistics.emit_pass_times;
+	if (!times.empty())
+		times.back() = chrono::duration<double>(now - emit_pass_start).count();
+	times.push_back(0.0);
+	emit_pass_start = now;
+}
+
+void Compiler::end_compile_statistics(size_t bytes_emitted)
+{
+	if (!compile_statistics_enabled)
+		return;
+
+	auto now = chrono::steady_clock::now();
+	auto &times = compile_statistics.emit_pass_times;
+	if (!times.empty())
+		times.back() = chrono::duration<double>(now - emit_pass_start).count();
+
+	compile_statistics.compile_time = chrono::duration<double>(now - compile_start).count();
+	compile_statistics.temporaries_forced = uint32_t(forced_temporaries.size());
+	compile_statistics.bytes_emitted = bytes_emitted;
+	compile_statistics.recompile = recompile_statistics;
+}
+
+void Compiler::force_recompile(RecompileTrigger trigger)
+{
+	recompile_statistics.triggers[trigger]++;
+
+	switch (trigger)
+	{
+	case RecompileHelperFunction:
+		if (can_recompile_helpers)
+			recompile_helpers = true;
+		else
+			recompile_all = true;
+		break;
+
+	case RecompileHeaderLine:
+	case RecompileImageAccess:
+		recompile_all = true;
+		break;
+
+	default:
+		if (can_recompile_function)
+			recompile_function = true;
+		else
+			recompile_all = true;
+		break;
+	}
+}
+
+bool Compiler::variable_storage_is_aliased(const SPIRVariable &v) const
 {
 	auto &type = get<SPIRType>(v.basetype);
 	bool ssbo = v.storage == StorageClassStorageBuffer ||
@@ -308,7 +410,7 @@ void Compiler::register_write(uint32_t chain)
 		if (var->parameter && var->parameter->write_count == 0)
 		{
 			var->parameter->write_count++;
-			force_recompile = true;
+			force_recompile(RecompileParameterWritten);
 		}
 	}
 	else
@@ -533,14 +635,67 @@ bool Compiler::is_array(const SPIRType &type) const
 	return !type.array.empty();
 }
 
+static void filter_resources(vector<Resource> &filtered, const vector<Resource> &resources,
+                             const unordered_set<uint32_t> &active_variables)
+{
+	filtered.clear();
+	for (auto &res : resources)
+		if (active_variables.count(res.id))
+			filtered.push_back(res);
+}
+
+// Same as collecting resources with active_variables as the filter, as the filter does not affect the order.
+static void filter_shader_resources(ShaderResources &filtered, const ShaderResources &res,
+                                    const unordered_set<uint32_t> &active_variables)
+{
+	filter_resources(filtered.uniform_buffers, res.uniform_buffers, active_variables);
+	filter_resources(filtered.storage_buffers, res.storage_buffers, active_variables);
+	filter_resources(filtered.stage_inputs, res.stage_inputs, active_variables);
+	filter_resources(filtered.stage_outputs, res.stage_outputs, active_variables);
+	filter_resources(filtered.subpass_inputs, res.subpass_inputs, active_variables);
+	filter_resources(filtered.storage_images, res.storage_images, active_variables);
+	filter_resources(filtered.sampled_images, res.sampled_images, active_variables);
+	filter_resources(filtered.atomic_counters, res.atomic_counters, active_variables);
+	filter_resources(filtered.push_constant_buffers, res.push_constant_buffers, active_variables);
+	filter_resources(filtered.separate_images, res.separate_images, active_variables);
+	filter_resources(filtered.separate_samplers, res.separate_samplers, active_variables);
+}
+
 ShaderResources Compiler::get_shader_resources() const
 {
-	return get_shader_resources(nullptr);
+	return get_cached_shader_resources();
 }
 
 ShaderResources Compiler::get_shader_resources(const unordered_set<uint32_t> &active_variables) const
 {
-	return get_shader_resources(&active_variables);
+	ShaderResources res;
+	filter_shader_resources(res, get_cached_shader_resources(), active_variables);
+	return res;
+}
+
+const ShaderResources &Compiler::get_cached_shader_resources() const
+{
+	auto &cache = reflection_cache;
+	lock_guard<recursive_mutex> holder(cache.lock);
+	if (cache.resources_count != ir.get_modification_count())
+	{
+		cache.resources = get_shader_resources(nullptr);
+		cache.resources_count = ir.get_modification_count();
+	}
+	return cache.resources;
+}
+
+const ShaderResources &Compiler::get_cached_active_shader_resources() const
+{
+	auto &cache = reflection_cache;
+	lock_guard<recursive_mutex> holder(cache.lock);
+	if (cache.active_resources_count != ir.get_modification_count())
+	{
+		filter_shader_resources(cache.active_resources, get_cached_shader_resources(),
+		                        get_cached_active_interface_variables());
+		cache.active_resources_count = ir.get_modification_count();
+	}
+	return cache.active_resources;
 }
 
 bool Compiler::InterfaceVariableAccessHandler::handle(Op opcode, const uint32_t *args, uint32_t length)
@@ -696,8 +851,19 @@ bool Compiler::InterfaceVariableAccessHandler::handle(Op opcode, const uint32_t
 
 unordered_set<uint32_t> Compiler::get_active_interface_variables() const
 {
+	return get_cached_active_interface_variables();
+}
+
+const unordered_set<uint32_t> &Compiler::get_cached_active_interface_variables() const
+{
+	auto &cache = reflection_cache;
+	lock_guard<recursive_mutex> holder(cache.lock);
+	if (cache.active_variables_count == ir.get_modification_count())
+		return cache.active_variables;
+
 	// Traverse the call graph and find all interface variables which are in use.
-	unordered_set<uint32_t> variables;
+	auto &variables = cache.active_variables;
+	variables.clear();
 	InterfaceVariableAccessHandler handler(*this, variables);
 	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler);
 
@@ -711,6 +877,7 @@ unordered_set<uint32_t> Compiler::get_active_interface_variables() const
 	if (dummy_sampler_id)
 		variables.insert(dummy_sampler_id);
 
+	cache.active_variables_count = ir.get_modification_count();
 	return variables;
 }
 
@@ -842,28 +1009,35 @@ void Compiler::fixup_type_alias()
 	// Due to how some backends work, the "master" type of type_alias must be a block-like type if it exists.
 	// FIXME: Multiple alias types which are both block-like will be awkward, for now, it's best to just drop the type
 	// alias if the slave type is a block type.
-	ir.for_each_typed_id<SPIRType>([&](uint32_t self, SPIRType &type) {
+	// Types are only looked up for writing when they change,
+	// so a compiler created from a view of a shared ParsedIR does not clone every type here.
+	const ParsedIR &const_ir = ir;
+
+	const_ir.for_each_typed_id<SPIRType>([&](uint32_t self, const SPIRType &type) {
 		if (type.type_alias && type_is_block_like(type))
 		{
+			uint32_t type_self = type.self;
+			uint32_t type_alias = type.type_alias;
+
 			// Become the master.
-			ir.for_each_typed_id<SPIRType>([&](uint32_t other_id, SPIRType &other_type) {
-				if (other_id == type.self)
+			const_ir.for_each_typed_id<SPIRType>([&](uint32_t other_id, const SPIRType &other_type) {
+				if (other_id == type_self)
 					return;
 
-				if (other_type.type_alias == type.type_alias)
-					other_type.type_alias = type.self;
+				if (other_type.type_alias == type_alias)
+					this->get<SPIRType>(other_id).type_alias = type_self;
 			});
 
-			this->get<SPIRType>(type.type_alias).type_alias = self;
-			type.type_alias = 0;
+			this->get<SPIRType>(type_alias).type_alias = self;
+			this->get<SPIRType>(self).type_alias = 0;
 		}
 	});
 
-	ir.for_each_typed_id<SPIRType>([&](uint32_t, SPIRType &type) {
+	const_ir.for_each_typed_id<SPIRType>([&](uint32_t self, const SPIRType &type) {
 		if (type.type_alias && type_is_block_like(type))
 		{
 			// This is not allowed, drop the type_alias.
-			type.type_alias = 0;
+			this->get<SPIRType>(self).type_alias = 0;
 		}
 	});
 
@@ -873,7 +1047,7 @@ void Compiler::fixup_type_alias()
 	auto &type_ids = ir.ids_for_type[TypeType];
 	for (auto alias_itr = begin(type_ids); alias_itr != end(type_ids); ++alias_itr)
 	{
-		auto &type = get<SPIRType>(*alias_itr);
+		auto &type = const_ir.ids[*alias_itr].get<SPIRType>();
 		if (type.type_alias != 0 && !has_extended_decoration(type.type_alias, SPIRVCrossDecorationPacked))
 		{
 			// We will skip declaring this type, so make sure the type_alias type comes before.
@@ -899,14 +1073,17 @@ void Compiler::fixup_type_alias()
 void Compiler::parse_fixup()
 {
 	// Figure out specialization constants for work group sizes.
+	// Only read through const access, so a compiler created from a view of a shared ParsedIR clones nothing here.
+	const ParsedIR &const_ir = ir;
 	for (auto id_ : ir.ids_for_constant_or_variable)
 	{
-		auto &id = ir.ids[id_];
+		auto &id = const_ir.ids[id_];
 
 		if (id.get_type() == TypeConstant)
 		{
 			auto &c = id.get<SPIRConstant>();
-			if (ir.meta[c.self].decoration.builtin && ir.meta[c.self].decoration.builtin_type == BuiltInWorkgroupSize)
+			auto &dec = const_ir.meta[c.self].decoration;
+			if (dec.builtin && dec.builtin_type == BuiltInWorkgroupSize)
 			{
 				// In current SPIR-V, there can be just one constant like this.
 				// All entry points will receive the constant value.
@@ -975,62 +1152,69 @@ void Compiler::flatten_interface_block(uint32_t id)
 	type.storage = storage;
 	type.parent_type = t;
 	var.storage = storage;
+	ir.mark_modified();
 }
 
-void Compiler::update_name_cache(unordered_set<string> &cache_primary, const unordered_set<string> &cache_secondary,
-                                 string &name)
+void Compiler::update_name_cache(NameCache &cache_primary, const NameCache &cache_secondary, string &name)
 {
 	if (name.empty())
 		return;
 
 	const auto find_name = [&](const string &n) -> bool {
-		if (cache_primary.find(n) != end(cache_primary))
+		if (cache_primary.contains(name_interner, n))
 			return true;
 
 		if (&cache_primary != &cache_secondary)
-			if (cache_secondary.find(n) != end(cache_secondary))
+			if (cache_secondary.contains(name_interner, n))
 				return true;
 
 		return false;
 	};
 
-	const auto insert_name = [&](const string &n) { cache_primary.insert(n); };
+	const auto find_suffix = [&](uint32_t prefix_symbol, uint32_t counter) -> bool {
+		if (cache_primary.contains_suffix(prefix_symbol, counter))
+			return true;
+
+		if (&cache_primary != &cache_secondary)
+			if (cache_secondary.contains_suffix(prefix_symbol, counter))
+				return true;
+
+		return false;
+	};
 
 	if (!find_name(name))
 	{
-		insert_name(name);
+		cache_primary.insert(name_interner, name);
 		return;
 	}
 
-	uint32_t counter = 0;
-	auto tmpname = name;
+	auto prefix = name;
 
-	bool use_linked_underscore = true;
-
-	if (tmpname == "_")
+	if (prefix == "_")
 	{
 		// We cannot just append numbers, as we will end up creating internally reserved names.
 		// Make it like _0_<counter> instead.
-		tmpname += "0";
+		prefix += "0_";
 	}
-	else if (tmpname.back() == '_')
+	else if (prefix.back() != '_')
 	{
-		// The last_character is an underscore, so we don't need to link in underscore.
+		// If the last character is an underscore, we don't need to link in underscore.
 		// This would violate double underscore rules.
-		use_linked_underscore = false;
+		prefix += "_";
 	}
 
-	// If there is a collision (very rare),
-	// keep tacking on extra identifier until it's unique.
-	do
-	{
+	// If there is a collision (very rare), find the first unused number to tack on.
+	// The caches track which numbers are in use for each prefix, so there is no need to try every candidate name.
+	uint32_t prefix_symbol = name_interner.intern(prefix);
+	uint32_t counter = 1;
+	while (find_suffix(prefix_symbol, counter))
 		counter++;
-		name = tmpname + (use_linked_underscore ? "_" : "") + convert_to_string(counter);
-	} while (find_name(name));
-	insert_name(name);
+
+	name = prefix + convert_to_string(counter);
+	cache_primary.insert(name_interner, name);
 }
 
-void Compiler::update_name_cache(unordered_set<string> &cache, string &name)
+void Compiler::update_name_cache(NameCache &cache, string &name)
 {
 	update_name_cache(cache, cache, name);
 }
@@ -1455,13 +1639,7 @@ bool Compiler::get_binary_offset_for_decoration(uint32_t id, spv::Decoration dec
 	if (!m)
 		return false;
 
-	auto &word_offsets = m->decoration_word_offset;
-	auto itr = word_offsets.find(decoration);
-	if (itr == end(word_offsets))
-		return false;
-
-	word_offset = itr->second;
-	return true;
+	return m->decoration_word_offset.find(decoration, word_offset);
 }
 
 bool Compiler::block_is_loop_candidate(const SPIRBlock &block, SPIRBlock::Method method) const
@@ -1640,6 +1818,95 @@ SPIRBlock::ContinueBlockType Compiler::continue_block_type(const SPIRBlock &bloc
 	}
 }
 
+// Opcodes whose operands are always emitted as expressions, so constants are referred to by their names.
+static bool opcode_uses_constants_by_name(Op op)
+{
+	switch (op)
+	{
+	case OpStore:
+	case OpCopyObject:
+	case OpCompositeConstruct:
+	case OpCompositeExtract:
+	case OpCompositeInsert:
+	case OpSelect:
+	case OpPhi:
+	case OpFunctionCall:
+	case OpExtInst:
+	case OpBitcast:
+		return true;
+
+	default:
+		// Conversions, arithmetic, relational and logical operations, and bit operations.
+		return (op >= OpConvertFToU && op <= OpQuantizeToF16) || (op >= OpSNegate && op <= OpSMulExtended) ||
+		       (op >= OpAny && op <= OpFUnordGreaterThanEqual) || (op >= OpShiftRightLogical && op <= OpBitCount);
+	}
+}
+
+void Compiler::find_specialization_constants_used_by_value(unordered_set<uint32_t> &ids) const
+{
+	unordered_set<uint32_t> visited;
+	vector<uint32_t> pending;
+
+	const auto mark = [&](uint32_t id) {
+		pending.push_back(id);
+		while (!pending.empty())
+		{
+			uint32_t current = pending.back();
+			pending.pop_back();
+			if (!visited.insert(current).second)
+				continue;
+
+			if (ir.ids[current].get_type() == TypeConstant)
+			{
+				auto &c = get<SPIRConstant>(current);
+				if (c.specialization)
+					ids.insert(current);
+
+				for (uint32_t col = 0; col < c.columns(); col++)
+				{
+					if (c.specialization_constant_id(col))
+						pending.push_back(c.specialization_constant_id(col));
+					for (uint32_t row = 0; row < c.vector_size(); row++)
+						if (c.specialization_constant_id(col, row))
+							pending.push_back(c.specialization_constant_id(col, row));
+				}
+
+				pending.insert(end(pending), begin(c.subconstants), end(c.subconstants));
+			}
+			else if (ir.ids[current].get_type() == TypeConstantOp)
+			{
+				// Some arguments are literals, which might also be marked here. That only makes this more conservative.
+				auto &op = get<SPIRConstantOp>(current);
+				for (auto arg : op.arguments)
+					if (arg < ir.ids.size())
+						pending.push_back(arg);
+			}
+		}
+	};
+
+	ir.for_each_typed_id<SPIRConstant>([&](uint32_t id, const SPIRConstant &c) {
+		if (c.is_used_as_array_length)
+			mark(id);
+	});
+
+	ir.for_each_typed_id<SPIRBlock>([&](uint32_t, const SPIRBlock &block) {
+		for (auto &i : block.ops)
+		{
+			if (opcode_uses_constants_by_name(static_cast<Op>(i.op)))
+				continue;
+
+			// Literal operands are treated as IDs as well, which again only makes this more conservative.
+			auto ops = stream(i);
+			for (uint32_t j = 0; j < i.length; j++)
+			{
+				auto type = ops[j] < ir.ids.size() ? ir.ids[ops[j]].get_type() : TypeNone;
+				if (type == TypeConstant || type == TypeConstantOp)
+					mark(ops[j]);
+			}
+		}
+	});
+}
+
 bool Compiler::traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHandler &handler) const
 {
 	handler.set_current_block(block);
@@ -1675,6 +1942,9 @@ bool Compiler::traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHand
 
 bool Compiler::traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHandler &handler) const
 {
+	if (handler.handles_each_function_once())
+		return traverse_all_reachable_opcodes(func, vector<OpcodeHandler *>{ &handler });
+
 	for (auto block : func.blocks)
 		if (!traverse_all_reachable_opcodes(get<SPIRBlock>(block), handler))
 			return false;
@@ -1682,141 +1952,395 @@ bool Compiler::traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHa
 	return true;
 }
 
-uint32_t Compiler::type_struct_member_offset(const SPIRType &type, uint32_t index) const
+bool Compiler::traverse_all_reachable_opcodes(const SPIRFunction &func, const vector<OpcodeHandler *> &handlers) const
 {
-	auto *type_meta = ir.find_meta(type.self);
-	if (type_meta)
+	uint32_t filter = 0;
+	for (auto *handler : handlers)
 	{
-		// Decoration must be set in valid SPIR-V, otherwise throw.
-		auto &dec = type_meta->members[index];
-		if (dec.decoration_flags.get(DecorationOffset))
-			return dec.offset;
-		else
-			SPIRV_CROSS_THROW("Struct member does not have Offset set.");
+		if (!handler->handles_each_function_once())
+			SPIRV_CROSS_THROW("Only handlers which handle each function once can share a traversal.");
+		filter |= handler->get_opcode_filter();
 	}
-	else
-		SPIRV_CROSS_THROW("Struct member does not have Offset set.");
-}
 
-uint32_t Compiler::type_struct_member_array_stride(const SPIRType &type, uint32_t index) const
-{
-	auto *type_meta = ir.find_meta(type.member_types[index]);
-	if (type_meta)
-	{
-		// Decoration must be set in valid SPIR-V, otherwise throw.
-		// ArrayStride is part of the array type not OpMemberDecorate.
-		auto &dec = type_meta->decoration;
-		if (dec.decoration_flags.get(DecorationArrayStride))
-			return dec.array_stride;
-		else
-			SPIRV_CROSS_THROW("Struct member does not have ArrayStride set.");
-	}
-	else
-		SPIRV_CROSS_THROW("Struct member does not have Offset set.");
+	auto active = handlers;
+	vector<bool> visited(ir.ids.size());
+	traverse_each_function_once(func, active, filter, visited);
+	return active.size() == handlers.size();
 }
 
-uint32_t Compiler::type_struct_member_matrix_stride(const SPIRType &type, uint32_t index) const
+bool Compiler::traverse_each_function_once(const SPIRFunction &func, vector<OpcodeHandler *> &handlers, uint32_t filter,
+                                           vector<bool> &visited) const
 {
-	auto *type_meta = ir.find_meta(type.self);
-	if (type_meta)
+	visited[func.self] = true;
+	if ((get_function_summary(func.self).reachable_opcodes & filter) == 0)
+		return true;
+
+	// Calls are followed where they are made, so handlers see instructions in the same order as when
+	// every call is followed, only without the repeats.
+	for (auto block_id : func.blocks)
 	{
-		// Decoration must be set in valid SPIR-V, otherwise throw.
-		// MatrixStride is part of OpMemberDecorate.
-		auto &dec = type_meta->members[index];
-		if (dec.decoration_flags.get(DecorationMatrixStride))
-			return dec.matrix_stride;
-		else
-			SPIRV_CROSS_THROW("Struct member does not have MatrixStride set.");
-	}
-	else
-		SPIRV_CROSS_THROW("Struct member does not have MatrixStride set.");
-}
+		auto &block = get<SPIRBlock>(block_id);
+		for (auto *handler : handlers)
+			handler->set_current_block(block);
 
-size_t Compiler::get_declared_struct_size(const SPIRType &type) const
-{
-	if (type.member_types.empty())
-		SPIRV_CROSS_THROW("Declared struct in block cannot be empty.");
+		for (auto &i : block.ops)
+		{
+			auto ops = stream(i);
+			auto op = static_cast<Op>(i.op);
 
-	uint32_t last = uint32_t(type.member_types.size() - 1);
-	size_t offset = type_struct_member_offset(type, last);
-	size_t size = get_declared_struct_member_size(type, last);
-	return offset + size;
-}
+			handlers.erase(remove_if(begin(handlers), end(handlers),
+			                         [&](OpcodeHandler *handler) { return !handler->handle(op, ops, i.length); }),
+			               end(handlers));
+			if (handlers.empty())
+				return false;
 
-size_t Compiler::get_declared_struct_size_runtime_array(const SPIRType &type, size_t array_size) const
-{
-	if (type.member_types.empty())
-		SPIRV_CROSS_THROW("Declared struct in block cannot be empty.");
+			if (op == OpFunctionCall && !visited[ops[2]])
+			{
+				if (!traverse_each_function_once(get<SPIRFunction>(ops[2]), handlers, filter, visited))
+					return false;
 
-	size_t size = get_declared_struct_size(type);
-	auto &last_type = get<SPIRType>(type.member_types.back());
-	if (!last_type.array.empty() && last_type.array_size_literal[0] && last_type.array[0] == 0) // Runtime array
-		size += array_size * type_struct_member_array_stride(type, uint32_t(type.member_types.size() - 1));
+				// Back to the caller, as the handlers last saw a block of the callee.
+				for (auto *handler : handlers)
+					handler->set_current_block(block);
+			}
+		}
+	}
 
-	return size;
+	return true;
 }
 
-size_t Compiler::get_declared_struct_member_size(const SPIRType &struct_type, uint32_t index) const
+uint32_t Compiler::get_opcode_kinds(const Instruction &instr) const
 {
-	if (struct_type.member_types.empty())
-		SPIRV_CROSS_THROW("Declared struct in block cannot be empty.");
-
-	auto &flags = get_member_decoration_bitset(struct_type.self, index);
-	auto &type = get<SPIRType>(struct_type.member_types[index]);
-
-	switch (type.basetype)
-	{
-	case SPIRType::Unknown:
-	case SPIRType::Void:
-	case SPIRType::Boolean: // Bools are purely logical, and cannot be used for externally visible types.
-	case SPIRType::AtomicCounter:
-	case SPIRType::Image:
-	case SPIRType::SampledImage:
-	case SPIRType::Sampler:
-		SPIRV_CROSS_THROW("Querying size for object with opaque size.");
-
-	default:
-		break;
-	}
-
-	if (!type.array.empty())
-	{
-		// For arrays, we can use ArrayStride to get an easy check.
-		bool array_size_literal = type.array_size_literal.back();
-		uint32_t array_size = array_size_literal ? type.array.back() : get<SPIRConstant>(type.array.back()).scalar();
-		return type_struct_member_array_stride(struct_type, index) * array_size;
-	}
-	else if (type.basetype == SPIRType::Struct)
+	auto ops = stream(instr);
+	auto op = static_cast<Op>(instr.op);
+	switch (op)
 	{
-		return get_declared_struct_size(type);
-	}
-	else
+	case OpLoad:
 	{
-		unsigned vecsize = type.vecsize;
-		unsigned columns = type.columns;
-
-		// Vectors.
-		if (columns == 1)
-		{
-			size_t component_size = type.width / 8;
-			return vecsize * component_size;
-		}
-		else
-		{
-			uint32_t matrix_stride = type_struct_member_matrix_stride(struct_type, index);
-
-			// Per SPIR-V spec, matrices must be tightly packed and aligned up for vec3 accesses.
-			if (flags.get(DecorationRowMajor))
-				return matrix_stride * vecsize;
-			else if (flags.get(DecorationColMajor))
-				return matrix_stride * columns;
-			else
-				SPIRV_CROSS_THROW("Either row-major or column-major must be declared for matrices.");
-		}
+		if (instr.length < 1)
+			return OpcodeKindOtherBit;
+		auto *type = maybe_get<SPIRType>(ops[0]);
+		if (type && (type->basetype == SPIRType::Image || type->basetype == SPIRType::SampledImage ||
+		             type->basetype == SPIRType::Sampler))
+			return OpcodeKindImageBit;
+		return OpcodeKindOtherBit;
 	}
-}
 
-bool Compiler::BufferAccessHandler::handle(Op opcode, const uint32_t *args, uint32_t length)
+	case OpSampledImage:
+	case OpImageSampleImplicitLod:
+	case OpImageSampleExplicitLod:
+	case OpImageSampleDrefImplicitLod:
+	case OpImageSampleDrefExplicitLod:
+	case OpImageSampleProjImplicitLod:
+	case OpImageSampleProjExplicitLod:
+	case OpImageSampleProjDrefImplicitLod:
+	case OpImageSampleProjDrefExplicitLod:
+	case OpImageFetch:
+	case OpImageGather:
+	case OpImageDrefGather:
+	case OpImageRead:
+	case OpImageWrite:
+	case OpImage:
+	case OpImageQueryFormat:
+	case OpImageQueryOrder:
+	case OpImageQuerySizeLod:
+	case OpImageQuerySize:
+	case OpImageQueryLod:
+	case OpImageQueryLevels:
+	case OpImageQuerySamples:
+	case OpImageSparseSampleImplicitLod:
+	case OpImageSparseSampleExplicitLod:
+	case OpImageSparseSampleDrefImplicitLod:
+	case OpImageSparseSampleDrefExplicitLod:
+	case OpImageSparseSampleProjImplicitLod:
+	case OpImageSparseSampleProjExplicitLod:
+	case OpImageSparseSampleProjDrefImplicitLod:
+	case OpImageSparseSampleProjDrefExplicitLod:
+	case OpImageSparseFetch:
+	case OpImageSparseGather:
+	case OpImageSparseDrefGather:
+	case OpImageSparseTexelsResident:
+	case OpImageSparseRead:
+	case OpImageTexelPointer:
+		return OpcodeKindImageBit;
+
+	case OpAtomicLoad:
+	case OpAtomicStore:
+	case OpAtomicExchange:
+	case OpAtomicCompareExchange:
+	case OpAtomicCompareExchangeWeak:
+	case OpAtomicIIncrement:
+	case OpAtomicIDecrement:
+	case OpAtomicIAdd:
+	case OpAtomicISub:
+	case OpAtomicSMin:
+	case OpAtomicUMin:
+	case OpAtomicSMax:
+	case OpAtomicUMax:
+	case OpAtomicAnd:
+	case OpAtomicOr:
+	case OpAtomicXor:
+	case OpAtomicFlagTestAndSet:
+	case OpAtomicFlagClear:
+		return OpcodeKindAtomicBit;
+
+	case OpControlBarrier:
+	case OpMemoryBarrier:
+		return OpcodeKindBarrierBit;
+
+	case OpAccessChain:
+	case OpInBoundsAccessChain:
+	case OpPtrAccessChain:
+		return OpcodeKindAccessChainBit;
+
+	default:
+		return OpcodeKindOtherBit;
+	}
+}
+
+const Compiler::CallGraph &Compiler::get_call_graph() const
+{
+	auto &graph = call_graph;
+	lock_guard<mutex> holder(graph.lock);
+	if (graph.valid && graph.entry_point == ir.default_entry_point)
+		return graph;
+
+	graph.functions.clear();
+	graph.reachable_functions.clear();
+	graph.reachable_variables.clear();
+
+	ir.for_each_typed_id<SPIRFunction>([&](uint32_t id, const SPIRFunction &func) {
+		auto &summary = graph.functions[id];
+		for (auto block : func.blocks)
+		{
+			for (auto &i : get<SPIRBlock>(block).ops)
+			{
+				auto ops = stream(i);
+				summary.opcodes |= get_opcode_kinds(i);
+
+				if (i.op == OpFunctionCall && i.length >= 3 &&
+				    find(begin(summary.callees), end(summary.callees), ops[2]) == end(summary.callees))
+					summary.callees.push_back(ops[2]);
+
+				for (uint32_t j = 0; j < i.length; j++)
+				{
+					auto *var = ops[j] < ir.ids.size() ? maybe_get<SPIRVariable>(ops[j]) : nullptr;
+					if (var && var->storage != StorageClassFunction)
+						summary.variables.push_back(ops[j]);
+				}
+			}
+		}
+
+		sort(begin(summary.variables), end(summary.variables));
+		summary.variables.erase(unique(begin(summary.variables), end(summary.variables)), end(summary.variables));
+	});
+
+	// Visit functions in the order the traversals call them for the first time, and fill in what they reach
+	// after all their callees. SPIR-V does not allow recursion, but make sure a bad module terminates.
+	struct Frame
+	{
+		uint32_t func;
+		uint32_t next_callee;
+	};
+	vector<Frame> stack;
+	unordered_set<uint32_t> seen;
+
+	if (ir.default_entry_point && graph.functions.count(ir.default_entry_point))
+	{
+		stack.push_back({ ir.default_entry_point, 0 });
+		seen.insert(ir.default_entry_point);
+		graph.reachable_functions.push_back(ir.default_entry_point);
+	}
+
+	// The order of callees is the order of their first call. That is also the order of the traversals,
+	// as a function reached by a call is done before the rest of the caller.
+	while (!stack.empty())
+	{
+		auto &frame = stack.back();
+		auto &summary = graph.functions[frame.func];
+		if (frame.next_callee < summary.callees.size())
+		{
+			uint32_t callee = summary.callees[frame.next_callee++];
+			if (graph.functions.count(callee) && seen.insert(callee).second)
+			{
+				graph.reachable_functions.push_back(callee);
+				stack.push_back({ callee, 0 });
+			}
+			continue;
+		}
+
+		summary.reachable_opcodes = summary.opcodes;
+		for (auto callee : summary.callees)
+		{
+			auto itr = graph.functions.find(callee);
+			if (itr != end(graph.functions))
+				summary.reachable_opcodes |= itr->second.reachable_opcodes;
+		}
+
+		graph.reachable_variables.insert(end(graph.reachable_variables), begin(summary.variables),
+		                                 end(summary.variables));
+		stack.pop_back();
+	}
+
+	sort(begin(graph.reachable_variables), end(graph.reachable_variables));
+	graph.reachable_variables.erase(unique(begin(graph.reachable_variables), end(graph.reachable_variables)),
+	                                end(graph.reachable_variables));
+
+	// Functions the entry point does not reach only get traversed when asked for directly,
+	// so do not bother to propagate through them.
+	for (auto &func : graph.functions)
+		if (!seen.count(func.first))
+			func.second.reachable_opcodes = OpcodeKindAllBits;
+
+	graph.entry_point = ir.default_entry_point;
+	graph.valid = true;
+	return graph;
+}
+
+const Compiler::FunctionSummary &Compiler::get_function_summary(uint32_t func) const
+{
+	auto &functions = get_call_graph().functions;
+	auto itr = functions.find(func);
+	if (itr == end(functions))
+		SPIRV_CROSS_THROW("Function does not exist.");
+	return itr->second;
+}
+
+uint32_t Compiler::type_struct_member_offset(const SPIRType &type, uint32_t index) const
+{
+	auto *type_meta = ir.find_meta(type.self);
+	if (type_meta)
+	{
+		// Decoration must be set in valid SPIR-V, otherwise throw.
+		auto &dec = type_meta->members[index];
+		if (dec.decoration_flags.get(DecorationOffset))
+			return dec.offset;
+		else
+			SPIRV_CROSS_THROW("Struct member does not have Offset set.");
+	}
+	else
+		SPIRV_CROSS_THROW("Struct member does not have Offset set.");
+}
+
+uint32_t Compiler::type_struct_member_array_stride(const SPIRType &type, uint32_t index) const
+{
+	auto *type_meta = ir.find_meta(type.member_types[index]);
+	if (type_meta)
+	{
+		// Decoration must be set in valid SPIR-V, otherwise throw.
+		// ArrayStride is part of the array type not OpMemberDecorate.
+		auto &dec = type_meta->decoration;
+		if (dec.decoration_flags.get(DecorationArrayStride))
+			return dec.array_stride;
+		else
+			SPIRV_CROSS_THROW("Struct member does not have ArrayStride set.");
+	}
+	else
+		SPIRV_CROSS_THROW("Struct member does not have Offset set.");
+}
+
+uint32_t Compiler::type_struct_member_matrix_stride(const SPIRType &type, uint32_t index) const
+{
+	auto *type_meta = ir.find_meta(type.self);
+	if (type_meta)
+	{
+		// Decoration must be set in valid SPIR-V, otherwise throw.
+		// MatrixStride is part of OpMemberDecorate.
+		auto &dec = type_meta->members[index];
+		if (dec.decoration_flags.get(DecorationMatrixStride))
+			return dec.matrix_stride;
+		else
+			SPIRV_CROSS_THROW("Struct member does not have MatrixStride set.");
+	}
+	else
+		SPIRV_CROSS_THROW("Struct member does not have MatrixStride set.");
+}
+
+size_t Compiler::get_declared_struct_size(const SPIRType &type) const
+{
+	if (type.member_types.empty())
+		SPIRV_CROSS_THROW("Declared struct in block cannot be empty.");
+
+	uint32_t last = uint32_t(type.member_types.size() - 1);
+	size_t offset = type_struct_member_offset(type, last);
+	size_t size = get_declared_struct_member_size(type, last);
+	return offset + size;
+}
+
+size_t Compiler::get_declared_struct_size_runtime_array(const SPIRType &type, size_t array_size) const
+{
+	if (type.member_types.empty())
+		SPIRV_CROSS_THROW("Declared struct in block cannot be empty.");
+
+	size_t size = get_declared_struct_size(type);
+	auto &last_type = get<SPIRType>(type.member_types.back());
+	if (!last_type.array.empty() && last_type.array_size_literal[0] && last_type.array[0] == 0) // Runtime array
+		size += array_size * type_struct_member_array_stride(type, uint32_t(type.member_types.size() - 1));
+
+	return size;
+}
+
+size_t Compiler::get_declared_struct_member_size(const SPIRType &struct_type, uint32_t index) const
+{
+	if (struct_type.member_types.empty())
+		SPIRV_CROSS_THROW("Declared struct in block cannot be empty.");
+
+	auto &flags = get_member_decoration_bitset(struct_type.self, index);
+	auto &type = get<SPIRType>(struct_type.member_types[index]);
+
+	switch (type.basetype)
+	{
+	case SPIRType::Unknown:
+	case SPIRType::Void:
+	case SPIRType::Boolean: // Bools are purely logical, and cannot be used for externally visible types.
+	case SPIRType::AtomicCounter:
+	case SPIRType::Image:
+	case SPIRType::SampledImage:
+	case SPIRType::Sampler:
+		SPIRV_CROSS_THROW("Querying size for object with opaque size.");
+
+	default:
+		break;
+	}
+
+	if (!type.array.empty())
+	{
+		// For arrays, we can use ArrayStride to get an easy check.
+		bool array_size_literal = type.array_size_literal.back();
+		uint32_t array_size = array_size_literal ? type.array.back() : get<SPIRConstant>(type.array.back()).scalar();
+		return type_struct_member_array_stride(struct_type, index) * array_size;
+	}
+	else if (type.basetype == SPIRType::Struct)
+	{
+		return get_declared_struct_size(type);
+	}
+	else
+	{
+		unsigned vecsize = type.vecsize;
+		unsigned columns = type.columns;
+
+		// Vectors.
+		if (columns == 1)
+		{
+			size_t component_size = type.width / 8;
+			return vecsize * component_size;
+		}
+		else
+		{
+			uint32_t matrix_stride = type_struct_member_matrix_stride(struct_type, index);
+
+			// Per SPIR-V spec, matrices must be tightly packed and aligned up for vec3 accesses.
+			if (flags.get(DecorationRowMajor))
+				return matrix_stride * vecsize;
+			else if (flags.get(DecorationColMajor))
+				return matrix_stride * columns;
+			else
+				SPIRV_CROSS_THROW("Either row-major or column-major must be declared for matrices.");
+		}
+	}
+}
+
+bool Compiler::BufferAccessHandler::handle(Op opcode, const uint32_t *args, uint32_t length)
 {
 	if (opcode != OpAccessChain && opcode != OpInBoundsAccessChain && opcode != OpPtrAccessChain)
 		return true;
@@ -1865,6 +2389,12 @@ bool Compiler::BufferAccessHandler::handle(Op opcode, const uint32_t *args, uint
 std::vector<BufferRange> Compiler::get_active_buffer_ranges(uint32_t id) const
 {
 	std::vector<BufferRange> ranges;
+
+	// Nothing can access the buffer without using it as an operand.
+	auto &variables = get_call_graph().reachable_variables;
+	if (!binary_search(begin(variables), end(variables), id))
+		return ranges;
+
 	BufferAccessHandler handler(*this, ranges, id);
 	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler);
 	return ranges;
@@ -2130,12 +2660,14 @@ void Compiler::set_entry_point(const std::string &name)
 {
 	auto &entry = get_first_entry_point(name);
 	ir.default_entry_point = entry.self;
+	ir.mark_modified();
 }
 
 void Compiler::set_entry_point(const std::string &name, spv::ExecutionModel model)
 {
 	auto &entry = get_entry_point(name, model);
 	ir.default_entry_point = entry.self;
+	ir.mark_modified();
 }
 
 SPIREntryPoint &Compiler::get_entry_point(const std::string &name)
@@ -2615,154 +3147,1395 @@ bool Compiler::CombinedImageSamplerHandler::handle(Op opcode, const uint32_t *ar
 	uint32_t image_id = remap_parameter(args[2]);
 	uint32_t sampler_id = is_fetch ? compiler.dummy_sampler_id : remap_parameter(args[3]);
 
-	auto itr = find_if(begin(compiler.combined_image_samplers), end(compiler.combined_image_samplers),
-	                   [image_id, sampler_id](const CombinedImageSampler &combined) {
-		                   return combined.image_id == image_id && combined.sampler_id == sampler_id;
-	                   });
+	auto itr = find_if(begin(compiler.combined_image_samplers), end(compiler.combined_image_samplers),
+	                   [image_id, sampler_id](const CombinedImageSampler &combined) {
+		                   return combined.image_id == image_id && combined.sampler_id == sampler_id;
+	                   });
+
+	if (itr == end(compiler.combined_image_samplers))
+	{
+		uint32_t sampled_type;
+		if (is_fetch)
+		{
+			// Have to invent the sampled image type.
+			sampled_type = compiler.ir.increase_bound_by(1);
+			auto &type = compiler.set<SPIRType>(sampled_type);
+			type = compiler.expression_type(args[2]);
+			type.self = sampled_type;
+			type.basetype = SPIRType::SampledImage;
+			type.image.depth = false;
+		}
+		else
+		{
+			sampled_type = args[0];
+		}
+
+		auto id = compiler.ir.increase_bound_by(2);
+		auto type_id = id + 0;
+		auto combined_id = id + 1;
+
+		// Make a new type, pointer to OpTypeSampledImage, so we can make a variable of this type.
+		// We will probably have this type lying around, but it doesn't hurt to make duplicates for internal purposes.
+		auto &type = compiler.set<SPIRType>(type_id);
+		auto &base = compiler.get<SPIRType>(sampled_type);
+		type = base;
+		type.pointer = true;
+		type.storage = StorageClassUniformConstant;
+		type.parent_type = type_id;
+
+		// Build new variable.
+		compiler.set<SPIRVariable>(combined_id, type_id, StorageClassUniformConstant, 0);
+
+		// Inherit RelaxedPrecision (and potentially other useful flags if deemed relevant).
+		auto &new_flags = compiler.ir.meta[combined_id].decoration.decoration_flags;
+		// Fetch inherits precision from the image, not sampler (there is no sampler).
+		auto &old_flags = compiler.ir.meta[is_fetch ? image_id : sampler_id].decoration.decoration_flags;
+		new_flags.reset();
+		if (old_flags.get(DecorationRelaxedPrecision))
+			new_flags.set(DecorationRelaxedPrecision);
+
+		// Propagate the array type for the original image as well.
+		auto *var = compiler.maybe_get_backing_variable(image_id);
+		if (var)
+		{
+			auto &parent_type = compiler.get<SPIRType>(var->basetype);
+			type.array = parent_type.array;
+			type.array_size_literal = parent_type.array_size_literal;
+		}
+
+		compiler.combined_image_samplers.push_back({ combined_id, image_id, sampler_id });
+	}
+
+	return true;
+}
+
+uint32_t Compiler::build_dummy_sampler_for_combined_images()
+{
+	DummySamplerForCombinedImageHandler handler(*this);
+	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler);
+	if (handler.need_dummy_sampler)
+	{
+		uint32_t offset = ir.increase_bound_by(3);
+		auto type_id = offset + 0;
+		auto ptr_type_id = offset + 1;
+		auto var_id = offset + 2;
+
+		SPIRType sampler_type;
+		auto &sampler = set<SPIRType>(type_id);
+		sampler.basetype = SPIRType::Sampler;
+
+		auto &ptr_sampler = set<SPIRType>(ptr_type_id);
+		ptr_sampler = sampler;
+		ptr_sampler.self = type_id;
+		ptr_sampler.storage = StorageClassUniformConstant;
+		ptr_sampler.pointer = true;
+		ptr_sampler.parent_type = type_id;
+
+		set<SPIRVariable>(var_id, ptr_type_id, StorageClassUniformConstant, 0);
+		set_name(var_id, "SPIRV_Cross_DummySampler");
+		dummy_sampler_id = var_id;
+		return var_id;
+	}
+	else
+		return 0;
+}
+
+void Compiler::build_combined_image_samplers()
+{
+	ir.for_each_typed_id<SPIRFunction>([&](uint32_t, SPIRFunction &func) {
+		func.combined_parameters.clear();
+		func.shadow_arguments.clear();
+		func.do_combined_parameters = true;
+	});
+
+	combined_image_samplers.clear();
+	CombinedImageSamplerHandler handler(*this);
+	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler);
+}
+
+vector<SpecializationConstant> Compiler::get_specialization_constants() const
+{
+	vector<SpecializationConstant> spec_consts;
+	ir.for_each_typed_id<SPIRConstant>([&](uint32_t, const SPIRConstant &c) {
+		if (c.specialization && has_decoration(c.self, DecorationSpecId))
+			spec_consts.push_back({ c.self, get_decoration(c.self, DecorationSpecId) });
+	});
+	return spec_consts;
+}
+
+SPIRConstant &Compiler::get_constant(uint32_t id)
+{
+	return get<SPIRConstant>(id);
+}
+
+const SPIRConstant &Compiler::get_constant(uint32_t id) const
+{
+	return get<SPIRConstant>(id);
+}
+
+static bool is_foldable_integer_type(const SPIRType &type)
+{
+	if (type.pointer || !type.array.empty() || type.columns != 1)
+		return false;
+
+	switch (type.basetype)
+	{
+	case SPIRType::Boolean:
+	case SPIRType::Int:
+	case SPIRType::UInt:
+	case SPIRType::Int64:
+	case SPIRType::UInt64:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static uint64_t read_component(const SPIRConstant &c, uint32_t index, uint32_t width)
+{
+	return width > 32 ? c.m.c[0].r[index].u64 : c.m.c[0].r[index].u32;
+}
+
+static int64_t read_signed_component(const SPIRConstant &c, uint32_t index, uint32_t width)
+{
+	return width > 32 ? c.m.c[0].r[index].i64 : c.m.c[0].r[index].i32;
+}
+
+static void write_component(SPIRConstant &c, uint32_t index, uint32_t width, uint64_t value)
+{
+	if (width > 32)
+		c.m.c[0].r[index].u64 = value;
+	else
+		c.m.c[0].r[index].u32 = uint32_t(value);
+}
+
+bool Compiler::evaluate_specialization_constant_op(const SPIRConstantOp &op, SPIRConstant &result) const
+{
+	auto &type = get<SPIRType>(op.basetype);
+	if (type.pointer || !type.array.empty() || type.columns != 1 || type.basetype == SPIRType::Struct)
+		return false;
+
+	// Only operands which are plain scalar or vector constants by now can be evaluated.
+	auto operand = [&](uint32_t index) -> const SPIRConstant * {
+		if (index >= op.arguments.size())
+			return nullptr;
+		auto *c = maybe_get<SPIRConstant>(op.arguments[index]);
+		if (!c || c->specialization || c->columns() != 1 || !c->subconstants.empty())
+			return nullptr;
+		return c;
+	};
+
+	result = SPIRConstant(op.basetype);
+	result.make_null(type);
+	uint32_t width = type.width;
+
+	switch (op.opcode)
+	{
+	case OpSelect:
+	{
+		auto *cond = operand(0);
+		auto *a = operand(1);
+		auto *b = operand(2);
+		if (!cond || !a || !b)
+			return false;
+
+		for (uint32_t i = 0; i < type.vecsize; i++)
+		{
+			bool take_a = cond->m.c[0].r[cond->vector_size() == 1 ? 0 : i].u32 != 0;
+			result.m.c[0].r[i] = take_a ? a->m.c[0].r[i] : b->m.c[0].r[i];
+		}
+		return true;
+	}
+
+	case OpCompositeExtract:
+	{
+		auto *composite = operand(0);
+		if (!composite || op.arguments.size() != 2 || op.arguments[1] >= composite->vector_size())
+			return false;
+
+		result.m.c[0].r[0] = composite->m.c[0].r[op.arguments[1]];
+		return true;
+	}
+
+	case OpVectorShuffle:
+	{
+		auto *a = operand(0);
+		auto *b = operand(1);
+		if (!a || !b || op.arguments.size() != type.vecsize + 2)
+			return false;
+
+		for (uint32_t i = 0; i < type.vecsize; i++)
+		{
+			uint32_t index = op.arguments[i + 2];
+			if (index < a->vector_size())
+				result.m.c[0].r[i] = a->m.c[0].r[index];
+			else if (index - a->vector_size() < b->vector_size())
+				result.m.c[0].r[i] = b->m.c[0].r[index - a->vector_size()];
+			else
+				return false;
+		}
+		return true;
+	}
+
+	default:
+		break;
+	}
+
+	// The remaining ops work component-wise on integers and booleans.
+	if (!is_foldable_integer_type(type))
+		return false;
+
+	auto *a = operand(0);
+	if (!a || !is_foldable_integer_type(get<SPIRType>(a->constant_type)))
+		return false;
+	uint32_t a_width = get<SPIRType>(a->constant_type).width;
+
+	const SPIRConstant *b = nullptr;
+	switch (op.opcode)
+	{
+	case OpSConvert:
+	case OpUConvert:
+	case OpSNegate:
+	case OpNot:
+	case OpLogicalNot:
+		break;
+
+	default:
+		b = operand(1);
+		if (!b || !is_foldable_integer_type(get<SPIRType>(b->constant_type)))
+			return false;
+		break;
+	}
+	uint32_t b_width = b ? get<SPIRType>(b->constant_type).width : 0;
+
+	for (uint32_t i = 0; i < type.vecsize; i++)
+	{
+		uint64_t ua = read_component(*a, i, a_width);
+		int64_t sa = read_signed_component(*a, i, a_width);
+		uint64_t ub = b ? read_component(*b, i, b_width) : 0;
+		int64_t sb = b ? read_signed_component(*b, i, b_width) : 0;
+		uint64_t value;
+
+		switch (op.opcode)
+		{
+		case OpSConvert:
+			value = uint64_t(sa);
+			break;
+		case OpUConvert:
+			value = ua;
+			break;
+		case OpSNegate:
+			value = 0 - ua;
+			break;
+		case OpNot:
+			value = ~ua;
+			break;
+		case OpIAdd:
+			value = ua + ub;
+			break;
+		case OpISub:
+			value = ua - ub;
+			break;
+		case OpIMul:
+			value = ua * ub;
+			break;
+
+		case OpUDiv:
+		case OpUMod:
+			if (ub == 0)
+				return false;
+			value = op.opcode == OpUDiv ? ua / ub : ua % ub;
+			break;
+
+		case OpSDiv:
+		case OpSRem:
+		case OpSMod:
+			// Division by zero and overflow are undefined, leave those to the driver.
+			if (sb == 0 || (sb == -1 && sa == (a_width > 32 ? INT64_MIN : int64_t(INT32_MIN))))
+				return false;
+			if (op.opcode == OpSDiv)
+				value = uint64_t(sa / sb);
+			else if (op.opcode == OpSRem)
+				value = uint64_t(sa % sb);
+			else
+			{
+				// The result of OpSMod takes the sign of the divisor.
+				int64_t mod = sa % sb;
+				if (mod != 0 && ((mod < 0) != (sb < 0)))
+					mod += sb;
+				value = uint64_t(mod);
+			}
+			break;
+
+		case OpShiftRightLogical:
+		case OpShiftRightArithmetic:
+		case OpShiftLeftLogical:
+			if (ub >= a_width)
+				return false;
+			if (op.opcode == OpShiftRightLogical)
+				value = ua >> ub;
+			else if (op.opcode == OpShiftRightArithmetic)
+				value = uint64_t(sa >> ub);
+			else
+				value = ua << ub;
+			break;
+
+		case OpBitwiseOr:
+			value = ua | ub;
+			break;
+		case OpBitwiseXor:
+			value = ua ^ ub;
+			break;
+		case OpBitwiseAnd:
+			value = ua & ub;
+			break;
+
+		case OpLogicalOr:
+			value = ua || ub;
+			break;
+		case OpLogicalAnd:
+			value = ua && ub;
+			break;
+		case OpLogicalNot:
+			value = !ua;
+			break;
+		case OpLogicalEqual:
+		case OpIEqual:
+			value = ua == ub;
+			break;
+		case OpLogicalNotEqual:
+		case OpINotEqual:
+			value = ua != ub;
+			break;
+		case OpULessThan:
+			value = ua < ub;
+			break;
+		case OpULessThanEqual:
+			value = ua <= ub;
+			break;
+		case OpUGreaterThan:
+			value = ua > ub;
+			break;
+		case OpUGreaterThanEqual:
+			value = ua >= ub;
+			break;
+		case OpSLessThan:
+			value = sa < sb;
+			break;
+		case OpSLessThanEqual:
+			value = sa <= sb;
+			break;
+		case OpSGreaterThan:
+			value = sa > sb;
+			break;
+		case OpSGreaterThanEqual:
+			value = sa >= sb;
+			break;
+
+		default:
+			return false;
+		}
+
+		write_component(result, i, width, value);
+	}
+
+	return true;
+}
+
+bool Compiler::constant_branch_target(const SPIRBlock &block, uint32_t &target) const
+{
+	auto *c = maybe_get<SPIRConstant>(block.condition);
+	if (!c || c->specialization || c->columns() != 1 || c->vector_size() != 1 || !c->subconstants.empty())
+		return false;
+
+	if (block.terminator == SPIRBlock::Select)
+	{
+		target = c->scalar() != 0 ? block.true_block : block.false_block;
+		return true;
+	}
+	else if (block.terminator == SPIRBlock::MultiSelect)
+	{
+		// Case literals are 32-bit here, see the parser.
+		if (get<SPIRType>(c->constant_type).width > 32)
+			return false;
+
+		target = block.default_block;
+		for (auto &c_case : block.cases)
+		{
+			if (c_case.value == c->scalar())
+			{
+				target = c_case.block;
+				break;
+			}
+		}
+		return true;
+	}
+	else
+		return false;
+}
+
+// Counts the edges into merge from every block reachable from target, including blocks inside nested constructs,
+// which may break to merge from anywhere. Merge and continue blocks of enclosing loops are not entered,
+// but those of loops nested in the region are.
+uint32_t Compiler::count_branches_to_merge(uint32_t target, uint32_t merge) const
+{
+	uint32_t count = 0;
+	unordered_set<uint32_t> visited;
+	unordered_set<uint32_t> nested_loop_blocks;
+	vector<uint32_t> pending;
+
+	auto follow = [&](uint32_t to) {
+		if (to == merge)
+			count++;
+		else if ((ir.block_meta[to] & (ParsedIR::BLOCK_META_LOOP_MERGE_BIT | ParsedIR::BLOCK_META_CONTINUE_BIT)) == 0 ||
+		         nested_loop_blocks.count(to))
+			pending.push_back(to);
+	};
+
+	follow(target);
+	while (!pending.empty())
+	{
+		uint32_t id = pending.back();
+		pending.pop_back();
+		if (!visited.insert(id).second)
+			continue;
+
+		// A loop header is reached before anything in its loop, so its blocks are known before they are followed.
+		auto &block = get<SPIRBlock>(id);
+		if (block.merge == SPIRBlock::MergeLoop)
+		{
+			nested_loop_blocks.insert(block.merge_block);
+			nested_loop_blocks.insert(block.continue_block);
+		}
+
+		switch (block.terminator)
+		{
+		case SPIRBlock::Direct:
+			follow(block.next_block);
+			break;
+
+		case SPIRBlock::Select:
+			follow(block.true_block);
+			follow(block.false_block);
+			break;
+
+		case SPIRBlock::MultiSelect:
+			follow(block.default_block);
+			for (auto &c : block.cases)
+				follow(c.block);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return count;
+}
+
+void Compiler::fold_constant_branches(SPIRFunction &func)
+{
+	const uint32_t merge_bits = ParsedIR::BLOCK_META_SELECTION_MERGE_BIT | ParsedIR::BLOCK_META_MULTISELECT_MERGE_BIT;
+
+	for (auto block_id : func.blocks)
+	{
+		auto &block = get<SPIRBlock>(block_id);
+		if (block.merge != SPIRBlock::MergeSelection)
+			continue;
+
+		uint32_t target;
+		if (!constant_branch_target(block, target))
+			continue;
+
+		// Without the selection construct, the merge block is emitted inline after the path which is taken,
+		// which only works if that path reaches it once. A merge block which also belongs to a loop is left alone.
+		uint32_t merge = block.next_block;
+		if ((ir.block_meta[merge] & ~merge_bits) != 0 || count_branches_to_merge(target, merge) > 1)
+			continue;
+
+		block.terminator = SPIRBlock::Direct;
+		block.next_block = target;
+		block.merge = SPIRBlock::MergeNone;
+		block.hint = SPIRBlock::HintNone;
+		block.condition = 0;
+		block.cases.clear();
+		ir.block_meta[merge] &= ~merge_bits;
+	}
+}
+
+void Compiler::remove_unreachable_blocks(SPIRFunction &func)
+{
+	unordered_set<uint32_t> reachable;
+	vector<uint32_t> pending = { func.entry_block };
+
+	auto add = [&](uint32_t id) {
+		if (id && !reachable.count(id))
+			pending.push_back(id);
+	};
+
+	while (!pending.empty())
+	{
+		uint32_t id = pending.back();
+		pending.pop_back();
+		if (!reachable.insert(id).second)
+			continue;
+
+		// Merge and continue blocks are referenced by their headers even if no branch leads to them.
+		auto &block = get<SPIRBlock>(id);
+		if (block.merge == SPIRBlock::MergeLoop)
+		{
+			add(block.merge_block);
+			add(block.continue_block);
+		}
+		else if (block.merge == SPIRBlock::MergeSelection)
+			add(block.next_block);
+
+		switch (block.terminator)
+		{
+		case SPIRBlock::Direct:
+			add(block.next_block);
+			break;
+
+		case SPIRBlock::Select:
+			add(block.true_block);
+			add(block.false_block);
+			break;
+
+		case SPIRBlock::MultiSelect:
+			add(block.default_block);
+			for (auto &c : block.cases)
+				add(c.block);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	func.blocks.erase(remove_if(begin(func.blocks), end(func.blocks),
+	                            [&](uint32_t id) { return reachable.count(id) == 0; }),
+	                  end(func.blocks));
+}
+
+void Compiler::fold_specialization_constants()
+{
+	// Constants are defined before their uses, so a single pass in declaration order sees final operand values.
+	for (size_t i = 0; i < ir.ids_for_constant_or_type.size(); i++)
+	{
+		uint32_t id = ir.ids_for_constant_or_type[i];
+		auto type = ir.ids[id].get_type();
+		if (type == TypeConstantOp)
+		{
+			SPIRConstant folded;
+			if (evaluate_specialization_constant_op(get<SPIRConstantOp>(id), folded))
+			{
+				ir.ids[id].set_allow_type_rewrite();
+				set<SPIRConstant>(id, move(folded));
+			}
+			continue;
+		}
+		else if (type != TypeConstant)
+			continue;
+
+		auto &c = get<SPIRConstant>(id);
+		if (!c.specialization)
+			continue;
+
+		// Composites hold copies of their elements' values, refresh those in case the elements were changed.
+		bool folded = true;
+		if (c.subconstants.empty())
+		{
+			for (uint32_t col = 0; col < c.columns(); col++)
+			{
+				auto &column = c.m.c[col];
+				if (c.m.id[col])
+				{
+					auto *elem = maybe_get<SPIRConstant>(c.m.id[col]);
+					if (elem && !elem->specialization)
+					{
+						uint32_t vecsize = column.vecsize;
+						column = elem->m.c[0];
+						column.vecsize = vecsize;
+						c.m.id[col] = 0;
+					}
+					else
+						folded = false;
+				}
+
+				for (uint32_t row = 0; row < column.vecsize; row++)
+				{
+					if (!column.id[row])
+						continue;
+
+					auto *elem = maybe_get<SPIRConstant>(column.id[row]);
+					if (elem && !elem->specialization)
+					{
+						column.r[row] = elem->m.c[0].r[0];
+						column.id[row] = 0;
+					}
+					else
+						folded = false;
+				}
+			}
+		}
+		else
+		{
+			for (auto &sub : c.subconstants)
+			{
+				auto *elem = maybe_get<SPIRConstant>(sub);
+				if (!elem || elem->specialization)
+					folded = false;
+			}
+		}
+
+		if (!folded)
+			continue;
+
+		c.specialization = false;
+		for (auto &entry : ir.entry_points)
+		{
+			auto &workgroup_size = entry.second.workgroup_size;
+			if (workgroup_size.constant == id)
+			{
+				workgroup_size.x = c.scalar(0, 0);
+				workgroup_size.y = c.scalar(0, 1);
+				workgroup_size.z = c.scalar(0, 2);
+			}
+		}
+	}
+
+	// Array lengths which are known now are turned into literals, like the parser does for regular constants.
+	ir.for_each_typed_id<SPIRType>([&](uint32_t, SPIRType &type) {
+		for (size_t i = 0; i < type.array.size(); i++)
+		{
+			if (type.array_size_literal[i])
+				continue;
+
+			auto *c = maybe_get<SPIRConstant>(type.array[i]);
+			if (c && !c->specialization)
+			{
+				type.array[i] = c->scalar();
+				type.array_size_literal[i] = true;
+			}
+		}
+	});
+
+	ir.for_each_typed_id<SPIRFunction>([&](uint32_t, SPIRFunction &func) {
+		fold_constant_branches(func);
+		remove_unreachable_blocks(func);
+	});
+
+	call_graph.valid = false;
+	ir.mark_modified();
+}
+
+// Adds id and everything it refers to, to used. Every word of the instructions in a function is treated as an ID,
+// literals only make this more conservative.
+void Compiler::collect_used_ids(uint32_t id, unordered_set<uint32_t> &used) const
+{
+	vector<uint32_t> pending;
+	auto use = [&](uint32_t ref) {
+		if (ref != 0 && ref < ir.ids.size() && used.insert(ref).second)
+			pending.push_back(ref);
+	};
+
+	use(id);
+	while (!pending.empty())
+	{
+		uint32_t ref = pending.back();
+		pending.pop_back();
+
+		auto *meta = ir.find_meta(ref);
+		if (meta)
+			use(meta->hlsl_magic_counter_buffer);
+
+		switch (ir.ids[ref].get_type())
+		{
+		case TypeFunction:
+		{
+			auto &func = get<SPIRFunction>(ref);
+			use(func.return_type);
+			use(func.function_type);
+			for (auto &arg : func.arguments)
+			{
+				use(arg.type);
+				use(arg.id);
+			}
+			for (auto &arg : func.shadow_arguments)
+			{
+				use(arg.type);
+				use(arg.id);
+			}
+			for (auto &param : func.combined_parameters)
+			{
+				use(param.id);
+				use(param.image_id);
+				use(param.sampler_id);
+			}
+			for (auto local : func.local_variables)
+				use(local);
+			for (auto block : func.blocks)
+				use(block);
+			break;
+		}
+
+		case TypeBlock:
+		{
+			auto &block = get<SPIRBlock>(ref);
+			for (auto &i : block.ops)
+			{
+				auto ops = stream(i);
+				for (uint32_t j = 0; j < i.length; j++)
+					use(ops[j]);
+			}
+			use(block.condition);
+			use(block.return_value);
+			for (auto &phi : block.phi_variables)
+			{
+				use(phi.local_variable);
+				use(phi.function_variable);
+			}
+			break;
+		}
+
+		case TypeVariable:
+		{
+			auto &var = get<SPIRVariable>(ref);
+			use(var.basetype);
+			use(var.initializer);
+			use(var.basevariable);
+			break;
+		}
+
+		case TypeType:
+		{
+			auto &type = get<SPIRType>(ref);
+			use(type.self);
+			use(type.parent_type);
+			use(type.type_alias);
+			use(type.image.type);
+			for (auto member : type.member_types)
+				use(member);
+			for (size_t i = 0; i < type.array.size(); i++)
+				if (!type.array_size_literal[i])
+					use(type.array[i]);
+			break;
+		}
+
+		case TypeConstant:
+		{
+			auto &c = get<SPIRConstant>(ref);
+			use(c.constant_type);
+			for (auto sub : c.subconstants)
+				use(sub);
+			for (uint32_t col = 0; col < c.columns(); col++)
+			{
+				use(c.m.id[col]);
+				for (uint32_t row = 0; row < c.m.c[col].vecsize; row++)
+					use(c.m.c[col].id[row]);
+			}
+			break;
+		}
+
+		case TypeConstantOp:
+		{
+			auto &op = get<SPIRConstantOp>(ref);
+			use(op.basetype);
+			for (auto arg : op.arguments)
+				use(arg);
+			break;
+		}
+
+		case TypeUndef:
+			use(get<SPIRUndef>(ref).basetype);
+			break;
+
+		case TypeFunctionPrototype:
+		{
+			auto &proto = get<SPIRFunctionPrototype>(ref);
+			use(proto.return_type);
+			for (auto param : proto.parameter_types)
+				use(param);
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+}
+
+// Finds the types of the block which var points to, if the members at its end can be removed.
+// Only blocks which are not shared with anything else, and which are only used through access chains
+// with a constant member index, are safe to change.
+bool Compiler::find_removable_block_types(const SPIRVariable &var, const vector<uint32_t> &functions,
+                                          vector<uint32_t> &block_types) const
+{
+	auto &ptr_type = get<SPIRType>(var.basetype);
+	if (!ptr_type.pointer || !ptr_type.array.empty())
+		return false;
+
+	uint32_t struct_id = ptr_type.self;
+	auto &block_type = get<SPIRType>(struct_id);
+	if (block_type.basetype != SPIRType::Struct || block_type.type_alias != 0 ||
+	    (!has_decoration(struct_id, DecorationBlock) && !has_decoration(struct_id, DecorationBufferBlock)))
+		return false;
+
+	// The struct and the pointers to it all have the struct as self, and hold their own copy of the members.
+	bool shared = false;
+	ir.for_each_typed_id<SPIRType>([&](uint32_t id, const SPIRType &type) {
+		if (type.self == struct_id)
+			block_types.push_back(id);
+		if (type.type_alias == struct_id)
+			shared = true;
+		for (auto member : type.member_types)
+			if (get<SPIRType>(member).self == struct_id)
+				shared = true;
+	});
+	ir.for_each_typed_id<SPIRVariable>([&](uint32_t id, const SPIRVariable &other) {
+		if (id != var.self && get<SPIRType>(other.basetype).self == struct_id)
+			shared = true;
+	});
+	if (shared)
+		return false;
+
+	auto is_block_type = [&](uint32_t id) { return find(begin(block_types), end(block_types), id) != end(block_types); };
+
+	for (auto func_id : functions)
+	{
+		auto &func = get<SPIRFunction>(func_id);
+		for (auto &arg : func.arguments)
+			if (is_block_type(arg.type))
+				return false;
+
+		for (auto block_id : func.blocks)
+		{
+			for (auto &i : get<SPIRBlock>(block_id).ops)
+			{
+				auto ops = stream(i);
+				auto op = static_cast<Op>(i.op);
+				bool member_access = (op == OpAccessChain || op == OpInBoundsAccessChain) && i.length >= 4 &&
+				                     ops[2] == var.self && maybe_get<SPIRConstant>(ops[3]) != nullptr;
+
+				for (uint32_t j = 0; j < i.length; j++)
+				{
+					if (is_block_type(ops[j]))
+						return false;
+					if (ops[j] == var.self && !(member_access && j == 2))
+						return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// Removes the members at the end of the blocks which the variables point to, if nothing accesses them.
+void Compiler::remove_unused_block_members(const vector<uint32_t> &variables)
+{
+	vector<uint32_t> functions;
+	ir.for_each_typed_id<SPIRFunction>([&](uint32_t id, const SPIRFunction &) { functions.push_back(id); });
+
+	struct Candidate
+	{
+		uint32_t variable;
+		vector<uint32_t> block_types;
+		vector<BufferRange> ranges;
+	};
+	vector<Candidate> candidates;
+	for (auto id : variables)
+	{
+		vector<uint32_t> block_types;
+		if (find_removable_block_types(get<SPIRVariable>(id), functions, block_types))
+			candidates.push_back({ id, move(block_types), {} });
+	}
+
+	if (candidates.empty())
+		return;
+
+	// Find the members all of them access in a single traversal.
+	vector<BufferAccessHandler> handlers;
+	vector<OpcodeHandler *> handler_ptrs;
+	handlers.reserve(candidates.size());
+	for (auto &candidate : candidates)
+	{
+		handlers.emplace_back(*this, candidate.ranges, candidate.variable);
+		handler_ptrs.push_back(&handlers.back());
+	}
+	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler_ptrs);
+
+	for (auto &candidate : candidates)
+	{
+		uint32_t member_count = 0;
+		for (auto &range : candidate.ranges)
+			member_count = max(member_count, range.index + 1);
+
+		auto &block_type = get<SPIRType>(get<SPIRType>(get<SPIRVariable>(candidate.variable).basetype).self);
+		if (member_count == 0 || member_count >= block_type.member_types.size())
+			continue;
+
+		for (auto id : candidate.block_types)
+			get<SPIRType>(id).member_types.resize(member_count);
+	}
+}
+
+void Compiler::remove_unused_ir()
+{
+	auto &execution = get_entry_point();
+
+	unordered_set<uint32_t> used;
+	collect_used_ids(ir.default_entry_point, used);
+	collect_used_ids(execution.workgroup_size.constant, used);
+	for (auto id : execution.interface_variables)
+	{
+		auto storage = get<SPIRVariable>(id).storage;
+		if (storage == StorageClassInput || storage == StorageClassOutput)
+			collect_used_ids(id, used);
+	}
+
+	// Objects created through the API before this are used by compile().
+	collect_used_ids(dummy_sampler_id, used);
+	for (auto &combined : combined_image_samplers)
+	{
+		collect_used_ids(combined.combined_id, used);
+		collect_used_ids(combined.image_id, used);
+		collect_used_ids(combined.sampler_id, used);
+	}
+
+	unordered_set<uint32_t> removed;
+	for (uint32_t id = 0; id < ir.ids.size(); id++)
+	{
+		if (used.count(id))
+			continue;
+
+		switch (ir.ids[id].get_type())
+		{
+		case TypeType:
+		case TypeVariable:
+		case TypeConstant:
+		case TypeConstantOp:
+		case TypeFunction:
+		case TypeFunctionPrototype:
+		case TypeBlock:
+		case TypeUndef:
+			removed.insert(id);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	for (auto itr = begin(ir.entry_points); itr != end(ir.entry_points);)
+	{
+		if (itr->first != ir.default_entry_point)
+			itr = ir.entry_points.erase(itr);
+		else
+			++itr;
+	}
+
+	ir.reset_ids(removed);
+	call_graph.valid = false;
+
+	auto erase_removed = [&](vector<uint32_t> &list) {
+		list.erase(remove_if(begin(list), end(list), [&](uint32_t id) { return removed.count(id) != 0; }),
+		           end(list));
+	};
+	erase_removed(global_variables);
+	erase_removed(aliased_variables);
+
+	vector<uint32_t> blocks;
+	ir.for_each_typed_id<SPIRVariable>([&](uint32_t id, const SPIRVariable &var) {
+		if (var.storage == StorageClassUniform || var.storage == StorageClassStorageBuffer ||
+		    var.storage == StorageClassPushConstant)
+			blocks.push_back(id);
+	});
+	remove_unused_block_members(blocks);
+
+	ir.mark_modified();
+}
+
+// Instructions without side effects, whose result only depends on their operands.
+// Cheap ones are swizzles and copies, which are not worth a temporary of their own when the same one is used twice.
+static bool opcode_is_pure(const ParsedIR &ir, Op op, const uint32_t *ops, uint32_t length, bool &cheap)
+{
+	cheap = false;
+	switch (op)
+	{
+	case OpCompositeExtract:
+	case OpVectorShuffle:
+	case OpCopyObject:
+		cheap = true;
+		return true;
+
+	case OpSNegate:
+	case OpFNegate:
+	case OpIAdd:
+	case OpFAdd:
+	case OpISub:
+	case OpFSub:
+	case OpIMul:
+	case OpFMul:
+	case OpUDiv:
+	case OpSDiv:
+	case OpFDiv:
+	case OpUMod:
+	case OpSRem:
+	case OpSMod:
+	case OpFRem:
+	case OpFMod:
+	case OpVectorTimesScalar:
+	case OpMatrixTimesScalar:
+	case OpVectorTimesMatrix:
+	case OpMatrixTimesVector:
+	case OpMatrixTimesMatrix:
+	case OpOuterProduct:
+	case OpDot:
+	case OpTranspose:
+	case OpShiftRightLogical:
+	case OpShiftRightArithmetic:
+	case OpShiftLeftLogical:
+	case OpBitwiseOr:
+	case OpBitwiseXor:
+	case OpBitwiseAnd:
+	case OpNot:
+	case OpBitFieldInsert:
+	case OpBitFieldSExtract:
+	case OpBitFieldUExtract:
+	case OpBitReverse:
+	case OpBitCount:
+	case OpAny:
+	case OpAll:
+	case OpIsNan:
+	case OpIsInf:
+	case OpLogicalEqual:
+	case OpLogicalNotEqual:
+	case OpLogicalOr:
+	case OpLogicalAnd:
+	case OpLogicalNot:
+	case OpSelect:
+	case OpIEqual:
+	case OpINotEqual:
+	case OpUGreaterThan:
+	case OpSGreaterThan:
+	case OpUGreaterThanEqual:
+	case OpSGreaterThanEqual:
+	case OpULessThan:
+	case OpSLessThan:
+	case OpULessThanEqual:
+	case OpSLessThanEqual:
+	case OpFOrdEqual:
+	case OpFUnordEqual:
+	case OpFOrdNotEqual:
+	case OpFUnordNotEqual:
+	case OpFOrdLessThan:
+	case OpFUnordLessThan:
+	case OpFOrdGreaterThan:
+	case OpFUnordGreaterThan:
+	case OpFOrdLessThanEqual:
+	case OpFUnordLessThanEqual:
+	case OpFOrdGreaterThanEqual:
+	case OpFUnordGreaterThanEqual:
+	case OpConvertFToU:
+	case OpConvertFToS:
+	case OpConvertSToF:
+	case OpConvertUToF:
+	case OpUConvert:
+	case OpSConvert:
+	case OpFConvert:
+	case OpBitcast:
+	case OpQuantizeToF16:
+	case OpCompositeConstruct:
+	case OpCompositeInsert:
+	case OpVectorExtractDynamic:
+	case OpVectorInsertDynamic:
+		return true;
+
+	case OpExtInst:
+	{
+		if (length < 4 || ir.ids[ops[2]].get<SPIRExtension>().ext != SPIRExtension::GLSL)
+			return false;
+
+		// These take pointers.
+		switch (ops[3])
+		{
+		case GLSLstd450Modf:
+		case GLSLstd450Frexp:
+		case GLSLstd450InterpolateAtCentroid:
+		case GLSLstd450InterpolateAtSample:
+		case GLSLstd450InterpolateAtOffset:
+			return false;
+
+		default:
+			return true;
+		}
+	}
+
+	default:
+		return false;
+	}
+}
+
+// Whether an operand is an ID which is read, for the instructions eliminate_common_subexpressions() rewrites
+// operands of. Result types and IDs do not count. Returns false for operands of any other instruction,
+// as it is not known which of them are literals.
+static bool operand_is_id(const ParsedIR &ir, Op op, const uint32_t *ops, uint32_t length, uint32_t index,
+                          bool &known)
+{
+	known = true;
+	bool cheap;
+	if (op == OpStore)
+		return index < 2;
+	else if (opcode_is_pure(ir, op, ops, length, cheap))
+	{
+		switch (op)
+		{
+		case OpCompositeExtract:
+			return index == 2;
+		case OpCompositeInsert:
+		case OpVectorShuffle:
+			return index >= 2 && index < 4;
+		case OpExtInst:
+			return index >= 2 && index != 3;
+		default:
+			return index >= 2;
+		}
+	}
+
+	switch (op)
+	{
+	case OpFunctionCall:
+		return index >= 2;
+
+	// Sampling and reading, where the image operand mask is followed by more IDs.
+	case OpImageSampleImplicitLod:
+	case OpImageSampleExplicitLod:
+	case OpImageSampleProjImplicitLod:
+	case OpImageSampleProjExplicitLod:
+	case OpImageFetch:
+	case OpImageRead:
+		return index >= 2 && index != 4;
+
+	case OpImageSampleDrefImplicitLod:
+	case OpImageSampleDrefExplicitLod:
+	case OpImageSampleProjDrefImplicitLod:
+	case OpImageSampleProjDrefExplicitLod:
+	case OpImageGather:
+	case OpImageDrefGather:
+		return index >= 2 && index != 5;
+
+	default:
+		known = false;
+		return false;
+	}
+}
+
+void Compiler::eliminate_common_subexpressions()
+{
+	// Operands are rewritten in place, so borrowed SPIR-V words have to be copied first.
+	if (ir.spirv.empty() && ir.get_spirv_word_count())
+	{
+		auto *words = ir.get_spirv_words();
+		vector<uint32_t> spirv(words, words + ir.get_spirv_word_count());
+		ir.set_borrowed_spirv(nullptr, 0);
+		ir.spirv = move(spirv);
+	}
+
+	ir.for_each_typed_id<SPIRFunction>([&](uint32_t, SPIRFunction &func) { eliminate_common_subexpressions(func); });
+
+	call_graph.valid = false;
+	ir.mark_modified();
+}
+
+void Compiler::eliminate_common_subexpressions(SPIRFunction &func)
+{
+	if (func.blocks.empty())
+		return;
 
-	if (itr == end(compiler.combined_image_samplers))
+	// Visit blocks down the dominator tree, so an instruction can take the place of the same instruction
+	// anywhere it dominates. Blocks which cannot be reached are left alone.
+	CFG cfg(*this, func);
+	unordered_map<uint32_t, vector<uint32_t>> dominated;
+	for (auto block : func.blocks)
 	{
-		uint32_t sampled_type;
-		if (is_fetch)
+		uint32_t dominator = cfg.get_immediate_dominator(block);
+		if (dominator && block != func.entry_block)
+			dominated[dominator].push_back(block);
+	}
+
+	struct ValueKey
+	{
+		vector<uint32_t> words;
+		bool operator==(const ValueKey &other) const
 		{
-			// Have to invent the sampled image type.
-			sampled_type = compiler.ir.increase_bound_by(1);
-			auto &type = compiler.set<SPIRType>(sampled_type);
-			type = compiler.expression_type(args[2]);
-			type.self = sampled_type;
-			type.basetype = SPIRType::SampledImage;
-			type.image.depth = false;
+			return words == other.words;
 		}
-		else
+	};
+
+	struct ValueKeyHasher
+	{
+		size_t operator()(const ValueKey &key) const
 		{
-			sampled_type = args[0];
+			Hasher h;
+			for (auto word : key.words)
+				h.u32(word);
+			return size_t(h.get());
 		}
+	};
 
-		auto id = compiler.ir.increase_bound_by(2);
-		auto type_id = id + 0;
-		auto combined_id = id + 1;
-
-		// Make a new type, pointer to OpTypeSampledImage, so we can make a variable of this type.
-		// We will probably have this type lying around, but it doesn't hurt to make duplicates for internal purposes.
-		auto &type = compiler.set<SPIRType>(type_id);
-		auto &base = compiler.get<SPIRType>(sampled_type);
-		type = base;
-		type.pointer = true;
-		type.storage = StorageClassUniformConstant;
-		type.parent_type = type_id;
+	// Equal values have the same number, which is the ID of the first instruction which computes it.
+	unordered_map<ValueKey, uint32_t, ValueKeyHasher> values;
+	unordered_map<uint32_t, uint32_t> value_numbers;
+	unordered_map<uint32_t, uint32_t> replacements;
+	const auto value_number = [&](uint32_t id) {
+		auto itr = value_numbers.find(id);
+		return itr != end(value_numbers) ? itr->second : id;
+	};
 
-		// Build new variable.
-		compiler.set<SPIRVariable>(combined_id, type_id, StorageClassUniformConstant, 0);
+	struct Frame
+	{
+		uint32_t block;
+		size_t first_value;
+	};
+	vector<Frame> stack = { { func.entry_block, 0 } };
+	vector<const ValueKey *> scope;
 
-		// Inherit RelaxedPrecision (and potentially other useful flags if deemed relevant).
-		auto &new_flags = compiler.ir.meta[combined_id].decoration.decoration_flags;
-		// Fetch inherits precision from the image, not sampler (there is no sampler).
-		auto &old_flags = compiler.ir.meta[is_fetch ? image_id : sampler_id].decoration.decoration_flags;
-		new_flags.reset();
-		if (old_flags.get(DecorationRelaxedPrecision))
-			new_flags.set(DecorationRelaxedPrecision);
+	while (!stack.empty())
+	{
+		auto frame = stack.back();
+		stack.pop_back();
 
-		// Propagate the array type for the original image as well.
-		auto *var = compiler.maybe_get_backing_variable(image_id);
-		if (var)
+		// Leave the subtrees of the blocks which are done.
+		while (scope.size() > frame.first_value)
 		{
-			auto &parent_type = compiler.get<SPIRType>(var->basetype);
-			type.array = parent_type.array;
-			type.array_size_literal = parent_type.array_size_literal;
+			values.erase(values.find(*scope.back()));
+			scope.pop_back();
 		}
 
-		compiler.combined_image_samplers.push_back({ combined_id, image_id, sampler_id });
-	}
+		for (auto &i : get<SPIRBlock>(frame.block).ops)
+		{
+			auto ops = stream(i);
+			auto op = static_cast<Op>(i.op);
+			bool cheap;
+			if (i.length < 3 || !opcode_is_pure(ir, op, ops, i.length, cheap))
+				continue;
 
-	return true;
-}
+			uint32_t result_type = ops[0];
+			uint32_t id = ops[1];
+			if (get<SPIRType>(result_type).pointer)
+				continue;
 
-uint32_t Compiler::build_dummy_sampler_for_combined_images()
-{
-	DummySamplerForCombinedImageHandler handler(*this);
-	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler);
-	if (handler.need_dummy_sampler)
-	{
-		uint32_t offset = ir.increase_bound_by(3);
-		auto type_id = offset + 0;
-		auto ptr_type_id = offset + 1;
-		auto var_id = offset + 2;
+			// Values made from constants alone are as cheap to repeat as the constants, e.g. vec2(1.0).
+			bool known;
+			bool constant = true;
+			ValueKey key;
+			key.words.reserve(i.length + 1);
+			key.words.push_back(op);
+			key.words.push_back(result_type);
+			for (uint32_t j = 2; j < i.length; j++)
+			{
+				if (operand_is_id(ir, op, ops, i.length, j, known))
+				{
+					auto type = ir.ids[ops[j]].get_type();
+					if (type != TypeConstant && type != TypeExtension)
+						constant = false;
+					key.words.push_back(value_number(ops[j]));
+				}
+				else
+					key.words.push_back(ops[j]);
+			}
+			cheap = cheap || constant;
 
-		SPIRType sampler_type;
-		auto &sampler = set<SPIRType>(type_id);
-		sampler.basetype = SPIRType::Sampler;
+			auto itr = values.find(key);
+			if (itr == end(values))
+			{
+				itr = values.insert({ move(key), id }).first;
+				scope.push_back(&itr->first);
+				continue;
+			}
 
-		auto &ptr_sampler = set<SPIRType>(ptr_type_id);
-		ptr_sampler = sampler;
-		ptr_sampler.self = type_id;
-		ptr_sampler.storage = StorageClassUniformConstant;
-		ptr_sampler.pointer = true;
-		ptr_sampler.parent_type = type_id;
+			// RelaxedPrecision and NoContraction change the result, so those have to match.
+			uint32_t original = itr->second;
+			if (get_decoration_bitset(original) != get_decoration_bitset(id))
+				continue;
 
-		set<SPIRVariable>(var_id, ptr_type_id, StorageClassUniformConstant, 0);
-		set_name(var_id, "SPIRV_Cross_DummySampler");
-		dummy_sampler_id = var_id;
-		return var_id;
+			value_numbers[id] = original;
+			if (!cheap)
+				replacements[id] = original;
+		}
+
+		auto itr = dominated.find(frame.block);
+		if (itr != end(dominated))
+			for (auto block : itr->second)
+				stack.push_back({ block, scope.size() });
 	}
-	else
-		return 0;
-}
 
-void Compiler::build_combined_image_samplers()
-{
-	ir.for_each_typed_id<SPIRFunction>([&](uint32_t, SPIRFunction &func) {
-		func.combined_parameters.clear();
-		func.shadow_arguments.clear();
-		func.do_combined_parameters = true;
-	});
+	if (replacements.empty())
+		return;
 
-	combined_image_samplers.clear();
-	CombinedImageSamplerHandler handler(*this);
-	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler);
-}
+	// Keep instructions which are used where operands cannot be told apart from literals.
+	for (auto block : func.blocks)
+	{
+		for (auto &i : get<SPIRBlock>(block).ops)
+		{
+			auto ops = stream(i);
+			auto op = static_cast<Op>(i.op);
+			for (uint32_t j = 0; j < i.length; j++)
+			{
+				bool known;
+				operand_is_id(ir, op, ops, i.length, j, known);
+				if (!known)
+					replacements.erase(ops[j]);
+			}
+		}
+	}
 
-vector<SpecializationConstant> Compiler::get_specialization_constants() const
-{
-	vector<SpecializationConstant> spec_consts;
-	ir.for_each_typed_id<SPIRConstant>([&](uint32_t, const SPIRConstant &c) {
-		if (c.specialization && has_decoration(c.self, DecorationSpecId))
-			spec_consts.push_back({ c.self, get_decoration(c.self, DecorationSpecId) });
-	});
-	return spec_consts;
-}
+	const auto replace = [&](uint32_t &id) {
+		auto itr = replacements.find(id);
+		if (itr != end(replacements))
+			id = itr->second;
+	};
 
-SPIRConstant &Compiler::get_constant(uint32_t id)
-{
-	return get<SPIRConstant>(id);
-}
+	for (auto block_id : func.blocks)
+	{
+		auto &block = get<SPIRBlock>(block_id);
+		for (auto &i : block.ops)
+		{
+			auto *ops = ir.spirv.data() + i.offset;
+			auto op = static_cast<Op>(i.op);
+			for (uint32_t j = 0; j < i.length; j++)
+			{
+				bool known;
+				if (operand_is_id(ir, op, ops, i.length, j, known))
+					replace(ops[j]);
+			}
+		}
 
-const SPIRConstant &Compiler::get_constant(uint32_t id) const
-{
-	return get<SPIRConstant>(id);
+		for (auto &phi : block.phi_variables)
+			replace(phi.local_variable);
+		replace(block.condition);
+		replace(block.return_value);
+
+		block.ops.erase(remove_if(begin(block.ops), end(block.ops),
+		                          [&](const Instruction &i) {
+			                          bool cheap;
+			                          auto ops = stream(i);
+			                          return i.length >= 2 &&
+			                                 opcode_is_pure(ir, static_cast<Op>(i.op), ops, i.length, cheap) &&
+			                                 replacements.count(ops[1]);
+		                          }),
+		                end(block.ops));
+	}
 }
 
-static bool exists_unaccessed_path_to_return(const CFG &cfg, uint32_t block, const unordered_set<uint32_t> &blocks)
+void Compiler::analyze_parameter_preservation(SPIRFunction &entry, const CFG &cfg,
+                                              const AnalyzeVariableScopeAccessHandler &handler)
 {
-	// This block accesses the variable.
-	if (blocks.find(block) != end(blocks))
-		return false;
+	// The arguments which are completely written somewhere, where we have to look at the paths through the function.
+	vector<SPIRFunction::Parameter *> written_arguments;
 
-	// We are at the end of the CFG.
-	if (cfg.get_succeeding_edges(block).empty())
-		return true;
-
-	// If any of our successors have a path to the end, there exists a path from block.
-	for (auto &succ : cfg.get_succeeding_edges(block))
-		if (exists_unaccessed_path_to_return(cfg, succ, blocks))
-			return true;
-
-	return false;
-}
-
-void Compiler::analyze_parameter_preservation(
-    SPIRFunction &entry, const CFG &cfg, const unordered_map<uint32_t, unordered_set<uint32_t>> &variable_to_blocks,
-    const unordered_map<uint32_t, unordered_set<uint32_t>> &complete_write_blocks)
-{
 	for (auto &arg : entry.arguments)
 	{
 		// Non-pointers are always inputs.
@@ -2789,8 +4562,8 @@ void Compiler::analyze_parameter_preservation(
 		if (!potential_preserve)
 			continue;
 
-		auto itr = variable_to_blocks.find(arg.id);
-		if (itr == end(variable_to_blocks))
+		auto *blocks = handler.find_accessed_blocks(arg.id);
+		if (!blocks)
 		{
 			// Variable is never accessed.
 			continue;
@@ -2798,29 +4571,91 @@ void Compiler::analyze_parameter_preservation(
 
 		// We have accessed a variable, but there was no complete writes to that variable.
 		// We deduce that we must preserve the argument.
-		itr = complete_write_blocks.find(arg.id);
-		if (itr == end(complete_write_blocks))
+		if (blocks->complete_writes.empty())
 		{
 			arg.read_count++;
 			continue;
 		}
 
-		// If there is a path through the CFG where no block completely writes to the variable, the variable will be in an undefined state
-		// when the function returns. We therefore need to implicitly preserve the variable in case there are writers in the function.
-		// Major case here is if a function is
-		// void foo(int &var) { if (cond) var = 10; }
-		// Using read/write counts, we will think it's just an out variable, but it really needs to be inout,
-		// because if we don't write anything whatever we put into the function must return back to the caller.
-		if (exists_unaccessed_path_to_return(cfg, entry.entry_block, itr->second))
-			arg.read_count++;
+		written_arguments.push_back(&arg);
+	}
+
+	if (written_arguments.empty())
+		return;
+
+	// If there is a path through the CFG where no block completely writes to the variable, the variable will be in an undefined state
+	// when the function returns. We therefore need to implicitly preserve the variable in case there are writers in the function.
+	// Major case here is if a function is
+	// void foo(int &var) { if (cond) var = 10; }
+	// Using read/write counts, we will think it's just an out variable, but it really needs to be inout,
+	// because if we don't write anything whatever we put into the function must return back to the caller.
+	// Find the complete writes which reach the end of the CFG on every path, i.e. the definitions which must reach.
+	uint32_t count = uint32_t(written_arguments.size());
+	ReachingDefinitions must_reach(cfg, ReachingDefinitions::MustReach, count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		handler.find_accessed_blocks(written_arguments[i]->id)->complete_writes.for_each_bit([&](uint32_t block) {
+			must_reach.add_definition(block, i);
+		});
 	}
+	must_reach.solve();
+
+	auto written_on_every_path = must_reach.get_reaching_exit();
+
+	for (uint32_t i = 0; i < count; i++)
+		if (!written_on_every_path.get(i))
+			written_arguments[i]->read_count++;
 }
 
 Compiler::AnalyzeVariableScopeAccessHandler::AnalyzeVariableScopeAccessHandler(Compiler &compiler_,
-                                                                               SPIRFunction &entry_)
+                                                                               SPIRFunction &entry_, const CFG &cfg_,
+                                                                               vector<uint32_t> &id_rows_)
     : compiler(compiler_)
     , entry(entry_)
+    , cfg(cfg_)
+    , id_rows(id_rows_)
+{
+}
+
+Compiler::AnalyzeVariableScopeAccessHandler::~AnalyzeVariableScopeAccessHandler()
+{
+	for (auto &blocks : accessed_blocks)
+		id_rows[blocks.id] = 0;
+}
+
+Compiler::AnalyzeVariableScopeAccessHandler::AccessedBlocks &Compiler::AnalyzeVariableScopeAccessHandler::
+    get_accessed_blocks(uint32_t id, bool temporary)
+{
+	auto &row = id_rows[id];
+	if (!row)
+	{
+		accessed_blocks.push_back({ id, temporary, DenseBitset(cfg.get_block_count()), {}, {} });
+		row = uint32_t(accessed_blocks.size());
+	}
+	return accessed_blocks[row - 1];
+}
+
+const Compiler::AnalyzeVariableScopeAccessHandler::AccessedBlocks *Compiler::AnalyzeVariableScopeAccessHandler::
+    find_accessed_blocks(uint32_t id) const
+{
+	uint32_t row = id_rows[id];
+	return row ? &accessed_blocks[row - 1] : nullptr;
+}
+
+void Compiler::AnalyzeVariableScopeAccessHandler::access_variable(uint32_t id, uint32_t block_index)
+{
+	get_accessed_blocks(id, false).accessed.set(block_index);
+}
+
+void Compiler::AnalyzeVariableScopeAccessHandler::write_variable(uint32_t id, uint32_t block_index, bool complete)
 {
+	auto &blocks = get_accessed_blocks(id, false);
+	blocks.accessed.set(block_index);
+
+	auto &writes = complete ? blocks.complete_writes : blocks.partial_writes;
+	if (!writes.size())
+		writes = DenseBitset(cfg.get_block_count());
+	writes.set(block_index);
 }
 
 bool Compiler::AnalyzeVariableScopeAccessHandler::follow_function_call(const SPIRFunction &)
@@ -2832,6 +4667,7 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::follow_function_call(const SPI
 void Compiler::AnalyzeVariableScopeAccessHandler::set_current_block(const SPIRBlock &block)
 {
 	current_block = &block;
+	current_block_index = cfg.get_block_index(block.self);
 
 	// If we're branching to a block which uses OpPhi, in GLSL
 	// this will be a variable write when we branch,
@@ -2843,11 +4679,11 @@ void Compiler::AnalyzeVariableScopeAccessHandler::set_current_block(const SPIRBl
 		{
 			if (phi.parent == block.self)
 			{
-				accessed_variables_to_block[phi.function_variable].insert(block.self);
+				access_variable(phi.function_variable, current_block_index);
 				// Phi variables are also accessed in our target branch block.
-				accessed_variables_to_block[phi.function_variable].insert(next.self);
+				access_variable(phi.function_variable, cfg.get_block_index(next.self));
 
-				notify_variable_access(phi.local_variable, block.self);
+				notify_variable_access(phi.local_variable, current_block_index);
 			}
 		}
 	};
@@ -2855,18 +4691,18 @@ void Compiler::AnalyzeVariableScopeAccessHandler::set_current_block(const SPIRBl
 	switch (block.terminator)
 	{
 	case SPIRBlock::Direct:
-		notify_variable_access(block.condition, block.self);
+		notify_variable_access(block.condition, current_block_index);
 		test_phi(block.next_block);
 		break;
 
 	case SPIRBlock::Select:
-		notify_variable_access(block.condition, block.self);
+		notify_variable_access(block.condition, current_block_index);
 		test_phi(block.true_block);
 		test_phi(block.false_block);
 		break;
 
 	case SPIRBlock::MultiSelect:
-		notify_variable_access(block.condition, block.self);
+		notify_variable_access(block.condition, current_block_index);
 		for (auto &target : block.cases)
 			test_phi(target.block);
 		if (block.default_block)
@@ -2878,12 +4714,12 @@ void Compiler::AnalyzeVariableScopeAccessHandler::set_current_block(const SPIRBl
 	}
 }
 
-void Compiler::AnalyzeVariableScopeAccessHandler::notify_variable_access(uint32_t id, uint32_t block)
+void Compiler::AnalyzeVariableScopeAccessHandler::notify_variable_access(uint32_t id, uint32_t block_index)
 {
 	if (id_is_phi_variable(id))
-		accessed_variables_to_block[id].insert(block);
+		access_variable(id, block_index);
 	else if (id_is_potential_temporary(id))
-		accessed_temporaries_to_block[id].insert(block);
+		get_accessed_blocks(id, true).accessed.set(block_index);
 }
 
 bool Compiler::AnalyzeVariableScopeAccessHandler::id_is_phi_variable(uint32_t id) const
@@ -2905,10 +4741,9 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::id_is_potential_temporary(uint
 
 bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint32_t *args, uint32_t length)
 {
-	// Keep track of the types of temporaries, so we can hoist them out as necessary.
 	uint32_t result_type, result_id;
 	if (compiler.instruction_to_result_type(result_type, result_id, op, args, length))
-		result_id_to_type[result_id] = result_type;
+		result_definitions[result_id] = { result_type, current_block_index };
 
 	switch (op)
 	{
@@ -2923,15 +4758,11 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		// If we store through an access chain, we have a partial write.
 		if (var)
 		{
-			accessed_variables_to_block[var->self].insert(current_block->self);
-			if (var->self == ptr)
-				complete_write_variables_to_block[var->self].insert(current_block->self);
-			else
-				partial_write_variables_to_block[var->self].insert(current_block->self);
+			write_variable(var->self, current_block_index, var->self == ptr);
 		}
 
 		// Might try to store a Phi variable here.
-		notify_variable_access(args[1], current_block->self);
+		notify_variable_access(args[1], current_block_index);
 		break;
 	}
 
@@ -2945,10 +4776,10 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		uint32_t ptr = args[2];
 		auto *var = compiler.maybe_get<SPIRVariable>(ptr);
 		if (var)
-			accessed_variables_to_block[var->self].insert(current_block->self);
+			access_variable(var->self, current_block_index);
 
 		for (uint32_t i = 3; i < length; i++)
-			notify_variable_access(args[i], current_block->self);
+			notify_variable_access(args[i], current_block_index);
 
 		// The result of an access chain is a fixed expression and is not really considered a temporary.
 		auto &e = compiler.set<SPIRExpression>(args[1], "", args[0], true);
@@ -2972,16 +4803,12 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		// If we store through an access chain, we have a partial write.
 		if (var)
 		{
-			accessed_variables_to_block[var->self].insert(current_block->self);
-			if (var->self == lhs)
-				complete_write_variables_to_block[var->self].insert(current_block->self);
-			else
-				partial_write_variables_to_block[var->self].insert(current_block->self);
+			write_variable(var->self, current_block_index, var->self == lhs);
 		}
 
 		var = compiler.maybe_get_backing_variable(rhs);
 		if (var)
-			accessed_variables_to_block[var->self].insert(current_block->self);
+			access_variable(var->self, current_block_index);
 		break;
 	}
 
@@ -2992,10 +4819,10 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 
 		auto *var = compiler.maybe_get_backing_variable(args[2]);
 		if (var)
-			accessed_variables_to_block[var->self].insert(current_block->self);
+			access_variable(var->self, current_block_index);
 
 		// Might try to copy a Phi variable here.
-		notify_variable_access(args[2], current_block->self);
+		notify_variable_access(args[2], current_block_index);
 		break;
 	}
 
@@ -3006,10 +4833,10 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		uint32_t ptr = args[2];
 		auto *var = compiler.maybe_get_backing_variable(ptr);
 		if (var)
-			accessed_variables_to_block[var->self].insert(current_block->self);
+			access_variable(var->self, current_block_index);
 
 		// Loaded value is a temporary.
-		notify_variable_access(args[1], current_block->self);
+		notify_variable_access(args[1], current_block_index);
 		break;
 	}
 
@@ -3026,9 +4853,8 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 			auto *var = compiler.maybe_get_backing_variable(args[i]);
 			if (var)
 			{
-				accessed_variables_to_block[var->self].insert(current_block->self);
 				// Assume we can get partial writes to this variable.
-				partial_write_variables_to_block[var->self].insert(current_block->self);
+				write_variable(var->self, current_block_index, false);
 			}
 
 			// Cannot easily prove if argument we pass to a function is completely written.
@@ -3036,19 +4862,19 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 			// which is then copied to in full to the real argument.
 
 			// Might try to copy a Phi variable here.
-			notify_variable_access(args[i], current_block->self);
+			notify_variable_access(args[i], current_block_index);
 		}
 
 		// Return value may be a temporary.
-		notify_variable_access(args[1], current_block->self);
+		notify_variable_access(args[1], current_block_index);
 		break;
 	}
 
 	case OpExtInst:
 	{
 		for (uint32_t i = 4; i < length; i++)
-			notify_variable_access(args[i], current_block->self);
-		notify_variable_access(args[1], current_block->self);
+			notify_variable_access(args[i], current_block_index);
+		notify_variable_access(args[1], current_block_index);
 		break;
 	}
 
@@ -3063,13 +4889,13 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 	case OpVectorShuffle:
 		// Specialize for opcode which contains literals.
 		for (uint32_t i = 1; i < 4; i++)
-			notify_variable_access(args[i], current_block->self);
+			notify_variable_access(args[i], current_block_index);
 		break;
 
 	case OpCompositeExtract:
 		// Specialize for opcode which contains literals.
 		for (uint32_t i = 1; i < 3; i++)
-			notify_variable_access(args[i], current_block->self);
+			notify_variable_access(args[i], current_block_index);
 		break;
 
 	case OpImageWrite:
@@ -3077,7 +4903,7 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		{
 			// Argument 3 is a literal.
 			if (i != 3)
-				notify_variable_access(args[i], current_block->self);
+				notify_variable_access(args[i], current_block_index);
 		}
 		break;
 
@@ -3097,7 +4923,7 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		{
 			// Argument 4 is a literal.
 			if (i != 4)
-				notify_variable_access(args[i], current_block->self);
+				notify_variable_access(args[i], current_block_index);
 		}
 		break;
 
@@ -3117,7 +4943,7 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		{
 			// Argument 5 is a literal.
 			if (i != 5)
-				notify_variable_access(args[i], current_block->self);
+				notify_variable_access(args[i], current_block_index);
 		}
 		break;
 
@@ -3130,7 +4956,7 @@ bool Compiler::AnalyzeVariableScopeAccessHandler::handle(spv::Op op, const uint3
 		// but worst case, it does not affect the correctness of the compile.
 		// Exhaustive analysis would be better here, but it's not worth it for now.
 		for (uint32_t i = 0; i < length; i++)
-			notify_variable_access(args[i], current_block->self);
+			notify_variable_access(args[i], current_block_index);
 		break;
 	}
 	}
@@ -3190,12 +5016,24 @@ void Compiler::find_function_local_luts(SPIRFunction &entry, const AnalyzeVariab
 {
 	auto &cfg = *function_cfgs.find(entry.self)->second;
 
+	// Variables which might be LUTs. Without an initializer, the one complete write to the variable must dominate
+	// all other accesses, which is when it must reach them, so that is checked for all candidates at once.
+	struct LUTCandidate
+	{
+		const AnalyzeVariableScopeAccessHandler::AccessedBlocks *blocks;
+		uint32_t static_constant_expression;
+		uint32_t write_block;
+	};
+	vector<LUTCandidate> candidates;
+
 	// For each variable which is statically accessed.
-	for (auto &accessed_var : handler.accessed_variables_to_block)
+	for (auto &accessed_var : handler.accessed_blocks)
 	{
-		auto &blocks = accessed_var.second;
-		auto &var = get<SPIRVariable>(accessed_var.first);
-		auto &type = expression_type(accessed_var.first);
+		if (accessed_var.temporary)
+			continue;
+
+		auto &var = get<SPIRVariable>(accessed_var.id);
+		auto &type = expression_type(accessed_var.id);
 
 		// Only consider function local variables here.
 		// If we only have a single function in our CFG, private storage is also fine,
@@ -3213,50 +5051,68 @@ void Compiler::find_function_local_luts(SPIRFunction &entry, const AnalyzeVariab
 			continue;
 
 		// If the variable has an initializer, make sure it is a constant expression.
-		uint32_t static_constant_expression = 0;
 		if (var.initializer)
 		{
 			if (ir.ids[var.initializer].get_type() != TypeConstant)
 				continue;
-			static_constant_expression = var.initializer;
 
 			// There can be no stores to this variable, we have now proved we have a LUT.
-			if (handler.complete_write_variables_to_block.count(var.self) != 0 ||
-			    handler.partial_write_variables_to_block.count(var.self) != 0)
+			if (!accessed_var.complete_writes.empty() || !accessed_var.partial_writes.empty())
 				continue;
+
+			candidates.push_back({ &accessed_var, var.initializer, CFG::InvalidIndex });
 		}
 		else
 		{
 			// We can have one, and only one write to the variable, and that write needs to be a constant.
 
 			// No partial writes allowed.
-			if (handler.partial_write_variables_to_block.count(var.self) != 0)
+			if (!accessed_var.partial_writes.empty())
 				continue;
 
-			auto itr = handler.complete_write_variables_to_block.find(var.self);
-
-			// No writes?
-			if (itr == end(handler.complete_write_variables_to_block))
+			// No writes, or we write to the variable in more than one block.
+			auto &write_blocks = accessed_var.complete_writes;
+			if (write_blocks.empty() || write_blocks.count_bits() != 1)
 				continue;
 
-			// We write to the variable in more than one block.
-			auto &write_blocks = itr->second;
-			if (write_blocks.size() != 1)
+			// Unreachable via the CFG, we will never emit this code anyways.
+			uint32_t write_block = 0;
+			write_blocks.for_each_bit([&](uint32_t block) { write_block = block; });
+			if (!cfg.get_immediate_dominator(cfg.get_block_id(write_block)))
 				continue;
 
-			// The write needs to happen in the dominating block.
-			DominatorBuilder builder(cfg);
-			for (auto &block : blocks)
-				builder.add_block(block);
-			uint32_t dominator = builder.get_dominator();
+			candidates.push_back({ &accessed_var, 0, write_block });
+		}
+	}
+
+	ReachingDefinitions writes(cfg, ReachingDefinitions::MustReach, uint32_t(candidates.size()));
+	for (uint32_t i = 0; i < uint32_t(candidates.size()); i++)
+		if (candidates[i].write_block != CFG::InvalidIndex)
+			writes.add_definition(candidates[i].write_block, i);
+	writes.solve();
+
+	for (uint32_t i = 0; i < uint32_t(candidates.size()); i++)
+	{
+		auto &candidate = candidates[i];
+		auto &var = get<SPIRVariable>(candidate.blocks->id);
+		uint32_t static_constant_expression = candidate.static_constant_expression;
 
-			// The complete write happened in a branch or similar, cannot deduce static expression.
-			if (write_blocks.count(dominator) == 0)
+		if (candidate.write_block != CFG::InvalidIndex)
+		{
+			// The write needs to happen in the dominating block.
+			// Otherwise, the complete write happened in a branch or similar, cannot deduce static expression.
+			bool write_dominates = true;
+			candidate.blocks->accessed.for_each_bit([&](uint32_t block) {
+				if (block != candidate.write_block && !writes.get_reaching_in(block).get(i))
+					write_dominates = false;
+			});
+			if (!write_dominates)
 				continue;
 
 			// Find the static expression for this variable.
 			StaticExpressionAccessHandler static_expression_handler(*this, var.self);
-			traverse_all_reachable_opcodes(get<SPIRBlock>(dominator), static_expression_handler);
+			traverse_all_reachable_opcodes(get<SPIRBlock>(cfg.get_block_id(candidate.write_block)),
+			                               static_expression_handler);
 
 			// We want one, and exactly one write
 			if (static_expression_handler.write_count != 1 || static_expression_handler.static_expression == 0)
@@ -3283,28 +5139,32 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 	// Essentially a map of block -> { variables accessed in the basic block }
 	traverse_all_reachable_opcodes(entry, handler);
 
-	auto &cfg = *function_cfgs.find(entry.self)->second;
+	auto &cfg = handler.cfg;
 
 	// Analyze if there are parameters which need to be implicitly preserved with an "in" qualifier.
-	analyze_parameter_preservation(entry, cfg, handler.accessed_variables_to_block,
-	                               handler.complete_write_variables_to_block);
+	analyze_parameter_preservation(entry, cfg, handler);
 
-	unordered_map<uint32_t, uint32_t> potential_loop_variables;
+	// Variables which might be loop variables, and the continue block they are accessed in.
+	vector<pair<uint32_t, uint32_t>> potential_loop_variables;
 
 	// For each variable which is statically accessed.
-	for (auto &var : handler.accessed_variables_to_block)
+	for (auto &var : handler.accessed_blocks)
 	{
+		if (var.temporary)
+			continue;
+
 		// Only deal with variables which are considered local variables in this function.
-		if (find(begin(entry.local_variables), end(entry.local_variables), var.first) == end(entry.local_variables))
+		if (find(begin(entry.local_variables), end(entry.local_variables), var.id) == end(entry.local_variables))
 			continue;
 
 		DominatorBuilder builder(cfg);
-		auto &blocks = var.second;
-		auto &type = expression_type(var.first);
+		auto &type = expression_type(var.id);
+		uint32_t potential_loop_block = 0;
 
 		// Figure out which block is dominating all accesses of those variables.
-		for (auto &block : blocks)
-		{
+		var.accessed.for_each_bit([&](uint32_t block_index) {
+			uint32_t block = cfg.get_block_id(block_index);
+
 			// If we're accessing a variable inside a continue block, this variable might be a loop variable.
 			// We can only use loop variables with scalars, as we cannot track static expressions for vectors.
 			if (is_continue(block))
@@ -3322,16 +5182,17 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 				{
 					// The variable is used in multiple continue blocks, this is not a loop
 					// candidate, signal that by setting block to -1u.
-					auto &potential = potential_loop_variables[var.first];
-
-					if (potential == 0)
-						potential = block;
+					if (potential_loop_block == 0)
+						potential_loop_block = block;
 					else
-						potential = ~(0u);
+						potential_loop_block = ~(0u);
 				}
 			}
 			builder.add_block(block);
-		}
+		});
+
+		if (potential_loop_block)
+			potential_loop_variables.emplace_back(var.id, potential_loop_block);
 
 		builder.lift_continue_block_dominator();
 
@@ -3343,16 +5204,33 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 		if (dominating_block)
 		{
 			auto &block = get<SPIRBlock>(dominating_block);
-			block.dominated_variables.push_back(var.first);
-			get<SPIRVariable>(var.first).dominator = dominating_block;
+			block.dominated_variables.push_back(var.id);
+			get<SPIRVariable>(var.id).dominator = dominating_block;
 		}
 	}
 
-	for (auto &var : handler.accessed_temporaries_to_block)
+	// A temporary is declared in the block defining it, unless it is used where that block does not dominate,
+	// e.g. after the loop it is defined in. The defining block dominates a use exactly when the definition must reach
+	// it, so check that for all temporaries used in several blocks at once, and only search for a common dominator
+	// of the uses when it fails.
+	struct Temporary
 	{
-		auto itr = handler.result_id_to_type.find(var.first);
+		const AnalyzeVariableScopeAccessHandler::AccessedBlocks *blocks;
+		uint32_t type;
+		uint32_t definition_block;
+		uint32_t definition_bit;
+	};
+	vector<Temporary> temporaries;
+	uint32_t definition_count = 0;
+
+	for (auto &var : handler.accessed_blocks)
+	{
+		if (!var.temporary)
+			continue;
 
-		if (itr == end(handler.result_id_to_type))
+		auto itr = handler.result_definitions.find(var.id);
+
+		if (itr == end(handler.result_definitions))
 		{
 			// We found a false positive ID being used, ignore.
 			// This should probably be an assert.
@@ -3360,49 +5238,82 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 		}
 
 		// There is no point in doing domination analysis for opaque types.
-		auto &type = get<SPIRType>(itr->second);
+		auto &type = get<SPIRType>(itr->second.type);
 		if (type_is_opaque_value(type))
 			continue;
 
-		DominatorBuilder builder(cfg);
-		bool force_temporary = false;
+		uint32_t definition_block = itr->second.block_index;
+		bool check_definition = var.accessed.get(definition_block) && var.accessed.count_bits() > 1 &&
+		                        cfg.get_immediate_dominator(cfg.get_block_id(definition_block)) != 0;
+		temporaries.push_back({ &var, itr->second.type, definition_block, check_definition ? definition_count++ : ~0u });
+	}
 
-		// Figure out which block is dominating all accesses of those temporaries.
-		auto &blocks = var.second;
-		for (auto &block : blocks)
-		{
-			builder.add_block(block);
+	ReachingDefinitions definitions(cfg, ReachingDefinitions::MustReach, definition_count);
+	for (auto &temporary : temporaries)
+		if (temporary.definition_bit != ~0u)
+			definitions.add_definition(temporary.definition_block, temporary.definition_bit);
+	definitions.solve();
 
-			// If a temporary is used in more than one block, we might have to lift continue block
-			// access up to loop header like we did for variables.
-			if (blocks.size() != 1 && is_continue(block))
-				builder.add_block(ir.continue_block_to_loop_header[block]);
-			else if (blocks.size() != 1 && is_single_block_loop(block))
+	vector<uint32_t> dominated;
+	for (auto &temporary : temporaries)
+	{
+		bool force_temporary = false;
+		uint32_t id = temporary.blocks->id;
+
+		// The blocks the declaration has to dominate. If a temporary is used in more than one block,
+		// we might have to lift continue block access up to loop header like we did for variables.
+		auto &blocks = temporary.blocks->accessed;
+		uint32_t block_count = blocks.count_bits();
+		dominated.clear();
+		blocks.for_each_bit([&](uint32_t block_index) {
+			uint32_t block = cfg.get_block_id(block_index);
+			dominated.push_back(block);
+
+			if (block_count != 1 && is_continue(block))
+				dominated.push_back(ir.continue_block_to_loop_header[block]);
+			else if (block_count != 1 && is_single_block_loop(block))
 			{
 				// Awkward case, because the loop header is also the continue block.
 				force_temporary = true;
 			}
+		});
+
+		const auto definition_reaches = [&](uint32_t block) {
+			uint32_t block_index = cfg.get_block_index(block);
+			return block_index == temporary.definition_block ||
+			       (block_index != CFG::InvalidIndex &&
+			        definitions.get_reaching_in(block_index).get(temporary.definition_bit));
+		};
+
+		uint32_t dominating_block;
+		if (temporary.definition_bit != ~0u && all_of(begin(dominated), end(dominated), definition_reaches))
+			dominating_block = cfg.get_block_id(temporary.definition_block);
+		else
+		{
+			DominatorBuilder builder(cfg);
+			for (auto block : dominated)
+				builder.add_block(block);
+			dominating_block = builder.get_dominator();
 		}
 
-		uint32_t dominating_block = builder.get_dominator();
 		if (dominating_block)
 		{
 			// If we touch a variable in the dominating block, this is the expected setup.
 			// SPIR-V normally mandates this, but we have extra cases for temporary use inside loops.
-			bool first_use_is_dominator = blocks.count(dominating_block) != 0;
+			bool first_use_is_dominator = blocks.get(cfg.get_block_index(dominating_block));
 
 			if (!first_use_is_dominator || force_temporary)
 			{
 				// This should be very rare, but if we try to declare a temporary inside a loop,
 				// and that temporary is used outside the loop as well (spirv-opt inliner likes this)
 				// we should actually emit the temporary outside the loop.
-				hoisted_temporaries.insert(var.first);
-				forced_temporaries.insert(var.first);
+				hoisted_temporaries.insert(id);
+				forced_temporaries.insert(id);
 
 				auto &block_temporaries = get<SPIRBlock>(dominating_block).declare_temporary;
-				block_temporaries.emplace_back(handler.result_id_to_type[var.first], var.first);
+				block_temporaries.emplace_back(temporary.type, id);
 			}
-			else if (blocks.size() > 1)
+			else if (block_count > 1)
 			{
 				// Keep track of the temporary as we might have to declare this temporary.
 				// This can happen if the loop header dominates a temporary, but we have a complex fallback loop.
@@ -3410,22 +5321,37 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 				// What we need to do is hoist the temporaries outside the for (;;) {} block in case the header block
 				// declares the temporary.
 				auto &block_temporaries = get<SPIRBlock>(dominating_block).potential_declare_temporary;
-				block_temporaries.emplace_back(handler.result_id_to_type[var.first], var.first);
+				block_temporaries.emplace_back(temporary.type, id);
 			}
 		}
 	}
 
-	unordered_set<uint32_t> seen_blocks;
+	if (potential_loop_variables.empty())
+		return;
+
+	// Find the variables which are accessed on some path starting at each block.
+	// This is liveness where every access counts as a use and nothing kills, since a loop variable is declared by
+	// the loop, and cannot be written to after it either.
+	uint32_t loop_variable_count = uint32_t(potential_loop_variables.size());
+	LivenessAnalysis accessed_later(cfg, loop_variable_count);
+	for (uint32_t i = 0; i < loop_variable_count; i++)
+	{
+		handler.find_accessed_blocks(potential_loop_variables[i].first)->accessed.for_each_bit([&](uint32_t block) {
+			accessed_later.add_use(block, i);
+		});
+	}
+	accessed_later.solve();
 
 	// Now, try to analyze whether or not these variables are actually loop variables.
-	for (auto &loop_variable : potential_loop_variables)
+	for (uint32_t i = 0; i < loop_variable_count; i++)
 	{
+		auto &loop_variable = potential_loop_variables[i];
 		auto &var = get<SPIRVariable>(loop_variable.first);
 		auto dominator = var.dominator;
 		auto block = loop_variable.second;
 
 		// The variable was accessed in multiple continue blocks, ignore.
-		if (block == ~(0u) || block == 0)
+		if (block == ~(0u))
 			continue;
 
 		// Dead code.
@@ -3450,10 +5376,10 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 
 		assert(header);
 		auto &header_block = get<SPIRBlock>(header);
-		auto &blocks = handler.accessed_variables_to_block[loop_variable.first];
+		auto &blocks = handler.find_accessed_blocks(loop_variable.first)->accessed;
 
 		// If a loop variable is not used before the loop, it's probably not a loop variable.
-		bool has_accessed_variable = blocks.count(header) != 0;
+		bool has_accessed_variable = blocks.get(cfg.get_block_index(header));
 
 		// Now, there are two conditions we need to meet for the variable to be a loop variable.
 		// 1. The dominating block must have a branch-free path to the loop header,
@@ -3464,17 +5390,17 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 		bool static_loop_init = true;
 		while (dominator != header)
 		{
-			if (blocks.count(dominator) != 0)
+			if (blocks.get(cfg.get_block_index(dominator)))
 				has_accessed_variable = true;
 
-			auto &succ = cfg.get_succeeding_edges(dominator);
+			auto succ = cfg.get_succeeding_edges(dominator);
 			if (succ.size() != 1)
 			{
 				static_loop_init = false;
 				break;
 			}
 
-			auto &pred = cfg.get_preceding_edges(succ.front());
+			auto pred = cfg.get_preceding_edges(succ.front());
 			if (pred.size() != 1 || pred.front() != dominator)
 			{
 				static_loop_init = false;
@@ -3488,21 +5414,14 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 			continue;
 
 		// The second condition we need to meet is that no access after the loop
-		// merge can occur. Walk the CFG to see if we find anything.
-
-		seen_blocks.clear();
-		cfg.walk_from(seen_blocks, header_block.merge_block, [&](uint32_t walk_block) {
-			// We found a block which accesses the variable outside the loop.
-			if (blocks.find(walk_block) != end(blocks))
-				static_loop_init = false;
-		});
-
-		if (!static_loop_init)
+		// merge can occur, on any path starting at the merge block.
+		uint32_t merge_index = cfg.get_block_index(header_block.merge_block);
+		if (merge_index == CFG::InvalidIndex || accessed_later.get_live_in(merge_index).get(i))
 			continue;
 
 		// We have a loop variable.
 		header_block.loop_variables.push_back(loop_variable.first);
-		// Need to sort here as variables come from an unordered container, and pushing stuff in wrong order
+		// Need to sort here as variables come in the order they were first accessed, and pushing stuff in wrong order
 		// will break reproducability in regression runs.
 		sort(begin(header_block.loop_variables), end(header_block.loop_variables));
 		get<SPIRVariable>(loop_variable.first).loop_variable = true;
@@ -3717,6 +5636,7 @@ bool Compiler::ActiveBuiltinHandler::handle(spv::Op opcode, const uint32_t *args
 
 void Compiler::update_active_builtins()
 {
+	PhaseTimer timer(*this, compile_statistics.active_builtins_time);
 	active_input_builtins.reset();
 	active_output_builtins.reset();
 	cull_distance_count = 0;
@@ -3746,6 +5666,7 @@ bool Compiler::has_active_builtin(BuiltIn builtin, StorageClass storage)
 
 void Compiler::analyze_image_and_sampler_usage()
 {
+	PhaseTimer timer(*this, compile_statistics.image_and_sampler_analysis_time);
 	CombinedImageSamplerDrefHandler dref_handler(*this);
 	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), dref_handler);
 
@@ -3787,16 +5708,20 @@ bool Compiler::CombinedImageSamplerDrefHandler::handle(spv::Op opcode, const uin
 
 void Compiler::build_function_control_flow_graphs_and_analyze()
 {
-	CFGBuilder handler(*this);
-	handler.function_cfgs[ir.default_entry_point].reset(new CFG(*this, get<SPIRFunction>(ir.default_entry_point)));
-	traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), handler);
-	function_cfgs = move(handler.function_cfgs);
+	PhaseTimer timer(*this, compile_statistics.control_flow_analysis_time);
+	unordered_map<uint32_t, unique_ptr<CFG>> cfgs;
+	for (auto func : get_call_graph().reachable_functions)
+		cfgs[func].reset(new CFG(*this, get<SPIRFunction>(func)));
+	function_cfgs = move(cfgs);
 	bool single_function = function_cfgs.size() <= 1;
 
+	// Shared by the scope analysis of every function, which only uses a few of the IDs each.
+	vector<uint32_t> id_rows(ir.ids.size());
+
 	for (auto &f : function_cfgs)
 	{
 		auto &func = get<SPIRFunction>(f.first);
-		AnalyzeVariableScopeAccessHandler scope_handler(*this, func);
+		AnalyzeVariableScopeAccessHandler scope_handler(*this, func, *f.second, id_rows);
 		analyze_variable_scope(func, scope_handler);
 		find_function_local_luts(func, scope_handler, single_function);
 
@@ -3831,27 +5756,6 @@ void Compiler::build_function_control_flow_graphs_and_analyze()
 	}
 }
 
-Compiler::CFGBuilder::CFGBuilder(spirv_cross::Compiler &compiler_)
-    : compiler(compiler_)
-{
-}
-
-bool Compiler::CFGBuilder::handle(spv::Op, const uint32_t *, uint32_t)
-{
-	return true;
-}
-
-bool Compiler::CFGBuilder::follow_function_call(const SPIRFunction &func)
-{
-	if (function_cfgs.find(func.self) == end(function_cfgs))
-	{
-		function_cfgs[func.self].reset(new CFG(compiler, func));
-		return true;
-	}
-	else
-		return false;
-}
-
 bool Compiler::CombinedImageSamplerUsageHandler::begin_function_scope(const uint32_t *args, uint32_t length)
 {
 	if (length < 3)
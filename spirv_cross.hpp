@@ -20,6 +20,9 @@
 #include "spirv.hpp"
 #include "spirv_cfg.hpp"
 #include "spirv_cross_parsed_ir.hpp"
+#include "spirv_dataflow.hpp"
+#include <chrono>
+#include <mutex>
 
 namespace spirv_cross
 {
@@ -91,6 +94,16 @@ struct SpecializationConstant
 	uint32_t constant_id;
 };
 
+// A new default value for a scalar specialization constant, see CompilerGLSL::respecialize().
+struct SpecializationConstantValue
+{
+	// The ID of the specialization constant, as in SpecializationConstant::id.
+	uint32_t id;
+	// The bits of the value, e.g. 0x3f800000 for 1.0f or 1 for true.
+	// Only the lower 32 bits are used for types of 32 bits or less.
+	uint64_t value;
+};
+
 struct BufferRange
 {
 	unsigned index;
@@ -114,6 +127,94 @@ struct EntryPoint
 	spv::ExecutionModel execution_model;
 };
 
+// The reasons why code had to be emitted again during compile().
+// Most of them are discovered while emitting a function and only change how that function is emitted,
+// so only that function is emitted again. RecompileHelperFunction only needs the helper functions
+// to be emitted again, and the rest need a new pass over the whole shader.
+enum RecompileTrigger
+{
+	// A temporary had to be declared instead of forwarding an expression,
+	// because the expression was invalidated, read more than once, or could not be forwarded.
+	RecompileExpressionInvalidated,
+	RecompileExpressionReadTwice,
+	RecompileForwardingDisallowed,
+	// A temporary declared in a continue block had to be hoisted to the loop header.
+	RecompileTemporaryHoisted,
+	// A phi variable needs a copy to be read after it has been written.
+	RecompilePhiTemporaryCopy,
+	// A switch block needs a ladder variable to break out of a loop.
+	RecompileLadderBreak,
+	// A loop could not be emitted as a for or while loop.
+	RecompileLoopPattern,
+	// A function parameter is written to, so it must be declared as out or inout.
+	RecompileParameterWritten,
+	// A constant array must be copied to a function local array.
+	RecompileConstantArrayOnStack,
+
+	// A helper function which is emitted before all functions is needed.
+	RecompileHelperFunction,
+
+	// An extension, pragma or typedef must be declared at the top of the shader.
+	RecompileHeaderLine,
+	// An image turned out to be read or written after all, so its declaration must change.
+	RecompileImageAccess,
+
+	RecompileTriggerCount
+};
+
+// How much code compile() had to emit again, see RecompileTrigger.
+struct RecompileStatistics
+{
+	// Number of passes over the whole shader, 1 if nothing needed a full pass again.
+	uint32_t full_passes = 0;
+
+	// Number of times a single function was emitted again.
+	uint32_t function_passes = 0;
+
+	// Number of times only the helper functions were emitted again.
+	uint32_t helper_passes = 0;
+
+	// Number of specialization constant declarations replaced by CompilerGLSL::respecialize()
+	// without emitting anything else again. full_passes is 0 in that case.
+	uint32_t respecialized_constants = 0;
+
+	// Number of times each RecompileTrigger was hit, including the ones which were resolved
+	// by emitting a single function or the helper functions again.
+	uint32_t triggers[RecompileTriggerCount] = {};
+};
+
+// Where the time went in the last compile(), see Compiler::set_compile_statistics_enabled().
+// Times are wall clock seconds.
+struct CompileStatistics
+{
+	// Only set when the compiler parsed the SPIR-V itself, i.e. when it was constructed from SPIR-V words.
+	double parse_time = 0.0;
+
+	// The whole compile() call, including everything below.
+	double compile_time = 0.0;
+
+	double control_flow_analysis_time = 0.0;
+	double image_and_sampler_analysis_time = 0.0;
+	double active_builtins_time = 0.0;
+
+	// One entry per pass over the whole shader.
+	std::vector<double> emit_pass_times;
+
+	// Passes which only some backends run, in the order they ran, e.g. "preprocess_op_codes" in MSL.
+	std::vector<std::pair<std::string, double>> backend_phase_times;
+
+	// Number of expressions created, including the ones thrown away by recompiles.
+	uint32_t expressions_created = 0;
+
+	// Number of IDs which had to be emitted as temporaries instead of forwarded expressions.
+	uint32_t temporaries_forced = 0;
+
+	// Size of the output in bytes.
+	size_t bytes_emitted = 0;
+
+	RecompileStatistics recompile;
+};
+
 enum ExtendedDecorations
 {
 	SPIRVCrossDecorationPacked,
@@ -136,6 +237,8 @@ public:
 
 	// This is more modular. We can also consume a ParsedIR structure directly, either as a move, or copy.
 	// With copy, we can reuse the same parsed IR for multiple Compiler instances.
+	// To avoid cloning the entire IR for every instance, share an immutable ParsedIR and move in
+	// copy-on-write views of it instead, e.g. CompilerGLSL(ParsedIR(shared_ir)).
 	explicit Compiler(const ParsedIR &ir);
 	explicit Compiler(ParsedIR &&ir);
 
@@ -286,6 +389,21 @@ public:
 	// accessed.
 	ShaderResources get_shader_resources(const std::unordered_set<uint32_t> &active_variables) const;
 
+	// The same as get_shader_resources(), get_shader_resources(get_active_interface_variables())
+	// and get_active_interface_variables(), but these return references to results kept by the Compiler.
+	// Nothing is copied, and the results are only collected again when the module, a name, a decoration
+	// or the entry point has changed since the previous call, so calling them repeatedly is nearly free.
+	// A later call after such a change updates the referenced object in place,
+	// so do not hold on to the reference while modifying the Compiler.
+	//
+	// The results are collected under a lock, so like any other const reflection method, these and
+	// get_shader_resources(), get_active_interface_variables() and get_active_buffer_ranges() can be called
+	// from several threads at once, as long as no thread modifies the Compiler meanwhile.
+	// This includes a Compiler created from a copy-on-write ParsedIR view, as const accesses read the base in place.
+	const ShaderResources &get_cached_shader_resources() const;
+	const ShaderResources &get_cached_active_shader_resources() const;
+	const std::unordered_set<uint32_t> &get_cached_active_interface_variables() const;
+
 	// Remapped variables are considered built-in variables and a backend will
 	// not emit a declaration for this variable.
 	// This is mostly useful for making use of builtins which are dependent on extensions.
@@ -447,6 +565,34 @@ public:
 	SPIRConstant &get_constant(uint32_t id);
 	const SPIRConstant &get_constant(uint32_t id) const;
 
+	// Bakes the current values of all specialization constants into the module, for when they are known up front.
+	// Specialization constants become regular constants, specialization constant ops are evaluated where possible,
+	// and if/switch constructs on a constant condition are replaced by the path which is taken.
+	// Blocks which can no longer be reached are removed from their functions.
+	// Only integer and boolean specialization constant ops are evaluated, the rest keep being emitted as expressions.
+	// Call this after setting the values with get_constant() and before compile().
+	// The output can no longer be specialized, and get_specialization_constants() will not return folded constants.
+	void fold_specialization_constants();
+
+	// Removes everything the current entry point does not use from the module, before compile().
+	// Functions which are never called, and global variables, types, constants and undefs which nothing refers to
+	// are removed, along with the other entry points. Stage inputs and outputs are kept, as they are part of the
+	// linking interface, see set_enabled_interface_variables() for those.
+	// Members at the end of uniform, storage and push constant blocks which are never accessed are removed as well,
+	// if every access to the block goes through a constant member index. Earlier members are kept, so offsets
+	// do not change.
+	// Reflection only sees what is left afterwards.
+	void remove_unused_ir();
+
+	// Lets instructions which compute the same value as an instruction that dominates them reuse its result,
+	// e.g. an expression which is written out twice in the source, or repeated by inlining.
+	// This rewrites the IR of each function, it does not change how the backends build expressions.
+	// Only arithmetic, comparisons, conversions, composite construction and GLSL.std.450 calls are shared,
+	// and only if they are decorated the same way. Swizzles and copies are not worth a temporary
+	// and keep being repeated in the output. The backends decide which shared results become temporaries.
+	// Call this before compile().
+	void eliminate_common_subexpressions();
+
 	uint32_t get_current_id_bound() const
 	{
 		return uint32_t(ir.ids.size());
@@ -520,6 +666,24 @@ public:
 	// The most common use here is to check if a buffer is readonly or writeonly.
 	Bitset get_buffer_block_flags(uint32_t id) const;
 
+	// Returns how much code the last call to compile() had to emit again, and why.
+	const RecompileStatistics &get_recompile_statistics() const
+	{
+		return recompile_statistics;
+	}
+
+	// Collects timings and counters in compile(). Off by default.
+	void set_compile_statistics_enabled(bool enable)
+	{
+		compile_statistics_enabled = enable;
+	}
+
+	// Returns the statistics of the last call to compile() while statistics were enabled.
+	const CompileStatistics &get_compile_statistics() const
+	{
+		return compile_statistics;
+	}
+
 protected:
 	const uint32_t *stream(const Instruction &instr) const
 	{
@@ -529,9 +693,9 @@ protected:
 		if (!instr.length)
 			return nullptr;
 
-		if (instr.offset + instr.length > ir.spirv.size())
+		if (instr.offset + instr.length > ir.get_spirv_word_count())
 			SPIRV_CROSS_THROW("Compiler::stream() out of range.");
-		return &ir.spirv[instr.offset];
+		return ir.get_spirv_words() + instr.offset;
 	}
 
 	ParsedIR ir;
@@ -551,6 +715,8 @@ protected:
 	T &set(uint32_t id, P &&... args)
 	{
 		ir.add_typed_id(static_cast<Types>(T::type), id);
+		if (static_cast<Types>(T::type) == TypeExpression && compile_statistics_enabled)
+			compile_statistics.expressions_created++;
 		auto &var = variant_set<T>(ir.ids[id], std::forward<P>(args)...);
 		var.self = id;
 		return var;
@@ -632,7 +798,7 @@ protected:
 	uint32_t expression_type_id(uint32_t id) const;
 	const SPIRType &expression_type(uint32_t id) const;
 	bool expression_is_lvalue(uint32_t id) const;
-	bool variable_storage_is_aliased(const SPIRVariable &var);
+	bool variable_storage_is_aliased(const SPIRVariable &var) const;
 	SPIRVariable *maybe_get_backing_variable(uint32_t chain);
 
 	void register_read(uint32_t expr, uint32_t chain, bool forwarded);
@@ -676,13 +842,15 @@ protected:
 	void register_global_read_dependencies(const SPIRFunction &func, uint32_t id);
 	std::unordered_set<uint32_t> invalid_expressions;
 
-	void update_name_cache(std::unordered_set<std::string> &cache, std::string &name);
+	// Interns the names held by the name caches below and in SPIRType::member_name_cache.
+	StringInterner name_interner;
+
+	void update_name_cache(NameCache &cache, std::string &name);
 
 	// A variant which takes two sets of names. The secondary is only used to verify there are no collisions,
 	// but the set is not updated when we have found a new name.
 	// Used primarily when adding block interface names.
-	void update_name_cache(std::unordered_set<std::string> &cache_primary,
-	                       const std::unordered_set<std::string> &cache_secondary, std::string &name);
+	void update_name_cache(NameCache &cache_primary, const NameCache &cache_secondary, std::string &name);
 
 	bool function_is_pure(const SPIRFunction &func);
 	bool block_is_pure(const SPIRBlock &block);
@@ -692,7 +860,85 @@ protected:
 	bool execution_is_noop(const SPIRBlock &from, const SPIRBlock &to) const;
 	SPIRBlock::ContinueBlockType continue_block_type(const SPIRBlock &continue_block) const;
 
-	bool force_recompile = false;
+	// Finds the specialization constants whose values a backend may use while emitting code,
+	// e.g. array lengths, access chain indices or memory semantics, instead of only referring to them by name.
+	// Constants which are part of a composite or specialization constant op used that way are included.
+	void find_specialization_constants_used_by_value(std::unordered_set<uint32_t> &ids) const;
+
+	// Helpers for fold_specialization_constants().
+	bool evaluate_specialization_constant_op(const SPIRConstantOp &op, SPIRConstant &result) const;
+	void fold_constant_branches(SPIRFunction &func);
+	bool constant_branch_target(const SPIRBlock &block, uint32_t &target) const;
+	uint32_t count_branches_to_merge(uint32_t target, uint32_t merge) const;
+	void remove_unreachable_blocks(SPIRFunction &func);
+
+	// Helpers for remove_unused_ir().
+	void collect_used_ids(uint32_t id, std::unordered_set<uint32_t> &used) const;
+	bool find_removable_block_types(const SPIRVariable &var, const std::vector<uint32_t> &functions,
+	                                std::vector<uint32_t> &block_types) const;
+	void remove_unused_block_members(const std::vector<uint32_t> &variables);
+
+	// Helper for eliminate_common_subexpressions().
+	void eliminate_common_subexpressions(SPIRFunction &func);
+
+	// Requests that code is emitted again. Depending on the trigger and on what the backend is emitting
+	// right now, this only applies to the current function, to the helper functions, or to the whole shader.
+	void force_recompile(RecompileTrigger trigger);
+
+	// True if the code emitted from now on is going to be thrown away,
+	// because either the current function or the whole shader will be emitted again.
+	bool is_forcing_recompilation() const
+	{
+		return recompile_all || recompile_function;
+	}
+
+	void clear_force_recompile()
+	{
+		recompile_all = false;
+		recompile_function = false;
+		recompile_helpers = false;
+	}
+
+	// Set by backends while the current function can be emitted again on its own,
+	// and by backends which can emit their helper functions again on their own.
+	bool can_recompile_function = false;
+	bool can_recompile_helpers = false;
+
+	// Which recompiles are pending.
+	bool recompile_all = false;
+	bool recompile_function = false;
+	bool recompile_helpers = false;
+
+	RecompileStatistics recompile_statistics;
+
+	bool compile_statistics_enabled = false;
+	CompileStatistics compile_statistics;
+	double parse_time = 0.0;
+
+	// Adds the wall time between construction and destruction to a statistic,
+	// if compile statistics are enabled.
+	class PhaseTimer
+	{
+	public:
+		PhaseTimer(const Compiler &compiler, double &seconds);
+
+		// Adds a new entry to CompileStatistics::backend_phase_times.
+		PhaseTimer(Compiler &compiler, const char *name);
+
+		~PhaseTimer();
+
+	private:
+		CompileStatistics *statistics = nullptr;
+		double *seconds = nullptr;
+		const char *name = nullptr;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	// Resets the statistics when a compile starts and fills in the totals when it is done.
+	void begin_compile_statistics();
+	void end_compile_statistics(size_t bytes_emitted);
+	void begin_emit_pass_statistics();
+	std::chrono::steady_clock::time_point compile_start, emit_pass_start;
 
 	bool block_is_loop_candidate(const SPIRBlock &block, SPIRBlock::Method method) const;
 
@@ -717,6 +963,19 @@ protected:
 	void set_ir(ParsedIR &&parsed);
 	void parse_fixup();
 
+	// Kinds of instructions which FunctionSummary keeps track of.
+	enum OpcodeKindBits
+	{
+		// Image instructions, and loads of images, samplers and sampled images.
+		OpcodeKindImageBit = 1 << 0,
+		OpcodeKindAtomicBit = 1 << 1,
+		OpcodeKindBarrierBit = 1 << 2,
+		OpcodeKindAccessChainBit = 1 << 3,
+		// Every instruction which is none of the above.
+		OpcodeKindOtherBit = 1 << 4,
+		OpcodeKindAllBits = (1 << 5) - 1
+	};
+
 	// Used internally to implement various traversals for queries.
 	struct OpcodeHandler
 	{
@@ -744,6 +1003,21 @@ protected:
 		{
 			return true;
 		}
+
+		// Return true if what the handler finds does not depend on the call stack. Each function is then
+		// traversed once, the first time it is called, and follow_function_call() and the function scopes are
+		// not used. Such handlers can also share a traversal with others.
+		virtual bool handles_each_function_once() const
+		{
+			return false;
+		}
+
+		// With handles_each_function_once(), the OpcodeKindBits of the instructions the handler looks at.
+		// Functions without any of them, including in the functions they call, are skipped.
+		virtual uint32_t get_opcode_filter() const
+		{
+			return OpcodeKindAllBits;
+		}
 	};
 
 	struct BufferAccessHandler : OpcodeHandler
@@ -757,6 +1031,16 @@ protected:
 
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
 
+		bool handles_each_function_once() const override
+		{
+			return true;
+		}
+
+		uint32_t get_opcode_filter() const override
+		{
+			return OpcodeKindAccessChainBit;
+		}
+
 		const Compiler &compiler;
 		std::vector<BufferRange> &ranges;
 		uint32_t id;
@@ -774,6 +1058,11 @@ protected:
 
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
 
+		bool handles_each_function_once() const override
+		{
+			return true;
+		}
+
 		const Compiler &compiler;
 		std::unordered_set<uint32_t> &variables;
 	};
@@ -809,6 +1098,17 @@ protected:
 		}
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
 
+		bool handles_each_function_once() const override
+		{
+			return true;
+		}
+
+		// Access chains to images are handled as well.
+		uint32_t get_opcode_filter() const override
+		{
+			return OpcodeKindImageBit | OpcodeKindAccessChainBit;
+		}
+
 		Compiler &compiler;
 		bool need_dummy_sampler = false;
 	};
@@ -821,6 +1121,12 @@ protected:
 		}
 
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
+
+		bool handles_each_function_once() const override
+		{
+			return true;
+		}
+
 		Compiler &compiler;
 
 		void handle_builtin(const SPIRType &type, spv::BuiltIn builtin, const Bitset &decoration_flags);
@@ -828,11 +1134,74 @@ protected:
 
 	bool traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHandler &handler) const;
 	bool traverse_all_reachable_opcodes(const SPIRFunction &block, OpcodeHandler &handler) const;
+
+	// Runs several handlers which all handle each function once in a single traversal.
+	// A handler which returns false stops, while the others go on. Returns false if any handler stopped.
+	bool traverse_all_reachable_opcodes(const SPIRFunction &func, const std::vector<OpcodeHandler *> &handlers) const;
+	bool traverse_each_function_once(const SPIRFunction &func, std::vector<OpcodeHandler *> &handlers,
+	                                 uint32_t filter, std::vector<bool> &visited) const;
+
+	// What a function does, as far as the traversals are concerned.
+	struct FunctionSummary
+	{
+		// Functions called directly, each once, in the order of their first call.
+		std::vector<uint32_t> callees;
+
+		// Global variables used by any instruction, sorted.
+		// Literals are taken as IDs as well, so this can have variables which are not used at all.
+		std::vector<uint32_t> variables;
+
+		// OpcodeKindBits in the function itself, and also in everything it calls.
+		uint32_t opcodes = 0;
+		uint32_t reachable_opcodes = 0;
+	};
+
+	// Summaries of every function, and the call graph of the default entry point.
+	// Compiling creates IDs all the time, so rather than the modification count of the IR, this is reset by
+	// everything which changes the functions themselves: set_ir(), fold_specialization_constants(),
+	// remove_unused_ir() and eliminate_common_subexpressions().
+	struct CallGraph
+	{
+		std::unordered_map<uint32_t, FunctionSummary> functions;
+
+		// The entry point, then the functions it reaches in the order the traversals first call them.
+		std::vector<uint32_t> reachable_functions;
+
+		// The variables of all reachable functions, sorted.
+		std::vector<uint32_t> reachable_variables;
+
+		uint32_t entry_point = 0;
+		bool valid = false;
+
+		// Held while checking and rebuilding, as const reflection methods get here from several threads.
+		std::mutex lock;
+	};
+	mutable CallGraph call_graph;
+
+	const CallGraph &get_call_graph() const;
+	const FunctionSummary &get_function_summary(uint32_t func) const;
+	uint32_t get_opcode_kinds(const Instruction &instr) const;
 	// This must be an ordered data structure so we always pick the same type aliases.
 	std::vector<uint32_t> global_struct_cache;
 
 	ShaderResources get_shader_resources(const std::unordered_set<uint32_t> *active_variables) const;
 
+	// Backs get_cached_shader_resources() and friends.
+	// Each member is up to date while its count matches ir.get_modification_count().
+	struct ReflectionCache
+	{
+		ShaderResources resources;
+		ShaderResources active_resources;
+		std::unordered_set<uint32_t> active_variables;
+		uint64_t resources_count = UINT64_MAX;
+		uint64_t active_resources_count = UINT64_MAX;
+		uint64_t active_variables_count = UINT64_MAX;
+
+		// Recursive, as the active resources are collected from the other two members.
+		std::recursive_mutex lock;
+	};
+	mutable ReflectionCache reflection_cache;
+
 	VariableTypeRemapCallback variable_remap_callback;
 
 	bool get_common_basic_type(const SPIRType &type, SPIRType::BaseType &base_type);
@@ -851,11 +1220,6 @@ protected:
 	void update_active_builtins();
 	bool has_active_builtin(spv::BuiltIn builtin, spv::StorageClass storage);
 
-	void analyze_parameter_preservation(
-	    SPIRFunction &entry, const CFG &cfg,
-	    const std::unordered_map<uint32_t, std::unordered_set<uint32_t>> &variable_to_blocks,
-	    const std::unordered_map<uint32_t, std::unordered_set<uint32_t>> &complete_write_blocks);
-
 	// If a variable ID or parameter ID is found in this set, a sampler is actually a shadow/comparison sampler.
 	// SPIR-V does not support this distinction, so we must keep track of this information outside the type system.
 	// There might be unrelated IDs found in this set which do not correspond to actual variables.
@@ -879,6 +1243,16 @@ protected:
 		}
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
 
+		bool handles_each_function_once() const override
+		{
+			return true;
+		}
+
+		uint32_t get_opcode_filter() const override
+		{
+			return OpcodeKindImageBit;
+		}
+
 		Compiler &compiler;
 		std::unordered_set<uint32_t> dref_combined_samplers;
 	};
@@ -906,36 +1280,57 @@ protected:
 
 	void build_function_control_flow_graphs_and_analyze();
 	std::unordered_map<uint32_t, std::unique_ptr<CFG>> function_cfgs;
-	struct CFGBuilder : OpcodeHandler
-	{
-		CFGBuilder(Compiler &compiler_);
-
-		bool follow_function_call(const SPIRFunction &func) override;
-		bool handle(spv::Op op, const uint32_t *args, uint32_t length) override;
-		Compiler &compiler;
-		std::unordered_map<uint32_t, std::unique_ptr<CFG>> function_cfgs;
-	};
 
 	struct AnalyzeVariableScopeAccessHandler : OpcodeHandler
 	{
-		AnalyzeVariableScopeAccessHandler(Compiler &compiler_, SPIRFunction &entry_);
+		// id_rows must have an entry for every ID, all 0, and is left that way when the handler is destroyed,
+		// so one table can be shared by the handlers of all functions.
+		AnalyzeVariableScopeAccessHandler(Compiler &compiler_, SPIRFunction &entry_, const CFG &cfg_,
+		                                  std::vector<uint32_t> &id_rows_);
+		~AnalyzeVariableScopeAccessHandler();
 
 		bool follow_function_call(const SPIRFunction &) override;
 		void set_current_block(const SPIRBlock &block) override;
 
-		void notify_variable_access(uint32_t id, uint32_t block);
+		void notify_variable_access(uint32_t id, uint32_t block_index);
 		bool id_is_phi_variable(uint32_t id) const;
 		bool id_is_potential_temporary(uint32_t id) const;
 		bool handle(spv::Op op, const uint32_t *args, uint32_t length) override;
 
+		// The blocks a variable or temporary is used in, as sets of CFG block indices.
+		struct AccessedBlocks
+		{
+			uint32_t id;
+			bool temporary;
+			DenseBitset accessed;
+
+			// Only variables can be written to, these are empty until they are.
+			DenseBitset complete_writes;
+			DenseBitset partial_writes;
+		};
+
+		AccessedBlocks &get_accessed_blocks(uint32_t id, bool temporary);
+		const AccessedBlocks *find_accessed_blocks(uint32_t id) const;
+		void access_variable(uint32_t id, uint32_t block_index);
+		void write_variable(uint32_t id, uint32_t block_index, bool complete);
+
 		Compiler &compiler;
 		SPIRFunction &entry;
-		std::unordered_map<uint32_t, std::unordered_set<uint32_t>> accessed_variables_to_block;
-		std::unordered_map<uint32_t, std::unordered_set<uint32_t>> accessed_temporaries_to_block;
-		std::unordered_map<uint32_t, uint32_t> result_id_to_type;
-		std::unordered_map<uint32_t, std::unordered_set<uint32_t>> complete_write_variables_to_block;
-		std::unordered_map<uint32_t, std::unordered_set<uint32_t>> partial_write_variables_to_block;
+		const CFG &cfg;
+		std::vector<uint32_t> &id_rows;
+
+		// In the order the IDs are first accessed. id_rows holds the index into this plus one.
+		std::vector<AccessedBlocks> accessed_blocks;
+
+		// Keep track of the types of temporaries, and the blocks defining them, so we can hoist them out as necessary.
+		struct ResultDefinition
+		{
+			uint32_t type;
+			uint32_t block_index;
+		};
+		std::unordered_map<uint32_t, ResultDefinition> result_definitions;
 		const SPIRBlock *current_block = nullptr;
+		uint32_t current_block_index = 0;
 	};
 
 	struct StaticExpressionAccessHandler : OpcodeHandler
@@ -951,6 +1346,8 @@ protected:
 	};
 
 	void analyze_variable_scope(SPIRFunction &function, AnalyzeVariableScopeAccessHandler &handler);
+	void analyze_parameter_preservation(SPIRFunction &entry, const CFG &cfg,
+	                                    const AnalyzeVariableScopeAccessHandler &handler);
 	void find_function_local_luts(SPIRFunction &function, const AnalyzeVariableScopeAccessHandler &handler,
 	                              bool single_function);
 
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_cross_batch.hpp"
+#include "spirv_reflect.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+using namespace spv;
+
+namespace spirv_cross
+{
+static unique_ptr<CompilerGLSL> create_compiler(const shared_ptr<const ParsedIR> &ir, const BatchEntryPoint &entry)
+{
+	unique_ptr<CompilerGLSL> compiler;
+
+	switch (entry.backend)
+	{
+	case BatchBackend::GLSL:
+		compiler.reset(new CompilerGLSL(ParsedIR(ir)));
+		compiler->set_common_options(entry.common);
+		break;
+
+	case BatchBackend::HLSL:
+	{
+		auto *hlsl = new CompilerHLSL(ParsedIR(ir));
+		compiler.reset(hlsl);
+		hlsl->set_common_options(entry.common);
+		hlsl->set_hlsl_options(entry.hlsl);
+		break;
+	}
+
+	case BatchBackend::MSL:
+	{
+		auto *msl = new CompilerMSL(ParsedIR(ir));
+		compiler.reset(msl);
+		msl->set_common_options(entry.common);
+		msl->set_msl_options(entry.msl);
+		break;
+	}
+
+	case BatchBackend::Reflect:
+		// Reflection sets up its own common options.
+		compiler.reset(new CompilerReflection(ParsedIR(ir)));
+		break;
+	}
+
+	return compiler;
+}
+
+static void compile_entry_point(const shared_ptr<const ParsedIR> &ir, const BatchEntryPoint &entry,
+                                BatchResult &result)
+{
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	try
+#endif
+	{
+		auto compiler = create_compiler(ir, entry);
+		compiler->set_entry_point(entry.name, entry.model);
+		if (entry.setup)
+			entry.setup(*compiler);
+
+		result.source = compiler->compile();
+		result.resources = compiler->get_shader_resources(compiler->get_active_interface_variables());
+	}
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	catch (const exception &e)
+	{
+		result.source.clear();
+		result.resources = {};
+		result.error = e.what();
+	}
+#endif
+}
+
+vector<BatchResult> compile_entry_points(shared_ptr<const ParsedIR> ir, const vector<BatchEntryPoint> &entry_points,
+                                         unsigned num_threads)
+{
+	vector<BatchResult> results(entry_points.size());
+
+	if (num_threads == 0)
+		num_threads = max(thread::hardware_concurrency(), 1u);
+	num_threads = unsigned(min<size_t>(num_threads, entry_points.size()));
+
+	// Workers pull the next entry point off a shared counter, so a slow compile does not hold up a whole thread's
+	// share of the work. Each result is only written by the worker which compiled it.
+	atomic<size_t> next_entry(0);
+	const auto worker = [&]() {
+		for (size_t i = next_entry++; i < entry_points.size(); i = next_entry++)
+			compile_entry_point(ir, entry_points[i], results[i]);
+	};
+
+	if (num_threads <= 1)
+	{
+		worker();
+		return results;
+	}
+
+	vector<thread> threads;
+	threads.reserve(num_threads - 1);
+	for (unsigned i = 1; i < num_threads; i++)
+		threads.emplace_back(worker);
+	worker();
+
+	for (auto &t : threads)
+		t.join();
+
+	return results;
+}
+} // namespace spirv_cross
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_BATCH_HPP
+#define SPIRV_CROSS_BATCH_HPP
+
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spirv_cross
+{
+enum class BatchBackend
+{
+	GLSL,
+	HLSL,
+	MSL,
+	Reflect
+};
+
+// One entry point to compile, and how to compile it.
+struct BatchEntryPoint
+{
+	std::string name;
+	spv::ExecutionModel model = spv::ExecutionModelMax;
+	BatchBackend backend = BatchBackend::GLSL;
+
+	// The common options apply to every backend except Reflect.
+	// The HLSL and MSL options only apply to their own backend.
+	CompilerGLSL::Options common;
+	CompilerHLSL::Options hlsl;
+	CompilerMSL::Options msl;
+
+	// Called after the entry point and options are set, right before compile().
+	// Use it for anything else the compiler needs, e.g. remapping or renaming.
+	// It runs on a worker thread, so it must only touch the compiler it is given.
+	std::function<void(CompilerGLSL &)> setup;
+};
+
+struct BatchResult
+{
+	std::string source;
+
+	// Reflection of the resources which are statically used by this entry point.
+	ShaderResources resources;
+
+	// Empty if the compile succeeded, otherwise the exception message and source is empty.
+	std::string error;
+};
+
+// Compiles every entry point in entry_points against the same ParsedIR, up to num_threads at a time.
+// Each compile gets its own copy-on-write view of ir (see ParsedIR(std::shared_ptr<const ParsedIR>)),
+// so the IR is only read, never modified, and the views only clone the objects their compile touches.
+// ir must not be modified while this runs.
+// If num_threads is 0, std::thread::hardware_concurrency() threads are used.
+// Results are returned in the same order as entry_points.
+std::vector<BatchResult> compile_entry_points(std::shared_ptr<const ParsedIR> ir,
+                                              const std::vector<BatchEntryPoint> &entry_points,
+                                              unsigned num_threads = 0);
+} // namespace spirv_cross
+
+#endif
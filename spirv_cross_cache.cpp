@@ -0,0 +1,421 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_cross_cache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+using namespace std;
+
+namespace spirv_cross
+{
+// Bump this whenever a change to SPIRV-Cross changes the output of any compile,
+// or the layout of an entry, so entries written by older versions are never returned.
+static const uint32_t CacheVersion = 1;
+
+static const uint32_t CacheMagic = 0x43435053; // "SPCC"
+static const uint32_t CacheHeaderWords = 4;
+
+CompileCacheKey::CompileCacheKey()
+{
+	// Start the two hashes apart, so they do not collide on the same inputs.
+	hi.u32(0x9e3779b9);
+	add(CacheVersion);
+}
+
+void CompileCacheKey::add(uint32_t value)
+{
+	lo.u32(value);
+	hi.u32(((value << 13) | (value >> 19)) * 0x85ebca6bu);
+}
+
+void CompileCacheKey::add(const string &str)
+{
+	add(uint32_t(str.size()));
+	for (size_t i = 0; i < str.size(); i += 4)
+	{
+		uint32_t word = 0;
+		for (size_t j = i; j < min(i + 4, str.size()); j++)
+			word |= uint32_t(uint8_t(str[j])) << (8 * (j - i));
+		add(word);
+	}
+}
+
+void CompileCacheKey::add(const uint32_t *words, size_t word_count)
+{
+	add(uint32_t(word_count));
+	for (size_t i = 0; i < word_count; i++)
+		add(words[i]);
+}
+
+void CompileCacheKey::add(const CompilerGLSL::Options &options)
+{
+	add(options.version);
+	add(options.es);
+	add(options.force_temporary);
+	add(options.vulkan_semantics);
+	add(options.separate_shader_objects);
+	add(options.flatten_multidimensional_arrays);
+	add(options.enable_420pack_extension);
+	add(options.vertex.fixup_clipspace);
+	add(options.vertex.flip_vert_y);
+	add(options.vertex.support_nonzero_base_instance);
+	add(options.fragment.default_float_precision);
+	add(options.fragment.default_int_precision);
+}
+
+void CompileCacheKey::add(const CompilerHLSL::Options &options)
+{
+	add(options.shader_model);
+	add(options.point_size_compat);
+	add(options.point_coord_compat);
+	add(options.support_nonzero_base_vertex_base_instance);
+}
+
+void CompileCacheKey::add(const CompilerMSL::Options &options)
+{
+	add(options.platform);
+	add(options.msl_version);
+	add(options.texel_buffer_texture_width);
+	add(options.aux_buffer_index);
+	add(options.indirect_params_buffer_index);
+	add(options.shader_output_buffer_index);
+	add(options.shader_patch_output_buffer_index);
+	add(options.shader_tess_factor_buffer_index);
+	add(options.shader_input_wg_index);
+	add(options.enable_point_size_builtin);
+	add(options.disable_rasterization);
+	add(options.capture_output_to_buffer);
+	add(options.swizzle_texture_samples);
+	add(options.tess_domain_origin_lower_left);
+	add(options.pad_fragment_output_components);
+}
+
+void CompileCacheKey::add(const HLSLVertexAttributeRemap &remap)
+{
+	add(remap.location);
+	add(remap.semantic);
+}
+
+void CompileCacheKey::add(const MSLVertexAttr &attr)
+{
+	add(attr.location);
+	add(attr.msl_buffer);
+	add(attr.msl_offset);
+	add(attr.msl_stride);
+	add(attr.per_instance);
+	add(attr.format);
+	add(attr.builtin);
+}
+
+void CompileCacheKey::add(const MSLResourceBinding &binding)
+{
+	add(binding.stage);
+	add(binding.desc_set);
+	add(binding.binding);
+	add(binding.msl_buffer);
+	add(binding.msl_texture);
+	add(binding.msl_sampler);
+}
+
+string CompileCacheKey::get() const
+{
+	char str[33];
+	sprintf(str, "%016llx%016llx", static_cast<unsigned long long>(hi.get()),
+	        static_cast<unsigned long long>(lo.get()));
+	return str;
+}
+
+namespace
+{
+struct CacheFile
+{
+	string path;
+	uint64_t size;
+	int64_t last_used;
+	bool temporary;
+};
+} // namespace
+
+// Temporary files older than this were left behind by a process which died in store(), and are deleted on eviction.
+// Younger ones may still be written, and are left alone.
+static const int64_t StaleTemporarySeconds = 60 * 60;
+
+// Entries are named <key>.spvc, and temporary files <key>.spvc.<pid>.<count>.tmp.
+// Anything else in the directory is left alone.
+static bool is_cache_file(const char *name, bool &temporary)
+{
+	for (int i = 0; i < 32; i++)
+		if (!isxdigit(static_cast<unsigned char>(name[i])))
+			return false;
+	if (strncmp(name + 32, ".spvc", 5) != 0)
+		return false;
+
+	temporary = name[37] != '\0';
+	if (!temporary)
+		return true;
+
+	size_t len = strlen(name);
+	return name[37] == '.' && len > 42 && strcmp(name + len - 4, ".tmp") == 0;
+}
+
+static string entry_path(const string &directory, const CompileCacheKey &key)
+{
+	return directory + "/" + key.get() + ".spvc";
+}
+
+#ifdef _WIN32
+static void make_directory(const string &path)
+{
+	_mkdir(path.c_str());
+}
+
+static void mark_used(const string &path)
+{
+	_utime(path.c_str(), nullptr);
+}
+
+static bool replace_file(const string &from, const string &to)
+{
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static uint32_t process_id()
+{
+	return uint32_t(_getpid());
+}
+
+// In the units of CacheFile::last_used, which are those of FILETIME.
+static int64_t stale_temporary_time()
+{
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	int64_t time = int64_t((uint64_t(now.dwHighDateTime) << 32) | now.dwLowDateTime);
+	return time - StaleTemporarySeconds * 10000000;
+}
+
+static vector<CacheFile> list_cache_files(const string &directory)
+{
+	vector<CacheFile> files;
+	WIN32_FIND_DATAA data;
+	HANDLE handle = FindFirstFileA((directory + "/*").c_str(), &data);
+	if (handle == INVALID_HANDLE_VALUE)
+		return files;
+
+	do
+	{
+		bool temporary;
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !is_cache_file(data.cFileName, temporary))
+			continue;
+
+		uint64_t size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		int64_t last_used = int64_t((uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) |
+		                            data.ftLastWriteTime.dwLowDateTime);
+		files.push_back({ directory + "/" + data.cFileName, size, last_used, temporary });
+	} while (FindNextFileA(handle, &data));
+
+	FindClose(handle);
+	return files;
+}
+#else
+static void make_directory(const string &path)
+{
+	mkdir(path.c_str(), 0777);
+}
+
+static void mark_used(const string &path)
+{
+	utime(path.c_str(), nullptr);
+}
+
+static bool replace_file(const string &from, const string &to)
+{
+	return rename(from.c_str(), to.c_str()) == 0;
+}
+
+static uint32_t process_id()
+{
+	return uint32_t(getpid());
+}
+
+// In the units of CacheFile::last_used, which are those of st_mtime.
+static int64_t stale_temporary_time()
+{
+	return int64_t(time(nullptr)) - StaleTemporarySeconds;
+}
+
+static vector<CacheFile> list_cache_files(const string &directory)
+{
+	vector<CacheFile> files;
+	DIR *dir = opendir(directory.c_str());
+	if (!dir)
+		return files;
+
+	while (auto *ent = readdir(dir))
+	{
+		bool temporary;
+		if (!is_cache_file(ent->d_name, temporary))
+			continue;
+
+		string path = directory + "/" + ent->d_name;
+		struct stat st;
+		if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+			files.push_back({ move(path), uint64_t(st.st_size), int64_t(st.st_mtime), temporary });
+	}
+
+	closedir(dir);
+	return files;
+}
+#endif
+
+CompileCache::CompileCache(string directory_, uint64_t max_size_)
+    : directory(move(directory_))
+    , max_size(max_size_)
+{
+	make_directory(directory);
+}
+
+bool CompileCache::load(const CompileCacheKey &key, CompileCacheEntry &entry) const
+{
+	auto name = key.get();
+	auto path = entry_path(directory, key);
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	// The header repeats the key, so a damaged or foreign file is never mistaken for an entry.
+	uint32_t header[CacheHeaderWords];
+	char stored_name[32];
+	bool valid = fread(header, sizeof(uint32_t), CacheHeaderWords, file) == CacheHeaderWords &&
+	             fread(stored_name, 1, sizeof(stored_name), file) == sizeof(stored_name) &&
+	             header[0] == CacheMagic && header[1] == CacheVersion &&
+	             memcmp(stored_name, name.data(), sizeof(stored_name)) == 0;
+
+	if (valid)
+	{
+		entry.source.resize(header[2]);
+		entry.reflection.resize(header[3]);
+		valid = fread(&entry.source[0], 1, entry.source.size(), file) == entry.source.size() &&
+		        fread(&entry.reflection[0], 1, entry.reflection.size(), file) == entry.reflection.size() &&
+		        fgetc(file) == EOF;
+	}
+	fclose(file);
+
+	if (!valid)
+	{
+		entry = {};
+		return false;
+	}
+
+	mark_used(path);
+	return true;
+}
+
+bool CompileCache::store(const CompileCacheKey &key, const CompileCacheEntry &entry)
+{
+	if (entry.source.size() > 0xffffffffu || entry.reflection.size() > 0xffffffffu)
+		return false;
+
+	static atomic<uint32_t> temp_count(0);
+	auto name = key.get();
+	auto path = entry_path(directory, key);
+	auto temp_path = join(path, ".", process_id(), ".", temp_count++, ".tmp");
+
+	FILE *file = fopen(temp_path.c_str(), "wb");
+	if (!file)
+		return false;
+
+	uint32_t header[CacheHeaderWords] = {
+		CacheMagic, CacheVersion, uint32_t(entry.source.size()), uint32_t(entry.reflection.size()),
+	};
+	bool success = fwrite(header, sizeof(uint32_t), CacheHeaderWords, file) == CacheHeaderWords &&
+	               fwrite(name.data(), 1, name.size(), file) == name.size() &&
+	               fwrite(entry.source.data(), 1, entry.source.size(), file) == entry.source.size() &&
+	               fwrite(entry.reflection.data(), 1, entry.reflection.size(), file) == entry.reflection.size();
+	success = fclose(file) == 0 && success;
+
+	if (!success || !replace_file(temp_path, path))
+	{
+		remove(temp_path.c_str());
+		return false;
+	}
+
+	uint64_t size = sizeof(header) + name.size() + entry.source.size() + entry.reflection.size();
+	lock_guard<mutex> holder(lock);
+	total_size += size;
+	if (!total_size_known || total_size > max_size)
+		evict();
+	return true;
+}
+
+void CompileCache::evict()
+{
+	// Temporary files are not entries. Other processes may still be writing theirs, so only stale ones go.
+	vector<CacheFile> files;
+	int64_t stale_time = stale_temporary_time();
+	for (auto &file : list_cache_files(directory))
+	{
+		if (!file.temporary)
+			files.push_back(move(file));
+		else if (file.last_used < stale_time)
+			remove(file.path.c_str());
+	}
+
+	total_size = 0;
+	for (auto &file : files)
+		total_size += file.size;
+	total_size_known = true;
+
+	if (total_size <= max_size)
+		return;
+
+	sort(begin(files), end(files),
+	     [](const CacheFile &a, const CacheFile &b) { return a.last_used < b.last_used; });
+
+	// Go well below the limit, so the next few stores do not have to list the directory again.
+	uint64_t target_size = max_size / 4 * 3;
+	for (auto &file : files)
+	{
+		if (total_size <= target_size)
+			break;
+		if (remove(file.path.c_str()) == 0)
+			total_size -= file.size;
+	}
+}
+} // namespace spirv_cross
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_CACHE_HPP
+#define SPIRV_CROSS_CACHE_HPP
+
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include <mutex>
+#include <string>
+
+namespace spirv_cross
+{
+// Identifies one compile. Everything which affects the output of the compile must be added to the key:
+// the SPIR-V module, the backend, every Options struct, and every remap or rename applied to the compiler.
+// Nothing is parsed to build a key, so a hit in CompileCache skips parsing as well as compiling.
+//
+// Every key starts out with the version of SPIRV-Cross, so entries written by another version never match.
+// The key is 128 bits, built from two differently seeded FNV hashes.
+class CompileCacheKey
+{
+public:
+	CompileCacheKey();
+
+	void add(uint32_t value);
+	void add(const std::string &str);
+	void add(const uint32_t *words, size_t word_count);
+
+	void add(const CompilerGLSL::Options &options);
+	void add(const CompilerHLSL::Options &options);
+	void add(const CompilerMSL::Options &options);
+	void add(const HLSLVertexAttributeRemap &remap);
+	void add(const MSLVertexAttr &attr);
+	void add(const MSLResourceBinding &binding);
+
+	// The key as 32 hex digits, which is also the file name of the entry.
+	std::string get() const;
+
+private:
+	Hasher lo;
+	Hasher hi;
+};
+
+struct CompileCacheEntry
+{
+	std::string source;
+
+	// Anything the application wants to keep along with the source, e.g. reflection as JSON.
+	std::string reflection;
+};
+
+// An on-disk cache of compile results, with one file per entry in a directory.
+// The directory may be shared by any number of threads and processes at once:
+// entries are written to a temporary file which is then renamed into place,
+// so a reader either sees a complete entry or no entry at all.
+//
+// Once the files in the directory grow past max_size bytes, the least recently used entries are deleted
+// until they take up three quarters of max_size. Loading an entry marks it as used.
+// Each CompileCache keeps a running total of what it wrote itself, and only lists the directory
+// when that total says it is full, so with several processes writing at once the limit is approximate.
+class CompileCache
+{
+public:
+	// The directory is created if it does not exist, but its parent must exist.
+	explicit CompileCache(std::string directory, uint64_t max_size = 256ull * 1024 * 1024);
+
+	// Returns false if there is no valid entry for key.
+	bool load(const CompileCacheKey &key, CompileCacheEntry &entry) const;
+
+	// Returns false if the entry could not be written. A failed store leaves the cache as it was.
+	bool store(const CompileCacheKey &key, const CompileCacheEntry &entry);
+
+	const std::string &get_directory() const
+	{
+		return directory;
+	}
+
+private:
+	std::string directory;
+	uint64_t max_size;
+
+	std::mutex lock;
+	uint64_t total_size = 0;
+	bool total_size_known = false;
+
+	void evict();
+};
+} // namespace spirv_cross
+
+#endif
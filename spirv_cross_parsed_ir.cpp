@@ -23,12 +23,146 @@ using namespace spv;
 
 namespace spirv_cross
 {
+// Out of line, so the copy stays out of every lookup.
+void MetaStore::unshare(size_t id)
+{
+	entries[id] = *shared[id];
+	shared[id] = nullptr;
+	if (--shared_count == 0)
+		shared.clear();
+}
+
+ParsedIR::ParsedIR()
+{
+	// Variants keep a pointer to the pool group,
+	// so it lives on the heap to stay put when the ParsedIR is moved.
+	pool_group.reset(new ObjectPoolGroup);
+}
+
+ParsedIR::ParsedIR(const ParsedIR &other)
+    : ParsedIR()
+{
+	*this = other;
+}
+
+ParsedIR::ParsedIR(ParsedIR &&other) SPIRV_CROSS_NOEXCEPT
+{
+	*this = move(other);
+}
+
+ParsedIR &ParsedIR::operator=(ParsedIR &&other) SPIRV_CROSS_NOEXCEPT
+{
+	if (this != &other)
+	{
+		// The ids must go before the pool group they were allocated from.
+		ids = move(other.ids);
+		pool_group = move(other.pool_group);
+
+		spirv = move(other.spirv);
+		meta = move(other.meta);
+		for (int i = 0; i < TypeCount; i++)
+			ids_for_type[i] = move(other.ids_for_type[i]);
+		ids_for_constant_or_type = move(other.ids_for_constant_or_type);
+		ids_for_constant_or_variable = move(other.ids_for_constant_or_variable);
+		declared_capabilities = move(other.declared_capabilities);
+		declared_extensions = move(other.declared_extensions);
+		block_meta = move(other.block_meta);
+		continue_block_to_loop_header = move(other.continue_block_to_loop_header);
+		entry_points = move(other.entry_points);
+		default_entry_point = other.default_entry_point;
+		source = other.source;
+		borrowed_spirv = other.borrowed_spirv;
+		borrowed_spirv_word_count = other.borrowed_spirv_word_count;
+		loop_iteration_depth = other.loop_iteration_depth;
+		shared_base = move(other.shared_base);
+		modification_count++;
+	}
+	return *this;
+}
+
+ParsedIR::ParsedIR(shared_ptr<const ParsedIR> base)
+    : ParsedIR()
+{
+	copy_non_id_members(*base);
+	meta.set_shared(base->meta);
+	set_borrowed_spirv(base->get_spirv_words(), base->get_spirv_word_count());
+
+	ids.reserve(base->ids.size());
+	for (auto &id : base->ids)
+	{
+		ids.emplace_back(pool_group.get());
+		ids.back().set_shared(id);
+	}
+
+	// If base is itself a view, the objects we refer to may live in its base, so keep the whole chain alive.
+	shared_base = move(base);
+}
+
+// Copies everything but ids, spirv and meta, which views share with their base instead.
+void ParsedIR::copy_non_id_members(const ParsedIR &other)
+{
+	for (int i = 0; i < TypeCount; i++)
+		ids_for_type[i] = other.ids_for_type[i];
+	ids_for_constant_or_type = other.ids_for_constant_or_type;
+	ids_for_constant_or_variable = other.ids_for_constant_or_variable;
+	declared_capabilities = other.declared_capabilities;
+	declared_extensions = other.declared_extensions;
+	block_meta = other.block_meta;
+	continue_block_to_loop_header = other.continue_block_to_loop_header;
+	entry_points = other.entry_points;
+	default_entry_point = other.default_entry_point;
+	source = other.source;
+	borrowed_spirv = other.borrowed_spirv;
+	borrowed_spirv_word_count = other.borrowed_spirv_word_count;
+	loop_iteration_depth = other.loop_iteration_depth;
+}
+
+ParsedIR &ParsedIR::operator=(const ParsedIR &other)
+{
+	if (this != &other)
+	{
+		copy_non_id_members(other);
+		spirv = other.spirv;
+
+		// Entries still shared with the base of other stay shared, as the base is kept alive below.
+		meta = other.meta;
+
+		// Very deliberate copying of IDs. There is no default copy constructor, nor a simple default constructor.
+		// Clone all the objects into our own pool group, which also materializes objects shared from a base.
+		ids.clear();
+		ids.reserve(other.ids.size());
+		for (size_t i = 0; i < other.ids.size(); i++)
+		{
+			ids.emplace_back(pool_group.get());
+			ids.back() = other.ids[i];
+		}
+
+		// Borrowed SPIR-V words may belong to the base of other.
+		shared_base = other.shared_base;
+		modification_count++;
+	}
+	return *this;
+}
+
 void ParsedIR::set_id_bounds(uint32_t bounds)
 {
-	ids.resize(bounds);
+	modification_count++;
+	ids.reserve(bounds);
+	while (ids.size() < bounds)
+		ids.emplace_back(pool_group.get());
+
+	meta.resize(bounds);
 	block_meta.resize(bounds);
 }
 
+void ParsedIR::set_borrowed_spirv(const uint32_t *words, size_t word_count)
+{
+	borrowed_spirv = words;
+	borrowed_spirv_word_count = words ? word_count : 0;
+	if (words)
+		spirv.clear();
+}
+
 static string ensure_valid_identifier(const string &name, bool member)
 {
 	// Functions in glslangValidator are mangled with name(<mangled> stuff.
@@ -87,6 +221,7 @@ const string &ParsedIR::get_member_name(uint32_t id, uint32_t index) const
 
 void ParsedIR::set_name(uint32_t id, const string &name)
 {
+	modification_count++;
 	auto &str = meta[id].decoration.alias;
 	str.clear();
 
@@ -102,6 +237,7 @@ void ParsedIR::set_name(uint32_t id, const string &name)
 
 void ParsedIR::set_member_name(uint32_t id, uint32_t index, const string &name)
 {
+	modification_count++;
 	meta[id].members.resize(max(meta[id].members.size(), size_t(index) + 1));
 
 	auto &str = meta[id].members[index].alias;
@@ -118,6 +254,7 @@ void ParsedIR::set_member_name(uint32_t id, uint32_t index, const string &name)
 
 void ParsedIR::set_decoration_string(uint32_t id, Decoration decoration, const string &argument)
 {
+	modification_count++;
 	auto &dec = meta[id].decoration;
 	dec.decoration_flags.set(decoration);
 
@@ -134,6 +271,7 @@ void ParsedIR::set_decoration_string(uint32_t id, Decoration decoration, const s
 
 void ParsedIR::set_decoration(uint32_t id, Decoration decoration, uint32_t argument)
 {
+	modification_count++;
 	auto &dec = meta[id].decoration;
 	dec.decoration_flags.set(decoration);
 
@@ -200,6 +338,7 @@ void ParsedIR::set_decoration(uint32_t id, Decoration decoration, uint32_t argum
 
 void ParsedIR::set_member_decoration(uint32_t id, uint32_t index, Decoration decoration, uint32_t argument)
 {
+	modification_count++;
 	meta[id].members.resize(max(meta[id].members.size(), size_t(index) + 1));
 	auto &dec = meta[id].members[index];
 	dec.decoration_flags.set(decoration);
@@ -376,6 +515,7 @@ const string &ParsedIR::get_decoration_string(uint32_t id, Decoration decoration
 
 void ParsedIR::unset_decoration(uint32_t id, Decoration decoration)
 {
+	modification_count++;
 	auto &dec = meta[id].decoration;
 	dec.decoration_flags.clear(decoration);
 	switch (decoration)
@@ -489,6 +629,7 @@ const Bitset &ParsedIR::get_decoration_bitset(uint32_t id) const
 
 void ParsedIR::set_member_decoration_string(uint32_t id, uint32_t index, Decoration decoration, const string &argument)
 {
+	modification_count++;
 	meta[id].members.resize(max(meta[id].members.size(), size_t(index) + 1));
 	auto &dec = meta[id].members[index];
 	dec.decoration_flags.set(decoration);
@@ -529,6 +670,7 @@ const string &ParsedIR::get_member_decoration_string(uint32_t id, uint32_t index
 
 void ParsedIR::unset_member_decoration(uint32_t id, uint32_t index, Decoration decoration)
 {
+	modification_count++;
 	auto &m = meta[id];
 	if (index >= m.members.size())
 		return;
@@ -569,19 +711,46 @@ void ParsedIR::unset_member_decoration(uint32_t id, uint32_t index, Decoration d
 
 uint32_t ParsedIR::increase_bound_by(uint32_t incr_amount)
 {
+	modification_count++;
 	auto curr_bound = ids.size();
 	auto new_bound = curr_bound + incr_amount;
-	ids.resize(new_bound);
+
+	for (uint32_t i = 0; i < incr_amount; i++)
+		ids.emplace_back(pool_group.get());
+
+	meta.resize(new_bound);
 	block_meta.resize(new_bound);
 	return uint32_t(curr_bound);
 }
 
 void ParsedIR::remove_typed_id(Types type, uint32_t id)
 {
+	modification_count++;
 	auto &type_ids = ids_for_type[type];
 	type_ids.erase(remove(begin(type_ids), end(type_ids), id), end(type_ids));
 }
 
+void ParsedIR::reset_ids(const unordered_set<uint32_t> &removed)
+{
+	if (loop_iteration_depth)
+		SPIRV_CROSS_THROW("Cannot reset IDs while looping over them.");
+
+	modification_count++;
+
+	auto is_removed = [&](uint32_t id) { return removed.count(id) != 0; };
+	auto erase_removed = [&](vector<uint32_t> &list) {
+		list.erase(remove_if(begin(list), end(list), is_removed), end(list));
+	};
+
+	for (auto &list : ids_for_type)
+		erase_removed(list);
+	erase_removed(ids_for_constant_or_type);
+	erase_removed(ids_for_constant_or_variable);
+
+	for (auto id : removed)
+		ids[id].reset();
+}
+
 void ParsedIR::reset_all_of_type(Types type)
 {
 	for (auto &id : ids_for_type[type])
@@ -591,25 +760,50 @@ void ParsedIR::reset_all_of_type(Types type)
 	ids_for_type[type].clear();
 }
 
+void ParsedIR::reset_all_of_type(Types type, size_t first_index)
+{
+	auto &type_ids = ids_for_type[type];
+	if (first_index >= type_ids.size())
+		return;
+
+	for (auto itr = begin(type_ids) + first_index; itr != end(type_ids); ++itr)
+		if (ids[*itr].get_type() == type)
+			ids[*itr].reset();
+
+	type_ids.resize(first_index);
+}
+
 void ParsedIR::add_typed_id(Types type, uint32_t id)
 {
 	if (loop_iteration_depth)
 		SPIRV_CROSS_THROW("Cannot add typed ID while looping over it.");
 
+	modification_count++;
+
+	// An ID which changes type, e.g. a specialization constant op which is folded into a constant,
+	// keeps its place in declaration order.
+	auto old_type = ids[id].get_type();
+	bool was_constant_or_variable = old_type == TypeConstant || old_type == TypeVariable;
+	bool was_constant_or_type = old_type == TypeConstant || old_type == TypeType || old_type == TypeConstantOp;
+
 	switch (type)
 	{
 	case TypeConstant:
-		ids_for_constant_or_variable.push_back(id);
-		ids_for_constant_or_type.push_back(id);
+		if (!was_constant_or_variable)
+			ids_for_constant_or_variable.push_back(id);
+		if (!was_constant_or_type)
+			ids_for_constant_or_type.push_back(id);
 		break;
 
 	case TypeVariable:
-		ids_for_constant_or_variable.push_back(id);
+		if (!was_constant_or_variable)
+			ids_for_constant_or_variable.push_back(id);
 		break;
 
 	case TypeType:
 	case TypeConstantOp:
-		ids_for_constant_or_type.push_back(id);
+		if (!was_constant_or_type)
+			ids_for_constant_or_type.push_back(id);
 		break;
 
 	default:
@@ -629,20 +823,14 @@ void ParsedIR::add_typed_id(Types type, uint32_t id)
 
 const Meta *ParsedIR::find_meta(uint32_t id) const
 {
-	auto itr = meta.find(id);
-	if (itr != end(meta))
-		return &itr->second;
-	else
-		return nullptr;
+	return id < meta.size() ? &meta[id] : nullptr;
 }
 
 Meta *ParsedIR::find_meta(uint32_t id)
 {
-	auto itr = meta.find(id);
-	if (itr != end(meta))
-		return &itr->second;
-	else
-		return nullptr;
+	// The caller may modify the meta through the pointer.
+	modification_count++;
+	return id < meta.size() ? &meta[id] : nullptr;
 }
 
 } // namespace spirv_cross
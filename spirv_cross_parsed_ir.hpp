@@ -20,11 +20,65 @@
 #include "spirv_common.hpp"
 #include <stdint.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace spirv_cross
 {
 
+// Holds the Meta of every ID, indexed directly by ID.
+// A store can share the entries of another one. As with Variant, const access reads a shared entry in place,
+// and an entry is only copied the first time it is accessed through the non-const operator[].
+class MetaStore
+{
+public:
+	Meta &operator[](size_t id)
+	{
+		if (shared_count != 0 && shared[id])
+			unshare(id);
+		return entries[id];
+	}
+
+	const Meta &operator[](size_t id) const
+	{
+		if (shared_count != 0 && shared[id])
+			return *shared[id];
+		return entries[id];
+	}
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+
+	void resize(size_t count)
+	{
+		entries.resize(count);
+		if (shared_count != 0)
+			shared.resize(count, nullptr);
+	}
+
+	// Refers to the entries of base instead of copying them.
+	// base must outlive this store and must not be modified in the meantime.
+	void set_shared(const MetaStore &base)
+	{
+		entries.clear();
+		entries.resize(base.entries.size());
+		shared.resize(base.entries.size());
+		for (size_t i = 0; i < shared.size(); i++)
+			shared[i] = base.shared_count != 0 && base.shared[i] ? base.shared[i] : &base.entries[i];
+		shared_count = shared.size();
+	}
+
+private:
+	std::vector<Meta> entries;
+	// Only looked at while shared_count is not 0, so stores which never shared anything skip it.
+	std::vector<const Meta *> shared;
+	size_t shared_count = 0;
+
+	void unshare(size_t id);
+};
+
 // This data structure holds all information needed to perform cross-compilation and reflection.
 // It is the output of the Parser, but any implementation could create this structure.
 // It is intentionally very "open" and struct-like with some helper functions to deal with decorations.
@@ -32,18 +86,56 @@ namespace spirv_cross
 
 class ParsedIR
 {
+private:
+	// This must be destroyed after the "ids" vector.
+	std::unique_ptr<ObjectPoolGroup> pool_group;
+
 public:
+	ParsedIR();
+
+	// Due to custom allocations from object pools, we cannot use a default copy constructor.
+	ParsedIR(const ParsedIR &other);
+	ParsedIR &operator=(const ParsedIR &other);
+
+	// Moves are unproblematic, as the pool group moves along with the Variants which refer to it.
+	ParsedIR(ParsedIR &&other) SPIRV_CROSS_NOEXCEPT;
+	ParsedIR &operator=(ParsedIR &&other) SPIRV_CROSS_NOEXCEPT;
+
+	// Creates a copy-on-write view of an immutable base, so one parse can feed many compilers cheaply.
+	// Nothing is cloned up front. Const access reads base in place. Each object in ids and each entry in meta
+	// is copied from base the first time it is accessed for writing, and the SPIR-V words are borrowed from base.
+	// The view keeps base alive.
+	explicit ParsedIR(std::shared_ptr<const ParsedIR> base);
+
 	// Resizes ids, meta and block_meta.
 	void set_id_bounds(uint32_t bounds);
 
 	// The raw SPIR-V, instructions and opcodes refer to this by offset + count.
+	// This is empty if the SPIR-V words are borrowed from the caller, see set_borrowed_spirv().
 	std::vector<uint32_t> spirv;
 
+	// References SPIR-V words owned by someone else, e.g. a memory mapped file, instead of copying them into spirv.
+	// The buffer must remain valid and unmodified for as long as this ParsedIR, or any Compiler created from it, is alive.
+	// Pass nullptr to go back to using spirv.
+	void set_borrowed_spirv(const uint32_t *words, size_t word_count);
+
+	// The SPIR-V words which instructions refer to, either owned or borrowed.
+	const uint32_t *get_spirv_words() const
+	{
+		return borrowed_spirv ? borrowed_spirv : spirv.data();
+	}
+
+	size_t get_spirv_word_count() const
+	{
+		return borrowed_spirv ? borrowed_spirv_word_count : spirv.size();
+	}
+
 	// Holds various data structures which inherit from IVariant.
 	std::vector<Variant> ids;
 
 	// Various meta data for IDs, decorations, names, etc.
-	std::unordered_map<uint32_t, Meta> meta;
+	// Indexed directly by ID and always sized to the ID bound, so lookups never hash.
+	MetaStore meta;
 
 	// Holds all IDs which have a certain type.
 	// This is needed so we can iterate through a specific kind of resource quickly,
@@ -126,6 +218,9 @@ public:
 	void add_typed_id(Types type, uint32_t id);
 	void remove_typed_id(Types type, uint32_t id);
 
+	// Resets the IDs and drops them from the lists of IDs by type, e.g. once they turn out to be unused.
+	void reset_ids(const std::unordered_set<uint32_t> &removed);
+
 	template <typename T, typename Op>
 	void for_each_typed_id(const Op &op)
 	{
@@ -156,6 +251,9 @@ public:
 
 	void reset_all_of_type(Types type);
 
+	// Only resets the IDs which were added to ids_for_type[type] after the first first_index ones.
+	void reset_all_of_type(Types type, size_t first_index);
+
 	Meta *find_meta(uint32_t id);
 	const Meta *find_meta(uint32_t id) const;
 
@@ -164,6 +262,19 @@ public:
 		return empty_string;
 	}
 
+	// Counts the modifications made through the methods of ParsedIR, and through mark_modified().
+	// Code which changes the IR some other way, e.g. by writing to meta or an object directly,
+	// must call mark_modified() if reflection could observe the change. See Compiler::get_shader_resources().
+	uint64_t get_modification_count() const
+	{
+		return modification_count;
+	}
+
+	void mark_modified()
+	{
+		modification_count++;
+	}
+
 private:
 	template <typename T>
 	T &get(uint32_t id)
@@ -177,7 +288,16 @@ private:
 		return variant_get<T>(ids[id]);
 	}
 
+	void copy_non_id_members(const ParsedIR &other);
+
+	const uint32_t *borrowed_spirv = nullptr;
+	size_t borrowed_spirv_word_count = 0;
+
+	// Set for copy-on-write views. ids may refer to objects owned by this base.
+	std::shared_ptr<const ParsedIR> shared_base;
+
 	uint32_t loop_iteration_depth = 0;
+	uint64_t modification_count = 0;
 	std::string empty_string;
 	Bitset cleared_bitset;
 };
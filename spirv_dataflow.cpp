@@ -0,0 +1,207 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_dataflow.hpp"
+#include "spirv_cfg.hpp"
+
+using namespace std;
+
+namespace spirv_cross
+{
+DenseBitset::DenseBitset(uint32_t count_, bool value)
+    : count(count_)
+{
+	words.resize((count + 63) / 64);
+	reset(value);
+}
+
+void DenseBitset::reset(bool value)
+{
+	for (auto &word : words)
+		word = value ? ~0ull : 0ull;
+
+	// Keep the bits past the end clear, so comparisons and counts do not need to mask them.
+	if (value && (count & 63))
+		words.back() &= (1ull << (count & 63)) - 1;
+}
+
+bool DenseBitset::merge_and(const DenseBitset &other)
+{
+	uint64_t changed = 0;
+	for (size_t i = 0; i < words.size(); i++)
+	{
+		uint64_t word = words[i] & other.words[i];
+		changed |= word ^ words[i];
+		words[i] = word;
+	}
+	return changed != 0;
+}
+
+bool DenseBitset::merge_or(const DenseBitset &other)
+{
+	uint64_t changed = 0;
+	for (size_t i = 0; i < words.size(); i++)
+	{
+		uint64_t word = words[i] | other.words[i];
+		changed |= word ^ words[i];
+		words[i] = word;
+	}
+	return changed != 0;
+}
+
+void DenseBitset::merge_and_not(const DenseBitset &other)
+{
+	for (size_t i = 0; i < words.size(); i++)
+		words[i] &= ~other.words[i];
+}
+
+bool DenseBitset::empty() const
+{
+	for (auto word : words)
+		if (word)
+			return false;
+	return true;
+}
+
+uint32_t DenseBitset::count_bits() const
+{
+	uint32_t bits = 0;
+	for_each_bit([&](uint32_t) { bits++; });
+	return bits;
+}
+
+BlockDataflow::BlockDataflow(const CFG &cfg_, Direction direction_, Meet meet_, uint32_t bit_count)
+    : cfg(cfg_)
+    , direction(direction_)
+    , meet(meet_)
+    , gen(cfg.get_block_count(), DenseBitset(bit_count))
+    , kill(cfg.get_block_count(), DenseBitset(bit_count))
+    , input(cfg.get_block_count(), DenseBitset(bit_count))
+    , output(cfg.get_block_count(), DenseBitset(bit_count, meet == Intersection))
+    , boundary(bit_count)
+{
+}
+
+bool BlockDataflow::is_boundary(uint32_t block) const
+{
+	if (direction == Forward)
+		return block == cfg.get_function().entry_block;
+	else
+		return cfg.get_succeeding_edges(block).empty();
+}
+
+void BlockDataflow::solve()
+{
+	uint32_t count = cfg.get_block_count();
+	vector<uint32_t> worklist;
+	vector<bool> queued(count);
+	worklist.reserve(count);
+
+	const auto push = [&](uint32_t index) {
+		if (!queued[index])
+		{
+			queued[index] = true;
+			worklist.push_back(index);
+		}
+	};
+
+	// Visit blocks in the order which needs the fewest passes, reverse post-order for forward problems,
+	// and post-order for backward ones. Blocks the entry does not reach come last.
+	auto &post_order = cfg.get_post_order();
+	for (size_t i = 0; i < post_order.size(); i++)
+		push(cfg.get_block_index(post_order[direction == Forward ? post_order.size() - 1 - i : i]));
+	for (uint32_t i = 0; i < count; i++)
+		push(i);
+
+	DenseBitset next;
+	size_t head = 0;
+	while (head < worklist.size())
+	{
+		uint32_t index = worklist[head++];
+		if (head == worklist.size())
+		{
+			worklist.clear();
+			head = 0;
+		}
+		queued[index] = false;
+
+		uint32_t block = cfg.get_block_id(index);
+		auto neighbours = direction == Forward ? cfg.get_preceding_edges(block) : cfg.get_succeeding_edges(block);
+		auto &in = input[index];
+
+		if (is_boundary(block))
+			in = boundary;
+		else if (neighbours.empty())
+			in.reset(meet == Intersection);
+		else
+		{
+			in = output[cfg.get_block_index(neighbours.front())];
+			for (size_t i = 1; i < neighbours.size(); i++)
+			{
+				auto &other = output[cfg.get_block_index(neighbours[i])];
+				if (meet == Union)
+					in.merge_or(other);
+				else
+					in.merge_and(other);
+			}
+		}
+
+		next = in;
+		next.merge_and_not(kill[index]);
+		next.merge_or(gen[index]);
+		if (next == output[index])
+			continue;
+
+		swap(output[index], next);
+
+		// Everything which reads our output has to be looked at again.
+		auto dependents = direction == Forward ? cfg.get_succeeding_edges(block) : cfg.get_preceding_edges(block);
+		for (auto dependent : dependents)
+			push(cfg.get_block_index(dependent));
+	}
+}
+
+LivenessAnalysis::LivenessAnalysis(const CFG &cfg, uint32_t variable_count)
+    : dataflow(cfg, BlockDataflow::Backward, BlockDataflow::Union, variable_count)
+{
+}
+
+ReachingDefinitions::ReachingDefinitions(const CFG &cfg_, Mode mode_, uint32_t definition_count_)
+    : cfg(cfg_)
+    , mode(mode_)
+    , definition_count(definition_count_)
+    , dataflow(cfg, BlockDataflow::Forward,
+               mode == MayReach ? BlockDataflow::Union : BlockDataflow::Intersection, definition_count_)
+{
+}
+
+DenseBitset ReachingDefinitions::get_reaching_exit() const
+{
+	uint32_t count = cfg.get_block_count();
+	DenseBitset exit(definition_count, mode == MustReach);
+	for (uint32_t index = 0; index < count; index++)
+	{
+		if (!cfg.get_succeeding_edges(cfg.get_block_id(index)).empty())
+			continue;
+
+		if (mode == MayReach)
+			exit.merge_or(get_reaching_out(index));
+		else
+			exit.merge_and(get_reaching_out(index));
+	}
+	return exit;
+}
+} // namespace spirv_cross
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_DATAFLOW_HPP
+#define SPIRV_CROSS_DATAFLOW_HPP
+
+#include "spirv_common.hpp"
+
+namespace spirv_cross
+{
+class CFG;
+
+// A set of small integers of a fixed range, e.g. block or variable indices, packed into 64-bit words.
+// Unlike Bitset, which is tuned for sparse decoration flags, every word is stored, so all operations are linear scans.
+class DenseBitset
+{
+public:
+	DenseBitset() = default;
+	explicit DenseBitset(uint32_t count, bool value = false);
+
+	uint32_t size() const
+	{
+		return count;
+	}
+
+	bool get(uint32_t bit) const
+	{
+		return (words[bit >> 6] & (1ull << (bit & 63))) != 0;
+	}
+
+	void set(uint32_t bit)
+	{
+		words[bit >> 6] |= 1ull << (bit & 63);
+	}
+
+	void clear(uint32_t bit)
+	{
+		words[bit >> 6] &= ~(1ull << (bit & 63));
+	}
+
+	// Sets all bits to value.
+	void reset(bool value = false);
+
+	// Both return whether any bit changed. The other set must have the same size.
+	bool merge_and(const DenseBitset &other);
+	bool merge_or(const DenseBitset &other);
+
+	// Clears the bits which are set in other.
+	void merge_and_not(const DenseBitset &other);
+
+	bool empty() const;
+	uint32_t count_bits() const;
+
+	bool operator==(const DenseBitset &other) const
+	{
+		return count == other.count && words == other.words;
+	}
+
+	bool operator!=(const DenseBitset &other) const
+	{
+		return !(*this == other);
+	}
+
+	// Visits set bits in ascending order.
+	template <typename Op>
+	void for_each_bit(const Op &op) const
+	{
+		for (size_t i = 0; i < words.size(); i++)
+		{
+			uint64_t bits = words[i];
+			while (bits)
+			{
+				uint32_t bit = trailing_zeroes(bits);
+				op(uint32_t(i << 6) + bit);
+				bits &= bits - 1;
+			}
+		}
+	}
+
+private:
+	std::vector<uint64_t> words;
+	uint32_t count = 0;
+};
+
+// Solves a bit vector dataflow problem over the blocks of a CFG with a worklist, using the dense block indices.
+// Every block has a transfer function out = gen | (in & ~kill), and the input of a block is the meet of the outputs
+// of its predecessors for forward problems, or of its successors for backward problems.
+//
+// LivenessAnalysis and ReachingDefinitions below set up the two common problems, use those where they fit.
+//
+// The CFG has no back edges, but loop headers have an edge to their merge block, so this iterates to a fixed point
+// rather than relying on a single pass.
+class BlockDataflow
+{
+public:
+	enum Direction
+	{
+		Forward,
+		Backward
+	};
+
+	enum Meet
+	{
+		Union,
+		Intersection
+	};
+
+	// All gen and kill sets start out empty.
+	BlockDataflow(const CFG &cfg, Direction direction, Meet meet, uint32_t bit_count);
+
+	// Indexed by CFG::get_block_index().
+	DenseBitset &get_gen(uint32_t block_index)
+	{
+		return gen[block_index];
+	}
+
+	DenseBitset &get_kill(uint32_t block_index)
+	{
+		return kill[block_index];
+	}
+
+	// The input of the entry block for forward problems, and of the blocks without successors for backward problems.
+	// Empty unless set.
+	void set_boundary(const DenseBitset &value)
+	{
+		boundary = value;
+	}
+
+	void solve();
+
+	// The meet of the neighbours, which is the state at the start of the block for forward problems,
+	// or at the end for backward problems.
+	const DenseBitset &get_input(uint32_t block_index) const
+	{
+		return input[block_index];
+	}
+
+	// The state after the transfer function of the block.
+	const DenseBitset &get_output(uint32_t block_index) const
+	{
+		return output[block_index];
+	}
+
+private:
+	const CFG &cfg;
+	Direction direction;
+	Meet meet;
+	std::vector<DenseBitset> gen;
+	std::vector<DenseBitset> kill;
+	std::vector<DenseBitset> input;
+	std::vector<DenseBitset> output;
+	DenseBitset boundary;
+
+	bool is_boundary(uint32_t block) const;
+};
+
+// Liveness of a set of variables, where a variable is live at a point if some path from there reads it before
+// writing it. Works on whole blocks, so a block which both reads and writes a variable counts as reading it first.
+class LivenessAnalysis
+{
+public:
+	LivenessAnalysis(const CFG &cfg, uint32_t variable_count);
+
+	// The block reads the variable.
+	void add_use(uint32_t block_index, uint32_t variable)
+	{
+		dataflow.get_gen(block_index).set(variable);
+	}
+
+	// The block completely overwrites the variable.
+	void add_definition(uint32_t block_index, uint32_t variable)
+	{
+		dataflow.get_kill(block_index).set(variable);
+	}
+
+	void solve()
+	{
+		dataflow.solve();
+	}
+
+	// The variables which are live at the start of the block.
+	const DenseBitset &get_live_in(uint32_t block_index) const
+	{
+		return dataflow.get_output(block_index);
+	}
+
+	// The variables which are live at the end of the block.
+	const DenseBitset &get_live_out(uint32_t block_index) const
+	{
+		return dataflow.get_input(block_index);
+	}
+
+private:
+	BlockDataflow dataflow;
+};
+
+// Reaching definitions, with one bit per definition.
+// MayReach finds the definitions which reach a point on some path from the entry, MustReach the ones which reach it
+// on every path. With one definition per block and no kills, a definition must reach exactly the blocks which its own
+// block strictly dominates, which makes this a way to check dominance for many blocks at once.
+class ReachingDefinitions
+{
+public:
+	enum Mode
+	{
+		MayReach,
+		MustReach
+	};
+
+	ReachingDefinitions(const CFG &cfg, Mode mode, uint32_t definition_count);
+
+	// The definition is made in the block, and is not killed after that in the same block.
+	void add_definition(uint32_t block_index, uint32_t definition)
+	{
+		dataflow.get_gen(block_index).set(definition);
+	}
+
+	// The block kills the definition, e.g. by writing the same variable again.
+	void add_kill(uint32_t block_index, uint32_t definition)
+	{
+		dataflow.get_kill(block_index).set(definition);
+	}
+
+	void solve()
+	{
+		dataflow.solve();
+	}
+
+	// The definitions which reach the start of the block.
+	const DenseBitset &get_reaching_in(uint32_t block_index) const
+	{
+		return dataflow.get_input(block_index);
+	}
+
+	// The definitions which reach the end of the block.
+	const DenseBitset &get_reaching_out(uint32_t block_index) const
+	{
+		return dataflow.get_output(block_index);
+	}
+
+	// The definitions which reach the end of the function, the meet over all blocks without successors.
+	// If there are no such blocks, this is empty for MayReach and full for MustReach.
+	DenseBitset get_reaching_exit() const;
+
+private:
+	const CFG &cfg;
+	Mode mode;
+	uint32_t definition_count;
+	BlockDataflow dataflow;
+};
+} // namespace spirv_cross
+
+#endif
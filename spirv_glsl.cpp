@@ -252,7 +252,9 @@ void CompilerGLSL::reset()
 	// We do some speculative optimizations which should pretty much always work out,
 	// but just in case the SPIR-V is rather weird, recompile until it's happy.
 	// This typically only means one extra pass.
-	force_recompile = false;
+	clear_force_recompile();
+	recompile_statistics.full_passes++;
+	begin_emit_pass_statistics();
 
 	// Clear invalid expression tracking.
 	invalid_expressions.clear();
@@ -276,6 +278,7 @@ void CompilerGLSL::reset()
 
 	statement_count = 0;
 	indent = 0;
+	specialization_constant_declarations.clear();
 }
 
 void CompilerGLSL::remap_pls_variables()
@@ -387,9 +390,115 @@ void CompilerGLSL::find_static_extensions()
 
 string CompilerGLSL::compile()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
+	recompile_statistics = RecompileStatistics();
+	begin_compile_statistics();
 
+	// Compiling changes the IR in place, so reflection cached before or during the compile is stale after it.
+	ir.mark_modified();
+	compiled_modification_count = UINT64_MAX;
+	emit_source();
+	ir.mark_modified();
+	compiled_modification_count = ir.get_modification_count();
+
+	end_compile_statistics(buffer.size());
+	return buffer.str();
+}
+
+void CompilerGLSL::compile_to(OutputSink &sink)
+{
+	recompile_statistics = RecompileStatistics();
+	begin_compile_statistics();
+	ir.mark_modified();
+	compiled_modification_count = UINT64_MAX;
+	emit_source();
+	ir.mark_modified();
+	compiled_modification_count = ir.get_modification_count();
+	end_compile_statistics(buffer.size());
+	buffer.for_each_block([&](const char *data, size_t size) { sink.write(data, size); });
+}
+
+bool CompilerGLSL::respecialize(const vector<SpecializationConstantValue> &values, string &source)
+{
+	// The last source can only be patched if it is complete and nothing was changed since.
+	if (buffer.empty() || compiled_modification_count != ir.get_modification_count())
+		return false;
+
+	if (!specialization_constants_used_by_value_valid)
+	{
+		find_specialization_constants_used_by_value(specialization_constants_used_by_value);
+		specialization_constants_used_by_value_valid = true;
+	}
+
+	vector<uint32_t> changed;
+	for (auto &value : values)
+	{
+		auto *c = maybe_get<SPIRConstant>(value.id);
+		if (!c || !c->specialization || !c->subconstants.empty() || c->columns() != 1 || c->vector_size() != 1)
+			SPIRV_CROSS_THROW("respecialize() only accepts scalar specialization constants.");
+
+		bool is_64bit = get<SPIRType>(c->constant_type).width > 32;
+		if (is_64bit ? c->scalar_u64() == value.value : c->scalar() == uint32_t(value.value))
+			continue;
+
+		if (!specialization_constant_declarations.count(value.id) ||
+		    specialization_constants_used_by_value.count(value.id))
+			return false;
+
+		changed.push_back(value.id);
+	}
+
+	for (auto &value : values)
+	{
+		auto &c = get<SPIRConstant>(value.id);
+		if (get<SPIRType>(c.constant_type).width > 32)
+			c.m.c[0].r[0].u64 = value.value;
+		else
+			c.m.c[0].r[0].u32 = uint32_t(value.value);
+	}
+
+	recompile_statistics = RecompileStatistics();
+	begin_compile_statistics();
+
+	// Replace the changed declarations in order, and move every declaration behind them.
+	vector<pair<size_t, uint32_t>> declarations;
+	declarations.reserve(specialization_constant_declarations.size());
+	for (auto &declaration : specialization_constant_declarations)
+		declarations.push_back({ declaration.second.offset, declaration.first });
+	sort(begin(declarations), end(declarations));
+	sort(begin(changed), end(changed));
+
+	string old_source = buffer.str();
+	source.clear();
+	source.reserve(old_source.size());
+	size_t copied = 0;
+
+	for (auto &declaration : declarations)
+	{
+		auto &range = specialization_constant_declarations[declaration.second];
+		source.append(old_source, copied, range.offset - copied);
+		copied = range.offset;
+		range.offset = source.size();
+
+		if (binary_search(begin(changed), end(changed), declaration.second))
+		{
+			buffer.reset();
+			emit_specialization_constant(get<SPIRConstant>(declaration.second));
+			buffer.for_each_block([&](const char *data, size_t size) { source.append(data, size); });
+			copied += range.size;
+			range.size = buffer.size();
+			recompile_statistics.respecialized_constants++;
+		}
+	}
+	source.append(old_source, copied, string::npos);
+
+	buffer.reset();
+	buffer.append(source.data(), source.size());
+	end_compile_statistics(buffer.size());
+	return true;
+}
+
+void CompilerGLSL::emit_source()
+{
 	if (options.vulkan_semantics)
 		backend.allow_precision_qualifiers = true;
 	backend.force_gl_in_out_block = true;
@@ -410,8 +519,7 @@ string CompilerGLSL::compile()
 
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
 
 		emit_header();
 		emit_resources();
@@ -419,17 +527,15 @@ string CompilerGLSL::compile()
 		emit_function(get<SPIRFunction>(ir.default_entry_point), Bitset());
 
 		pass_count++;
-	} while (force_recompile);
+	} while (is_forcing_recompilation());
 
 	// Entry point in GLSL is always main().
 	get_entry_point().name = "main";
-
-	return buffer->str();
 }
 
 std::string CompilerGLSL::get_partial_source()
 {
-	return buffer ? buffer->str() : "No compiled source available yet.";
+	return buffer.empty() ? "No compiled source available yet." : buffer.str();
 }
 
 void CompilerGLSL::build_workgroup_size(vector<string> &arguments, const SpecializationConstant &wg_x,
@@ -1517,8 +1623,8 @@ void CompilerGLSL::emit_buffer_block_native(const SPIRVariable &var)
 	// Shaders never use the block by interface name, so we don't
 	// have to track this other than updating name caches.
 	// If we have a collision for any reason, just fallback immediately.
-	if (ir.meta[type.self].decoration.alias.empty() || block_namespace.find(buffer_name) != end(block_namespace) ||
-	    resource_names.find(buffer_name) != end(resource_names))
+	if (ir.meta[type.self].decoration.alias.empty() || block_namespace.contains(name_interner, buffer_name) ||
+	    resource_names.contains(name_interner, buffer_name))
 	{
 		buffer_name = get_block_fallback_name(var.self);
 	}
@@ -1533,8 +1639,8 @@ void CompilerGLSL::emit_buffer_block_native(const SPIRVariable &var)
 	if (buffer_name.empty())
 		buffer_name = join("_", get<SPIRType>(var.basetype).self, "_", var.self);
 
-	block_names.insert(buffer_name);
-	block_namespace.insert(buffer_name);
+	block_names.insert(name_interner, buffer_name);
+	block_namespace.insert(name_interner, buffer_name);
 
 	// Save for post-reflection later.
 	declared_block_names[var.self] = buffer_name;
@@ -1687,10 +1793,10 @@ void CompilerGLSL::emit_interface_block(const SPIRVariable &var)
 
 			// Shaders never use the block by interface name, so we don't
 			// have to track this other than updating name caches.
-			if (block_name.empty() || block_namespace.find(block_name) != end(block_namespace))
+			if (block_name.empty() || block_namespace.contains(name_interner, block_name))
 				block_name = get_fallback_name(type.self);
 			else
-				block_namespace.insert(block_name);
+				block_namespace.insert(name_interner, block_name);
 
 			// If for some reason buffer_name is an illegal name, make a final fallback to a workaround name.
 			// This cannot conflict with anything else, so we're safe now.
@@ -1698,7 +1804,7 @@ void CompilerGLSL::emit_interface_block(const SPIRVariable &var)
 				block_name = join("_", get<SPIRType>(var.basetype).self, "_", var.self);
 
 			// Instance names cannot alias block names.
-			resource_names.insert(block_name);
+			resource_names.insert(name_interner, block_name);
 
 			statement(layout_for_variable(var), qual, block_name);
 			begin_scope();
@@ -1827,6 +1933,21 @@ void CompilerGLSL::emit_constant(const SPIRConstant &constant)
 	}
 }
 
+void CompilerGLSL::declare_specialization_constant(SPIRConstant &constant)
+{
+	size_t offset = buffer.size();
+	emit_specialization_constant(constant);
+	specialization_constant_declarations[constant.self] = { offset, buffer.size() - offset };
+}
+
+void CompilerGLSL::emit_specialization_constant(SPIRConstant &constant)
+{
+	if (!options.vulkan_semantics)
+		constant.specialization_constant_macro_name =
+		    constant_value_macro_name(get_decoration(constant.self, DecorationSpecId));
+	emit_constant(constant);
+}
+
 void CompilerGLSL::emit_entry_point_declarations()
 {
 }
@@ -2221,12 +2342,10 @@ void CompilerGLSL::emit_resources()
 
 			if (needs_declaration)
 			{
-				if (!options.vulkan_semantics && c.specialization)
-				{
-					c.specialization_constant_macro_name =
-					    constant_value_macro_name(get_decoration(c.self, DecorationSpecId));
-				}
-				emit_constant(c);
+				if (c.specialization)
+					declare_specialization_constant(c);
+				else
+					emit_constant(c);
 				emitted = true;
 			}
 		}
@@ -2392,7 +2511,7 @@ void CompilerGLSL::handle_invalid_expression(uint32_t id)
 	// We tried to read an invalidated expression.
 	// This means we need another pass at compilation, but next time, force temporary variables so that they cannot be invalidated.
 	forced_temporaries.insert(id);
-	force_recompile = true;
+	force_recompile(RecompileExpressionInvalidated);
 }
 
 // Converts the format of the current expression from packed to unpacked,
@@ -2603,7 +2722,7 @@ string CompilerGLSL::to_expression(uint32_t id, bool register_expression_read)
 		}
 		else
 		{
-			if (force_recompile)
+			if (is_forcing_recompilation())
 			{
 				// During first compilation phase, certain expression patterns can trigger exponential growth of memory.
 				// Avoid this by returning dummy expressions during this phase.
@@ -3538,7 +3657,7 @@ string CompilerGLSL::declare_temporary(uint32_t result_type, uint32_t result_id)
 		{
 			header.declare_temporary.emplace_back(result_type, result_id);
 			hoisted_temporaries.insert(result_id);
-			force_recompile = true;
+			force_recompile(RecompileTemporaryHoisted);
 		}
 
 		return join(to_name(result_id), " = ");
@@ -6403,7 +6522,7 @@ void CompilerGLSL::track_expression_read(uint32_t id)
 
 			forced_temporaries.insert(id);
 			// Force a recompile after this pass to avoid forwarding this variable.
-			force_recompile = true;
+			force_recompile(RecompileExpressionReadTwice);
 		}
 	}
 }
@@ -6732,7 +6851,7 @@ void CompilerGLSL::disallow_forwarding_in_expression_chain(const SPIRExpression
 	if (forwarded_temporaries.count(expr.self))
 	{
 		forced_temporaries.insert(expr.self);
-		force_recompile = true;
+		force_recompile(RecompileForwardingDisallowed);
 	}
 
 	for (auto &dependent : expr.expression_dependencies)
@@ -8275,7 +8394,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 			if (flags.get(DecorationNonReadable))
 			{
 				flags.clear(DecorationNonReadable);
-				force_recompile = true;
+				force_recompile(RecompileImageAccess);
 			}
 		}
 
@@ -8423,7 +8542,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 			if (flags.get(DecorationNonWritable))
 			{
 				flags.clear(DecorationNonWritable);
-				force_recompile = true;
+				force_recompile(RecompileImageAccess);
 			}
 		}
 
@@ -9549,8 +9668,7 @@ string CompilerGLSL::type_to_glsl(const SPIRType &type, uint32_t id)
 	}
 }
 
-void CompilerGLSL::add_variable(unordered_set<string> &variables_primary,
-                                const unordered_set<string> &variables_secondary, string &name)
+void CompilerGLSL::add_variable(NameCache &variables_primary, const NameCache &variables_secondary, string &name)
 {
 	if (name.empty())
 		return;
@@ -9600,7 +9718,7 @@ void CompilerGLSL::require_extension_internal(const string &ext)
 	if (backend.supports_extensions && !has_extension(ext))
 	{
 		forced_extensions.push_back(ext);
-		force_recompile = true;
+		force_recompile(RecompileHeaderLine);
 	}
 }
 
@@ -9639,7 +9757,7 @@ bool CompilerGLSL::check_atomic_image(uint32_t id)
 			{
 				flags.clear(DecorationNonWritable);
 				flags.clear(DecorationNonReadable);
-				force_recompile = true;
+				force_recompile(RecompileImageAccess);
 			}
 		}
 		return true;
@@ -9650,6 +9768,13 @@ bool CompilerGLSL::check_atomic_image(uint32_t id)
 
 void CompilerGLSL::add_function_overload(const SPIRFunction &func)
 {
+	// When a function is emitted again after a recompile request, it keeps the name it got the first time.
+	if (emitting_function_again)
+	{
+		resource_names.insert(name_interner, to_name(func.self));
+		return;
+	}
+
 	Hasher hasher;
 	for (auto &arg : func.arguments)
 	{
@@ -9676,8 +9801,7 @@ void CompilerGLSL::add_function_overload(const SPIRFunction &func)
 	}
 	uint64_t types_hash = hasher.get();
 
-	auto function_name = to_name(func.self);
-	auto itr = function_overloads.find(function_name);
+	auto itr = function_overloads.find(name_interner.intern(to_name(func.self)));
 	if (itr != end(function_overloads))
 	{
 		// There exists a function with this name already.
@@ -9686,7 +9810,7 @@ void CompilerGLSL::add_function_overload(const SPIRFunction &func)
 		{
 			// Overload conflict, assign a new name.
 			add_resource_name(func.self);
-			function_overloads[to_name(func.self)].insert(types_hash);
+			function_overloads[name_interner.intern(to_name(func.self))].insert(types_hash);
 		}
 		else
 		{
@@ -9698,7 +9822,7 @@ void CompilerGLSL::add_function_overload(const SPIRFunction &func)
 	{
 		// First time we see this function name.
 		add_resource_name(func.self);
-		function_overloads[to_name(func.self)].insert(types_hash);
+		function_overloads[name_interner.intern(to_name(func.self))].insert(types_hash);
 	}
 }
 
@@ -9795,6 +9919,53 @@ void CompilerGLSL::emit_function(SPIRFunction &func, const Bitset &return_flags)
 		}
 	}
 
+	// Most recompile requests only change how this function is emitted, e.g. an expression which must become
+	// a temporary. The functions we call are done by now, so rewind the output and the expression state
+	// to this point and emit this function again, instead of running another pass over the whole shader.
+	size_t output_begin = buffer.size();
+	uint32_t indent_begin = indent;
+	size_t expressions_begin = ir.ids_for_type[TypeExpression].size();
+	size_t access_chains_begin = ir.ids_for_type[TypeAccessChain].size();
+	size_t resource_names_begin = resource_names.size();
+	size_t block_names_begin = block_names.size();
+
+	for (uint32_t attempt = 0;; attempt++)
+	{
+		can_recompile_function = true;
+		emit_function_body(func, return_flags);
+		can_recompile_function = false;
+
+		if (!recompile_function || recompile_all)
+			break;
+
+		if (attempt >= 2)
+			SPIRV_CROSS_THROW("Over 3 compilation loops detected. Must be a bug!");
+
+		recompile_function = false;
+		recompile_statistics.function_passes++;
+
+		buffer.truncate(output_begin);
+		indent = indent_begin;
+
+		invalid_expressions.clear();
+		expression_usage_counts.clear();
+		forwarded_temporaries.clear();
+		func.flush_undeclared = true;
+		ir.for_each_typed_id<SPIRVariable>([&](uint32_t, SPIRVariable &var) { var.dependees.clear(); });
+		ir.reset_all_of_type(TypeExpression, expressions_begin);
+		ir.reset_all_of_type(TypeAccessChain, access_chains_begin);
+		resource_names.rollback(resource_names_begin);
+		block_names.rollback(block_names_begin);
+
+		// Keep the name this function got the first time around.
+		emitting_function_again = true;
+	}
+
+	emitting_function_again = false;
+}
+
+void CompilerGLSL::emit_function_body(SPIRFunction &func, const Bitset &return_flags)
+{
 	emit_function_prototype(func, return_flags);
 	begin_scope();
 
@@ -9947,7 +10118,7 @@ void CompilerGLSL::flush_phi(uint32_t from, uint32_t to)
 					if (!var.allocate_temporary_copy)
 					{
 						var.allocate_temporary_copy = true;
-						force_recompile = true;
+						force_recompile(RecompilePhiTemporaryCopy);
 					}
 					statement("_", phi.function_variable, "_copy", " = ", to_name(phi.function_variable), ";");
 					temporary_phi_variables.insert(phi.function_variable);
@@ -10057,7 +10228,7 @@ void CompilerGLSL::branch(uint32_t from, uint32_t to)
 		{
 			if (!current_emitting_switch->need_ladder_break)
 			{
-				force_recompile = true;
+				force_recompile(RecompileLadderBreak);
 				current_emitting_switch->need_ladder_break = true;
 			}
 
@@ -10393,7 +10564,7 @@ bool CompilerGLSL::attempt_emit_loop_header(SPIRBlock &block, SPIRBlock::Method
 		else
 		{
 			block.disable_block_optimization = true;
-			force_recompile = true;
+			force_recompile(RecompileLoopPattern);
 			begin_scope(); // We'll see an end_scope() later.
 			return false;
 		}
@@ -10449,7 +10620,7 @@ bool CompilerGLSL::attempt_emit_loop_header(SPIRBlock &block, SPIRBlock::Method
 		else
 		{
 			block.disable_block_optimization = true;
-			force_recompile = true;
+			force_recompile(RecompileLoopPattern);
 			begin_scope(); // We'll see an end_scope() later.
 			return false;
 		}
@@ -10585,7 +10756,7 @@ void CompilerGLSL::emit_block_chain(SPIRBlock &block)
 	// as writes to said loop variables might have been masked out, we need a recompile.
 	if (!emitted_for_loop_header && !block.loop_variables.empty())
 	{
-		force_recompile = true;
+		force_recompile(RecompileLoopPattern);
 		for (auto var : block.loop_variables)
 			get<SPIRVariable>(var).loop_variable = false;
 		block.loop_variables.clear();
@@ -10827,7 +10998,7 @@ void CompilerGLSL::emit_block_chain(SPIRBlock &block)
 			{
 				// The DoWhile block has side effects, force ComplexLoop pattern next pass.
 				get<SPIRBlock>(block.continue_block).complex_continue = true;
-				force_recompile = true;
+				force_recompile(RecompileLoopPattern);
 			}
 
 			end_scope_decl(join("while (", to_expression(get<SPIRBlock>(block.continue_block).condition), ")"));
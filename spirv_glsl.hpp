@@ -18,7 +18,6 @@
 #define SPIRV_CROSS_GLSL_HPP
 
 #include "spirv_cross.hpp"
-#include <sstream>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -60,6 +59,58 @@ enum AccessChainFlagBits
 };
 typedef uint32_t AccessChainFlags;
 
+// Receives the compiled source from CompilerGLSL::compile_to() in pieces, in order.
+class OutputSink
+{
+public:
+	virtual ~OutputSink() = default;
+	virtual void write(const char *data, size_t size) = 0;
+};
+
+// Appends the compiled source to a std::string owned by the caller.
+class StringOutputSink : public OutputSink
+{
+public:
+	explicit StringOutputSink(std::string &output_)
+	    : output(output_)
+	{
+	}
+
+	void write(const char *data, size_t size) override
+	{
+		output.append(data, size);
+	}
+
+private:
+	std::string &output;
+};
+
+// Writes the compiled source to a FILE opened by the caller.
+// Check failed() afterwards, as write errors cannot be reported from inside compile_to().
+class FileOutputSink : public OutputSink
+{
+public:
+	explicit FileOutputSink(FILE *file_)
+	    : file(file_)
+	{
+	}
+
+	void write(const char *data, size_t size) override
+	{
+		if (fwrite(data, 1, size, file) != size)
+			write_failed = true;
+	}
+
+	bool failed() const
+	{
+		return write_failed;
+	}
+
+private:
+	FILE *file;
+	bool write_failed = false;
+};
+
 class CompilerGLSL : public Compiler
 {
 public:
@@ -189,6 +240,22 @@ public:
 
 	std::string compile() override;
 
+	// Same as compile(), but the source is written to sink as it is stored internally,
+	// instead of being copied into a single std::string first.
+	// Large shaders produce hundreds of kilobytes of source, so this saves a copy of all of it
+	// when the source is only going to be written out somewhere anyway.
+	void compile_to(OutputSink &sink);
+
+	// Changes the default values of scalar specialization constants in the source of the last compile(),
+	// e.g. to build one pipeline per set of values on targets without real specialization constants.
+	// This works if the last compile() declared each changed constant and referred to it by name everywhere else,
+	// which is the common case. Then only the declarations of the changed constants are emitted again,
+	// the patched source is returned in source, and true is returned.
+	// Otherwise nothing is changed and false is returned. Set the values with get_constant() on a new compiler
+	// and compile() that instead, as compile() cannot be called twice on all backends.
+	// Options and anything else which changes the output must not be changed after compile().
+	bool respecialize(const std::vector<SpecializationConstantValue> &values, std::string &source);
+
 	// Returns the current string held in the conversion buffer. Useful for
 	// capturing what has been converted so far when compile() throws an error.
 	std::string get_partial_source();
@@ -219,6 +286,8 @@ public:
 protected:
 	void reset();
 	void emit_function(SPIRFunction &func, const Bitset &return_flags);
+	void emit_function_body(SPIRFunction &func, const Bitset &return_flags);
+	bool emitting_function_again = false;
 
 	bool has_extension(const std::string &ext) const;
 	void require_extension_internal(const std::string &ext);
@@ -272,19 +341,23 @@ protected:
 	virtual void emit_uniform(const SPIRVariable &var);
 	virtual std::string unpack_expression_type(std::string expr_str, const SPIRType &type, uint32_t packed_type_id);
 
-	std::unique_ptr<std::ostringstream> buffer;
+	// Emits the whole shader into buffer. Backends override this rather than compile(),
+	// so compile() and compile_to() work the same way for all of them.
+	virtual void emit_source();
+
+	StringStream buffer;
 
 	template <typename T>
 	inline void statement_inner(T &&t)
 	{
-		(*buffer) << std::forward<T>(t);
+		buffer << std::forward<T>(t);
 		statement_count++;
 	}
 
 	template <typename T, typename... Ts>
 	inline void statement_inner(T &&t, Ts &&... ts)
 	{
-		(*buffer) << std::forward<T>(t);
+		buffer << std::forward<T>(t);
 		statement_count++;
 		statement_inner(std::forward<Ts>(ts)...);
 	}
@@ -292,10 +365,10 @@ protected:
 	template <typename... Ts>
 	inline void statement(Ts &&... ts)
 	{
-		if (force_recompile)
+		if (is_forcing_recompilation())
 		{
-			// Do not bother emitting code while force_recompile is active.
-			// We will compile again.
+			// Do not bother emitting code while a recompile is pending.
+			// We will emit this code again.
 			statement_count++;
 			return;
 		}
@@ -304,10 +377,9 @@ protected:
 			redirect_statement->push_back(join(std::forward<Ts>(ts)...));
 		else
 		{
-			for (uint32_t i = 0; i < indent; i++)
-				(*buffer) << "    ";
+			buffer.append_spaces(indent * 4);
 			statement_inner(std::forward<Ts>(ts)...);
-			(*buffer) << '\n';
+			buffer << '\n';
 		}
 	}
 
@@ -350,14 +422,14 @@ protected:
 	bool member_is_packed_type(const SPIRType &type, uint32_t index) const;
 	virtual std::string convert_row_major_matrix(std::string exp_str, const SPIRType &exp_type, bool is_packed);
 
-	std::unordered_set<std::string> local_variable_names;
-	std::unordered_set<std::string> resource_names;
-	std::unordered_set<std::string> block_input_names;
-	std::unordered_set<std::string> block_output_names;
-	std::unordered_set<std::string> block_ubo_names;
-	std::unordered_set<std::string> block_ssbo_names;
-	std::unordered_set<std::string> block_names; // A union of all block_*_names.
-	std::unordered_map<std::string, std::unordered_set<uint64_t>> function_overloads;
+	NameCache local_variable_names;
+	NameCache resource_names;
+	NameCache block_input_names;
+	NameCache block_output_names;
+	NameCache block_ubo_names;
+	NameCache block_ssbo_names;
+	NameCache block_names; // A union of all block_*_names.
+	std::unordered_map<uint32_t, std::unordered_set<uint64_t>> function_overloads; // Keyed by interned name.
 	std::unordered_map<uint32_t, std::string> preserved_aliases;
 	void preserve_alias_on_reset(uint32_t id);
 	void reset_name_caches();
@@ -418,6 +490,21 @@ protected:
 	void emit_hoisted_temporaries(std::vector<std::pair<uint32_t, uint32_t>> &temporaries);
 	std::string constant_value_macro_name(uint32_t id);
 	void emit_constant(const SPIRConstant &constant);
+
+	// Emits the declaration of a specialization constant through emit_specialization_constant(),
+	// and remembers where it is in the output for respecialize().
+	void declare_specialization_constant(SPIRConstant &constant);
+	virtual void emit_specialization_constant(SPIRConstant &constant);
+
+	struct DeclarationRange
+	{
+		size_t offset;
+		size_t size;
+	};
+	std::unordered_map<uint32_t, DeclarationRange> specialization_constant_declarations;
+	std::unordered_set<uint32_t> specialization_constants_used_by_value;
+	bool specialization_constants_used_by_value_valid = false;
+	uint64_t compiled_modification_count = 0;
 	void emit_specialization_constant_op(const SPIRConstantOp &constant);
 	std::string emit_continue_block(uint32_t continue_block);
 	bool attempt_emit_loop_header(SPIRBlock &block, SPIRBlock::Method method);
@@ -598,8 +685,7 @@ protected:
 	// A variant which takes two sets of name. The secondary is only used to verify there are no collisions,
 	// but the set is not updated when we have found a new name.
 	// Used primarily when adding block interface names.
-	void add_variable(std::unordered_set<std::string> &variables_primary,
-	                  const std::unordered_set<std::string> &variables_secondary, std::string &name);
+	void add_variable(NameCache &variables_primary, const NameCache &variables_secondary, std::string &name);
 
 	void check_function_call_constraints(const uint32_t *args, uint32_t length);
 	void handle_invalid_expression(uint32_t id);
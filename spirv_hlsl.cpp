@@ -1026,6 +1026,21 @@ void CompilerHLSL::emit_composite_constants()
 		statement("");
 }
 
+void CompilerHLSL::emit_specialization_constant(SPIRConstant &constant)
+{
+	auto &type = get<SPIRType>(constant.constant_type);
+	auto name = to_name(constant.self);
+
+	// HLSL does not support specialization constants, so fallback to macros.
+	constant.specialization_constant_macro_name =
+	    constant_value_macro_name(get_decoration(constant.self, DecorationSpecId));
+
+	statement("#ifndef ", constant.specialization_constant_macro_name);
+	statement("#define ", constant.specialization_constant_macro_name, " ", constant_expression(constant));
+	statement("#endif");
+	statement("static const ", variable_decl(type, name), " = ", constant.specialization_constant_macro_name, ";");
+}
+
 void CompilerHLSL::emit_specialization_constants_and_structs()
 {
 	bool emitted = false;
@@ -1048,17 +1063,7 @@ void CompilerHLSL::emit_specialization_constants_and_structs()
 			}
 			else if (c.specialization)
 			{
-				auto &type = get<SPIRType>(c.constant_type);
-				auto name = to_name(c.self);
-
-				// HLSL does not support specialization constants, so fallback to macros.
-				c.specialization_constant_macro_name =
-				    constant_value_macro_name(get_decoration(c.self, DecorationSpecId));
-
-				statement("#ifndef ", c.specialization_constant_macro_name);
-				statement("#define ", c.specialization_constant_macro_name, " ", constant_expression(c));
-				statement("#endif");
-				statement("static const ", variable_decl(type, name), " = ", c.specialization_constant_macro_name, ";");
+				declare_specialization_constant(c);
 				emitted = true;
 			}
 		}
@@ -1352,7 +1357,10 @@ void CompilerHLSL::emit_resources()
 		statement("");
 
 	declare_undefined_values();
+}
 
+void CompilerHLSL::emit_helper_functions()
+{
 	if (requires_op_fmod)
 	{
 		static const char *types[] = {
@@ -1819,8 +1827,8 @@ void CompilerHLSL::emit_buffer_block(const SPIRVariable &var)
 			// Prefer the block name if possible.
 			auto buffer_name = to_name(type.self, false);
 			if (ir.meta[type.self].decoration.alias.empty() ||
-			    resource_names.find(buffer_name) != end(resource_names) ||
-			    block_names.find(buffer_name) != end(block_names))
+			    resource_names.contains(name_interner, buffer_name) ||
+			    block_names.contains(name_interner, buffer_name))
 			{
 				buffer_name = get_block_fallback_name(var.self);
 			}
@@ -1832,7 +1840,7 @@ void CompilerHLSL::emit_buffer_block(const SPIRVariable &var)
 			if (buffer_name.empty())
 				buffer_name = join("_", get<SPIRType>(var.basetype).self, "_", var.self);
 
-			block_names.insert(buffer_name);
+			block_names.insert(name_interner, buffer_name);
 
 			// Save for post-reflection later.
 			declared_block_names[var.self] = buffer_name;
@@ -2131,9 +2139,9 @@ void CompilerHLSL::emit_hlsl_entry_point()
 		uint32_t y = execution.workgroup_size.y;
 		uint32_t z = execution.workgroup_size.z;
 
-		auto x_expr = wg_x.id ? get<SPIRConstant>(wg_x.id).specialization_constant_macro_name : to_string(x);
-		auto y_expr = wg_y.id ? get<SPIRConstant>(wg_y.id).specialization_constant_macro_name : to_string(y);
-		auto z_expr = wg_z.id ? get<SPIRConstant>(wg_z.id).specialization_constant_macro_name : to_string(z);
+		auto x_expr = wg_x.id ? get<SPIRConstant>(wg_x.id).specialization_constant_macro_name : convert_to_string(x);
+		auto y_expr = wg_y.id ? get<SPIRConstant>(wg_y.id).specialization_constant_macro_name : convert_to_string(y);
+		auto z_expr = wg_z.id ? get<SPIRConstant>(wg_z.id).specialization_constant_macro_name : convert_to_string(z);
 
 		statement("[numthreads(", x_expr, ", ", y_expr, ", ", z_expr, ")]");
 		break;
@@ -3030,7 +3038,7 @@ string CompilerHLSL::bitcast_glsl_op(const SPIRType &out_type, const SPIRType &i
 		if (!requires_explicit_fp16_packing)
 		{
 			requires_explicit_fp16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		return "SPIRV_Cross_unpackFloat2x16";
 	}
@@ -3039,7 +3047,7 @@ string CompilerHLSL::bitcast_glsl_op(const SPIRType &out_type, const SPIRType &i
 		if (!requires_explicit_fp16_packing)
 		{
 			requires_explicit_fp16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		return "SPIRV_Cross_packFloat2x16";
 	}
@@ -3096,7 +3104,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_fp16_packing)
 		{
 			requires_fp16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_packHalf2x16");
 		break;
@@ -3105,7 +3113,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_fp16_packing)
 		{
 			requires_fp16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_unpackHalf2x16");
 		break;
@@ -3114,7 +3122,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_snorm8_packing)
 		{
 			requires_snorm8_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_packSnorm4x8");
 		break;
@@ -3123,7 +3131,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_snorm8_packing)
 		{
 			requires_snorm8_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_unpackSnorm4x8");
 		break;
@@ -3132,7 +3140,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_unorm8_packing)
 		{
 			requires_unorm8_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_packUnorm4x8");
 		break;
@@ -3141,7 +3149,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_unorm8_packing)
 		{
 			requires_unorm8_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_unpackUnorm4x8");
 		break;
@@ -3150,7 +3158,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_snorm16_packing)
 		{
 			requires_snorm16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_packSnorm2x16");
 		break;
@@ -3159,7 +3167,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_snorm16_packing)
 		{
 			requires_snorm16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_unpackSnorm2x16");
 		break;
@@ -3168,7 +3176,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_unorm16_packing)
 		{
 			requires_unorm16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_packUnorm2x16");
 		break;
@@ -3177,7 +3185,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 		if (!requires_unorm16_packing)
 		{
 			requires_unorm16_packing = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_unpackUnorm2x16");
 		break;
@@ -3202,7 +3210,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 			if (!requires_inverse_2x2)
 			{
 				requires_inverse_2x2 = true;
-				force_recompile = true;
+				force_recompile(RecompileHelperFunction);
 			}
 		}
 		else if (type.vecsize == 3 && type.columns == 3)
@@ -3210,7 +3218,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 			if (!requires_inverse_3x3)
 			{
 				requires_inverse_3x3 = true;
-				force_recompile = true;
+				force_recompile(RecompileHelperFunction);
 			}
 		}
 		else if (type.vecsize == 4 && type.columns == 4)
@@ -3218,7 +3226,7 @@ void CompilerHLSL::emit_glsl_op(uint32_t result_type, uint32_t id, uint32_t eop,
 			if (!requires_inverse_4x4)
 			{
 				requires_inverse_4x4 = true;
-				force_recompile = true;
+				force_recompile(RecompileHelperFunction);
 			}
 		}
 		emit_unary_func_op(result_type, id, args[0], "SPIRV_Cross_Inverse");
@@ -3940,7 +3948,7 @@ void CompilerHLSL::emit_instruction(const Instruction &instruction)
 		if (!requires_op_fmod)
 		{
 			requires_op_fmod = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 		CompilerGLSL::emit_instruction(instruction);
 		break;
@@ -4455,7 +4463,7 @@ void CompilerHLSL::emit_instruction(const Instruction &instruction)
 		if (!requires_bitfield_insert)
 		{
 			requires_bitfield_insert = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 
 		auto expr = join("SPIRV_Cross_bitfieldInsert(", to_expression(ops[2]), ", ", to_expression(ops[3]), ", ",
@@ -4476,7 +4484,7 @@ void CompilerHLSL::emit_instruction(const Instruction &instruction)
 		if (!requires_bitfield_extract)
 		{
 			requires_bitfield_extract = true;
-			force_recompile = true;
+			force_recompile(RecompileHelperFunction);
 		}
 
 		if (opcode == OpBitFieldSExtract)
@@ -4553,7 +4561,7 @@ void CompilerHLSL::require_texture_query_variant(const SPIRType &type)
 	uint64_t mask = 1ull << bit;
 	if ((required_textureSizeVariants & mask) == 0)
 	{
-		force_recompile = true;
+		force_recompile(RecompileHelperFunction);
 		required_textureSizeVariants |= mask;
 	}
 }
@@ -4564,6 +4572,11 @@ string CompilerHLSL::compile(std::vector<HLSLVertexAttributeRemap> vertex_attrib
 	return compile();
 }
 
+void CompilerHLSL::add_vertex_attribute_remap(const HLSLVertexAttributeRemap &vertex_attribute)
+{
+	remap_vertex_attributes.push_back(vertex_attribute);
+}
+
 uint32_t CompilerHLSL::remap_num_workgroups_builtin()
 {
 	update_active_builtins();
@@ -4610,7 +4623,7 @@ uint32_t CompilerHLSL::remap_num_workgroups_builtin()
 	return variable_id;
 }
 
-string CompilerHLSL::compile()
+void CompilerHLSL::emit_source()
 {
 	// Do not deal with ES-isms like precision, older extensions and such.
 	options.es = false;
@@ -4644,6 +4657,10 @@ string CompilerHLSL::compile()
 	if (need_subpass_input)
 		active_input_builtins.set(BuiltInFragCoord);
 
+	// Helper functions are declared before all other functions, but we only find out which ones we need
+	// while emitting those functions. They do not depend on anything else, so emit them again on their own.
+	can_recompile_helpers = true;
+
 	uint32_t pass_count = 0;
 	do
 	{
@@ -4652,22 +4669,36 @@ string CompilerHLSL::compile()
 
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
 
 		emit_header();
 		emit_resources();
 
+		size_t helpers_begin = buffer.size();
+		recompile_helpers = false;
+		emit_helper_functions();
+		size_t helpers_end = buffer.size();
+
 		emit_function(get<SPIRFunction>(ir.default_entry_point), Bitset());
 		emit_hlsl_entry_point();
 
+		if (recompile_helpers && !is_forcing_recompilation())
+		{
+			StringStream functions;
+			functions.append(buffer, helpers_end);
+			buffer.truncate(helpers_begin);
+			emit_helper_functions();
+			buffer.append(functions);
+
+			recompile_helpers = false;
+			recompile_statistics.helper_passes++;
+		}
+
 		pass_count++;
-	} while (force_recompile);
+	} while (is_forcing_recompilation());
 
 	// Entry point in HLSL is always main() for the time being.
 	get_entry_point().name = "main";
-
-	return buffer->str();
 }
 
 void CompilerHLSL::emit_block_hints(const SPIRBlock &block)
@@ -118,7 +118,11 @@ public:
 	// Matrices are unrolled to vectors with notation ${SEMANTIC}_#, where # denotes row.
 	// $SEMANTIC is either TEXCOORD# or a semantic name specified here.
 	std::string compile(std::vector<HLSLVertexAttributeRemap> vertex_attributes);
-	std::string compile() override;
+	using CompilerGLSL::compile;
+
+	// Adds a vertex attribute remap for the following calls to compile() or compile_to(),
+	// same as passing it to compile(vertex_attributes).
+	void add_vertex_attribute_remap(const HLSLVertexAttributeRemap &vertex_attribute);
 
 	// This is a special HLSL workaround for the NumWorkGroups builtin.
 	// This does not exist in HLSL, so the calling application must create a dummy cbuffer in
@@ -133,6 +137,7 @@ public:
 	uint32_t remap_num_workgroups_builtin();
 
 private:
+	void emit_source() override;
 	std::string type_to_glsl(const SPIRType &type, uint32_t id = 0) override;
 	std::string image_type_hlsl(const SPIRType &type, uint32_t id);
 	std::string image_type_hlsl_modern(const SPIRType &type, uint32_t id);
@@ -141,6 +146,7 @@ private:
 	void emit_hlsl_entry_point();
 	void emit_header() override;
 	void emit_resources();
+	void emit_helper_functions();
 	void emit_interface_block_globally(const SPIRVariable &type);
 	void emit_interface_block_in_struct(const SPIRVariable &type, std::unordered_set<uint32_t> &active_locations);
 	void emit_builtin_inputs_in_struct();
@@ -154,6 +160,7 @@ private:
 	void emit_uniform(const SPIRVariable &var) override;
 	void emit_modern_uniform(const SPIRVariable &var);
 	void emit_legacy_uniform(const SPIRVariable &var);
+	void emit_specialization_constant(SPIRConstant &constant) override;
 	void emit_specialization_constants_and_structs();
 	void emit_composite_constants();
 	void emit_fixup() override;
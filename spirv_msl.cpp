@@ -572,11 +572,8 @@ void CompilerMSL::emit_entry_point_declarations()
 	buffer_arrays.clear();
 }
 
-string CompilerMSL::compile()
+void CompilerMSL::emit_source()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
-
 	// Do not deal with GLES-isms like precision, older extensions and such.
 	options.vulkan_semantics = true;
 	options.es = false;
@@ -626,36 +623,51 @@ string CompilerMSL::compile()
 		active_interface_variables.insert(aux_buffer_id);
 
 	// Preprocess OpCodes to extract the need to output additional header content
-	preprocess_op_codes();
+	{
+		PhaseTimer timer(*this, "preprocess_op_codes");
+		preprocess_op_codes();
+	}
 
 	// Create structs to hold input, output and uniform variables.
 	// Do output first to ensure out. is declared at top of entry function.
-	qual_pos_var_name = "";
-	stage_out_var_id = add_interface_block(StorageClassOutput);
-	patch_stage_out_var_id = add_interface_block(StorageClassOutput, true);
-	stage_in_var_id = add_interface_block(StorageClassInput);
-	if (get_execution_model() == ExecutionModelTessellationEvaluation)
-		patch_stage_in_var_id = add_interface_block(StorageClassInput, true);
+	{
+		PhaseTimer timer(*this, "add_interface_block");
+		qual_pos_var_name = "";
+		stage_out_var_id = add_interface_block(StorageClassOutput);
+		patch_stage_out_var_id = add_interface_block(StorageClassOutput, true);
+		stage_in_var_id = add_interface_block(StorageClassInput);
+		if (get_execution_model() == ExecutionModelTessellationEvaluation)
+			patch_stage_in_var_id = add_interface_block(StorageClassInput, true);
 
-	if (get_execution_model() == ExecutionModelTessellationControl)
-		stage_out_ptr_var_id = add_interface_block_pointer(stage_out_var_id, StorageClassOutput);
-	if (is_tessellation_shader())
-		stage_in_ptr_var_id = add_interface_block_pointer(stage_in_var_id, StorageClassInput);
+		if (get_execution_model() == ExecutionModelTessellationControl)
+			stage_out_ptr_var_id = add_interface_block_pointer(stage_out_var_id, StorageClassOutput);
+		if (is_tessellation_shader())
+			stage_in_ptr_var_id = add_interface_block_pointer(stage_in_var_id, StorageClassInput);
+	}
 
 	// Metal vertex functions that define no output must disable rasterization and return void.
 	if (!stage_out_var_id)
 		is_rasterization_disabled = true;
 
 	// Convert the use of global variables to recursively-passed function parameters
-	localize_global_variables();
-	extract_global_variables_from_functions();
+	{
+		PhaseTimer timer(*this, "extract_global_variables_from_functions");
+		localize_global_variables();
+		extract_global_variables_from_functions();
+	}
 
 	// Mark any non-stage-in structs to be tightly packed.
-	mark_packable_structs();
+	{
+		PhaseTimer timer(*this, "mark_packable_structs");
+		mark_packable_structs();
+	}
 
 	// Add fixup hooks required by shader inputs and outputs. This needs to happen before
 	// the loop, so the hooks aren't added multiple times.
-	fix_up_shader_inputs_outputs();
+	{
+		PhaseTimer timer(*this, "fix_up_shader_inputs_outputs");
+		fix_up_shader_inputs_outputs();
+	}
 
 	uint32_t pass_count = 0;
 	do
@@ -667,8 +679,7 @@ string CompilerMSL::compile()
 
 		next_metal_resource_index = MSLResourceBinding(); // Start bindings at zero
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
 
 		emit_header();
 		emit_specialization_constants_and_structs();
@@ -677,9 +688,7 @@ string CompilerMSL::compile()
 		emit_function(get<SPIRFunction>(ir.default_entry_point), Bitset());
 
 		pass_count++;
-	} while (force_recompile);
-
-	return buffer->str();
+	} while (is_forcing_recompilation());
 }
 
 string CompilerMSL::compile(vector<MSLVertexAttr> *p_vtx_attrs, vector<MSLResourceBinding> *p_res_bindings)
@@ -2413,14 +2422,14 @@ void CompilerMSL::add_pragma_line(const string &line)
 {
 	auto rslt = pragma_lines.insert(line);
 	if (rslt.second)
-		force_recompile = true;
+		force_recompile(RecompileHeaderLine);
 }
 
 void CompilerMSL::add_typedef_line(const string &line)
 {
 	auto rslt = typedef_lines.insert(line);
 	if (rslt.second)
-		force_recompile = true;
+		force_recompile(RecompileHeaderLine);
 }
 
 // Emits any needed custom function bodies.
@@ -2965,6 +2974,45 @@ void CompilerMSL::emit_resources()
 	emit_interface_block(patch_stage_in_var_id);
 }
 
+void CompilerMSL::emit_specialization_constant(SPIRConstant &constant)
+{
+	auto &type = get<SPIRType>(constant.constant_type);
+	string sc_type_name = type_to_glsl(type);
+	string sc_name = to_name(constant.self);
+	string sc_tmp_name = sc_name + "_tmp";
+
+	// Function constants are only supported in MSL 1.2 and later.
+	// If we don't support it just declare the "default" directly.
+	// This "default" value can be overridden to the true specialization constant by the API user.
+	// Specialization constants which are used as array length expressions cannot be function constants in MSL,
+	// so just fall back to macros.
+	if (msl_options.supports_msl_version(1, 2) && has_decoration(constant.self, DecorationSpecId) &&
+	    !constant.is_used_as_array_length)
+	{
+		uint32_t constant_id = get_decoration(constant.self, DecorationSpecId);
+		// Only scalar, non-composite values can be function constants.
+		statement("constant ", sc_type_name, " ", sc_tmp_name, " [[function_constant(", constant_id, ")]];");
+		statement("constant ", sc_type_name, " ", sc_name, " = is_function_constant_defined(", sc_tmp_name,
+		          ") ? ", sc_tmp_name, " : ", constant_expression(constant), ";");
+	}
+	else if (has_decoration(constant.self, DecorationSpecId))
+	{
+		// Fallback to macro overrides.
+		constant.specialization_constant_macro_name =
+		    constant_value_macro_name(get_decoration(constant.self, DecorationSpecId));
+
+		statement("#ifndef ", constant.specialization_constant_macro_name);
+		statement("#define ", constant.specialization_constant_macro_name, " ", constant_expression(constant));
+		statement("#endif");
+		statement("constant ", sc_type_name, " ", sc_name, " = ", constant.specialization_constant_macro_name, ";");
+	}
+	else
+	{
+		// Composite specialization constants must be built from other specialization constants.
+		statement("constant ", sc_type_name, " ", sc_name, " = ", constant_expression(constant), ";");
+	}
+}
+
 // Emit declarations for the specialization Metal function constants
 void CompilerMSL::emit_specialization_constants_and_structs()
 {
@@ -2993,43 +3041,7 @@ void CompilerMSL::emit_specialization_constants_and_structs()
 			}
 			else if (c.specialization)
 			{
-				auto &type = get<SPIRType>(c.constant_type);
-				string sc_type_name = type_to_glsl(type);
-				string sc_name = to_name(c.self);
-				string sc_tmp_name = sc_name + "_tmp";
-
-				// Function constants are only supported in MSL 1.2 and later.
-				// If we don't support it just declare the "default" directly.
-				// This "default" value can be overridden to the true specialization constant by the API user.
-				// Specialization constants which are used as array length expressions cannot be function constants in MSL,
-				// so just fall back to macros.
-				if (msl_options.supports_msl_version(1, 2) && has_decoration(c.self, DecorationSpecId) &&
-				    !c.is_used_as_array_length)
-				{
-					uint32_t constant_id = get_decoration(c.self, DecorationSpecId);
-					// Only scalar, non-composite values can be function constants.
-					statement("constant ", sc_type_name, " ", sc_tmp_name, " [[function_constant(", constant_id,
-					          ")]];");
-					statement("constant ", sc_type_name, " ", sc_name, " = is_function_constant_defined(", sc_tmp_name,
-					          ") ? ", sc_tmp_name, " : ", constant_expression(c), ";");
-				}
-				else if (has_decoration(c.self, DecorationSpecId))
-				{
-					// Fallback to macro overrides.
-					c.specialization_constant_macro_name =
-					    constant_value_macro_name(get_decoration(c.self, DecorationSpecId));
-
-					statement("#ifndef ", c.specialization_constant_macro_name);
-					statement("#define ", c.specialization_constant_macro_name, " ", constant_expression(c));
-					statement("#endif");
-					statement("constant ", sc_type_name, " ", sc_name, " = ", c.specialization_constant_macro_name,
-					          ";");
-				}
-				else
-				{
-					// Composite specialization constants must be built from other specialization constants.
-					statement("constant ", sc_type_name, " ", sc_name, " = ", constant_expression(c), ";");
-				}
+				declare_specialization_constant(c);
 				emitted = true;
 			}
 		}
@@ -3604,7 +3616,7 @@ void CompilerMSL::emit_instruction(const Instruction &instruction)
 			if (p_var && has_decoration(p_var->self, DecorationNonReadable))
 			{
 				unset_decoration(p_var->self, DecorationNonReadable);
-				force_recompile = true;
+				force_recompile(RecompileImageAccess);
 			}
 		}
 
@@ -3630,7 +3642,7 @@ void CompilerMSL::emit_instruction(const Instruction &instruction)
 		if (p_var && has_decoration(p_var->self, DecorationNonWritable))
 		{
 			unset_decoration(p_var->self, DecorationNonWritable);
-			force_recompile = true;
+			force_recompile(RecompileImageAccess);
 		}
 
 		bool forward = false;
@@ -4766,7 +4778,7 @@ string CompilerMSL::to_component_argument(uint32_t id)
 {
 	if (ir.ids[id].get_type() != TypeConstant)
 	{
-		SPIRV_CROSS_THROW("ID " + to_string(id) + " is not an OpConstant.");
+		SPIRV_CROSS_THROW(join("ID ", id, " is not an OpConstant."));
 		return "component::x";
 	}
 
@@ -4783,8 +4795,8 @@ string CompilerMSL::to_component_argument(uint32_t id)
 		return "component::w";
 
 	default:
-		SPIRV_CROSS_THROW("The value (" + to_string(component_index) + ") of OpConstant ID " + to_string(id) +
-		                  " is not a valid Component index, which must be one of 0, 1, 2, or 3.");
+		SPIRV_CROSS_THROW(join("The value (", component_index, ") of OpConstant ID ", id,
+		                       " is not a valid Component index, which must be one of 0, 1, 2, or 3."));
 		return "component::x";
 	}
 }
@@ -4818,7 +4830,7 @@ string CompilerMSL::to_func_call_arg(uint32_t id)
 		auto itr = find(begin(constants), end(constants), id);
 		if (itr == end(constants))
 		{
-			force_recompile = true;
+			force_recompile(RecompileConstantArrayOnStack);
 			constants.push_back(id);
 		}
 	}
@@ -4958,7 +4970,7 @@ void CompilerMSL::add_convert_row_major_matrix_function(uint32_t cols, uint32_t
 	if (rslt.second)
 	{
 		add_pragma_line("#pragma clang diagnostic ignored \"-Wmissing-prototypes\"");
-		force_recompile = true;
+		force_recompile(RecompileHelperFunction);
 	}
 }
 
@@ -4974,7 +4986,7 @@ string CompilerMSL::convert_row_major_matrix(string exp_str, const SPIRType &exp
 	if (exp_type.columns == exp_type.vecsize || is_packed)
 		func_name = "transpose";
 	else
-		func_name = string("spvConvertFromRowMajor") + to_string(exp_type.columns) + "x" + to_string(exp_type.vecsize);
+		func_name = join("spvConvertFromRowMajor", exp_type.columns, "x", exp_type.vecsize);
 
 	return join(func_name, "(", exp_str, ")");
 }
@@ -5005,7 +5017,7 @@ string CompilerMSL::to_struct_member(const SPIRType &type, uint32_t member_type_
 	MSLStructMemberKey key = get_struct_member_key(type.self, index);
 	uint32_t pad_len = struct_member_padding[key];
 	if (pad_len > 0)
-		statement("char _m", index, "_pad", "[", to_string(pad_len), "];");
+		statement("char _m", index, "_pad", "[", pad_len, "];");
 
 	// If this member is packed, mark it as so.
 	string pack_pfx = "";
@@ -5024,12 +5036,8 @@ string CompilerMSL::to_struct_member(const SPIRType &type, uint32_t member_type_
 		{
 			pack_pfx = "packed_";
 			string base_type = membertype.width == 16 ? "half" : "float";
-			string td_line = "typedef ";
-			td_line += base_type + to_string(membertype.vecsize) + "x" + to_string(membertype.columns);
-			td_line += " " + pack_pfx;
-			td_line += base_type + to_string(membertype.columns) + "x" + to_string(membertype.vecsize);
-			td_line += ";";
-			add_typedef_line(td_line);
+			add_typedef_line(join("typedef ", base_type, membertype.vecsize, "x", membertype.columns, " ", pack_pfx,
+			                      base_type, membertype.columns, "x", membertype.vecsize, ";"));
 		}
 		else if (is_array(membertype) && membertype.vecsize <= 2 && membertype.basetype != SPIRType::Struct)
 		{
@@ -6391,11 +6399,11 @@ string CompilerMSL::type_to_glsl(const SPIRType &type, uint32_t id)
 
 	// Matrix?
 	if (type.columns > 1)
-		type_name += to_string(type.columns) + "x";
+		type_name += join(type.columns, "x");
 
 	// Vector or Matrix?
 	if (type.vecsize > 1)
-		type_name += to_string(type.vecsize);
+		type_name += convert_to_string(type.vecsize);
 
 	return type_name;
 }
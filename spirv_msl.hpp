@@ -329,7 +329,7 @@ public:
 	            MSLResourceBinding *p_res_bindings = nullptr, size_t res_bindings_count = 0);
 
 	// Compiles the SPIR-V code into Metal Shading Language.
-	std::string compile() override;
+	using CompilerGLSL::compile;
 
 	// Compiles the SPIR-V code into Metal Shading Language, overriding configuration parameters.
 	// Any of the parameters here may be null to indicate that the configuration provided in the
@@ -356,6 +356,7 @@ public:
 	void set_fragment_output_components(uint32_t location, uint32_t components);
 
 protected:
+	void emit_source() override;
 	void emit_binary_unord_op(uint32_t result_type, uint32_t result_id, uint32_t op0, uint32_t op1, const char *op);
 	void emit_instruction(const Instruction &instr) override;
 	void emit_glsl_op(uint32_t result_type, uint32_t result_id, uint32_t op, const uint32_t *args,
@@ -432,6 +433,7 @@ protected:
 
 	void emit_custom_functions();
 	void emit_resources();
+	void emit_specialization_constant(SPIRConstant &constant) override;
 	void emit_specialization_constants_and_structs();
 	void emit_interface_block(uint32_t ib_var_id);
 	bool maybe_emit_array_assignment(uint32_t id_lhs, uint32_t id_rhs);
@@ -546,6 +548,12 @@ protected:
 		}
 
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
+
+		bool handles_each_function_once() const override
+		{
+			return true;
+		}
+
 		CompilerMSL::SPVFuncImpl get_spv_func_impl(spv::Op opcode, const uint32_t *args);
 		void check_resource_write(uint32_t var_id);
 
@@ -566,6 +574,16 @@ protected:
 
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t) override;
 
+		bool handles_each_function_once() const override
+		{
+			return true;
+		}
+
+		uint32_t get_opcode_filter() const override
+		{
+			return OpcodeKindImageBit;
+		}
+
 		CompilerMSL &compiler;
 	};
 
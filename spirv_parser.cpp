@@ -32,6 +32,14 @@ Parser::Parser(const uint32_t *spirv_data, size_t word_count)
 	ir.spirv = vector<uint32_t>(spirv_data, spirv_data + word_count);
 }
 
+Parser::Parser(const uint32_t *spirv_data, size_t word_count, bool borrow_spirv)
+{
+	if (borrow_spirv)
+		ir.set_borrowed_spirv(spirv_data, word_count);
+	else
+		ir.spirv = vector<uint32_t>(spirv_data, spirv_data + word_count);
+}
+
 static bool decoration_is_string(Decoration decoration)
 {
 	switch (decoration)
@@ -68,17 +76,26 @@ static bool is_valid_spirv_version(uint32_t version)
 
 void Parser::parse()
 {
-	auto &spirv = ir.spirv;
-
-	auto len = spirv.size();
+	auto len = ir.get_spirv_word_count();
 	if (len < 5)
 		SPIRV_CROSS_THROW("SPIRV file too small.");
 
-	auto s = spirv.data();
+	auto s = ir.get_spirv_words();
 
 	// Endian-swap if we need to.
+	// Borrowed words are immutable, so this is the one case where we must take a private copy.
 	if (s[0] == swap_endian(MagicNumber))
+	{
+		auto &spirv = ir.spirv;
+		if (s != spirv.data())
+		{
+			spirv = vector<uint32_t>(s, s + len);
+			ir.set_borrowed_spirv(nullptr, 0);
+		}
+
 		transform(begin(spirv), end(spirv), begin(spirv), [](uint32_t c) { return swap_endian(c); });
+		s = spirv.data();
+	}
 
 	if (s[0] != MagicNumber || !is_valid_spirv_version(s[1]))
 		SPIRV_CROSS_THROW("Invalid SPIRV format.");
@@ -86,32 +103,30 @@ void Parser::parse()
 	uint32_t bound = s[3];
 	ir.set_id_bounds(bound);
 
-	uint32_t offset = 5;
-
-	vector<Instruction> instructions;
+	// Decode and dispatch each instruction as we go.
+	// Instructions inside blocks are copied straight into SPIRBlock::ops by parse(),
+	// so there is no need to build up a separate list of instructions for the whole module first.
+	size_t offset = 5;
 	while (offset < len)
 	{
 		Instruction instr = {};
-		instr.op = spirv[offset] & 0xffff;
-		instr.count = (spirv[offset] >> 16) & 0xffff;
+		instr.op = s[offset] & 0xffff;
+		instr.count = (s[offset] >> 16) & 0xffff;
 
 		if (instr.count == 0)
 			SPIRV_CROSS_THROW("SPIR-V instructions cannot consume 0 words. Invalid SPIR-V file.");
 
-		instr.offset = offset + 1;
-		instr.length = instr.count - 1;
+		instr.offset = uint32_t(offset + 1);
+		instr.length = instr.count - 1u;
 
 		offset += instr.count;
 
-		if (offset > spirv.size())
+		if (offset > len)
 			SPIRV_CROSS_THROW("SPIR-V instruction goes out of bounds.");
 
-		instructions.push_back(instr);
+		parse(instr);
 	}
 
-	for (auto &i : instructions)
-		parse(i);
-
 	if (current_function)
 		SPIRV_CROSS_THROW("Function was not terminated.");
 	if (current_block)
@@ -126,15 +141,18 @@ const uint32_t *Parser::stream(const Instruction &instr) const
 	if (!instr.length)
 		return nullptr;
 
-	if (instr.offset + instr.length > ir.spirv.size())
+	if (instr.offset + instr.length > ir.get_spirv_word_count())
 		SPIRV_CROSS_THROW("Compiler::stream() out of range.");
-	return &ir.spirv[instr.offset];
+	return ir.get_spirv_words() + instr.offset;
 }
 
-static string extract_string(const vector<uint32_t> &spirv, uint32_t offset)
+static string extract_string(const ParsedIR &ir, uint32_t offset)
 {
+	auto *spirv = ir.get_spirv_words();
+	auto len = ir.get_spirv_word_count();
+
 	string ret;
-	for (uint32_t i = offset; i < spirv.size(); i++)
+	for (size_t i = offset; i < len; i++)
 	{
 		uint32_t w = spirv[i];
 
@@ -222,7 +240,7 @@ void Parser::parse(const Instruction &instruction)
 
 	case OpExtension:
 	{
-		auto ext = extract_string(ir.spirv, instruction.offset);
+		auto ext = extract_string(ir, instruction.offset);
 		ir.declared_extensions.push_back(move(ext));
 		break;
 	}
@@ -230,7 +248,7 @@ void Parser::parse(const Instruction &instruction)
 	case OpExtInstImport:
 	{
 		uint32_t id = ops[0];
-		auto ext = extract_string(ir.spirv, instruction.offset + 1);
+		auto ext = extract_string(ir, instruction.offset + 1);
 		if (ext == "GLSL.std.450")
 			set<SPIRExtension>(id, SPIRExtension::GLSL);
 		else if (ext == "SPV_AMD_shader_ballot")
@@ -253,7 +271,7 @@ void Parser::parse(const Instruction &instruction)
 	{
 		auto itr =
 		    ir.entry_points.insert(make_pair(ops[1], SPIREntryPoint(ops[1], static_cast<ExecutionModel>(ops[0]),
-		                                                            extract_string(ir.spirv, instruction.offset + 2))));
+		                                                            extract_string(ir, instruction.offset + 2))));
 		auto &e = itr.first->second;
 
 		// Strings need nul-terminator and consume the whole word.
@@ -300,7 +318,7 @@ void Parser::parse(const Instruction &instruction)
 	case OpName:
 	{
 		uint32_t id = ops[0];
-		ir.set_name(id, extract_string(ir.spirv, instruction.offset + 1));
+		ir.set_name(id, extract_string(ir, instruction.offset + 1));
 		break;
 	}
 
@@ -308,7 +326,7 @@ void Parser::parse(const Instruction &instruction)
 	{
 		uint32_t id = ops[0];
 		uint32_t member = ops[1];
-		ir.set_member_name(id, member, extract_string(ir.spirv, instruction.offset + 2));
+		ir.set_member_name(id, member, extract_string(ir, instruction.offset + 2));
 		break;
 	}
 
@@ -339,8 +357,9 @@ void Parser::parse(const Instruction &instruction)
 				}
 				else
 				{
-					ir.meta[target].decoration_word_offset[decoration] =
-					    ir.meta[group_id].decoration_word_offset[decoration];
+					uint32_t word_offset;
+					if (ir.meta[group_id].decoration_word_offset.find(decoration, word_offset))
+						ir.meta[target].decoration_word_offset.set(decoration, word_offset);
 					ir.set_decoration(target, decoration, ir.get_decoration(group_id, decoration));
 				}
 			});
@@ -382,7 +401,7 @@ void Parser::parse(const Instruction &instruction)
 		auto decoration = static_cast<Decoration>(ops[1]);
 		if (length >= 3)
 		{
-			ir.meta[id].decoration_word_offset[decoration] = uint32_t(&ops[2] - ir.spirv.data());
+			ir.meta[id].decoration_word_offset.set(decoration, uint32_t(&ops[2] - ir.get_spirv_words()));
 			ir.set_decoration(id, decoration, ops[2]);
 		}
 		else
@@ -395,7 +414,7 @@ void Parser::parse(const Instruction &instruction)
 	{
 		uint32_t id = ops[0];
 		auto decoration = static_cast<Decoration>(ops[1]);
-		ir.set_decoration_string(id, decoration, extract_string(ir.spirv, instruction.offset + 2));
+		ir.set_decoration_string(id, decoration, extract_string(ir, instruction.offset + 2));
 		break;
 	}
 
@@ -416,7 +435,7 @@ void Parser::parse(const Instruction &instruction)
 		uint32_t id = ops[0];
 		uint32_t member = ops[1];
 		auto decoration = static_cast<Decoration>(ops[2]);
-		ir.set_member_decoration_string(id, member, decoration, extract_string(ir.spirv, instruction.offset + 3));
+		ir.set_member_decoration_string(id, member, decoration, extract_string(ir, instruction.offset + 3));
 		break;
 	}
 
@@ -29,6 +29,12 @@ public:
 	Parser(const uint32_t *spirv_data, size_t word_count);
 	Parser(std::vector<uint32_t> spirv);
 
+	// If borrow_spirv is true, the words are not copied, and the ParsedIR refers directly to spirv_data
+	// (see ParsedIR::set_borrowed_spirv()). This is intended for memory mapped files or caller-owned arenas,
+	// and spirv_data must outlive the ParsedIR and every Compiler created from it.
+	// A module which needs an endian swap is still copied, as the words cannot be modified in-place.
+	Parser(const uint32_t *spirv_data, size_t word_count, bool borrow_spirv);
+
 	void parse();
 
 	ParsedIR &get_parsed_ir()
@@ -36,10 +36,15 @@ using Stack = std::stack<State>;
 class Stream
 {
 	Stack stack;
-	std::ostringstream buffer;
+	StringStream &buffer;
 	uint32_t indent{ 0 };
 
 public:
+	explicit Stream(StringStream &buffer_)
+	    : buffer(buffer_)
+	{
+	}
+
 	void begin_json_object();
 	void end_json_object();
 	void emit_json_key(const std::string &key);
@@ -56,16 +61,10 @@ public:
 	void emit_json_array_value(const std::string &value);
 	void emit_json_array_value(uint32_t value);
 
-	std::string str() const
-	{
-		return buffer.str();
-	}
-
 private:
 	inline void statement_indent()
 	{
-		for (uint32_t i = 0; i < indent; i++)
-			buffer << "    ";
+		buffer.append_spaces(indent * 4);
 	}
 
 	template <typename T>
@@ -148,7 +147,7 @@ void Stream::emit_json_array_value(uint32_t value)
 		SPIRV_CROSS_THROW("Invalid JSON state");
 	if (stack.top().second)
 		statement_inner(",\n");
-	statement_no_return(std::to_string(value));
+	statement_no_return(convert_to_string(value));
 	stack.top().second = true;
 }
 
@@ -245,20 +244,16 @@ void CompilerReflection::set_format(const std::string &format)
 	}
 }
 
-string CompilerReflection::compile()
+void CompilerReflection::emit_source()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
-
-	// Move constructor for this type is broken on GCC 4.9 ...
-	json_stream = std::make_shared<simple_json::Stream>();
+	buffer.reset();
+	json_stream = std::make_shared<simple_json::Stream>(buffer);
 	json_stream->begin_json_object();
 	emit_entry_points();
 	emit_types();
 	emit_resources();
 	emit_specialization_constants();
 	json_stream->end_json_object();
-	return json_stream->str();
 }
 
 void CompilerReflection::emit_types()
@@ -288,7 +283,7 @@ void CompilerReflection::emit_type(const SPIRType &type, bool &emitted_open_tag)
 		json_stream->emit_json_key_object("types");
 		emitted_open_tag = true;
 	}
-	json_stream->emit_json_key_object("_" + std::to_string(type.self));
+	json_stream->emit_json_key_object("_" + convert_to_string(type.self));
 	json_stream->emit_json_key_value("name", name);
 	json_stream->emit_json_key_array("members");
 	// FIXME ideally we'd like to emit the size of a structure as a
@@ -321,7 +316,7 @@ void CompilerReflection::emit_type_member(const SPIRType &type, uint32_t index)
 	json_stream->emit_json_key_value("name", name);
 	if (membertype.basetype == SPIRType::Struct)
 	{
-		json_stream->emit_json_key_value("type", "_" + std::to_string(membertype.self));
+		json_stream->emit_json_key_value("type", "_" + convert_to_string(membertype.self));
 	}
 	else
 	{
@@ -456,7 +451,7 @@ void CompilerReflection::emit_resources(const char *tag, const vector<Resource>
 
 		if (type.basetype == SPIRType::Struct)
 		{
-			json_stream->emit_json_key_value("type", "_" + std::to_string(res.base_type_id));
+			json_stream->emit_json_key_value("type", "_" + convert_to_string(res.base_type_id));
 		}
 		else
 		{
@@ -58,9 +58,9 @@ public:
 	}
 
 	void set_format(const std::string &format);
-	std::string compile() override;
 
 private:
+	void emit_source() override;
 	static std::string execution_model_to_str(spv::ExecutionModel model);
 
 	void emit_entry_points();
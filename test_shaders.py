@@ -277,8 +277,12 @@ def cross_compile_reflect(shader, spirv, opt):
 
     spirv_cross_path = './spirv-cross'
 
+    extra_args = []
+    if '.remove_unused_ir.' in shader:
+        extra_args += ['--remove-unused-ir']
+
     sm = shader_to_sm(shader)
-    subprocess.check_call([spirv_cross_path, '--entry', 'main', '--output', reflect_path, spirv_path, '--reflect'])
+    subprocess.check_call([spirv_cross_path, '--entry', 'main', '--output', reflect_path, spirv_path, '--reflect'] + extra_args)
     return (spirv_path, reflect_path)
 
 def validate_shader(shader, vulkan):
@@ -320,6 +324,12 @@ def cross_compile(shader, vulkan, spirv, invalid_spirv, eliminate, is_legacy, fl
         extra_args += ['--separate-shader-objects']
     if flatten_dim:
         extra_args += ['--flatten-multidimensional-arrays']
+    if '.fold_spec.' in shader:
+        extra_args += ['--fold-spec-constants']
+    if '.remove_unused_ir.' in shader:
+        extra_args += ['--remove-unused-ir']
+    if '.cse.' in shader:
+        extra_args += ['--eliminate-common-subexpressions']
 
     spirv_cross_path = './spirv-cross'
 
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+
+# Runs spirv-cross --batch on a manifest with one good and one malformed job.
+# The batch must fail as a whole, the good job must still write exactly what a standalone run writes,
+# and the malformed job must write nothing.
+# Usage: batch_cli_test.py <spirv-cross> <file.spv> <work directory>
+
+import sys
+import os
+import os.path
+import shutil
+import subprocess
+
+def fail(message):
+    print('batch_cli_test: ' + message, file = sys.stderr)
+    sys.exit(1)
+
+def main():
+    if len(sys.argv) != 4:
+        fail('Usage: batch_cli_test.py <spirv-cross> <file.spv> <work directory>')
+
+    spirv_cross, spirv, work = sys.argv[1:]
+    shutil.rmtree(work, ignore_errors = True)
+    os.makedirs(work)
+
+    args = ['--version', '450', '--vulkan-semantics']
+    reference = os.path.join(work, 'reference.glsl')
+    good = os.path.join(work, 'good.glsl')
+    bad = os.path.join(work, 'bad.glsl')
+    missing = os.path.join(work, 'missing.spv')
+
+    subprocess.check_call([spirv_cross, spirv] + args + ['--output', reference])
+
+    manifest = os.path.join(work, 'manifest.txt')
+    with open(manifest, 'w') as f:
+        f.write('# One job which succeeds and one whose input does not exist.\n')
+        f.write('"{}" {} --output "{}"\n'.format(spirv, ' '.join(args), good))
+        f.write('\n')
+        f.write('"{}" --output "{}"\n'.format(missing, bad))
+
+    result = subprocess.run([spirv_cross, '--batch', manifest, '--batch-threads', '2'],
+                            stdout = subprocess.PIPE, stderr = subprocess.PIPE, universal_newlines = True)
+
+    if result.returncode == 0:
+        fail('--batch succeeded although one of its jobs failed.')
+    if '{}:4: Job failed'.format(manifest) not in result.stderr:
+        fail('--batch did not report the failing job on line 4:\n' + result.stderr)
+    if '1 of 2 jobs' not in result.stderr:
+        fail('--batch did not report 1 of 2 jobs failing:\n' + result.stderr)
+
+    if not os.path.isfile(good):
+        fail('The good job did not write its output.')
+    with open(good, 'rb') as a, open(reference, 'rb') as b:
+        if a.read() != b.read():
+            fail('The good job wrote something else than a standalone run.')
+    if os.path.exists(bad):
+        fail('The malformed job wrote an output.')
+
+    print('--batch ran the good job and reported the malformed one.')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles every entry point of a module for every backend with compile_entry_points() on several threads,
+// so several views share one ParsedIR at once, and checks that each result is byte for byte what a standalone
+// compiler gives on its own parse of the module.
+// batch_test.spv is shaders/asm/comp/multiple-entry.asm.comp, which has a fragment and a compute entry point.
+// Usage: spirv-cross-batch-test <file.spv>...
+
+#include "spirv_cross_batch.hpp"
+#include "spirv_parser.hpp"
+#include "spirv_reflect.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+static bool same(const vector<Resource> &a, const vector<Resource> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].id != b[i].id || a[i].type_id != b[i].type_id || a[i].name != b[i].name)
+			return false;
+	return true;
+}
+
+static bool same(const ShaderResources &a, const ShaderResources &b)
+{
+	return same(a.uniform_buffers, b.uniform_buffers) && same(a.storage_buffers, b.storage_buffers) &&
+	       same(a.stage_inputs, b.stage_inputs) && same(a.stage_outputs, b.stage_outputs) &&
+	       same(a.storage_images, b.storage_images) && same(a.sampled_images, b.sampled_images) &&
+	       same(a.separate_images, b.separate_images) && same(a.separate_samplers, b.separate_samplers);
+}
+
+// Compiles entry on its own parse of spirv, the way an application would without the batch API.
+static BatchResult compile_standalone(const vector<uint32_t> &spirv, const BatchEntryPoint &entry)
+{
+	Parser parser(spirv);
+	parser.parse();
+	auto &ir = parser.get_parsed_ir();
+
+	unique_ptr<CompilerGLSL> compiler;
+	switch (entry.backend)
+	{
+	case BatchBackend::GLSL:
+		compiler.reset(new CompilerGLSL(move(ir)));
+		compiler->set_common_options(entry.common);
+		break;
+
+	case BatchBackend::HLSL:
+	{
+		auto *hlsl = new CompilerHLSL(move(ir));
+		compiler.reset(hlsl);
+		hlsl->set_common_options(entry.common);
+		hlsl->set_hlsl_options(entry.hlsl);
+		break;
+	}
+
+	case BatchBackend::MSL:
+	{
+		auto *msl = new CompilerMSL(move(ir));
+		compiler.reset(msl);
+		msl->set_common_options(entry.common);
+		msl->set_msl_options(entry.msl);
+		break;
+	}
+
+	case BatchBackend::Reflect:
+		compiler.reset(new CompilerReflection(move(ir)));
+		break;
+	}
+
+	BatchResult result;
+	try
+	{
+		compiler->set_entry_point(entry.name, entry.model);
+		result.source = compiler->compile();
+		result.resources = compiler->get_shader_resources(compiler->get_active_interface_variables());
+	}
+	catch (const exception &e)
+	{
+		result.source.clear();
+		result.resources = {};
+		result.error = e.what();
+	}
+	return result;
+}
+
+static bool test_module(const vector<uint32_t> &spirv)
+{
+	Parser parser(spirv);
+	parser.parse();
+	auto ir = make_shared<const ParsedIR>(move(parser.get_parsed_ir()));
+
+	// Every entry point for every backend, twice over, so there are more jobs than threads.
+	vector<BatchEntryPoint> entry_points;
+	const BatchBackend backends[] = { BatchBackend::GLSL, BatchBackend::HLSL, BatchBackend::MSL,
+		                              BatchBackend::Reflect };
+	for (uint32_t round = 0; round < 2; round++)
+	{
+		for (auto &ep : ir->entry_points)
+		{
+			for (auto backend : backends)
+			{
+				BatchEntryPoint entry;
+				entry.name = ep.second.orig_name;
+				entry.model = ep.second.model;
+				entry.backend = backend;
+				entry.common.version = 450;
+				entry.common.vulkan_semantics = backend == BatchBackend::GLSL;
+				entry.hlsl.shader_model = 50;
+				entry_points.push_back(entry);
+			}
+		}
+	}
+
+	auto results = compile_entry_points(ir, entry_points, 4);
+	CHECK(results.size() == entry_points.size());
+
+	for (size_t i = 0; i < entry_points.size(); i++)
+	{
+		auto expected = compile_standalone(spirv, entry_points[i]);
+		if (results[i].source != expected.source || results[i].error != expected.error ||
+		    !same(results[i].resources, expected.resources))
+		{
+			fprintf(stderr, "Entry point %s for backend %d differs from a standalone compile.\n",
+			        entry_points[i].name.c_str(), int(entry_points[i].backend));
+			return false;
+		}
+		CHECK(results[i].error.empty());
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-batch-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty() || !test_module(spirv))
+		{
+			fprintf(stderr, "%s failed.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Batch compiles matched standalone compiles for %d modules.\n", argc - 1);
+	return EXIT_SUCCESS;
+}
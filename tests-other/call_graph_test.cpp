@@ -0,0 +1,327 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the call graph and function summaries against a scan of the module, and that handlers which handle
+// each function once find the same as when every call is followed, on their own and sharing a traversal.
+// call_graph_test.spv calls the same functions from several places, has a function without any image
+// instructions, atomics or access chains, and one the entry point does not call.
+// Usage: spirv-cross-call-graph-test <file.spv>...
+
+#include "spirv_cross.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+struct Counts
+{
+	unsigned functions = 0;
+	unsigned ops_followed = 0;
+	unsigned ops_once = 0;
+};
+
+// The traversals only get used by the compiler itself, so do the same from a subclass.
+class CallGraphTester : public Compiler
+{
+public:
+	explicit CallGraphTester(ParsedIR ir_)
+	    : Compiler(move(ir_))
+	{
+	}
+
+	bool test(Counts &counts)
+	{
+		return test_call_graph(counts) && test_handlers(counts);
+	}
+
+private:
+	// Forwards to another handler, either following every call, or handling each function once like it does.
+	struct Forwarder : OpcodeHandler
+	{
+		Forwarder(OpcodeHandler &inner_, bool once_)
+		    : inner(inner_)
+		    , once(once_)
+		{
+		}
+
+		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override
+		{
+			ops++;
+			return inner.handle(opcode, args, length);
+		}
+
+		void set_current_block(const SPIRBlock &block) override
+		{
+			inner.set_current_block(block);
+		}
+
+		bool handles_each_function_once() const override
+		{
+			return once;
+		}
+
+		uint32_t get_opcode_filter() const override
+		{
+			return inner.get_opcode_filter();
+		}
+
+		OpcodeHandler &inner;
+		bool once;
+		unsigned ops = 0;
+	};
+
+	// Records the order in which the traversal first enters each function.
+	struct CallRecorder : OpcodeHandler
+	{
+		bool handle(spv::Op, const uint32_t *, uint32_t) override
+		{
+			return true;
+		}
+
+		bool follow_function_call(const SPIRFunction &func) override
+		{
+			if (find(begin(order), end(order), func.self) == end(order))
+				order.push_back(func.self);
+			return true;
+		}
+
+		vector<uint32_t> order;
+	};
+
+	// Runs the handler following every call, and then a copy of it once per function, and returns
+	// whether both found the same with compare(). Unlike the traversal with the handler itself, skipped
+	// functions are not counted as handled.
+	template <typename Handler, typename Compare>
+	bool compare_traversals(Handler &followed, Handler &once, Counts &counts, const Compare &compare)
+	{
+		auto &entry = get<SPIRFunction>(ir.default_entry_point);
+		Forwarder followed_forwarder(followed, false);
+		Forwarder once_forwarder(once, true);
+		traverse_all_reachable_opcodes(entry, followed_forwarder);
+		traverse_all_reachable_opcodes(entry, once_forwarder);
+		counts.ops_followed += followed_forwarder.ops;
+		counts.ops_once += once_forwarder.ops;
+		return once_forwarder.ops <= followed_forwarder.ops && compare(followed, once);
+	}
+
+	static bool same_ranges(const vector<BufferRange> &a, const vector<BufferRange> &b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+			if (a[i].index != b[i].index || a[i].offset != b[i].offset || a[i].range != b[i].range)
+				return false;
+		return true;
+	}
+
+	bool test_call_graph(Counts &counts)
+	{
+		auto &graph = get_call_graph();
+		CHECK(&graph == &get_call_graph());
+
+		std::set<uint32_t> reachable;
+		size_t function_count = 0;
+		ir.for_each_typed_id<SPIRFunction>([&](uint32_t, const SPIRFunction &) { function_count++; });
+		counts.functions += unsigned(function_count);
+
+		CallRecorder recorder;
+		traverse_all_reachable_opcodes(get<SPIRFunction>(ir.default_entry_point), recorder);
+		vector<uint32_t> order = { ir.default_entry_point };
+		order.insert(end(order), begin(recorder.order), end(recorder.order));
+		CHECK(graph.reachable_functions == order);
+		reachable.insert(begin(order), end(order));
+
+		std::set<uint32_t> reachable_variables;
+		for (auto &f : graph.functions)
+		{
+			auto &func = get<SPIRFunction>(f.first);
+			auto &summary = f.second;
+
+			// Callees and opcode kinds are what the instructions say.
+			vector<uint32_t> callees;
+			std::set<uint32_t> variables;
+			uint32_t opcodes = 0;
+			for (auto block : func.blocks)
+			{
+				for (auto &i : get<SPIRBlock>(block).ops)
+				{
+					auto ops = stream(i);
+					opcodes |= get_opcode_kinds(i);
+					if (i.op == spv::OpFunctionCall && find(begin(callees), end(callees), ops[2]) == end(callees))
+						callees.push_back(ops[2]);
+					for (uint32_t j = 0; j < i.length; j++)
+					{
+						auto *var = ops[j] < ir.ids.size() ? maybe_get<SPIRVariable>(ops[j]) : nullptr;
+						if (var && var->storage != spv::StorageClassFunction)
+							variables.insert(ops[j]);
+					}
+				}
+			}
+
+			CHECK(summary.callees == callees);
+			CHECK(summary.opcodes == opcodes);
+			CHECK(vector<uint32_t>(begin(variables), end(variables)) == summary.variables);
+
+			if (!reachable.count(f.first))
+			{
+				CHECK(summary.reachable_opcodes == OpcodeKindAllBits);
+				continue;
+			}
+
+			// The reachable opcodes are those of every function reached from this one.
+			std::set<uint32_t> seen = { f.first };
+			vector<uint32_t> stack = { f.first };
+			uint32_t reachable_opcodes = 0;
+			while (!stack.empty())
+			{
+				auto &other = graph.functions.find(stack.back())->second;
+				stack.pop_back();
+				reachable_opcodes |= other.opcodes;
+				for (auto callee : other.callees)
+					if (seen.insert(callee).second)
+						stack.push_back(callee);
+			}
+			CHECK(summary.reachable_opcodes == reachable_opcodes);
+			reachable_variables.insert(begin(variables), end(variables));
+		}
+
+		CHECK(graph.functions.size() == function_count);
+		CHECK(vector<uint32_t>(begin(reachable_variables), end(reachable_variables)) == graph.reachable_variables);
+		return true;
+	}
+
+	bool test_handlers(Counts &counts)
+	{
+		unordered_set<uint32_t> followed_variables, once_variables;
+		InterfaceVariableAccessHandler followed_interface(*this, followed_variables);
+		InterfaceVariableAccessHandler once_interface(*this, once_variables);
+		CHECK(compare_traversals(followed_interface, once_interface, counts,
+		                         [&](InterfaceVariableAccessHandler &, InterfaceVariableAccessHandler &) {
+			                         return followed_variables == once_variables;
+		                         }));
+
+		CombinedImageSamplerDrefHandler followed_dref(*this);
+		CombinedImageSamplerDrefHandler once_dref(*this);
+		CHECK(compare_traversals(followed_dref, once_dref, counts,
+		                         [](CombinedImageSamplerDrefHandler &a, CombinedImageSamplerDrefHandler &b) {
+			                         return a.dref_combined_samplers == b.dref_combined_samplers;
+		                         }));
+
+		DummySamplerForCombinedImageHandler followed_dummy(*this);
+		DummySamplerForCombinedImageHandler once_dummy(*this);
+		CHECK(compare_traversals(followed_dummy, once_dummy, counts,
+		                         [](DummySamplerForCombinedImageHandler &a, DummySamplerForCombinedImageHandler &b) {
+			                         return a.need_dummy_sampler == b.need_dummy_sampler;
+		                         }));
+
+		// Active builtins end up in the compiler itself.
+		auto &entry = get<SPIRFunction>(ir.default_entry_point);
+		ActiveBuiltinHandler builtins(*this);
+		Forwarder followed_builtins(builtins, false);
+		traverse_all_reachable_opcodes(entry, followed_builtins);
+		auto input_builtins = active_input_builtins;
+		auto output_builtins = active_output_builtins;
+		active_input_builtins.reset();
+		active_output_builtins.reset();
+		Forwarder once_builtins(builtins, true);
+		traverse_all_reachable_opcodes(entry, once_builtins);
+		CHECK(input_builtins == active_input_builtins && output_builtins == active_output_builtins);
+
+		// The ranges of every buffer, where the order of the ranges matters, and all of them in one traversal.
+		vector<uint32_t> buffers;
+		ir.for_each_typed_id<SPIRVariable>([&](uint32_t id, const SPIRVariable &var) {
+			auto &type = get<SPIRType>(var.basetype);
+			bool block = has_decoration(type.self, spv::DecorationBlock) ||
+			             has_decoration(type.self, spv::DecorationBufferBlock);
+			if ((var.storage == spv::StorageClassUniform || var.storage == spv::StorageClassStorageBuffer ||
+			     var.storage == spv::StorageClassPushConstant) &&
+			    block && type.array.empty())
+				buffers.push_back(id);
+		});
+
+		vector<vector<BufferRange>> fused_ranges(buffers.size());
+		vector<BufferAccessHandler> fused_handlers;
+		vector<OpcodeHandler *> fused_handler_ptrs;
+		fused_handlers.reserve(buffers.size());
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			fused_handlers.emplace_back(*this, fused_ranges[i], buffers[i]);
+			fused_handler_ptrs.push_back(&fused_handlers.back());
+		}
+		if (!buffers.empty())
+			traverse_all_reachable_opcodes(entry, fused_handler_ptrs);
+
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			vector<BufferRange> followed_ranges, once_ranges;
+			BufferAccessHandler followed_buffer(*this, followed_ranges, buffers[i]);
+			BufferAccessHandler once_buffer(*this, once_ranges, buffers[i]);
+			CHECK(compare_traversals(followed_buffer, once_buffer, counts,
+			                         [&](BufferAccessHandler &, BufferAccessHandler &) {
+				                         return same_ranges(followed_ranges, once_ranges);
+			                         }));
+			CHECK(same_ranges(followed_ranges, fused_ranges[i]));
+			CHECK(same_ranges(followed_ranges, get_active_buffer_ranges(buffers[i])));
+		}
+
+		return true;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-call-graph-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	Counts counts;
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		Parser parser(move(spirv));
+		parser.parse();
+
+		CallGraphTester tester(move(parser.get_parsed_ir()));
+		if (!tester.test(counts))
+		{
+			fprintf(stderr, "%s failed.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Make sure some functions were called more than once, or were skipped.
+	if (counts.ops_once >= counts.ops_followed)
+	{
+		fprintf(stderr, "Handling each function once did not save anything.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Checked %u functions, handling each function once took %u instead of %u instructions.\n",
+	       counts.functions, counts.ops_once, counts.ops_followed);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the CFG of every function against its definition: edges against the branches in the module,
+// and dominators, post-dominators and dominance frontiers against a brute force search which removes one block
+// at a time. cfg_test.spv has loops with breaks, an infinite loop, a switch with shared cases and fallthrough,
+// a selection with the same block on both sides and a do-while loop in a called function.
+// Usage: spirv-cross-cfg-test <file.spv>...
+
+#include "spirv_cfg.hpp"
+#include "spirv_cross.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+struct Counts
+{
+	unsigned blocks = 0;
+	unsigned joins = 0;
+	unsigned frontiers = 0;
+	unsigned post_dominated = 0;
+};
+
+// The CFG only gets constructed by the compiler itself, so do the same from a subclass.
+class CFGTester : public Compiler
+{
+public:
+	explicit CFGTester(ParsedIR ir_)
+	    : Compiler(move(ir_))
+	{
+	}
+
+	bool test(Counts &counts)
+	{
+		bool success = true;
+		ir.for_each_typed_id<SPIRFunction>([&](uint32_t, SPIRFunction &func) {
+			if (success && !test_function(func, counts))
+			{
+				fprintf(stderr, "Function %u failed.\n", func.self);
+				success = false;
+			}
+		});
+		return success;
+	}
+
+private:
+	static vector<uint32_t> branch_targets(const SPIRBlock &block)
+	{
+		vector<uint32_t> targets;
+		switch (block.terminator)
+		{
+		case SPIRBlock::Direct:
+			targets.push_back(block.next_block);
+			break;
+
+		case SPIRBlock::Select:
+			targets.push_back(block.true_block);
+			targets.push_back(block.false_block);
+			break;
+
+		case SPIRBlock::MultiSelect:
+			for (auto &target : block.cases)
+				targets.push_back(target.block);
+			if (block.default_block)
+				targets.push_back(block.default_block);
+			break;
+
+		default:
+			break;
+		}
+		return targets;
+	}
+
+	// Blocks reachable from start in the forward edges of the CFG without going through the removed block.
+	static std::set<uint32_t> reachable(const CFG &cfg, uint32_t start, uint32_t removed)
+	{
+		std::set<uint32_t> seen;
+		vector<uint32_t> stack;
+		if (start != removed)
+		{
+			seen.insert(start);
+			stack.push_back(start);
+		}
+
+		while (!stack.empty())
+		{
+			uint32_t block = stack.back();
+			stack.pop_back();
+			for (auto succ : cfg.get_succeeding_edges(block))
+			{
+				if (succ != removed && is_forward_edge(cfg, block, succ) && seen.insert(succ).second)
+					stack.push_back(succ);
+			}
+		}
+		return seen;
+	}
+
+	// Loop headers have an edge to their merge block, which might not be reachable, or might even be an ancestor.
+	static bool is_forward_edge(const CFG &cfg, uint32_t from, uint32_t to)
+	{
+		return cfg.get_immediate_dominator(to) && cfg.get_visit_order(to) < cfg.get_visit_order(from);
+	}
+
+	// Whether every path from block to the end of the function goes through post_dominator.
+	static bool post_dominates(const CFG &cfg, uint32_t post_dominator, uint32_t block)
+	{
+		if (block == post_dominator)
+			return true;
+
+		for (auto other : reachable(cfg, block, post_dominator))
+		{
+			bool has_successor = false;
+			for (auto succ : cfg.get_succeeding_edges(other))
+				if (is_forward_edge(cfg, other, succ))
+					has_successor = true;
+			if (!has_successor)
+				return false;
+		}
+		return true;
+	}
+
+	bool test_function(const SPIRFunction &func, Counts &counts)
+	{
+		CFG cfg(*this, func);
+
+		// Every block has a dense index.
+		CHECK(cfg.get_block_count() == func.blocks.size());
+		for (auto block : func.blocks)
+			CHECK(cfg.get_block_id(cfg.get_block_index(block)) == block);
+
+		// Every block the branches in the module reach from the entry must be visited.
+		std::set<uint32_t> blocks;
+		vector<uint32_t> stack = { func.entry_block };
+		blocks.insert(func.entry_block);
+		while (!stack.empty())
+		{
+			uint32_t block = stack.back();
+			stack.pop_back();
+			for (auto target : branch_targets(get<SPIRBlock>(block)))
+				if (blocks.insert(target).second)
+					stack.push_back(target);
+		}
+
+		for (auto block : blocks)
+		{
+			auto &spir_block = get<SPIRBlock>(block);
+			auto targets = branch_targets(spir_block);
+			auto succ = cfg.get_succeeding_edges(block);
+			CHECK(cfg.get_immediate_dominator(block) != 0);
+
+			// Edges go to branch targets or the merge block of a loop, once each, and always have a matching
+			// preceding edge.
+			std::set<uint32_t> unique_succ(succ.begin(), succ.end());
+			CHECK(unique_succ.size() == succ.size());
+			for (auto target : succ)
+			{
+				bool is_target = find(begin(targets), end(targets), target) != end(targets);
+				CHECK(is_target || (spir_block.merge == SPIRBlock::MergeLoop && target == spir_block.merge_block));
+
+				auto pred = cfg.get_preceding_edges(target);
+				CHECK(count(pred.begin(), pred.end(), block) == 1);
+			}
+
+			for (auto pred : cfg.get_preceding_edges(block))
+			{
+				auto pred_succ = cfg.get_succeeding_edges(pred);
+				CHECK(find(pred_succ.begin(), pred_succ.end(), block) != pred_succ.end());
+			}
+
+			// Branches which are not edges are back edges to a block which was still being visited, maybe itself.
+			for (auto target : targets)
+			{
+				if (unique_succ.count(target))
+					CHECK(cfg.get_visit_order(target) < cfg.get_visit_order(block));
+				else
+					CHECK(cfg.get_visit_order(target) >= cfg.get_visit_order(block));
+			}
+
+			// walk_from() reaches every block exactly once.
+			vector<uint32_t> walked;
+			cfg.walk_from(block, [&](uint32_t walk_block) { walked.push_back(walk_block); });
+			std::set<uint32_t> unique_walked(begin(walked), end(walked));
+			CHECK(unique_walked.size() == walked.size());
+			CHECK(walked.front() == block);
+			for (auto walk_block : walked)
+				for (auto next : cfg.get_succeeding_edges(walk_block))
+					CHECK(unique_walked.count(next));
+		}
+
+		for (auto block : blocks)
+		{
+			// The dominators of a block are the blocks which make it unreachable when removed.
+			// The immediate one is visited first, as dominators are visited after the blocks they dominate.
+			uint32_t idom = block;
+			for (auto other : blocks)
+			{
+				bool dominates = other == block || !reachable(cfg, func.entry_block, other).count(block);
+				CHECK(cfg.dominates(other, block) == dominates);
+				if (dominates && other != block &&
+				    (idom == block || cfg.get_visit_order(other) < cfg.get_visit_order(idom)))
+					idom = other;
+			}
+			CHECK(cfg.get_immediate_dominator(block) == idom);
+
+			// The post-dominators are found the same way from the block towards the end of the function.
+			uint32_t ipdom = 0;
+			for (auto other : blocks)
+			{
+				if (other != block && post_dominates(cfg, other, block) &&
+				    (!ipdom || cfg.get_visit_order(other) > cfg.get_visit_order(ipdom)))
+					ipdom = other;
+			}
+			CHECK(cfg.get_immediate_post_dominator(block) == ipdom);
+			if (ipdom)
+			{
+				CHECK(cfg.find_common_post_dominator(block, ipdom) == ipdom);
+				counts.post_dominated++;
+			}
+
+			// The dominance frontier is where a block stops dominating, one edge away from blocks it dominates.
+			std::set<uint32_t> frontier;
+			for (auto other : blocks)
+			{
+				bool strictly_dominates = other != block && cfg.dominates(block, other);
+				for (auto pred : cfg.get_preceding_edges(other))
+				{
+					if (is_forward_edge(cfg, pred, other) && cfg.dominates(block, pred) && !strictly_dominates)
+						frontier.insert(other);
+				}
+			}
+
+			auto actual = cfg.get_dominance_frontier(block);
+			CHECK(std::set<uint32_t>(actual.begin(), actual.end()) == frontier);
+			CHECK(frontier.size() == actual.size());
+			counts.frontiers += unsigned(frontier.size());
+
+			if (cfg.get_preceding_edges(block).size() > 1)
+				counts.joins++;
+			counts.blocks++;
+		}
+
+		return true;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-cfg-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	Counts counts;
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		Parser parser(move(spirv));
+		parser.parse();
+
+		CFGTester tester(move(parser.get_parsed_ir()));
+		if (!tester.test(counts))
+		{
+			fprintf(stderr, "%s failed.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Make sure the modules had some control flow to check at all.
+	if (counts.joins == 0 || counts.frontiers == 0 || counts.post_dominated == 0)
+	{
+		fprintf(stderr, "No join points, dominance frontiers or post-dominators were found.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Checked %u blocks with %u join points, %u dominance frontier entries and %u post-dominated blocks.\n",
+	       counts.blocks, counts.joins, counts.frontiers, counts.post_dominated);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that CompileCache returns what was stored, rejects damaged entries, evicts the least recently used entry,
+// only deletes temporary files once they are stale, and keeps every entry intact when many threads store and load the same keys at once.
+// Usage: spirv-cross-compile-cache-test <cache directory>
+
+#include "spirv_cross_cache.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+using namespace spirv_cross;
+using namespace std;
+
+static CompileCacheKey make_key(uint32_t id)
+{
+	static const uint32_t spirv[] = { 0x07230203, 0x00010000, 0, 16, 0 };
+	CompileCacheKey key;
+	key.add(spirv, sizeof(spirv) / sizeof(spirv[0]));
+	key.add(CompilerGLSL::Options());
+	key.add(id);
+	return key;
+}
+
+static CompileCacheEntry make_entry(uint32_t id)
+{
+	CompileCacheEntry entry;
+	entry.source = string(100, char('a' + id % 26));
+	entry.reflection = "{ \"id\" : " + to_string(id) + " }";
+	return entry;
+}
+
+static bool matches(const CompileCacheEntry &a, const CompileCacheEntry &b)
+{
+	return a.source == b.source && a.reflection == b.reflection;
+}
+
+static bool test_cache(const string &directory)
+{
+	// A cache with no room deletes every entry it finds, which clears out earlier runs.
+	CompileCache(directory, 0).store(make_key(0), make_entry(0));
+
+	// Keys depend on everything which is added.
+	CHECK(make_key(1).get() == make_key(1).get());
+	CHECK(make_key(1).get() != make_key(2).get());
+	CompileCacheKey es_key = make_key(1);
+	CompilerGLSL::Options es_options;
+	es_options.es = true;
+	es_key.add(es_options);
+	CHECK(es_key.get() != make_key(1).get());
+
+	// Round trip.
+	{
+		CompileCache cache(directory);
+		CompileCacheEntry entry;
+		CHECK(!cache.load(make_key(1), entry));
+		CHECK(cache.store(make_key(1), make_entry(1)));
+		CHECK(cache.load(make_key(1), entry));
+		CHECK(matches(entry, make_entry(1)));
+		CHECK(CompileCache(directory).load(make_key(1), entry));
+	}
+
+	// A damaged entry is a miss.
+	{
+		CompileCache cache(directory);
+		CHECK(cache.store(make_key(2), make_entry(2)));
+		string path = directory + "/" + make_key(2).get() + ".spvc";
+		FILE *file = fopen(path.c_str(), "r+b");
+		CHECK(file);
+		fseek(file, -1, SEEK_END);
+		fputs("xx", file);
+		fclose(file);
+
+		CompileCacheEntry entry;
+		CHECK(!cache.load(make_key(2), entry));
+		CHECK(cache.load(make_key(1), entry));
+	}
+
+	// Three entries do not fit, so the one which was used least recently goes.
+	{
+		CompileCache(directory, 0).store(make_key(0), make_entry(0));
+
+		uint64_t entry_size = 16 + 32 + make_entry(3).source.size() + make_entry(3).reflection.size();
+		CompileCache cache(directory, entry_size * 28 / 10);
+		CHECK(cache.store(make_key(3), make_entry(3)));
+		CHECK(cache.store(make_key(4), make_entry(4)));
+
+		// File times may only have a resolution of a second.
+		this_thread::sleep_for(chrono::milliseconds(1100));
+		CompileCacheEntry entry;
+		CHECK(cache.load(make_key(3), entry));
+		CHECK(cache.store(make_key(5), make_entry(5)));
+
+		CHECK(cache.load(make_key(3), entry));
+		CHECK(!cache.load(make_key(4), entry));
+		CHECK(cache.load(make_key(5), entry));
+	}
+
+	// Eviction leaves temporary files of stores in progress alone, and deletes those left behind long ago.
+	{
+		string fresh = directory + "/" + make_key(6).get() + ".spvc.1.0.tmp";
+		string stale = directory + "/" + make_key(7).get() + ".spvc.1.0.tmp";
+		for (auto *path : { &fresh, &stale })
+		{
+			FILE *file = fopen(path->c_str(), "wb");
+			CHECK(file);
+			fputs("partial", file);
+			fclose(file);
+		}
+
+		struct utimbuf times = {};
+		times.actime = times.modtime = time(nullptr) - 2 * 60 * 60;
+		CHECK(utime(stale.c_str(), &times) == 0);
+
+		CompileCache(directory, 0).store(make_key(0), make_entry(0));
+		FILE *file = fopen(fresh.c_str(), "rb");
+		CHECK(file);
+		fclose(file);
+		CHECK(!fopen(stale.c_str(), "rb"));
+		remove(fresh.c_str());
+	}
+
+	// Many writers and readers on a few keys. A load must either miss or return the complete entry.
+	{
+		CompileCache cache(directory);
+		const unsigned thread_count = 8;
+		const unsigned iterations = 200;
+		atomic<unsigned> failures(0);
+
+		vector<thread> workers;
+		for (unsigned i = 0; i < thread_count; i++)
+		{
+			workers.emplace_back([&, i]() {
+				for (unsigned iteration = 0; iteration < iterations; iteration++)
+				{
+					uint32_t id = 10 + (i + iteration) % 4;
+					CompileCacheEntry entry;
+					if (cache.load(make_key(id), entry) && !matches(entry, make_entry(id)))
+						failures++;
+					if (!cache.store(make_key(id), make_entry(id)))
+						failures++;
+				}
+			});
+		}
+
+		for (auto &worker : workers)
+			worker.join();
+		CHECK(failures == 0);
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-compile-cache-test <cache directory>\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!test_cache(argv[1]))
+		return EXIT_FAILURE;
+
+	printf("Compile cache behaved as expected.\n");
+	return EXIT_SUCCESS;
+}
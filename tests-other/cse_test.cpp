@@ -0,0 +1,326 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that Compiler::eliminate_common_subexpressions() only lets instructions reuse results which dominate them,
+// and that the output still compiles and gets shorter.
+// cse_test.spv repeats expressions in the same block, in a dominated block and in sibling branches, and uses the
+// repeats in a phi, a branch condition, a return value, a function call, a sample and a derivative.
+// Repeats which have to go are named *_dup, except those the test expects to stay, see kept below.
+// The other files are only checked for valid rewrites and for still compiling.
+// Usage: spirv-cross-cse-test <cse_test.spv> [file.spv]...
+
+#include "spirv_cfg.hpp"
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+// Runs the pass and looks at the blocks before and after, which only the compiler itself can do.
+class CSETester : public CompilerGLSL
+{
+	struct BlockTerminator
+	{
+		uint32_t condition;
+		uint32_t return_value;
+		vector<uint32_t> phi_values;
+	};
+
+public:
+	explicit CSETester(const ParsedIR &ir_)
+	    : CompilerGLSL(ir_)
+	{
+	}
+
+	// Also returns the number of removed instructions.
+	bool run(uint32_t &removed)
+	{
+		vector<uint32_t> words(ir.get_spirv_words(), ir.get_spirv_words() + ir.get_spirv_word_count());
+		unordered_map<uint32_t, BlockTerminator> terminators;
+		unordered_map<uint32_t, uint32_t> defined_before;
+		ir.for_each_typed_id<SPIRFunction>([&](uint32_t, const SPIRFunction &func) {
+			for (auto block : func.blocks)
+				terminators[block] = get_terminator(block);
+		});
+		find_definitions(defined_before);
+
+		eliminate_common_subexpressions();
+
+		unordered_map<uint32_t, uint32_t> defined;
+		find_definitions(defined);
+		removed = uint32_t(defined_before.size() - defined.size());
+
+		bool ok = true;
+		ir.for_each_typed_id<SPIRFunction>([&](uint32_t, const SPIRFunction &func) {
+			if (ok)
+				ok = check_function(func, words, terminators, defined_before, defined);
+		});
+		return ok;
+	}
+
+	bool is_defined(const char *name)
+	{
+		unordered_map<uint32_t, uint32_t> defined;
+		find_definitions(defined);
+		for (auto &def : defined)
+			if (get_name(def.first) == name)
+				return true;
+		return false;
+	}
+
+private:
+	BlockTerminator get_terminator(uint32_t block_id)
+	{
+		auto &block = get<SPIRBlock>(block_id);
+		BlockTerminator terminator = { block.condition, block.return_value, {} };
+		for (auto &phi : block.phi_variables)
+			terminator.phi_values.push_back(phi.local_variable);
+		return terminator;
+	}
+
+	// Maps the results of arithmetic and logic instructions to their blocks. Those are the only ones the pass
+	// rewrites uses of, and all of them have a result type and an ID.
+	void find_definitions(unordered_map<uint32_t, uint32_t> &defined)
+	{
+		ir.for_each_typed_id<SPIRFunction>([&](uint32_t, const SPIRFunction &func) {
+			for (auto block : func.blocks)
+			{
+				for (auto &i : get<SPIRBlock>(block).ops)
+				{
+					auto op = static_cast<spv::Op>(i.op);
+					bool has_result = (op >= spv::OpConvertFToU && op <= spv::OpFUnordGreaterThanEqual) ||
+					                  (op >= spv::OpVectorExtractDynamic && op <= spv::OpCopyObject) ||
+					                  (op >= spv::OpShiftRightLogical && op <= spv::OpBitCount) ||
+					                  op == spv::OpExtInst;
+					if (has_result && i.length >= 2)
+						defined[stream(i)[1]] = block;
+				}
+			}
+		});
+	}
+
+	// Whether the value is available in the block, or for uses in the block, before instruction index.
+	bool available(const CFG &cfg, const unordered_map<uint32_t, uint32_t> &defined, uint32_t value,
+	               uint32_t block, size_t index)
+	{
+		auto itr = defined.find(value);
+		if (itr == end(defined))
+			return false;
+		if (itr->second != block)
+			return cfg.dominates(itr->second, block);
+
+		auto &ops = get<SPIRBlock>(block).ops;
+		for (size_t i = 0; i < index && i < ops.size(); i++)
+			if (ops[i].length >= 2 && stream(ops[i])[1] == value)
+				return true;
+		return false;
+	}
+
+	// Every operand which changed has to refer to a result which is still there and dominates the use,
+	// instead of one which was removed.
+	bool check_change(const CFG &cfg, const unordered_map<uint32_t, uint32_t> &defined_before,
+	                  const unordered_map<uint32_t, uint32_t> &defined, uint32_t before, uint32_t after,
+	                  uint32_t block, size_t index)
+	{
+		if (before == after)
+			return true;
+		CHECK(defined_before.count(before) && !defined.count(before));
+		CHECK(available(cfg, defined, after, block, index));
+		return true;
+	}
+
+	bool check_function(const SPIRFunction &func, const vector<uint32_t> &words,
+	                    const unordered_map<uint32_t, BlockTerminator> &terminators,
+	                    const unordered_map<uint32_t, uint32_t> &defined_before,
+	                    const unordered_map<uint32_t, uint32_t> &defined)
+	{
+		if (func.blocks.empty())
+			return true;
+
+		CFG cfg(*this, func);
+		for (auto block_id : func.blocks)
+		{
+			auto &block = get<SPIRBlock>(block_id);
+			for (size_t i = 0; i < block.ops.size(); i++)
+			{
+				auto &instr = block.ops[i];
+				auto ops = stream(instr);
+				for (uint32_t j = 0; j < instr.length; j++)
+					CHECK(check_change(cfg, defined_before, defined, words[instr.offset + j], ops[j], block_id, i));
+			}
+
+			// Conditions and return values come after all instructions, phi values at the end of the incoming block.
+			auto &terminator = terminators.find(block_id)->second;
+			CHECK(check_change(cfg, defined_before, defined, terminator.condition, block.condition, block_id,
+			                   block.ops.size()));
+			CHECK(check_change(cfg, defined_before, defined, terminator.return_value, block.return_value, block_id,
+			                   block.ops.size()));
+			CHECK(terminator.phi_values.size() == block.phi_variables.size());
+			for (size_t i = 0; i < block.phi_variables.size(); i++)
+			{
+				auto &phi = block.phi_variables[i];
+				CHECK(check_change(cfg, defined_before, defined, terminator.phi_values[i], phi.local_variable,
+				                   phi.parent, get<SPIRBlock>(phi.parent).ops.size()));
+			}
+		}
+		return true;
+	}
+};
+
+enum Backend
+{
+	BackendGLSL,
+	BackendHLSL,
+	BackendMSL,
+	BackendCount
+};
+
+static const char *backend_names[BackendCount] = { "GLSL", "HLSL", "MSL" };
+
+static unique_ptr<CompilerGLSL> create_compiler(const ParsedIR &ir, Backend backend)
+{
+	switch (backend)
+	{
+	case BackendGLSL:
+	{
+		unique_ptr<CompilerGLSL> compiler(new CompilerGLSL(ir));
+		auto opts = compiler->get_common_options();
+		opts.version = 450;
+		opts.es = false;
+		compiler->set_common_options(opts);
+		return compiler;
+	}
+
+	case BackendHLSL:
+	{
+		auto *compiler = new CompilerHLSL(ir);
+		auto opts = compiler->get_hlsl_options();
+		opts.shader_model = 50;
+		compiler->set_hlsl_options(opts);
+		return unique_ptr<CompilerGLSL>(compiler);
+	}
+
+	default:
+		return unique_ptr<CompilerGLSL>(new CompilerMSL(ir));
+	}
+}
+
+static bool test_fixture(const ParsedIR &ir, uint32_t &removed)
+{
+	CSETester tester(ir);
+	CHECK(tester.run(removed));
+
+	const char *merged[] = { "mul_dup", "add_dup", "cond_dup", "dom", "coord_dup", "len_dup", "h2" };
+	for (auto *name : merged)
+	{
+		if (tester.is_defined(name))
+		{
+			fprintf(stderr, "%s was not shared.\n", name);
+			return false;
+		}
+	}
+
+	// x0_dup is only a swizzle, precise is NoContraction, sib_dup is in the other branch,
+	// and a derivative, which the pass does not know the operands of, uses deriv_dup.
+	const char *kept[] = { "x0",    "x0_dup", "mul", "add",    "precise", "cond",      "sib",
+		                   "coord", "len",    "h1",  "sib_dup", "deriv", "deriv_dup" };
+	for (auto *name : kept)
+	{
+		if (!tester.is_defined(name))
+		{
+			fprintf(stderr, "%s was removed.\n", name);
+			return false;
+		}
+	}
+	CHECK(removed == sizeof(merged) / sizeof(merged[0]));
+
+	for (int backend = 0; backend < BackendCount; backend++)
+	{
+		auto before = create_compiler(ir, Backend(backend))->compile();
+		auto compiler = create_compiler(ir, Backend(backend));
+		compiler->eliminate_common_subexpressions();
+		auto after = compiler->compile();
+		if (after.size() >= before.size())
+		{
+			fprintf(stderr, "%s did not get shorter.\n%s\n", backend_names[backend], after.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Anything which compiled before has to compile afterwards.
+static bool test_file(const ParsedIR &ir, uint32_t &removed)
+{
+	CSETester tester(ir);
+	CHECK(tester.run(removed));
+
+	string before;
+	try
+	{
+		before = create_compiler(ir, BackendGLSL)->compile();
+	}
+	catch (const CompilerError &)
+	{
+		return true;
+	}
+
+	auto compiler = create_compiler(ir, BackendGLSL);
+	compiler->eliminate_common_subexpressions();
+	CHECK(compiler->compile().size() <= before.size());
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-cse-test <cse_test.spv> [file.spv]...\n");
+		return EXIT_FAILURE;
+	}
+
+	uint32_t removed = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		Parser parser(move(spirv));
+		parser.parse();
+		auto &ir = parser.get_parsed_ir();
+
+		uint32_t file_removed = 0;
+		if (!(i == 1 ? test_fixture(ir, file_removed) : test_file(ir, file_removed)))
+		{
+			fprintf(stderr, "%s failed.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+		removed += file_removed;
+	}
+
+	printf("Shared common subexpressions in %d files, %u instructions removed.\n", argc - 1, removed);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the dataflow solver on the CFG of every function. BlockDataflow is compared with naive iteration over
+// all blocks until nothing changes, in both directions and with both meets. LivenessAnalysis and
+// ReachingDefinitions are compared with searches along the edges of the CFG, which follow their definitions
+// rather than the equations, and reaching definitions with one definition per block must match the dominators.
+// Gen and kill sets are picked from the block index, so every function gets a different mix.
+// Usage: spirv-cross-dataflow-test <file.spv>...
+
+#include "spirv_cfg.hpp"
+#include "spirv_cross.hpp"
+#include "spirv_dataflow.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+struct Counts
+{
+	unsigned blocks = 0;
+	unsigned live = 0;
+	unsigned must_reach = 0;
+	unsigned dominated = 0;
+};
+
+typedef vector<vector<bool>> BlockBits;
+
+// The CFG only gets constructed by the compiler itself, so do the same from a subclass.
+class DataflowTester : public Compiler
+{
+public:
+	explicit DataflowTester(ParsedIR ir_)
+	    : Compiler(move(ir_))
+	{
+	}
+
+	bool test(Counts &counts)
+	{
+		bool success = true;
+		ir.for_each_typed_id<SPIRFunction>([&](uint32_t, SPIRFunction &func) {
+			if (success && !test_function(func, counts))
+			{
+				fprintf(stderr, "Function %u failed.\n", func.self);
+				success = false;
+			}
+		});
+		return success;
+	}
+
+private:
+	static const uint32_t bit_count = 70;
+
+	// Sets of bits per block which are neither too sparse nor too dense, and differ between the sets.
+	static BlockBits pick_bits(uint32_t block_count, uint32_t seed, uint32_t modulo)
+	{
+		BlockBits bits(block_count, vector<bool>(bit_count));
+		for (uint32_t block = 0; block < block_count; block++)
+			for (uint32_t bit = 0; bit < bit_count; bit++)
+				bits[block][bit] = (block * seed + bit * 3 + seed) % modulo == 0;
+		return bits;
+	}
+
+	// Solves the dataflow problem by going over all blocks until nothing changes, with gen and kill sets and
+	// the boundary picked from the block index, and compares with BlockDataflow.
+	static bool test_block_dataflow(const CFG &cfg, BlockDataflow::Direction direction, BlockDataflow::Meet meet)
+	{
+		uint32_t block_count = cfg.get_block_count();
+		BlockDataflow dataflow(cfg, direction, meet, bit_count);
+
+		auto gen = pick_bits(block_count, 7, 5);
+		auto kill = pick_bits(block_count, 3, 4);
+		vector<bool> boundary(bit_count);
+		DenseBitset dense_boundary(bit_count);
+
+		for (uint32_t bit = 0; bit < bit_count; bit++)
+		{
+			for (uint32_t block = 0; block < block_count; block++)
+			{
+				if (gen[block][bit])
+					dataflow.get_gen(block).set(bit);
+				if (kill[block][bit])
+					dataflow.get_kill(block).set(bit);
+			}
+
+			boundary[bit] = bit % 3 == 0;
+			if (boundary[bit])
+				dense_boundary.set(bit);
+		}
+
+		dataflow.set_boundary(dense_boundary);
+		dataflow.solve();
+
+		BlockBits input(block_count, vector<bool>(bit_count));
+		BlockBits output(block_count, vector<bool>(bit_count, meet == BlockDataflow::Intersection));
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (uint32_t index = 0; index < block_count; index++)
+			{
+				uint32_t block = cfg.get_block_id(index);
+				auto neighbours = direction == BlockDataflow::Forward ? cfg.get_preceding_edges(block) :
+				                                                        cfg.get_succeeding_edges(block);
+				bool is_boundary = direction == BlockDataflow::Forward ? block == cfg.get_function().entry_block :
+				                                                         cfg.get_succeeding_edges(block).empty();
+
+				for (uint32_t bit = 0; bit < bit_count; bit++)
+				{
+					bool value = meet == BlockDataflow::Intersection;
+					if (is_boundary)
+						value = boundary[bit];
+					else
+					{
+						for (auto neighbour : neighbours)
+						{
+							bool other = output[cfg.get_block_index(neighbour)][bit];
+							value = meet == BlockDataflow::Union ? (value || other) : (value && other);
+						}
+					}
+
+					input[index][bit] = value;
+					value = gen[index][bit] || (value && !kill[index][bit]);
+					if (output[index][bit] != value)
+					{
+						output[index][bit] = value;
+						changed = true;
+					}
+				}
+			}
+		}
+
+		for (uint32_t index = 0; index < block_count; index++)
+		{
+			for (uint32_t bit = 0; bit < bit_count; bit++)
+			{
+				CHECK(dataflow.get_input(index).get(bit) == input[index][bit]);
+				CHECK(dataflow.get_output(index).get(bit) == output[index][bit]);
+			}
+		}
+
+		return true;
+	}
+
+	// Whether some path starting at the block reads the variable before a block which only writes it.
+	static bool is_live(const CFG &cfg, uint32_t block, const BlockBits &use, const BlockBits &def, uint32_t bit)
+	{
+		std::set<uint32_t> seen = { block };
+		vector<uint32_t> stack = { block };
+		while (!stack.empty())
+		{
+			uint32_t index = cfg.get_block_index(stack.back());
+			stack.pop_back();
+			if (use[index][bit])
+				return true;
+			if (def[index][bit])
+				continue;
+
+			for (auto succ : cfg.get_succeeding_edges(cfg.get_block_id(index)))
+				if (seen.insert(succ).second)
+					stack.push_back(succ);
+		}
+		return false;
+	}
+
+	static bool test_liveness(const CFG &cfg, Counts &counts)
+	{
+		uint32_t block_count = cfg.get_block_count();
+		LivenessAnalysis liveness(cfg, bit_count);
+
+		auto use = pick_bits(block_count, 5, 7);
+		auto def = pick_bits(block_count, 3, 2);
+		for (uint32_t block = 0; block < block_count; block++)
+		{
+			for (uint32_t bit = 0; bit < bit_count; bit++)
+			{
+				if (use[block][bit])
+					liveness.add_use(block, bit);
+				if (def[block][bit])
+					liveness.add_definition(block, bit);
+			}
+		}
+		liveness.solve();
+
+		for (uint32_t index = 0; index < block_count; index++)
+		{
+			uint32_t block = cfg.get_block_id(index);
+			for (uint32_t bit = 0; bit < bit_count; bit++)
+			{
+				bool live_in = is_live(cfg, block, use, def, bit);
+				bool live_out = false;
+				for (auto succ : cfg.get_succeeding_edges(block))
+					live_out = live_out || is_live(cfg, succ, use, def, bit);
+
+				CHECK(liveness.get_live_in(index).get(bit) == live_in);
+				CHECK(liveness.get_live_out(index).get(bit) == live_out);
+				if (live_in)
+					counts.live++;
+			}
+		}
+
+		return true;
+	}
+
+	// Searches backwards from the start of the block. For MayReach, whether some path from a definition gets there
+	// without a kill. For MustReach, whether no path gets there from the entry or from a kill without passing
+	// a definition. Blocks without predecessors other than the entry start out with every definition,
+	// like the solver does.
+	static bool reaches(const CFG &cfg, ReachingDefinitions::Mode mode, uint32_t block, const BlockBits &gen,
+	                    const BlockBits &kill, uint32_t bit)
+	{
+		bool must = mode == ReachingDefinitions::MustReach;
+		uint32_t entry = cfg.get_function().entry_block;
+		if (block == entry)
+			return false;
+
+		auto preceding = cfg.get_preceding_edges(block);
+		std::set<uint32_t> seen(preceding.begin(), preceding.end());
+		vector<uint32_t> stack(preceding.begin(), preceding.end());
+		while (!stack.empty())
+		{
+			uint32_t pred = stack.back();
+			uint32_t index = cfg.get_block_index(pred);
+			stack.pop_back();
+
+			// A definition on the path decides it.
+			if (gen[index][bit])
+			{
+				if (!must)
+					return true;
+				continue;
+			}
+
+			// So does a kill, or reaching the entry, where nothing is defined yet.
+			if (kill[index][bit] || pred == entry)
+			{
+				if (must)
+					return false;
+				continue;
+			}
+
+			for (auto next : cfg.get_preceding_edges(pred))
+				if (seen.insert(next).second)
+					stack.push_back(next);
+		}
+		return must;
+	}
+
+	static bool test_reaching_definitions(const CFG &cfg, ReachingDefinitions::Mode mode, Counts &counts)
+	{
+		uint32_t block_count = cfg.get_block_count();
+		ReachingDefinitions definitions(cfg, mode, bit_count);
+
+		// Kills are rare, so definitions get a chance to reach every path.
+		auto gen = pick_bits(block_count, 7, 3);
+		auto kill = pick_bits(block_count, 11, 9);
+		for (uint32_t block = 0; block < block_count; block++)
+		{
+			for (uint32_t bit = 0; bit < bit_count; bit++)
+			{
+				if (gen[block][bit])
+					definitions.add_definition(block, bit);
+				if (kill[block][bit])
+					definitions.add_kill(block, bit);
+			}
+		}
+		definitions.solve();
+
+		bool must = mode == ReachingDefinitions::MustReach;
+		vector<bool> exit(bit_count, must);
+		for (uint32_t index = 0; index < block_count; index++)
+		{
+			uint32_t block = cfg.get_block_id(index);
+			bool is_exit = cfg.get_succeeding_edges(block).empty();
+			for (uint32_t bit = 0; bit < bit_count; bit++)
+			{
+				bool reaching_in = reaches(cfg, mode, block, gen, kill, bit);
+				bool reaching_out = gen[index][bit] || (reaching_in && !kill[index][bit]);
+
+				CHECK(definitions.get_reaching_in(index).get(bit) == reaching_in);
+				CHECK(definitions.get_reaching_out(index).get(bit) == reaching_out);
+				if (is_exit)
+					exit[bit] = must ? (exit[bit] && reaching_out) : (exit[bit] || reaching_out);
+				if (must && reaching_in)
+					counts.must_reach++;
+			}
+		}
+
+		auto reaching_exit = definitions.get_reaching_exit();
+		for (uint32_t bit = 0; bit < bit_count; bit++)
+			CHECK(reaching_exit.get(bit) == exit[bit]);
+
+		return true;
+	}
+
+	// With one definition per block and no kills, the definitions which must reach a block are its strict dominators.
+	bool test_dominators(const CFG &cfg, Counts &counts)
+	{
+		uint32_t block_count = cfg.get_block_count();
+		ReachingDefinitions definitions(cfg, ReachingDefinitions::MustReach, block_count);
+		for (uint32_t index = 0; index < block_count; index++)
+			definitions.add_definition(index, index);
+		definitions.solve();
+
+		for (uint32_t index = 0; index < block_count; index++)
+		{
+			uint32_t block = cfg.get_block_id(index);
+			if (!cfg.get_immediate_dominator(block))
+				continue;
+
+			for (uint32_t other = 0; other < block_count; other++)
+			{
+				uint32_t dominator = cfg.get_block_id(other);
+				if (!cfg.get_immediate_dominator(dominator))
+					continue;
+
+				bool strictly_dominates = dominator != block && cfg.dominates(dominator, block);
+				CHECK(definitions.get_reaching_in(index).get(other) == strictly_dominates);
+				if (strictly_dominates)
+					counts.dominated++;
+			}
+		}
+
+		return true;
+	}
+
+	bool test_function(const SPIRFunction &func, Counts &counts)
+	{
+		if (func.blocks.empty())
+			return true;
+
+		CFG cfg(*this, func);
+		counts.blocks += cfg.get_block_count();
+
+		return test_block_dataflow(cfg, BlockDataflow::Forward, BlockDataflow::Union) &&
+		       test_block_dataflow(cfg, BlockDataflow::Forward, BlockDataflow::Intersection) &&
+		       test_block_dataflow(cfg, BlockDataflow::Backward, BlockDataflow::Union) &&
+		       test_block_dataflow(cfg, BlockDataflow::Backward, BlockDataflow::Intersection) &&
+		       test_liveness(cfg, counts) &&
+		       test_reaching_definitions(cfg, ReachingDefinitions::MayReach, counts) &&
+		       test_reaching_definitions(cfg, ReachingDefinitions::MustReach, counts) &&
+		       test_dominators(cfg, counts);
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-dataflow-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	Counts counts;
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		Parser parser(move(spirv));
+		parser.parse();
+
+		DataflowTester tester(move(parser.get_parsed_ir()));
+		if (!tester.test(counts))
+		{
+			fprintf(stderr, "%s failed.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Make sure the problems had some non-trivial answers to check at all.
+	if (counts.live == 0 || counts.must_reach == 0 || counts.dominated == 0)
+	{
+		fprintf(stderr, "No live variables, definitions which must reach or dominated blocks were found.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Checked %u blocks with %u live variables, %u definitions which must reach and %u dominated blocks.\n",
+	       counts.blocks, counts.live, counts.must_reach, counts.dominated);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+; SPIR-V
+; Version: 1.0
+; Generator: Khronos Glslang Reference Front End; 7
+; Bound: 96
+; Schema: 0
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %FragColor %vIndex
+               OpExecutionMode %main OriginUpperLeft
+               OpName %main "main"
+               OpName %FragColor "FragColor"
+               OpName %vIndex "vIndex"
+               OpName %Mode "Mode"
+               OpName %UseFog "UseFog"
+               OpName %Count "Count"
+               OpName %Shift "Shift"
+               OpName %StopEarly "StopEarly"
+               OpName %Variant "Variant"
+               OpName %ModeIsTwo "ModeIsTwo"
+               OpName %NegCount "NegCount"
+               OpName %Rem "Rem"
+               OpName %Bits "Bits"
+               OpDecorate %FragColor Location 0
+               OpDecorate %vIndex Flat
+               OpDecorate %vIndex Location 0
+               OpDecorate %Mode SpecId 0
+               OpDecorate %UseFog SpecId 1
+               OpDecorate %Count SpecId 2
+               OpDecorate %Shift SpecId 3
+               OpDecorate %StopEarly SpecId 4
+               OpDecorate %Variant SpecId 5
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+        %int = OpTypeInt 32 1
+       %uint = OpTypeInt 32 0
+       %bool = OpTypeBool
+    %v4float = OpTypeVector %float 4
+      %int_0 = OpConstant %int 0
+      %int_1 = OpConstant %int 1
+      %int_2 = OpConstant %int 2
+      %int_3 = OpConstant %int 3
+      %int_5 = OpConstant %int 5
+     %uint_0 = OpConstant %uint 0
+     %uint_1 = OpConstant %uint 1
+     %uint_2 = OpConstant %uint 2
+     %uint_3 = OpConstant %uint 3
+    %float_0 = OpConstant %float 0
+ %float_0_25 = OpConstant %float 0.25
+  %float_0_5 = OpConstant %float 0.5
+ %float_1_25 = OpConstant %float 1.25
+  %float_1_5 = OpConstant %float 1.5
+ %float_1_75 = OpConstant %float 1.75
+ %float_2_25 = OpConstant %float 2.25
+  %float_3_5 = OpConstant %float 3.5
+  %float_4_5 = OpConstant %float 4.5
+%float_0_125 = OpConstant %float 0.125
+ %float_5_25 = OpConstant %float 5.25
+  %float_5_5 = OpConstant %float 5.5
+ %float_6_25 = OpConstant %float 6.25
+ %float_6_75 = OpConstant %float 6.75
+     %v4zero = OpConstantComposite %v4float %float_0 %float_0 %float_0 %float_0
+       %Mode = OpSpecConstant %int 2
+     %UseFog = OpSpecConstantTrue %bool
+      %Count = OpSpecConstant %int 3
+      %Shift = OpSpecConstant %uint 4
+  %StopEarly = OpSpecConstantFalse %bool
+    %Variant = OpSpecConstant %int 1
+  %ModeIsTwo = OpSpecConstantOp %bool IEqual %Mode %int_2
+   %NegCount = OpSpecConstantOp %int SNegate %Count
+        %Rem = OpSpecConstantOp %int SMod %NegCount %int_5
+       %Bits = OpSpecConstantOp %uint ShiftLeftLogical %uint_1 %Shift
+ %ptr_out_v4 = OpTypePointer Output %v4float
+  %FragColor = OpVariable %ptr_out_v4 Output
+ %ptr_in_int = OpTypePointer Input %int
+     %vIndex = OpVariable %ptr_in_int Input
+%ptr_out_float = OpTypePointer Output %float
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+        %idx = OpLoad %int %vIndex
+               OpStore %FragColor %v4zero
+          %x = OpAccessChain %ptr_out_float %FragColor %uint_0
+          %y = OpAccessChain %ptr_out_float %FragColor %uint_1
+          %z = OpAccessChain %ptr_out_float %FragColor %uint_2
+          %w = OpAccessChain %ptr_out_float %FragColor %uint_3
+               OpSelectionMerge %fog_merge None
+               OpBranchConditional %UseFog %fog_then %fog_else
+   %fog_then = OpLabel
+               OpStore %x %float_0_25
+               OpBranch %fog_merge
+   %fog_else = OpLabel
+               OpStore %x %float_0_5
+               OpBranch %fog_merge
+  %fog_merge = OpLabel
+               OpSelectionMerge %sw_merge None
+               OpSwitch %Mode %sw_default 0 %case0 1 %case1 2 %case2
+      %case0 = OpLabel
+               OpStore %y %float_1_25
+               OpBranch %sw_merge
+      %case1 = OpLabel
+               OpStore %y %float_1_5
+               OpBranch %case2
+      %case2 = OpLabel
+        %yv = OpLoad %float %y
+       %yv2 = OpFAdd %float %yv %float_1_75
+               OpStore %y %yv2
+         %bf = OpConvertUToF %float %Bits
+               OpStore %z %bf
+               OpBranch %sw_merge
+ %sw_default = OpLabel
+               OpStore %y %float_2_25
+               OpBranch %sw_merge
+   %sw_merge = OpLabel
+               OpSelectionMerge %var_merge None
+               OpSwitch %Variant %var_default 1 %var_case1
+  %var_case1 = OpLabel
+       %vpos = OpSGreaterThan %bool %idx %int_0
+               OpSelectionMerge %var_if_merge None
+               OpBranchConditional %vpos %var_then %var_if_merge
+   %var_then = OpLabel
+               OpStore %z %float_5_25
+               OpBranch %var_merge
+%var_if_merge = OpLabel
+               OpStore %z %float_5_5
+               OpBranch %var_merge
+%var_default = OpLabel
+               OpStore %z %float_6_25
+               OpBranch %var_merge
+  %var_merge = OpLabel
+               OpStore %w %float_6_75
+               OpSelectionMerge %two_merge None
+               OpBranchConditional %ModeIsTwo %two_then %two_merge
+   %two_then = OpLabel
+        %pos = OpSGreaterThan %bool %idx %int_0
+               OpSelectionMerge %inner_merge None
+               OpBranchConditional %pos %inner_then %inner_merge
+ %inner_then = OpLabel
+               OpStore %w %float_4_5
+               OpBranch %inner_merge
+%inner_merge = OpLabel
+               OpBranch %two_merge
+  %two_merge = OpLabel
+       %remf = OpConvertSToF %float %Rem
+         %w0 = OpLoad %float %w
+         %w1 = OpFAdd %float %w0 %remf
+               OpStore %w %w1
+               OpBranch %loop_header
+%loop_header = OpLabel
+          %i = OpPhi %int %int_0 %two_merge %i_next %loop_continue
+               OpLoopMerge %loop_merge %loop_continue None
+               OpBranch %loop_cond
+  %loop_cond = OpLabel
+         %lt = OpSLessThan %bool %i %Count
+               OpBranchConditional %lt %loop_body %loop_merge
+  %loop_body = OpLabel
+               OpSelectionMerge %stop_merge None
+               OpBranchConditional %StopEarly %stop_then %stop_merge
+  %stop_then = OpLabel
+               OpStore %z %float_3_5
+               OpBranch %loop_merge
+ %stop_merge = OpLabel
+         %x0 = OpLoad %float %x
+         %x1 = OpFAdd %float %x0 %float_0_125
+               OpStore %x %x1
+               OpBranch %loop_continue
+%loop_continue = OpLabel
+     %i_next = OpIAdd %int %i %int_1
+               OpBranch %loop_header
+ %loop_merge = OpLabel
+               OpReturn
+               OpFunctionEnd
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that Compiler::fold_specialization_constants() keeps only the code which is taken with the given values,
+// for every backend. fold_spec_constants_test.spv branches on its specialization constants with if, switch and
+// a conditional break out of a loop, and uses specialization constant ops which need to be evaluated.
+// One switch breaks to its merge from inside a nested if, which only folds when the other case is taken.
+// Every path stores a different literal, so the literals in the output tell which paths were kept.
+// Usage: spirv-cross-fold-spec-constants-test <fold_spec_constants_test.spv>
+
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+enum Backend
+{
+	BackendGLSL,
+	BackendVulkanGLSL,
+	BackendHLSL,
+	BackendMSL,
+	BackendCount
+};
+
+static const char *backend_names[BackendCount] = { "GLSL", "Vulkan GLSL", "HLSL", "MSL" };
+
+static unique_ptr<CompilerGLSL> create_compiler(const ParsedIR &ir, Backend backend)
+{
+	switch (backend)
+	{
+	case BackendGLSL:
+	case BackendVulkanGLSL:
+	{
+		unique_ptr<CompilerGLSL> compiler(new CompilerGLSL(ir));
+		auto opts = compiler->get_common_options();
+		opts.version = 450;
+		opts.es = false;
+		opts.vulkan_semantics = backend == BackendVulkanGLSL;
+		compiler->set_common_options(opts);
+		return compiler;
+	}
+
+	case BackendHLSL:
+	{
+		auto *compiler = new CompilerHLSL(ir);
+		auto opts = compiler->get_hlsl_options();
+		opts.shader_model = 50;
+		compiler->set_hlsl_options(opts);
+		return unique_ptr<CompilerGLSL>(compiler);
+	}
+
+	default:
+		return unique_ptr<CompilerGLSL>(new CompilerMSL(ir));
+	}
+}
+
+// The values of the specialization constants with SpecId 0 to 5 in fold_spec_constants_test.spv.
+struct Values
+{
+	int mode;
+	bool use_fog;
+	int count;
+	uint32_t shift;
+	bool stop_early;
+	int variant;
+};
+
+static void set_values(Compiler &compiler, const Values &values)
+{
+	for (auto &sc : compiler.get_specialization_constants())
+	{
+		auto &c = compiler.get_constant(sc.id);
+		switch (sc.constant_id)
+		{
+		case 0:
+			c.m.c[0].r[0].i32 = values.mode;
+			break;
+		case 1:
+			c.m.c[0].r[0].u32 = values.use_fog;
+			break;
+		case 2:
+			c.m.c[0].r[0].i32 = values.count;
+			break;
+		case 3:
+			c.m.c[0].r[0].u32 = values.shift;
+			break;
+		case 4:
+			c.m.c[0].r[0].u32 = values.stop_early;
+			break;
+		case 5:
+			c.m.c[0].r[0].i32 = values.variant;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static unsigned count_occurrences(const string &source, const string &str)
+{
+	unsigned count = 0;
+	for (auto pos = source.find(str); pos != string::npos; pos = source.find(str, pos + 1))
+		count++;
+	return count;
+}
+
+static bool test_values(const ParsedIR &ir, Backend backend, const Values &values)
+{
+	auto compiler = create_compiler(ir, backend);
+	set_values(*compiler, values);
+	compiler->fold_specialization_constants();
+	auto source = compiler->compile();
+
+	// The literal stored by each path, and whether the path is taken with these values.
+	struct Path
+	{
+		const char *literal;
+		bool taken;
+	};
+	const Path paths[] = {
+		{ "0.25", values.use_fog },
+		{ "0.5", !values.use_fog },
+		{ "1.25", values.mode == 0 },
+		{ "1.5", values.mode == 1 },
+		{ "1.75", values.mode == 1 || values.mode == 2 },
+		{ "2.25", values.mode < 0 || values.mode > 2 },
+		{ "4.5", values.mode == 2 },
+		{ "3.5", values.stop_early },
+		{ "5.25", values.variant == 1 },
+		{ "5.5", values.variant == 1 },
+		// The default case stays along with the switch.
+		{ "6.25", true },
+	};
+
+	bool ok = true;
+	for (auto &path : paths)
+	{
+		if ((count_occurrences(source, path.literal) != 0) != path.taken)
+		{
+			fprintf(stderr, "%s: the path storing %s is %s.\n", backend_names[backend], path.literal,
+			        path.taken ? "missing" : "still there");
+			ok = false;
+		}
+	}
+
+	// Only the branches on the non-constant input are left, and the switch which is left when the case with the
+	// nested break is taken. The code after that switch is emitted once.
+	unsigned expected_switches = values.variant == 1 ? 1 : 0;
+	unsigned expected_ifs = (values.mode == 2 ? 1 : 0) + expected_switches;
+	if (count_occurrences(source, "switch") != expected_switches || count_occurrences(source, "if (") != expected_ifs ||
+	    count_occurrences(source, "6.75") != 1)
+	{
+		fprintf(stderr, "%s: constant branches were not removed correctly.\n", backend_names[backend]);
+		ok = false;
+	}
+
+	// The specialization constant ops are evaluated, -Count smod 5 and 1u << Shift.
+	int rem = -values.count % 5;
+	if (rem < 0)
+		rem += 5;
+	if (count_occurrences(source, join("float(", rem, ")")) != 1 ||
+	    ((values.mode == 1 || values.mode == 2) &&
+	     count_occurrences(source, join("(", 1u << values.shift, "u)")) != 1))
+	{
+		fprintf(stderr, "%s: specialization constant ops were not evaluated.\n", backend_names[backend]);
+		ok = false;
+	}
+
+	if (count_occurrences(source, "SPIRV_CROSS_CONSTANT_ID") != 0 || count_occurrences(source, "constant_id") != 0 ||
+	    count_occurrences(source, "function_constant") != 0 || !compiler->get_specialization_constants().empty())
+	{
+		fprintf(stderr, "%s: specialization constants are still declared.\n", backend_names[backend]);
+		ok = false;
+	}
+
+	if (!ok)
+		fprintf(stderr, "%s\n", source.c_str());
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-fold-spec-constants-test <fold_spec_constants_test.spv>\n");
+		return EXIT_FAILURE;
+	}
+
+	auto spirv = read_spirv_file(argv[1]);
+	if (spirv.empty())
+		return EXIT_FAILURE;
+
+	Parser parser(move(spirv));
+	parser.parse();
+	auto &ir = parser.get_parsed_ir();
+
+	const Values value_sets[] = {
+		{ 2, true, 3, 4, false, 1 }, { 0, false, 3, 4, false, 0 }, { 1, true, 4, 2, true, 1 },
+		{ 7, false, 7, 0, true, 2 }, { 2, false, 1, 31, true, 0 }, { -1, true, 0, 1, false, 1 },
+	};
+
+	unsigned count = 0;
+	for (auto &values : value_sets)
+	{
+		for (int backend = 0; backend < BackendCount; backend++)
+		{
+			if (!test_values(ir, Backend(backend), values))
+			{
+				fprintf(stderr, "Folding mode %d, fog %d, count %d, shift %u, stop %d, variant %d failed.\n",
+				        values.mode, values.use_fog, values.count, values.shift, values.stop_early, values.variant);
+				return EXIT_FAILURE;
+			}
+			count++;
+		}
+	}
+
+	printf("Folded specialization constants in %u compiles.\n", count);
+	return EXIT_SUCCESS;
+}
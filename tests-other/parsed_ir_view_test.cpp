@@ -0,0 +1,192 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that reflecting on a Compiler created from a copy-on-write view of a shared ParsedIR,
+// through const access only, clones nothing from the base. The reflection makes exactly as many allocations
+// as on a Compiler which owns a full copy, and every object and Meta it reads still lives in the base.
+// Compiling the view afterwards must give the same source as compiling the full copy.
+// Usage: spirv-cross-parsed-ir-view-test <file.spv>...
+
+#include "spirv_glsl.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+static size_t allocation_count;
+
+void *operator new(size_t size)
+{
+	allocation_count++;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw bad_alloc();
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+// Reads what an application typically reflects on, and returns a checksum so nothing is optimized away.
+static size_t reflect(const Compiler &compiler)
+{
+	size_t sum = 0;
+	auto &res = compiler.get_cached_shader_resources();
+	const vector<Resource> *lists[] = {
+		&res.uniform_buffers, &res.storage_buffers,  &res.stage_inputs,      &res.stage_outputs,
+		&res.storage_images,  &res.sampled_images,   &res.separate_images,   &res.separate_samplers,
+		&res.subpass_inputs,  &res.atomic_counters,  &res.push_constant_buffers
+	};
+
+	for (auto *list : lists)
+	{
+		for (auto &resource : *list)
+		{
+			sum += compiler.get_name(resource.id).size();
+			sum += compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+			sum += compiler.get_decoration(resource.id, spv::DecorationBinding);
+			sum += compiler.get_decoration(resource.id, spv::DecorationLocation);
+
+			auto &type = compiler.get_type(resource.base_type_id);
+			sum += type.basetype;
+			for (uint32_t i = 0; i < uint32_t(type.member_types.size()); i++)
+			{
+				sum += compiler.get_member_name(resource.base_type_id, i).size();
+				sum += compiler.get_member_decoration(resource.base_type_id, i, spv::DecorationOffset);
+			}
+			if (type.basetype == SPIRType::Struct)
+				sum += compiler.get_declared_struct_size(type);
+		}
+	}
+
+	sum += compiler.get_cached_active_interface_variables().size();
+	sum += compiler.get_cached_active_shader_resources().stage_inputs.size();
+	for (auto &c : compiler.get_specialization_constants())
+		sum += c.constant_id;
+	for (auto &entry : compiler.get_entry_points_and_stages())
+		sum += entry.name.size();
+	return sum;
+}
+
+// Constants, names and decorations of the view must all still be read from the base.
+// Types may not be, as creating a Compiler rewrites type aliases, so this counts the types which still are.
+static bool check_shared(const Compiler &compiler, const ParsedIR &base, uint32_t &shared_types)
+{
+	shared_types = 0;
+	for (uint32_t id = 0; id < uint32_t(base.ids.size()); id++)
+	{
+		switch (base.ids[id].get_type())
+		{
+		case TypeType:
+			if (&compiler.get_type(id) == &base.ids[id].get<SPIRType>())
+				shared_types++;
+			break;
+
+		case TypeConstant:
+			CHECK(&compiler.get_constant(id) == &base.ids[id].get<SPIRConstant>());
+			break;
+
+		default:
+			break;
+		}
+
+		CHECK(&compiler.get_name(id) == &base.get_name(id));
+		CHECK(&compiler.get_decoration_bitset(id) == &base.get_decoration_bitset(id));
+	}
+	return true;
+}
+
+static bool test_module(const vector<uint32_t> &spirv)
+{
+	Parser parser(spirv);
+	parser.parse();
+	auto base = make_shared<const ParsedIR>(move(parser.get_parsed_ir()));
+
+	// The first reflection in the process makes a few one-off allocations, which must not count for either.
+	reflect(CompilerGLSL(*base));
+
+	CompilerGLSL full(*base);
+	CompilerGLSL view{ ParsedIR(base) };
+	uint32_t shared_types = 0;
+	CHECK(check_shared(view, *base, shared_types));
+
+	size_t start = allocation_count;
+	size_t full_sum = reflect(full);
+	size_t full_count = allocation_count - start;
+
+	start = allocation_count;
+	size_t view_sum = reflect(view);
+	size_t view_count = allocation_count - start;
+
+	CHECK(view_sum == full_sum);
+	CHECK(view_count == full_count);
+	uint32_t shared_types_after = 0;
+	CHECK(check_shared(view, *base, shared_types_after));
+	CHECK(shared_types_after == shared_types);
+
+	// Compiling goes through non-const access, which clones into the view without touching the base.
+	auto opts = full.get_common_options();
+	if (!opts.version)
+		opts.version = 450;
+	opts.vulkan_semantics = true;
+	full.set_common_options(opts);
+	view.set_common_options(opts);
+	auto expected = full.compile();
+	CHECK(view.compile() == expected);
+
+	// The base must be unchanged after the view has written to its own clones.
+	CompilerGLSL after(*base);
+	after.set_common_options(opts);
+	CHECK(after.compile() == expected);
+
+	printf("Reflection made %u allocations on the view and on the full copy.\n", unsigned(view_count));
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-parsed-ir-view-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty() || !test_module(spirv))
+		{
+			fprintf(stderr, "%s failed.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Views of %d modules were reflected on without cloning.\n", argc - 1);
+	return EXIT_SUCCESS;
+}
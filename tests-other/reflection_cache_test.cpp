@@ -0,0 +1,190 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that the cached reflection of a Compiler is reused while nothing changes,
+// and matches a fresh Compiler after names, decorations and compiles change the module.
+// Also checks that several threads can reflect on one Compiler at once.
+// Usage: spirv-cross-reflection-cache-test <file.spv>...
+
+#include "spirv_glsl.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+static bool same(const Resource &a, const Resource &b)
+{
+	return a.id == b.id && a.type_id == b.type_id && a.base_type_id == b.base_type_id && a.name == b.name;
+}
+
+static bool same(const vector<Resource> &a, const vector<Resource> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (!same(a[i], b[i]))
+			return false;
+	return true;
+}
+
+static bool same(const ShaderResources &a, const ShaderResources &b)
+{
+	return same(a.uniform_buffers, b.uniform_buffers) && same(a.storage_buffers, b.storage_buffers) &&
+	       same(a.stage_inputs, b.stage_inputs) && same(a.stage_outputs, b.stage_outputs) &&
+	       same(a.subpass_inputs, b.subpass_inputs) && same(a.storage_images, b.storage_images) &&
+	       same(a.sampled_images, b.sampled_images) && same(a.atomic_counters, b.atomic_counters) &&
+	       same(a.push_constant_buffers, b.push_constant_buffers) &&
+	       same(a.separate_images, b.separate_images) && same(a.separate_samplers, b.separate_samplers);
+}
+
+// Renames every resource and gives it a new binding, the way an application would remap a pipeline layout.
+static void remap_resources(Compiler &compiler, const ShaderResources &res)
+{
+	const vector<Resource> *lists[] = { &res.uniform_buffers, &res.storage_buffers, &res.stage_inputs,
+		                                &res.stage_outputs,   &res.storage_images,  &res.sampled_images,
+		                                &res.separate_images, &res.separate_samplers };
+
+	uint32_t index = 0;
+	for (auto *list : lists)
+	{
+		for (auto &resource : *list)
+		{
+			compiler.set_name(resource.id, "remapped_" + to_string(index));
+			compiler.set_decoration(resource.id, spv::DecorationBinding, index++);
+		}
+	}
+}
+
+static bool test_module(const vector<uint32_t> &spirv)
+{
+	Parser parser(spirv);
+	parser.parse();
+	auto &ir = parser.get_parsed_ir();
+
+	CompilerGLSL compiler(ir);
+	auto opts = compiler.get_common_options();
+	if (!opts.version)
+		opts.version = 450;
+	opts.vulkan_semantics = true;
+	compiler.set_common_options(opts);
+
+	// Without changes in between, the same results come back without being collected again.
+	auto &res = compiler.get_cached_shader_resources();
+	auto *first_input = res.stage_inputs.data();
+	CHECK(&compiler.get_cached_shader_resources() == &res);
+	CHECK(compiler.get_cached_shader_resources().stage_inputs.data() == first_input);
+	CHECK(same(compiler.get_shader_resources(), res));
+	CHECK(compiler.get_active_interface_variables() == compiler.get_cached_active_interface_variables());
+	CHECK(same(compiler.get_cached_active_shader_resources(),
+	            compiler.get_shader_resources(compiler.get_active_interface_variables())));
+
+	// Names and decorations show up in the next call.
+	auto before = res;
+	remap_resources(compiler, before);
+
+	CompilerGLSL reference(ir);
+	reference.set_common_options(opts);
+	remap_resources(reference, before);
+	CHECK(same(compiler.get_cached_shader_resources(), reference.get_shader_resources()));
+	CHECK(same(compiler.get_cached_active_shader_resources(),
+	            reference.get_shader_resources(reference.get_active_interface_variables())));
+
+	// Compiling may rename or add resources, e.g. to avoid reserved identifiers.
+	compiler.compile();
+	reference.compile();
+	CHECK(same(compiler.get_cached_shader_resources(), reference.get_shader_resources()));
+	CHECK(compiler.get_cached_active_interface_variables() == reference.get_active_interface_variables());
+	return true;
+}
+
+static bool same(const vector<BufferRange> &a, const vector<BufferRange> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].index != b[i].index || a[i].offset != b[i].offset || a[i].range != b[i].range)
+			return false;
+	return true;
+}
+
+// Reflects on one Compiler from several threads, before anything is cached, and compares with a Compiler of its own.
+static bool test_concurrent_reflection(const vector<uint32_t> &spirv)
+{
+	Parser parser(spirv);
+	parser.parse();
+	auto &ir = parser.get_parsed_ir();
+
+	CompilerGLSL reference(ir);
+	auto expected = reference.get_shader_resources();
+	auto expected_active = reference.get_shader_resources(reference.get_active_interface_variables());
+	vector<vector<BufferRange>> expected_ranges;
+	for (auto &ubo : expected.uniform_buffers)
+		expected_ranges.push_back(reference.get_active_buffer_ranges(ubo.id));
+
+	enum
+	{
+		ThreadCount = 8
+	};
+
+	CompilerGLSL compiler(ir);
+	bool ok[ThreadCount] = {};
+	vector<thread> threads;
+	for (uint32_t i = 0; i < ThreadCount; i++)
+	{
+		threads.emplace_back([&, i]() {
+			bool result = same(compiler.get_shader_resources(), expected) &&
+			              same(compiler.get_cached_active_shader_resources(), expected_active);
+			for (size_t j = 0; j < expected.uniform_buffers.size(); j++)
+				result = result && same(compiler.get_active_buffer_ranges(expected.uniform_buffers[j].id),
+				                        expected_ranges[j]);
+			ok[i] = result;
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+	for (auto result : ok)
+		CHECK(result);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-reflection-cache-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty() || !test_module(spirv) || !test_concurrent_reflection(spirv))
+		{
+			fprintf(stderr, "%s failed.\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Cached reflection matched fresh reflection for %d modules.\n", argc - 1);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that Compiler::remove_unused_ir() removes what the entry point does not use, for every backend.
+// remove_unused_ir_test.spv has an unused function, struct, uniform block, private variable, specialization constant
+// and undef, a second entry point, and a uniform block whose last two members are only used by the other entry point.
+// Everything unused is named unused_* or Unused*, except unused_middle, which has to stay to keep the offsets.
+// Usage: spirv-cross-remove-unused-ir-test <remove_unused_ir_test.spv>
+
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+enum Backend
+{
+	BackendGLSL,
+	BackendHLSL,
+	BackendMSL,
+	BackendCount
+};
+
+static const char *backend_names[BackendCount] = { "GLSL", "HLSL", "MSL" };
+
+static unique_ptr<CompilerGLSL> create_compiler(const ParsedIR &ir, Backend backend)
+{
+	switch (backend)
+	{
+	case BackendGLSL:
+	{
+		unique_ptr<CompilerGLSL> compiler(new CompilerGLSL(ir));
+		auto opts = compiler->get_common_options();
+		opts.version = 450;
+		opts.es = false;
+		compiler->set_common_options(opts);
+		return compiler;
+	}
+
+	case BackendHLSL:
+	{
+		auto *compiler = new CompilerHLSL(ir);
+		auto opts = compiler->get_hlsl_options();
+		opts.shader_model = 50;
+		compiler->set_hlsl_options(opts);
+		return unique_ptr<CompilerGLSL>(compiler);
+	}
+
+	default:
+		return unique_ptr<CompilerGLSL>(new CompilerMSL(ir));
+	}
+}
+
+static bool contains(const string &source, const char *str)
+{
+	return source.find(str) != string::npos;
+}
+
+static bool test_backend(const ParsedIR &ir, Backend backend)
+{
+	auto compiler = create_compiler(ir, backend);
+	CHECK(compiler->get_entry_points_and_stages().size() == 2);
+	CHECK(compiler->get_shader_resources().uniform_buffers.size() == 2);
+	CHECK(compiler->get_specialization_constants().size() == 2);
+
+	compiler->remove_unused_ir();
+	auto source = compiler->compile();
+
+	const char *removed[] = { "unused_helper", "UnusedStruct", "unused_member", "UnusedBlock", "unused_ubo",
+		                      "unused_value",  "unused_global", "UnusedSpec",   "unused_tail0", "unused_tail1" };
+	for (auto *name : removed)
+	{
+		if (contains(source, name))
+		{
+			fprintf(stderr, "%s: %s is still declared.\n%s\n", backend_names[backend], name, source.c_str());
+			return false;
+		}
+	}
+
+	const char *kept[] = { "helper", "scale", "unused_middle", "offset", "UsedSpec" };
+	for (auto *name : kept)
+	{
+		if (!contains(source, name))
+		{
+			fprintf(stderr, "%s: %s was removed.\n%s\n", backend_names[backend], name, source.c_str());
+			return false;
+		}
+	}
+
+	// Only the other entry point used the last members of params. Data is loaded as a whole, so it keeps all members.
+	auto res = compiler->get_shader_resources();
+	CHECK(compiler->get_entry_points_and_stages().size() == 1);
+	CHECK(compiler->get_specialization_constants().size() == 1);
+	CHECK(res.uniform_buffers.size() == 1);
+	CHECK(res.storage_buffers.size() == 1);
+	CHECK(compiler->get_declared_struct_size(compiler->get_type(res.uniform_buffers[0].base_type_id)) == 32);
+	CHECK(compiler->get_declared_struct_size(compiler->get_type(res.storage_buffers[0].base_type_id)) == 48);
+
+	// Nothing else is unused afterwards.
+	auto again = create_compiler(ir, backend);
+	again->remove_unused_ir();
+	again->remove_unused_ir();
+	CHECK(again->compile() == source);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-remove-unused-ir-test <remove_unused_ir_test.spv>\n");
+		return EXIT_FAILURE;
+	}
+
+	auto spirv = read_spirv_file(argv[1]);
+	if (spirv.empty())
+		return EXIT_FAILURE;
+
+	Parser parser(move(spirv));
+	parser.parse();
+	auto &ir = parser.get_parsed_ir();
+
+	for (int backend = 0; backend < BackendCount; backend++)
+	{
+		if (!test_backend(ir, Backend(backend)))
+		{
+			fprintf(stderr, "%s failed.\n", backend_names[backend]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Removed unused IR for %d backends.\n", int(BackendCount));
+	return EXIT_SUCCESS;
+}
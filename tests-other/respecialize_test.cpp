@@ -0,0 +1,250 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that CompilerGLSL::respecialize() returns the same source as compiling from scratch with the new values,
+// for every backend, changing each specialization constant on its own and then all of them at once.
+// respecialize_test.spv uses its constants in arithmetic, in a composite, in a spec constant op,
+// as an array length and as an access chain index, so both the patched and the full compile path are taken.
+// Usage: spirv-cross-respecialize-test <file.spv>...
+
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+enum Backend
+{
+	BackendGLSL,
+	BackendVulkanGLSL,
+	BackendHLSL,
+	BackendMSL,
+	BackendCount
+};
+
+static const char *backend_names[BackendCount] = { "GLSL", "Vulkan GLSL", "HLSL", "MSL" };
+
+static unique_ptr<CompilerGLSL> create_compiler(const ParsedIR &ir, Backend backend)
+{
+	switch (backend)
+	{
+	case BackendGLSL:
+	case BackendVulkanGLSL:
+	{
+		unique_ptr<CompilerGLSL> compiler(new CompilerGLSL(ir));
+		auto opts = compiler->get_common_options();
+		opts.version = 450;
+		opts.es = false;
+		opts.vulkan_semantics = backend == BackendVulkanGLSL;
+		compiler->set_common_options(opts);
+		return compiler;
+	}
+
+	case BackendHLSL:
+	{
+		auto *compiler = new CompilerHLSL(ir);
+		auto opts = compiler->get_hlsl_options();
+		opts.shader_model = 50;
+		compiler->set_hlsl_options(opts);
+		return unique_ptr<CompilerGLSL>(compiler);
+	}
+
+	default:
+		return unique_ptr<CompilerGLSL>(new CompilerMSL(ir));
+	}
+}
+
+// A value which differs from the current one, and prints differently.
+static SpecializationConstantValue changed_value(const Compiler &compiler, uint32_t id)
+{
+	auto &c = compiler.get_constant(id);
+	auto &type = compiler.get_type(c.constant_type);
+	SpecializationConstantValue value = { id, type.width > 32 ? c.scalar_u64() : c.scalar() };
+
+	switch (type.basetype)
+	{
+	case SPIRType::Boolean:
+		value.value ^= 1;
+		break;
+
+	case SPIRType::Float:
+	{
+		float f = c.scalar_f32() + 1.5f;
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		value.value = bits;
+		break;
+	}
+
+	case SPIRType::Double:
+	{
+		double d = c.scalar_f64() + 1.5;
+		memcpy(&value.value, &d, sizeof(d));
+		break;
+	}
+
+	case SPIRType::Int:
+	case SPIRType::UInt:
+	case SPIRType::Int64:
+	case SPIRType::UInt64:
+		value.value += 1;
+		break;
+
+	default:
+		value.value ^= 1;
+		break;
+	}
+
+	return value;
+}
+
+static string compile_from_scratch(const ParsedIR &ir, Backend backend, const vector<SpecializationConstantValue> &values)
+{
+	auto compiler = create_compiler(ir, backend);
+	for (auto &value : values)
+	{
+		auto &c = compiler->get_constant(value.id);
+		if (compiler->get_type(c.constant_type).width > 32)
+			c.m.c[0].r[0].u64 = value.value;
+		else
+			c.m.c[0].r[0].u32 = uint32_t(value.value);
+	}
+	return compiler->compile();
+}
+
+struct Counts
+{
+	unsigned patched = 0;
+	unsigned full = 0;
+};
+
+static bool test_backend(const ParsedIR &ir, Backend backend, Counts &counts)
+{
+	auto compiler = create_compiler(ir, backend);
+	string original;
+	try
+	{
+		original = compiler->compile();
+	}
+	catch (const CompilerError &)
+	{
+		// Not every module compiles for every backend, which is not what this test is about.
+		return true;
+	}
+
+	vector<SpecializationConstantValue> defaults;
+	vector<SpecializationConstantValue> all_changed;
+	for (auto &sc : compiler->get_specialization_constants())
+	{
+		auto &c = compiler->get_constant(sc.id);
+		if (c.vector_size() != 1 || c.columns() != 1 || !c.subconstants.empty())
+			continue;
+
+		auto &type = compiler->get_type(c.constant_type);
+		defaults.push_back({ sc.id, type.width > 32 ? c.scalar_u64() : c.scalar() });
+		all_changed.push_back(changed_value(*compiler, sc.id));
+	}
+
+	vector<vector<SpecializationConstantValue>> value_sets;
+	for (auto &value : all_changed)
+		value_sets.push_back({ value });
+	if (all_changed.size() > 1)
+		value_sets.push_back(all_changed);
+
+	for (auto &values : value_sets)
+	{
+		string source;
+		if (!compiler->respecialize(values, source))
+		{
+			// A constant is used in a way which needs a full compile, which is left to a new compiler.
+			if (compiler->get_partial_source() != original)
+			{
+				fprintf(stderr, "%s: a failed respecialize() changed the source.\n", backend_names[backend]);
+				return false;
+			}
+			counts.full++;
+			continue;
+		}
+		counts.patched++;
+
+		if (source != compile_from_scratch(ir, backend, values))
+		{
+			fprintf(stderr, "%s: respecializing constant %u did not match a full compile.\n", backend_names[backend],
+			        values.front().id);
+			return false;
+		}
+
+		// Going back to the defaults gives the first source again.
+		string restored;
+		if (!compiler->respecialize(defaults, restored) || restored != original)
+		{
+			fprintf(stderr, "%s: going back to the default of constant %u did not give the original source.\n",
+			        backend_names[backend], values.front().id);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-respecialize-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	Counts counts;
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		Parser parser(move(spirv));
+		parser.parse();
+		auto &ir = parser.get_parsed_ir();
+
+		for (int backend = 0; backend < BackendCount; backend++)
+		{
+			if (!test_backend(ir, Backend(backend), counts))
+			{
+				fprintf(stderr, "%s failed.\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	// Make sure the patched path was taken at all.
+	if (counts.patched == 0)
+	{
+		fprintf(stderr, "No specialization constant could be changed without a full compile.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%u respecializations patched the source and matched a full compile, %u needed a full compile.\n",
+	       counts.patched, counts.full);
+	return EXIT_SUCCESS;
+}
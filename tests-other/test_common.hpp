@@ -0,0 +1,62 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_TEST_COMMON_HPP
+#define SPIRV_CROSS_TEST_COMMON_HPP
+
+// Helpers shared by the programs in tests-other/ and benchmarks/.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Fails the calling function, which returns bool, and reports the line of the check which did not hold.
+#define CHECK(x)                                                            \
+	do                                                                      \
+	{                                                                       \
+		if (!(x))                                                           \
+		{                                                                   \
+			fprintf(stderr, "Check failed at line %d: %s\n", __LINE__, #x); \
+			return false;                                                   \
+		}                                                                   \
+	} while (0)
+
+namespace spirv_cross_test
+{
+// Returns the words of a SPIR-V file, or an empty vector if it cannot be read.
+inline std::vector<uint32_t> read_spirv_file(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open SPIR-V file: %s\n", path);
+		return {};
+	}
+
+	fseek(file, 0, SEEK_END);
+	long len = ftell(file) / sizeof(uint32_t);
+	rewind(file);
+
+	std::vector<uint32_t> spirv(len);
+	if (fread(spirv.data(), sizeof(uint32_t), len, file) != size_t(len))
+		spirv.clear();
+
+	fclose(file);
+	return spirv;
+}
+} // namespace spirv_cross_test
+
+#endif
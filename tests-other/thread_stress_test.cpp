@@ -0,0 +1,175 @@
+/*
+ * Copyright 2019 Arm Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles modules with many independent compilers on many threads at once in a locale with a decimal comma,
+// and checks that every result matches a single threaded compile in the classic locale,
+// and that the global locale is left alone.
+// Usage: spirv-cross-thread-stress-test <file.spv>...
+
+#include "spirv_hlsl.hpp"
+#include "spirv_msl.hpp"
+#include "spirv_parser.hpp"
+#include "test_common.hpp"
+#include <atomic>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <locale>
+#include <thread>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+using namespace spirv_cross_test;
+
+// Formats 1000.5 as "1.000,5", like many European locales do.
+struct CommaNumpunct : numpunct<char>
+{
+	char do_decimal_point() const override
+	{
+		return ',';
+	}
+
+	char do_thousands_sep() const override
+	{
+		return '.';
+	}
+
+	string do_grouping() const override
+	{
+		return "\3";
+	}
+};
+
+enum Backend
+{
+	BackendGLSL,
+	BackendHLSL,
+	BackendMSL,
+	BackendCount
+};
+
+static string compile(const ParsedIR &ir, Backend backend)
+{
+	switch (backend)
+	{
+	case BackendGLSL:
+	{
+		CompilerGLSL compiler(ir);
+		auto opts = compiler.get_common_options();
+		opts.version = 450;
+		opts.es = false;
+		opts.vulkan_semantics = true;
+		compiler.set_common_options(opts);
+		return compiler.compile();
+	}
+
+	case BackendHLSL:
+	{
+		CompilerHLSL compiler(ir);
+		auto opts = compiler.get_hlsl_options();
+		opts.shader_model = 50;
+		compiler.set_hlsl_options(opts);
+		return compiler.compile();
+	}
+
+	default:
+	{
+		CompilerMSL compiler(ir);
+		return compiler.compile();
+	}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: spirv-cross-thread-stress-test <file.spv>...\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned thread_count = 8;
+	const unsigned iterations = 30;
+
+	vector<ParsedIR> modules;
+	for (int i = 1; i < argc; i++)
+	{
+		auto spirv = read_spirv_file(argv[i]);
+		if (spirv.empty())
+			return EXIT_FAILURE;
+
+		Parser parser(move(spirv));
+		parser.parse();
+		modules.push_back(move(parser.get_parsed_ir()));
+	}
+
+	// The reference output, compiled in the classic locale before anything else runs.
+	vector<string> reference;
+	for (auto &ir : modules)
+		for (int backend = 0; backend < BackendCount; backend++)
+			reference.push_back(compile(ir, Backend(backend)));
+
+	// Use a C locale with a decimal comma if this system has one, so sprintf() is affected as well.
+	const char *c_locales[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8" };
+	for (auto *name : c_locales)
+		if (setlocale(LC_ALL, name))
+			break;
+
+	// Every new stream picks up the global C++ locale.
+	locale comma_locale(locale::classic(), new CommaNumpunct);
+	locale::global(comma_locale);
+
+	atomic<unsigned> failures(0);
+	vector<thread> workers;
+	for (unsigned i = 0; i < thread_count; i++)
+	{
+		workers.emplace_back([&, i]() {
+			for (unsigned iteration = 0; iteration < iterations; iteration++)
+			{
+				// Every thread goes through the modules and backends in a different order.
+				size_t job = (i + iteration) % reference.size();
+				if (compile(modules[job / BackendCount], Backend(job % BackendCount)) != reference[job])
+					failures++;
+			}
+		});
+	}
+
+	for (auto &worker : workers)
+		worker.join();
+
+	// Compiling must leave the application's locale alone, even when compiles overlap.
+	bool locale_changed = locale() != comma_locale;
+
+	locale::global(locale::classic());
+	setlocale(LC_ALL, "C");
+
+	if (failures)
+	{
+		fprintf(stderr, "%u of %u concurrent compiles did not match the reference.\n", unsigned(failures),
+		        thread_count * iterations);
+		return EXIT_FAILURE;
+	}
+
+	if (locale_changed)
+	{
+		fprintf(stderr, "The global locale was changed by compiling.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%u concurrent compiles matched the reference.\n", thread_count * iterations);
+	return EXIT_SUCCESS;
+}